@@ -0,0 +1,53 @@
+#version 430
+
+// Input Data (quantised, see create_packed_vao())
+layout(location = 0) in vec3 iPosition;  // UNORM16, relative to the AABB
+layout(location = 1) in vec2 iNormal;    // octahedral, SNORM16
+layout(location = 2) in vec3 iAmbient;
+layout(location = 3) in vec3 iDiffuse;
+layout(location = 4) in vec3 iSpecular;
+layout(location = 5) in float iShininess;
+layout(location = 6) in vec3 iEmissive;
+
+// Per instance: rows of the model-to-world matrix (rotation + translation)
+layout(location = 7) in vec4 iModel2World0;
+layout(location = 8) in vec4 iModel2World1;
+layout(location = 9) in vec4 iModel2World2;
+
+// uniform
+layout(location = 0) uniform mat4 uProjCameraWorld;
+layout(location = 16) uniform vec3 uPositionOrigin;
+layout(location = 17) uniform vec3 uPositionScale;
+
+// Outputs
+layout(location = 0) out vec3 v2fPosition;
+layout(location = 1) out vec3 v2fNormal;
+layout(location = 2) out vec3 v2fAmbient;
+layout(location = 3) out vec3 v2fDiffuse;
+layout(location = 4) out vec3 v2fSpecular;
+layout(location = 5) out float v2fShininess;
+layout(location = 6) out vec3 v2fEmissive;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
+void main() {
+    vec4 model = vec4(uPositionOrigin + uPositionScale * iPosition, 1.0);
+    vec3 world = vec3(dot(iModel2World0, model), dot(iModel2World1, model), dot(iModel2World2, model));
+
+    // The rotation block is orthogonal, so it is its own normal matrix
+    vec3 normal = octDecode(iNormal);
+    v2fNormal = normalize(vec3(dot(iModel2World0.xyz, normal), dot(iModel2World1.xyz, normal), dot(iModel2World2.xyz, normal)));
+
+    v2fPosition = world;
+    v2fAmbient = iAmbient;
+    v2fDiffuse = iDiffuse;
+    v2fSpecular = iSpecular;
+    v2fShininess = iShininess;
+    v2fEmissive = iEmissive;
+    gl_Position = uProjCameraWorld * vec4(world, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 430
+
+// input
+layout(location = 0) in vec2 v2fCorner;
+layout(location = 1) in vec4 v2fColor;
+
+// output
+layout(location = 0) out vec4 oColor;
+
+void main() {
+    // Round, soft edged sprite
+    float r2 = dot(v2fCorner, v2fCorner);
+    if (r2 >= 1.0) discard;
+    float falloff = 1.0 - r2;
+    oColor = vec4(v2fColor.rgb, v2fColor.a * falloff * falloff);
+}
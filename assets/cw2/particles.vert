@@ -0,0 +1,42 @@
+#version 430
+
+// Input Data: one particle per instance (see ParticleRenderer)
+layout(location = 0) in float iX;
+layout(location = 1) in float iY;
+layout(location = 2) in float iZ;
+layout(location = 3) in float iFade;  // fraction of its life gone; >= 1 dead
+
+// uniform
+layout(location = 0) uniform mat4 uProjCameraWorld;
+layout(location = 1) uniform vec3 uCameraRight;  // world space
+layout(location = 2) uniform vec3 uCameraUp;
+layout(location = 3) uniform float uSize;  // world units, at birth
+
+// Outputs
+layout(location = 0) out vec2 v2fCorner;
+layout(location = 1) out vec4 v2fColor;
+
+void main() {
+    if (iFade >= 1.0) {
+        // Dead: every corner in one place, so nothing is rasterised
+        gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+        v2fCorner = vec2(0.0);
+        v2fColor = vec4(0.0);
+        return;
+    }
+
+    // Triangle strip over the corners (-1,-1) (1,-1) (-1,1) (1,1)
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    float size = uSize * (0.5 + 2.0 * iFade);  // the plume spreads out
+    vec3 position = vec3(iX, iY, iZ) +
+                    size * (corner.x * uCameraRight + corner.y * uCameraUp);
+
+    // White hot at the nozzle, through orange, to faint smoke
+    vec3 hot = mix(vec3(1.0, 0.9, 0.6), vec3(1.0, 0.35, 0.05),
+                   smoothstep(0.0, 0.3, iFade));
+    vec3 color = mix(hot, vec3(0.15), smoothstep(0.3, 0.8, iFade));
+
+    v2fCorner = corner;
+    v2fColor = vec4(color, 0.5 * (1.0 - iFade));
+    gl_Position = uProjCameraWorld * vec4(position, 1.0);
+}
@@ -0,0 +1,39 @@
+#version 430
+
+// Input Data: a vertex of the shared tile grid (see Terrain)
+layout(location = 0) in vec3 iGrid;  // sample column, row, 1 on skirts
+
+// uniform
+layout(location = 0) uniform mat4 uProjCameraWorld;
+layout(location = 16) uniform vec2 uTileOrigin;  // world XZ of sample (0, 0)
+layout(location = 17) uniform vec3 uTileHeight;  // min, max - min, skirt depth
+layout(location = 18) uniform float uSpacing;
+layout(location = 19) uniform vec3 uTexU;  // u = dot(uTexU, vec3(x, z, 1))
+layout(location = 20) uniform vec3 uTexV;
+
+// UNORM16 heights with a one-sample apron around the tile
+layout(binding = 1) uniform sampler2D uHeights;
+
+// Outputs
+layout(location = 0) out vec3 v2fPosition;
+layout(location = 1) out vec3 v2fNormal;
+layout(location = 2) out vec2 v2fTexCoord;
+
+float height(ivec2 s) {
+    return uTileHeight.x + uTileHeight.y * texelFetch(uHeights, s + 1, 0).r;
+}
+
+void main() {
+    ivec2 s = ivec2(iGrid.xy);
+    vec2 xz = uTileOrigin + uSpacing * vec2(s);
+    float y = height(s) - iGrid.z * uTileHeight.z;
+
+    // Central differences; the apron provides the samples across the edges
+    float dx = height(s + ivec2(1, 0)) - height(s - ivec2(1, 0));
+    float dz = height(s + ivec2(0, 1)) - height(s - ivec2(0, 1));
+
+    v2fPosition = vec3(xz.x, y, xz.y);
+    v2fNormal = normalize(vec3(-dx, 2.0 * uSpacing, -dz));
+    v2fTexCoord = vec2(dot(uTexU, vec3(xz, 1.0)), dot(uTexV, vec3(xz, 1.0)));
+    gl_Position = uProjCameraWorld * vec4(v2fPosition, 1.0);
+}
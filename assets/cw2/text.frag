@@ -0,0 +1,16 @@
+#version 430
+
+// input
+layout(location = 0) in vec4 v2fColor;
+layout(location = 1) in vec2 v2fTexel;
+
+// Glyph coverage
+layout(binding = 0) uniform sampler2D uAtlas;
+
+// output
+layout(location = 0) out vec4 oColor;
+
+void main() {
+    vec2 uv = v2fTexel / vec2(textureSize(uAtlas, 0));
+    oColor = vec4(v2fColor.rgb, v2fColor.a * texture(uAtlas, uv).r);
+}
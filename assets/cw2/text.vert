@@ -0,0 +1,19 @@
+#version 430
+
+// Input Data: a TextVertex (see text.hpp)
+layout(location = 0) in vec2 iPosition;  // framebuffer pixels
+layout(location = 1) in vec4 iColor;
+layout(location = 2) in vec2 iTexel;  // glyph atlas texels
+
+// uniform
+layout(location = 0) uniform vec2 uViewport;  // framebuffer size in pixels
+
+// Outputs
+layout(location = 0) out vec4 v2fColor;
+layout(location = 1) out vec2 v2fTexel;
+
+void main() {
+    v2fColor = iColor;
+    v2fTexel = iTexel;
+    gl_Position = vec4(2.0 * iPosition / uViewport - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 430
+
+// Input Data: points of predicted paths (see TrajectoryRenderer)
+layout(location = 0) in vec3 iPosition;
+
+// uniform
+layout(location = 0) uniform mat4 uProjCameraWorld;
+layout(location = 1) uniform int uPathLength;  // points per path
+
+// Outputs
+layout(location = 0) out vec4 v2fColor;
+
+void main() {
+    // Paths are drawn one after the other, so this is how far along its
+    // path the point is; it fades out towards the end
+    float along = float(gl_VertexID % uPathLength) / float(uPathLength - 1);
+
+    v2fColor = vec4(0.3, 0.9, 1.0, 0.8 * (1.0 - along));
+    gl_Position = uProjCameraWorld * vec4(iPosition, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 430
+
+// input
+layout(location = 0) in vec4 v2fColor;
+
+// output
+layout(location = 0) out vec4 oColor;
+
+void main() {
+    oColor = v2fColor;
+}
@@ -1,9 +1,16 @@
 #version 430
 
-// Input Data
-layout(location = 0) in vec3 iPosition;
+// Input Data: a UiVertex (see ui_batch.hpp)
+layout(location = 0) in vec2 iPosition;  // framebuffer pixels
+layout(location = 1) in vec4 iColor;
 
+// uniform
+layout(location = 0) uniform vec2 uViewport;  // framebuffer size in pixels
+
+// Outputs
+layout(location = 0) out vec4 v2fColor;
 
 void main() {
-    gl_Position = vec4(iPosition, 1.0);
-}
\ No newline at end of file
+    v2fColor = iColor;
+    gl_Position = vec4(2.0 * iPosition / uViewport - 1.0, 0.0, 1.0);
+}
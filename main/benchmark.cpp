@@ -0,0 +1,66 @@
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include "../support/error.hpp"
+
+namespace {
+struct Benchmark {
+  char const* name;
+  BenchmarkFn fn;
+};
+
+// Function-local so that registration from other translation units does not
+// depend on static initialisation order
+std::vector<Benchmark>& registry_() {
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+}  // namespace
+
+BenchmarkRegistration::BenchmarkRegistration(char const* aName,
+                                             BenchmarkFn aFn) {
+  registry_().push_back(Benchmark{aName, aFn});
+}
+
+int run_benchmarks(char const* aFilter) {
+  auto benchmarks = registry_();
+  std::sort(benchmarks.begin(), benchmarks.end(),
+            [](Benchmark const& aA, Benchmark const& aB) {
+              return std::strcmp(aA.name, aB.name) < 0;
+            });
+
+  std::size_t count = 0;
+  std::size_t failed = 0;
+  for (auto const& b : benchmarks) {
+    if (!std::strstr(b.name, aFilter)) continue;
+
+    std::printf("== %s\n", b.name);
+    try {
+      b.fn();
+    } catch (Error const& eErr) {
+      std::printf("  FAILED: %s\n", eErr.what());
+      ++failed;
+    }
+    std::printf("\n");
+    ++count;
+  }
+
+  if (0 == count) {
+    std::fprintf(stderr, "No benchmark matches '%s'. Available:\n", aFilter);
+    for (auto const& b : benchmarks) std::fprintf(stderr, "  %s\n", b.name);
+    return 1;
+  }
+  if (failed > 0) {
+    std::fprintf(stderr, "%zu of %zu benchmark(s) failed\n", failed, count);
+    return 1;
+  }
+  return 0;
+}
+
+void print_timing(char const* aLabel, BenchmarkTiming const& aTiming) {
+  std::printf("  %-40s min %9.4f ms  median %9.4f ms  mean %9.4f ms  (%zu)\n",
+              aLabel, aTiming.minMs, aTiming.medianMs, aTiming.meanMs,
+              aTiming.iterations);
+}
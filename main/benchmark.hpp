@@ -0,0 +1,62 @@
+#ifndef BENCHMARK_HPP_E4C7A1B9_2D35_4F86_8B0E_6A9C3F5D1E27
+#define BENCHMARK_HPP_E4C7A1B9_2D35_4F86_8B0E_6A9C3F5D1E27
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "defaults.hpp"
+
+/* CPU micro-benchmarks
+ *
+ * Run with `main --bench [filter]`; every benchmark whose name contains the
+ * filter runs, without opening a window. Benchmarks live in main/benchmarks/
+ * and register themselves with a file-scope BenchmarkRegistration. A
+ * benchmark that also checks its results throws Error when they are wrong;
+ * run_benchmarks() reports it, runs the rest and returns non-zero.
+ */
+using BenchmarkFn = void (*)();
+
+struct BenchmarkRegistration {
+  BenchmarkRegistration(char const* aName, BenchmarkFn aFn);
+};
+
+int run_benchmarks(char const* aFilter);
+
+// Per-iteration wall clock times in milliseconds
+struct BenchmarkTiming {
+  std::size_t iterations = 0;
+  double minMs = 0.0;
+  double medianMs = 0.0;
+  double meanMs = 0.0;
+};
+
+// Runs aFn once to warm up, then aIterations timed times
+template <typename Fn>
+BenchmarkTiming time_iterations(std::size_t aIterations, Fn&& aFn) {
+  aFn();
+
+  std::vector<double> times(aIterations);
+  for (auto& t : times) {
+    auto const start = Clock::now();
+    aFn();
+    t = std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+  }
+
+  BenchmarkTiming ret;
+  ret.iterations = aIterations;
+  if (times.empty()) return ret;
+
+  for (double t : times) ret.meanMs += t;
+  ret.meanMs /= double(times.size());
+  std::sort(times.begin(), times.end());
+  ret.minMs = times.front();
+  ret.medianMs = times[times.size() / 2];
+  return ret;
+}
+
+void print_timing(char const* aLabel, BenchmarkTiming const&);
+
+#endif  // BENCHMARK_HPP_E4C7A1B9_2D35_4F86_8B0E_6A9C3F5D1E27
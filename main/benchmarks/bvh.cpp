@@ -0,0 +1,102 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../../support/error.hpp"
+#include "../benchmark.hpp"
+#include "../bvh.hpp"
+
+namespace {
+constexpr std::size_t kObjects = 100000;
+constexpr std::size_t kQueries = 1000;
+// Objects are scattered through a cube of this half-width
+constexpr float kWorldSize = 500.f;
+
+void print_rate_(char const* aLabel, BenchmarkTiming const& aTiming) {
+  print_timing(aLabel, aTiming);
+  std::printf("  %.0f queries/s\n",
+              double(kQueries) / (aTiming.medianMs * 1e-3));
+}
+
+void bench_bvh_() {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> position(-kWorldSize, kWorldSize);
+  std::uniform_real_distribution<float> size(0.5f, 2.f);
+  std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+  std::vector<Aabb> bounds(kObjects);
+  for (Aabb& box : bounds) {
+    Vec3f const c{position(rng), position(rng), position(rng)};
+    Vec3f const h{size(rng), size(rng), size(rng)};
+    box = Aabb{c - h, c + h};
+  }
+
+  Bvh bvh;
+  std::printf("%zu objects\n", kObjects);
+  print_timing("build", time_iterations(10, [&] { bvh.build(bounds); }));
+  std::printf("  %zu nodes\n", bvh.nodeCount());
+
+  // Everything drifts a little each frame, as the fleet does
+  std::vector<Vec3f> drift(kObjects);
+  for (Vec3f& d : drift) d = 0.01f * Vec3f{unit(rng), unit(rng), unit(rng)};
+  print_timing("setBounds + refit", time_iterations(20, [&] {
+                 for (std::size_t i = 0; i < kObjects; ++i) {
+                   bounds[i] = Aabb{bounds[i].min + drift[i],
+                                    bounds[i].max + drift[i]};
+                   bvh.setBounds(Bvh::ObjectId(i), bounds[i]);
+                 }
+                 bvh.refit();
+               }));
+  std::printf("  cost ratio after refits: %.3f\n", bvh.costRatio());
+
+  std::vector<Mat44f> views(kQueries);
+  std::vector<Ray> rays(kQueries);
+  std::vector<Vec3f> centres(kQueries);
+  Mat44f const projection =
+      make_perspective_projection(1.f, 16.f / 9.f, 0.1f, 200.f);
+  for (std::size_t q = 0; q < kQueries; ++q) {
+    Vec3f const eye{position(rng), position(rng), position(rng)};
+    views[q] = projection * make_rotation_y(3.f * unit(rng)) *
+               make_translation(-eye);
+    rays[q] = Ray{eye, normalize(Vec3f{unit(rng), unit(rng), unit(rng)})};
+    centres[q] = eye;
+  }
+
+  std::size_t found = 0;
+  print_rate_("frustum queries", time_iterations(5, [&] {
+                for (Mat44f const& view : views)
+                  bvh.queryFrustum(make_frustum(view),
+                                   [&](Bvh::ObjectId) { ++found; });
+              }));
+  print_rate_("ray casts", time_iterations(5, [&] {
+                for (Ray const& ray : rays)
+                  found += bvh.raycast(ray).object != Bvh::Hit{}.object;
+              }));
+  print_rate_("sphere queries, radius 20", time_iterations(5, [&] {
+                for (Vec3f const& c : centres)
+                  bvh.querySphere(c, 20.f, [&](Bvh::ObjectId) { ++found; });
+              }));
+  std::printf("(%zu results)\n", found);
+
+  // Rays along a face of a box, parallel to two axes, touch it whichever
+  // face it is
+  Aabb const box{Vec3f{-1.f, -1.f, -1.f}, Vec3f{1.f, 1.f, 1.f}};
+  for (std::size_t axis = 0; axis < 3; ++axis) {
+    for (float face : {-1.f, 1.f}) {
+      Vec3f origin{0.f, 0.f, 0.f};
+      origin[axis] = face;
+      origin[(axis + 1) % 3] = -5.f;
+      Vec3f direction{0.f, 0.f, 0.f};
+      direction[(axis + 1) % 3] = 1.f;
+      Vec3f const invDir{1.f / direction.x, 1.f / direction.y,
+                         1.f / direction.z};
+      if (!(intersect(Ray{origin, direction}, invDir, box) == 4.f)) {
+        throw Error("A ray along face %+g of axis %zu misses the box",
+                    double(face), axis);
+      }
+    }
+  }
+}
+
+BenchmarkRegistration const kBvhBenchmark("bvh", &bench_bvh_);
+}  // namespace
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../../support/error.hpp"
+#include "../benchmark.hpp"
+#include "../collision.hpp"
+#include "../job_system.hpp"
+#include "../simulation.hpp"
+
+namespace {
+// Bodies drifting inside a cube, with room for about a dozen neighbours
+// each to overlap
+struct Swarm {
+  std::vector<Vec3f> position, velocity;
+  float size = 0.f;
+  float radius = 0.35f;
+
+  Swarm(std::size_t aCount, std::uint32_t aSeed) {
+    size = 2.2f * std::cbrt(float(aCount));
+    std::mt19937 rng(aSeed);
+    std::uniform_real_distribution<float> where(0.f, size);
+    std::uniform_real_distribution<float> speed(-1.f, 1.f);
+    for (std::size_t i = 0; i < aCount; ++i) {
+      position.push_back(Vec3f{where(rng), where(rng), where(rng)});
+      velocity.push_back(Vec3f{speed(rng), speed(rng), speed(rng)});
+    }
+  }
+
+  Aabb bounds(std::size_t aIndex) const {
+    Vec3f const reach{radius, radius, radius};
+    return Aabb{position[aIndex] - reach, position[aIndex] + reach};
+  }
+
+  // One tick, bouncing off the walls
+  void move(BroadPhase& aBroadPhase) {
+    for (std::size_t i = 0; i < position.size(); ++i) {
+      Vec3f& p = position[i];
+      p += velocity[i] * kSimulationStep;
+      for (std::size_t a = 0; a < 3; ++a) {
+        if (p[a] < 0.f || p[a] > size) velocity[i][a] = -velocity[i][a];
+      }
+      aBroadPhase.setBounds(BroadPhase::BodyId(i), bounds(i));
+    }
+  }
+};
+
+// Every overlapping pair, by testing all of them
+std::vector<BroadPhasePair> find_pairs_directly_(Swarm const& aSwarm) {
+  std::vector<BroadPhasePair> pairs;
+  for (std::size_t i = 0; i < aSwarm.position.size(); ++i) {
+    Aabb const a = aSwarm.bounds(i);
+    for (std::size_t j = i + 1; j < aSwarm.position.size(); ++j) {
+      Aabb const b = aSwarm.bounds(j);
+      if (a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y &&
+          b.min.y <= a.max.y && a.min.z <= b.max.z && b.min.z <= a.max.z)
+        pairs.push_back(BroadPhasePair{std::uint32_t(i), std::uint32_t(j)});
+    }
+  }
+  return pairs;
+}
+
+// The broad phase must find exactly the pairs the all-pairs test finds
+void check_pairs_(BroadPhase const& aBroadPhase, Swarm const& aSwarm,
+                  char const* aWhen) {
+  auto const before = [](BroadPhasePair aL, BroadPhasePair aR) {
+    return aL.a < aR.a || (aL.a == aR.a && aL.b < aR.b);
+  };
+  std::vector<BroadPhasePair> found(aBroadPhase.pairs().begin(),
+                                    aBroadPhase.pairs().end());
+  std::sort(found.begin(), found.end(), before);
+  std::vector<BroadPhasePair> const expected = find_pairs_directly_(aSwarm);
+  bool const same = std::equal(
+      found.begin(), found.end(), expected.begin(), expected.end(),
+      [](BroadPhasePair aL, BroadPhasePair aR) {
+        return aL.a == aR.a && aL.b == aR.b;
+      });
+  if (!same) {
+    throw Error("%zu bodies %s: %zu pairs found, %zu overlap",
+                aSwarm.position.size(), aWhen, found.size(), expected.size());
+  }
+}
+
+// Roughly the player's ship: hull, nose and three legs
+CollisionShape make_ship_shape_() {
+  CollisionShape shape;
+  add_cylinder_capsules(shape, Vec3f{0.f, 0.f, 0.f}, Vec3f{0.f, 0.08f, 0.f},
+                        0.2f, false);
+  add_cylinder_capsules(shape, Vec3f{0.f, 0.12f, 0.f},
+                        Vec3f{0.f, 0.16f, 0.f}, 0.2f, true);
+  Vec3f const nose[3] = {Vec3f{0.02f, 0.f, 0.f}, Vec3f{0.f, 0.08f, 0.f},
+                         Vec3f{0.f, 0.f, 0.02f}};
+  add_ellipsoid_capsule(shape, Vec3f{0.f, 0.32f, 0.f}, nose);
+  for (float x : {-0.1f, 0.f, 0.1f}) {
+    add_cylinder_capsules(shape, Vec3f{x, 0.f, 0.1f}, Vec3f{x, -0.08f, 0.1f},
+                          0.004f, false);
+  }
+  update_bounds(shape);
+  return shape;
+}
+
+void bench_collision_() {
+  JobSystem jobs;
+  char label[64];
+
+  // Correctness, with too few bodies for more than one slab and with many:
+  // after the first update, which sorts from scratch, and after ticks
+  // sorted incrementally, with and without jobs
+  for (std::size_t count : {40u, 10000u}) {
+    Swarm swarm(count, 10);
+    BroadPhase broadPhase;
+    for (std::size_t i = 0; i < count; ++i) broadPhase.add(swarm.bounds(i));
+    broadPhase.update();
+    check_pairs_(broadPhase, swarm, "from scratch");
+    for (int tick = 0; tick < 60; ++tick) {
+      swarm.move(broadPhase);
+      if (tick % 2)
+        broadPhase.update(jobs);
+      else
+        broadPhase.update();
+    }
+    check_pairs_(broadPhase, swarm, "after 60 ticks");
+  }
+  std::printf("  %-40s yes\n", "pairs match all-pairs test");
+
+  for (std::size_t count : {10000u, 100000u}) {
+    Swarm swarm(count, 11);
+    BroadPhase broadPhase;
+    for (std::size_t i = 0; i < count; ++i) broadPhase.add(swarm.bounds(i));
+    broadPhase.update();
+
+    std::snprintf(label, sizeof(label), "move + update, %zu bodies", count);
+    BenchmarkTiming const single = time_iterations(200, [&] {
+      swarm.move(broadPhase);
+      broadPhase.update();
+    });
+    print_timing(label, single);
+    std::snprintf(label, sizeof(label), "move + update, jobs, %zu bodies",
+                  count);
+    BenchmarkTiming const parallel = time_iterations(200, [&] {
+      swarm.move(broadPhase);
+      broadPhase.update(jobs);
+    });
+    print_timing(label, parallel);
+    std::printf("  %-40s %zu pairs, %.1f M pairs/s\n", "overlapping",
+                broadPhase.pairs().size(),
+                double(broadPhase.pairs().size()) / parallel.medianMs / 1e3);
+  }
+
+  // Narrow phase on the pairs of a swarm of ships
+  Swarm swarm(10000, 12);
+  BroadPhase broadPhase;
+  for (std::size_t i = 0; i < swarm.position.size(); ++i)
+    broadPhase.add(swarm.bounds(i));
+  broadPhase.update();
+  CollisionShape const ship = make_ship_shape_();
+  std::size_t contacts = 0;
+  BenchmarkTiming const narrow = time_iterations(50, [&] {
+    contacts = 0;
+    for (BroadPhasePair const& pair : broadPhase.pairs()) {
+      Contact contact;
+      RigidTransform const a{kIdentity33f, swarm.position[pair.a]};
+      RigidTransform const b{kIdentity33f, swarm.position[pair.b]};
+      contacts += collide(ship, a, ship, b, contact) ? 1 : 0;
+    }
+  });
+  std::snprintf(label, sizeof(label), "narrow phase, %zu pairs",
+                broadPhase.pairs().size());
+  print_timing(label, narrow);
+  std::printf("  %-40s %zu contacts, %zu capsules per ship\n", "touching",
+              contacts, ship.capsules.size());
+}
+
+BenchmarkRegistration const kCollisionBenchmark("collision",
+                                                &bench_collision_);
+}  // namespace
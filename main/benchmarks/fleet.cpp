@@ -0,0 +1,33 @@
+#include <cstdio>
+#include <vector>
+
+#include "../benchmark.hpp"
+#include "../fleet.hpp"
+#include "../simulation.hpp"
+
+namespace {
+void bench_fleet_() {
+  for (std::size_t count : {1000u, 10000u, 100000u}) {
+    Fleet fleet(count);
+    fleet.launch();
+    fleet.update(5.f);  // about half of the ships in flight
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "update, %zu ships", count);
+    print_timing(label, time_iterations(
+                            1000, [&] { fleet.update(kSimulationStep); }));
+
+    FleetPoses const from = fleet.getPoses();
+    fleet.update(kSimulationStep);
+    std::vector<InstanceTransform> instances(count);
+    std::snprintf(label, sizeof(label), "instance transforms, %zu ships",
+                  count);
+    print_timing(label, time_iterations(1000, [&] {
+                   build_instance_transforms(from, fleet.getPoses(), 0.5f,
+                                             instances.data());
+                 }));
+  }
+}
+
+BenchmarkRegistration const kFleetBenchmark("fleet", &bench_fleet_);
+}  // namespace
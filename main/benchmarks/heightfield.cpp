@@ -0,0 +1,112 @@
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+#include "../benchmark.hpp"
+#include "../heightfield.hpp"
+#include "../job_system.hpp"
+
+namespace {
+// Synthetic ground: kGridQuads^2 quads over kGroundSize^2 units
+constexpr std::size_t kGridQuads = 256;
+constexpr float kGroundSize = 200.f;
+constexpr std::size_t kQueries = 1 << 20;
+constexpr std::size_t kRays = 1 << 16;
+
+MeshData make_ground_mesh_() {
+  MeshData mesh;
+  float const step = kGroundSize / float(kGridQuads);
+  auto vertex = [&](std::size_t aI, std::size_t aJ) {
+    float const x = step * float(aI) - 0.5f * kGroundSize;
+    float const z = step * float(aJ) - 0.5f * kGroundSize;
+    float const y = 2.f * std::sin(0.05f * x) * std::cos(0.07f * z) +
+                    0.3f * std::sin(0.5f * x + 0.3f * z);
+    mesh.positions.push_back({x, y, z});
+    mesh.normals.push_back({0.f, 1.f, 0.f});
+    mesh.texcoords.push_back(
+        {float(aI) / float(kGridQuads), float(aJ) / float(kGridQuads)});
+  };
+  for (std::size_t j = 0; j < kGridQuads; ++j) {
+    for (std::size_t i = 0; i < kGridQuads; ++i) {
+      vertex(i, j);
+      vertex(i, j + 1);
+      vertex(i + 1, j);
+      vertex(i + 1, j);
+      vertex(i, j + 1);
+      vertex(i + 1, j + 1);
+    }
+  }
+  return mesh;
+}
+
+void bench_heightfield_() {
+  JobSystem jobs;
+  std::filesystem::path const path =
+      std::filesystem::temp_directory_path() / "bench_heightfield.terrain";
+  bake_terrain(make_ground_mesh_(), path.string().c_str());
+  TerrainFile const file(path.string().c_str());
+
+  print_timing("load", time_iterations(5, [&] { Heightfield{file}; }));
+  Heightfield const ground(file);
+  std::printf("  %-40s %u x %u samples\n", "grid", ground.sizeX(),
+              ground.sizeZ());
+
+  std::mt19937 rng(5);
+  float const half = 0.5f * kGroundSize;
+  std::uniform_real_distribution<float> where(-half, half);
+
+  std::vector<Vec3f> points(kQueries);
+  for (Vec3f& p : points) p = Vec3f{where(rng), 0.f, where(rng)};
+  std::vector<float> heights(kQueries);
+  char label[64];
+  std::snprintf(label, sizeof(label), "heights, %zu points", kQueries);
+  print_timing(label, time_iterations(20, [&] {
+                 ground.heightsAt(points, heights, 0, points.size());
+               }));
+  std::snprintf(label, sizeof(label), "heights, jobs, %zu points", kQueries);
+  print_timing(label, time_iterations(20, [&] {
+                 ground.heightsAt(jobs, points, heights);
+               }));
+
+  // Straight down from above, where the answer is known
+  std::vector<Ray> rays(kRays);
+  for (std::size_t i = 0; i < kRays; ++i)
+    rays[i] = Ray{Vec3f{points[i].x, 10.f, points[i].z}, Vec3f{0.f, -1.f, 0.f}};
+  std::vector<float> distances(kRays);
+  ground.raycast(rays, distances, 100.f, 0, rays.size());
+  float worst = 0.f;
+  for (std::size_t i = 0; i < kRays; ++i)
+    worst = std::max(worst, std::abs(10.f - distances[i] - heights[i]));
+  std::printf("  %-40s %.6f\n", "largest vertical ray error", double(worst));
+
+  // What a camera looking across the ground casts: long, shallow rays,
+  // some of which miss
+  std::uniform_real_distribution<float> angle(0.f, 6.2831853f);
+  std::uniform_real_distribution<float> dip(0.02f, 0.4f);
+  for (std::size_t i = 0; i < kRays; ++i) {
+    float const a = angle(rng);
+    rays[i] = Ray{Vec3f{points[i].x, heights[i] + 2.f, points[i].z},
+                  normalize(Vec3f{std::cos(a), -dip(rng), std::sin(a)})};
+  }
+  std::size_t hits = 0;
+  std::snprintf(label, sizeof(label), "shallow rays, %zu", kRays);
+  BenchmarkTiming const single = time_iterations(5, [&] {
+    ground.raycast(rays, distances, 100.f, 0, rays.size());
+  });
+  print_timing(label, single);
+  std::snprintf(label, sizeof(label), "shallow rays, jobs, %zu", kRays);
+  print_timing(label, time_iterations(5, [&] {
+                 ground.raycast(jobs, rays, distances, 100.f);
+               }));
+  for (float d : distances) hits += std::isinf(d) ? 0 : 1;
+  std::printf("  %-40s %zu hits, %.2f us per ray\n", "shallow rays", hits,
+              1e3 * single.medianMs / double(kRays));
+
+  std::filesystem::remove(path);
+}
+
+BenchmarkRegistration const kHeightfieldBenchmark("heightfield",
+                                                  &bench_heightfield_);
+}  // namespace
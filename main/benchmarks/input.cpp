@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "../benchmark.hpp"
+#include "../input.hpp"
+#include "../simulation.hpp"
+
+namespace {
+constexpr std::size_t kBatch = 512;
+// Cursor moves come in at about this rate when the mouse is busy
+constexpr auto kPushInterval = std::chrono::microseconds(250);
+constexpr auto kRunTime = std::chrono::seconds(1);
+
+void bench_input_() {
+  InputQueue queue;
+  std::vector<InputEvent> drained;
+  drained.reserve(InputQueue::kCapacity);
+
+  char label[64];
+  std::snprintf(label, sizeof(label), "push + drain, %zu events", kBatch);
+  BenchmarkTiming const batch = time_iterations(200, [&] {
+    for (std::size_t i = 0; i < kBatch; ++i)
+      queue.push(make_cursor_event(double(i), double(i)));
+    drained.clear();
+    queue.drain(drained);
+  });
+  print_timing(label, batch);
+  std::printf("  %-40s %.1f ns per event\n", "push + drain",
+              1e6 * batch.medianMs / double(kBatch));
+
+  // The window's thread pushing while a simulation thread drains once per
+  // tick, as the app runs
+  InputQueue live;
+  std::atomic<bool> stop{false};
+  std::thread consumer([&] {
+    auto const step = std::chrono::duration_cast<Clock::duration>(
+        Secondsf(kSimulationStep));
+    std::vector<InputEvent> events;
+    auto next = Clock::now();
+    while (!stop.load(std::memory_order_relaxed)) {
+      events.clear();
+      live.drain(events);
+      next += step;
+      std::this_thread::sleep_until(next);
+    }
+    live.drain(events);
+  });
+
+  double longestPushUs = 0.0;
+  std::size_t pushes = 0;
+  auto const end = Clock::now() + kRunTime;
+  for (auto next = Clock::now(); next < end; next += kPushInterval) {
+    auto const start = Clock::now();
+    live.push(make_cursor_event(double(pushes), 0.0));
+    longestPushUs = std::max(
+        longestPushUs,
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count());
+    ++pushes;
+    std::this_thread::sleep_until(next + kPushInterval);
+  }
+  stop.store(true, std::memory_order_relaxed);
+  consumer.join();
+
+  InputLatency const latency = live.latency();
+  std::printf("  %-40s %zu pushed, %llu drained, %llu dropped\n",
+              "events at 4 kHz, ticks at 120 Hz", pushes,
+              static_cast<unsigned long long>(latency.events),
+              static_cast<unsigned long long>(latency.dropped));
+  std::printf("  %-40s mean %.1f us, max %.1f us\n", "input to simulation",
+              latency.meanUs, latency.maxUs);
+  std::printf("  %-40s %.2f us\n", "longest push", longestPushUs);
+}
+
+BenchmarkRegistration const kInputBenchmark("input", &bench_input_);
+}  // namespace
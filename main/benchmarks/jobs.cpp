@@ -0,0 +1,83 @@
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "../benchmark.hpp"
+#include "../job_system.hpp"
+
+namespace {
+constexpr std::size_t kEmptyJobs = 2048;
+constexpr std::size_t kChainLength = 1024;
+constexpr std::size_t kLoopSize = std::size_t(1) << 22;
+
+// Cost of creating, running and waiting for one job that does nothing
+void bench_overhead_(JobSystem& aJobs) {
+  auto const timing = time_iterations(100, [&] {
+    Job* root = aJobs.create([] {});
+    for (std::size_t i = 0; i < kEmptyJobs; ++i)
+      aJobs.run(aJobs.createChild(root, [] {}));
+    aJobs.run(root);
+    aJobs.wait(root);
+  });
+  std::printf("  %-40s %8.1f ns per job\n", "spawn + wait, empty jobs",
+              timing.medianMs * 1e6 / double(kEmptyJobs));
+}
+
+// Time from one job finishing to its dependent starting
+void bench_dependency_chain_(JobSystem& aJobs) {
+  std::atomic<std::size_t> counter{0};
+  auto const timing = time_iterations(100, [&] {
+    Job* previous = aJobs.create([&counter] { ++counter; });
+    Job* const first = previous;
+    std::vector<Job*> chain;
+    for (std::size_t i = 1; i < kChainLength; ++i) {
+      Job* job = aJobs.create([&counter] { ++counter; });
+      aJobs.addDependency(job, previous);
+      chain.push_back(job);
+      previous = job;
+    }
+    for (Job* job : chain) aJobs.run(job);
+    aJobs.run(first);
+    aJobs.wait(previous);
+  });
+  std::printf("  %-40s %8.1f ns per link\n", "dependency chain",
+              timing.medianMs * 1e6 / double(kChainLength));
+}
+
+// Compute-bound loop, to compare against other worker counts
+double bench_parallel_for_(JobSystem& aJobs, std::vector<float>& aData) {
+  auto const timing = time_iterations(20, [&] {
+    aJobs.parallel_for(0, aData.size(), 16384,
+                       [&](std::size_t aBegin, std::size_t aEnd) {
+                         for (std::size_t i = aBegin; i < aEnd; ++i)
+                           aData[i] = std::sqrt(aData[i] * 1.0001f + 1.f);
+                       });
+  });
+  return timing.medianMs;
+}
+
+void bench_jobs_() {
+  // Powers of two, then the whole machine
+  std::vector<std::size_t> workerCounts;
+  std::size_t const maxWorkers = JobSystem::default_worker_count();
+  for (std::size_t n = 1; n < maxWorkers; n *= 2) workerCounts.push_back(n);
+  workerCounts.push_back(maxWorkers);
+
+  std::vector<float> data(kLoopSize, 1.f);
+  double singleMs = 0.0;
+  for (std::size_t workers : workerCounts) {
+    JobSystem jobs(workers);
+    std::printf("%zu worker(s)\n", workers);
+    bench_overhead_(jobs);
+    bench_dependency_chain_(jobs);
+
+    double const ms = bench_parallel_for_(jobs, data);
+    if (1 == workers) singleMs = ms;
+    std::printf("  %-40s %8.3f ms, speedup %.2fx\n", "parallel_for, 4M sqrt",
+                ms, singleMs / ms);
+  }
+}
+
+BenchmarkRegistration const kJobsBenchmark("jobs", &bench_jobs_);
+}  // namespace
@@ -0,0 +1,103 @@
+#include <cmath>
+#include <cstdio>
+#include <numbers>
+#include <random>
+
+#include "../../support/error.hpp"
+#include "../benchmark.hpp"
+#include "../job_system.hpp"
+#include "../nbody.hpp"
+
+namespace {
+// Bodies checked against the direct sum in the accuracy test
+constexpr std::size_t kAccuracySamples = 500;
+// Largest RMS relative errors accepted: theta 0 sums every pair in a
+// different order than the direct sum, so only float rounding is allowed;
+// the default theta stays within 0.2 percent
+constexpr double kExactError = 1e-5;
+constexpr double kDefaultThetaError = 2e-3;
+
+// A Plummer sphere of total mass 1 and scale radius 1, at rest: dense in
+// the middle and sparse outside, like a cluster of moons and debris
+NBody make_cluster_(std::size_t aCount, float aTheta) {
+  NBody nbody(NBodyParams{1.f, aTheta, 0.01f});
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  for (std::size_t i = 0; i < aCount; ++i) {
+    float const u = std::max(unit(rng), 1e-6f);
+    float const r = 1.f / std::sqrt(std::pow(u, -2.f / 3.f) - 1.f);
+    float const cosTheta = 2.f * unit(rng) - 1.f;
+    float const sinTheta = std::sqrt(1.f - cosTheta * cosTheta);
+    float const phi = 2.f * std::numbers::pi_v<float> * unit(rng);
+    Vec3f const p{r * sinTheta * std::cos(phi), r * sinTheta * std::sin(phi),
+                  r * cosTheta};
+    nbody.add(p, Vec3f{0.f, 0.f, 0.f}, 1.f / float(aCount));
+  }
+  return nbody;
+}
+
+// RMS of |a_tree - a_direct| / |a_direct| over evenly spread bodies
+double relative_error_(NBody const& aNBody) {
+  NBodyBodies const& bodies = aNBody.bodies();
+  std::size_t const stride =
+      std::max<std::size_t>(1, bodies.size() / kAccuracySamples);
+  double sum = 0.0;
+  std::size_t samples = 0;
+  for (std::size_t i = 0; i < bodies.size(); i += stride, ++samples) {
+    Vec3f const exact = direct_acceleration(bodies, i, aNBody.params());
+    Vec3f const tree{bodies.ax[i], bodies.ay[i], bodies.az[i]};
+    double const e = length(tree - exact) / length(exact);
+    sum += e * e;
+  }
+  return std::sqrt(sum / double(samples));
+}
+
+void bench_nbody_() {
+  JobSystem jobs;
+  std::printf("%zu worker(s)\n", jobs.workerCount());
+
+  // Scaling: time per body over log2(N) is flat for O(N log N)
+  for (std::size_t count : {1000u, 10000u, 100000u}) {
+    NBody nbody = make_cluster_(count, 0.5f);
+    char label[64];
+    std::snprintf(label, sizeof(label), "accelerations, %zu bodies", count);
+    BenchmarkTiming const timing =
+        time_iterations(10, [&] { nbody.computeAccelerations(jobs); });
+    print_timing(label, timing);
+    std::printf("  %-40s %8.1f ns, %zu cells\n", "  per body per log2(N)",
+                timing.medianMs * 1e6 /
+                    (double(count) * std::log2(double(count))),
+                nbody.nodeCount());
+
+    std::snprintf(label, sizeof(label), "leapfrog step, %zu bodies", count);
+    print_timing(label,
+                 time_iterations(10, [&] { nbody.step(jobs, 1e-3f); }));
+  }
+
+  // Accuracy against the O(N^2) sum; theta 0 opens every cell, so it only
+  // differs from the direct sum by rounding
+  float const defaultTheta = NBodyParams{}.theta;
+  for (std::size_t count : {10000u, 100000u}) {
+    for (float theta : {0.f, 0.3f, 0.5f, 0.7f, 1.f}) {
+      if (0.f == theta && count > 10000u) continue;
+      NBody nbody = make_cluster_(count, theta);
+      nbody.computeAccelerations(jobs);
+      char label[64];
+      std::snprintf(label, sizeof(label), "error, %zu bodies, theta %.1f",
+                    count, double(theta));
+      double const error = relative_error_(nbody);
+      std::printf("  %-40s %8.2e RMS relative\n", label, error);
+
+      double const bound = 0.f == theta           ? kExactError
+                           : defaultTheta == theta ? kDefaultThetaError
+                                                   : 0.0;
+      if (bound > 0.0 && !(error <= bound)) {
+        throw Error("%zu bodies at theta %.1f are off by %.2e, over %.0e",
+                    count, double(theta), error, bound);
+      }
+    }
+  }
+}
+
+BenchmarkRegistration const kNBodyBenchmark("nbody", &bench_nbody_);
+}  // namespace
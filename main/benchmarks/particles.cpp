@@ -0,0 +1,49 @@
+#include <cstdio>
+
+#include "../benchmark.hpp"
+#include "../job_system.hpp"
+#include "../particles.hpp"
+#include "../simulation.hpp"
+
+namespace {
+// Emits aCount particles a second that outlive the benchmark, so the count
+// stays put while update() is timed
+SceneEmitter make_emitter_(std::size_t aCount) {
+  return SceneEmitter{{0.f, 0.f, 0.f}, {0.f, -1.f, 0.f}, float(aCount),
+                      1.5f, 0.2f, 100.f};
+}
+
+void bench_particles_() {
+  JobSystem jobs;
+  SpaceshipPose const pose{{0.f, 1.f, 0.f}, kIdentityQuatf, 1.f};
+  Vec3f const velocity{0.f, 0.5f, 0.f};
+
+  for (std::size_t count : {std::size_t(1) << 16, std::size_t(1) << 18,
+                            kMaxParticles}) {
+    ParticleSystem particles(kMaxParticles);
+    SceneEmitter const emitter = make_emitter_(count);
+
+    // A second's worth of ticks
+    for (int i = 0; i < int(kSimulationRate); ++i) {
+      particles.update(jobs, kSimulationStep);
+      particles.emit(std::span(&emitter, 1), pose, velocity, kSimulationStep);
+    }
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "update, %zu particles",
+                  particles.count());
+    print_timing(label, time_iterations(200, [&] {
+                   particles.update(jobs, kSimulationStep);
+                 }));
+    std::snprintf(label, sizeof(label), "emit, %zu per step",
+                  std::size_t(emitter.rate * kSimulationStep));
+    print_timing(label, time_iterations(200, [&] {
+                   particles.emit(std::span(&emitter, 1), pose, velocity,
+                                  kSimulationStep);
+                 }));
+  }
+}
+
+BenchmarkRegistration const kParticlesBenchmark("particles",
+                                                &bench_particles_);
+}  // namespace
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "../../support/error.hpp"
+#include "../benchmark.hpp"
+#include "../recording.hpp"
+#include "../simulation.hpp"
+
+namespace {
+// An hour of ticks
+constexpr std::uint64_t kTicks = 3600 * std::uint64_t(kSimulationRate);
+constexpr std::size_t kSeeks = 2000;
+
+Quatf turn_(float aAngle, Vec3f aAxis) {
+  float const s = std::sin(0.5f * aAngle);
+  return Quatf{s * aAxis.x, s * aAxis.y, s * aAxis.z, std::cos(0.5f * aAngle)};
+}
+
+// A ship flying loops over a few hundred units, with cameras following it
+WorldSnapshot make_snapshot_(std::uint64_t aTick) {
+  float const t = float(aTick) * kSimulationStep;
+  Vec3f const ship{150.f * std::sin(0.01f * t),
+                   20.f + 10.f * std::sin(0.1f * t),
+                   150.f * std::cos(0.013f * t)};
+  Quatf const heading = turn_(0.01f * t, Vec3f{0.f, 1.f, 0.f});
+  WorldSnapshot snapshot;
+  snapshot.spaceship =
+      SpaceshipPose{ship, heading, 0.5f + 0.5f * std::sin(0.3f * t)};
+  snapshot.firstPersonCamera =
+      CameraPose{Vec3f{0.f, 5.f, 10.f}, turn_(0.2f * t, Vec3f{0.f, 1.f, 0.f})};
+  snapshot.trackingCamera = CameraPose{ship + Vec3f{0.f, 2.f, 5.f}, heading};
+  snapshot.groundedCamera =
+      CameraPose{Vec3f{0.f, 1.f, 0.f},
+                 turn_(0.5f * std::sin(0.01f * t), Vec3f{1.f, 0.f, 0.f})};
+  return snapshot;
+}
+
+float largest_error_(WorldSnapshot const& aA, WorldSnapshot const& aB) {
+  float error = std::abs(aA.spaceship.throttle - aB.spaceship.throttle);
+  auto const pose = [&error](Vec3f aPosA, Quatf aRotA, Vec3f aPosB,
+                             Quatf aRotB) {
+    error = std::max({error, std::abs(aPosA.x - aPosB.x),
+                      std::abs(aPosA.y - aPosB.y),
+                      std::abs(aPosA.z - aPosB.z)});
+    // q and -q are the same turn
+    float const d = std::abs(aRotA.x * aRotB.x + aRotA.y * aRotB.y +
+                             aRotA.z * aRotB.z + aRotA.w * aRotB.w);
+    error = std::max(error, 1.f - std::min(d, 1.f));
+  };
+  pose(aA.spaceship.position, aA.spaceship.orientation, aB.spaceship.position,
+       aB.spaceship.orientation);
+  for (auto member : {&WorldSnapshot::firstPersonCamera,
+                      &WorldSnapshot::trackingCamera,
+                      &WorldSnapshot::groundedCamera}) {
+    pose((aA.*member).pos, (aA.*member).orientation, (aB.*member).pos,
+         (aB.*member).orientation);
+  }
+  return error;
+}
+
+// A recording cut off at aCut bytes, as a crash leaves it: no keyframe
+// table or trailer, and zeros after the last bytes written. The writer puts
+// a keyframe's marker in last, so one cut short, which starts at
+// aKeyframe, has none.
+void write_cut_recording_(std::filesystem::path const& aFrom,
+                          std::filesystem::path const& aTo, std::size_t aCut,
+                          std::size_t aKeyframe) {
+  std::vector<char> bytes(std::filesystem::file_size(aFrom));
+  std::ifstream in(aFrom, std::ios::binary);
+  in.read(bytes.data(), std::streamsize(bytes.size()));
+  bytes.resize(aCut);
+  bytes.resize(aCut + 4096, 0);
+  if (aKeyframe < aCut) std::fill_n(bytes.begin() + aKeyframe, 4, 0);
+  std::ofstream out(aTo, std::ios::binary | std::ios::trunc);
+  out.write(bytes.data(), std::streamsize(bytes.size()));
+  if (!in || !out) throw Error("Unable to copy '%s'", aFrom.string().c_str());
+}
+
+// Recordings without their keyframe table are read up to their last whole
+// keyframe, and give the same values as the whole recording there
+void check_crash_recovery_(std::filesystem::path const& aDirectory) {
+  constexpr std::uint32_t kInterval = 10;
+  constexpr std::uint64_t kShortTicks = 1000;
+  std::filesystem::path const whole = aDirectory / "bench_whole.rec";
+  std::filesystem::path const cut = aDirectory / "bench_cut.rec";
+  std::array<float, kSnapshotChannels> channels;
+
+  std::vector<std::size_t> keyframes;
+  std::size_t ticksEnd = 0;
+  {
+    RecordingWriter writer(whole.string().c_str(), snapshot_channel_steps(),
+                           kInterval);
+    for (std::uint64_t i = 0; i < kShortTicks; ++i) {
+      if (0 == i % kInterval) keyframes.push_back(writer.byteCount());
+      write_snapshot_channels(make_snapshot_(i), channels);
+      writer.append(channels);
+    }
+    ticksEnd = writer.byteCount();
+  }
+  std::size_t const keyframeSize = 4 + sizeof(std::int32_t) * kSnapshotChannels;
+
+  RecordingReader original(whole.string().c_str());
+  // After all ticks, inside a keyframe, inside a delta, right after a
+  // keyframe, and before the first keyframe is whole
+  for (std::size_t at : {ticksEnd, keyframes[37] + 3, keyframes[50] - 1,
+                         keyframes[50] + keyframeSize, keyframes[0] + 5}) {
+    auto const wholeKeyframes = std::uint64_t(std::count_if(
+        keyframes.begin(), keyframes.end(),
+        [&](std::size_t aOffset) { return aOffset + keyframeSize <= at; }));
+    std::size_t const partial = wholeKeyframes < keyframes.size()
+                                    ? keyframes[wholeKeyframes]
+                                    : at;
+    write_cut_recording_(whole, cut, at, partial);
+    RecordingReader reader(cut.string().c_str());
+
+    std::uint64_t const expected =
+        0 == wholeKeyframes ? 0 : (wholeKeyframes - 1) * kInterval + 1;
+    if (reader.tickCount() != expected) {
+      throw Error("Cut at byte %zu: %llu ticks recovered, not %llu", at,
+                  static_cast<unsigned long long>(reader.tickCount()),
+                  static_cast<unsigned long long>(expected));
+    }
+    for (std::uint64_t t = reader.tickCount(); t-- > 0;) {
+      reader.seek(t);
+      original.seek(t);
+      if (!std::equal(reader.values().begin(), reader.values().end(),
+                      original.values().begin()))
+        throw Error("Cut at byte %zu: tick %llu differs", at,
+                    static_cast<unsigned long long>(t));
+    }
+  }
+
+  std::filesystem::remove(whole);
+  std::filesystem::remove(cut);
+}
+
+void bench_recording_() {
+  std::filesystem::path const path =
+      std::filesystem::temp_directory_path() / "bench_recording.rec";
+  std::array<float, kSnapshotChannels> const steps = snapshot_channel_steps();
+  std::array<float, kSnapshotChannels> channels;
+
+  // Snapshots are made up front, so only the encoding is timed
+  std::vector<WorldSnapshot> snapshots(kTicks);
+  for (std::uint64_t i = 0; i < kTicks; ++i) snapshots[i] = make_snapshot_(i);
+
+  std::uint64_t bytes = 0;
+  print_timing("record 1 hour", time_iterations(3, [&] {
+                 RecordingWriter writer(path.string().c_str(), steps);
+                 for (WorldSnapshot const& snapshot : snapshots) {
+                   write_snapshot_channels(snapshot, channels);
+                   writer.append(channels);
+                 }
+                 writer.close();
+                 bytes = writer.byteCount();
+               }));
+  std::printf("  %-40s %.1f MiB, %.1f bytes per tick (raw %zu)\n",
+              "recording size", double(bytes) / (1024.0 * 1024.0),
+              double(bytes) / double(kTicks),
+              sizeof(float) * kSnapshotChannels);
+
+  RecordingReader reader(path.string().c_str());
+  print_timing("open", time_iterations(20, [&] {
+                 RecordingReader{path.string().c_str()};
+               }));
+
+  // Sequential playback, as a replay runs
+  float worst = 0.f;
+  print_timing("play 1 hour", time_iterations(3, [&] {
+                 reader.seek(0);
+                 worst = 0.f;
+                 do {
+                   WorldSnapshot const snapshot =
+                       read_snapshot_channels(reader.values());
+                   worst = std::max(
+                       worst, largest_error_(snapshot,
+                                             snapshots[reader.tick()]));
+                 } while (reader.next());
+               }));
+  std::printf("  %-40s %.6f\n", "largest quantisation error", double(worst));
+
+  // Jumps anywhere; they must give what playing up to them gave
+  std::mt19937_64 rng(7);
+  std::uniform_int_distribution<std::uint64_t> where(0, kTicks - 1);
+  std::vector<std::uint64_t> targets(kSeeks);
+  for (std::uint64_t& t : targets) t = where(rng);
+  char label[64];
+  std::snprintf(label, sizeof(label), "random seeks, %zu", kSeeks);
+  BenchmarkTiming const seeks = time_iterations(5, [&] {
+    for (std::uint64_t t : targets) reader.seek(t);
+  });
+  print_timing(label, seeks);
+  std::printf("  %-40s %.2f us per seek\n", "random seeks",
+              1e3 * seeks.medianMs / double(kSeeks));
+
+  // What playing through gives at each target, then the same by seeking
+  std::vector<std::uint64_t> sorted = targets;
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<float> played;
+  reader.seek(0);
+  for (std::uint64_t t : sorted) {
+    while (reader.tick() < t) reader.next();
+    played.insert(played.end(), reader.values().begin(),
+                  reader.values().end());
+  }
+  std::size_t mismatches = 0;
+  for (std::uint64_t t : targets) {
+    reader.seek(t);
+    std::size_t const i = std::size_t(
+        std::lower_bound(sorted.begin(), sorted.end(), t) - sorted.begin());
+    mismatches += std::equal(reader.values().begin(), reader.values().end(),
+                             played.begin() + i * kSnapshotChannels)
+                      ? 0
+                      : 1;
+  }
+  std::printf("  %-40s %zu of %zu\n", "seeks unlike playback", mismatches,
+              kSeeks);
+  if (mismatches > 0) throw Error("Seeks differ from playback");
+
+  std::filesystem::remove(path);
+
+  check_crash_recovery_(path.parent_path());
+  std::printf("  %-40s yes\n", "cut recordings recovered");
+}
+
+BenchmarkRegistration const kRecordingBenchmark("recording",
+                                                &bench_recording_);
+}  // namespace
@@ -0,0 +1,68 @@
+#include <cstdio>
+
+#include "../benchmark.hpp"
+#include "../job_system.hpp"
+#include "../rigid_body.hpp"
+#include "../simulation.hpp"
+
+namespace {
+constexpr Vec3f kGravity{0.f, -0.5f, 0.f};
+constexpr ThrustKey kProfile[] = {
+    {0.f, 0.66f, 0.f}, {10.f, 0.725f, -0.426f}, {20.f, 0.892f, -0.738f}};
+
+// aCount ships spread over a square, each a different time into the
+// profile
+RigidBodies make_ships_(std::size_t aCount, std::vector<float>& aTimes) {
+  RigidBodies ships;
+  aTimes.clear();
+  Vec3f const moments = make_cylinder_moments(1.f, 0.2f, 0.4f);
+  for (std::size_t i = 0; i < aCount; ++i) {
+    ships.add(1.f, moments, Vec3f{float(i % 100), 0.f, float(i / 100)},
+              kIdentityQuatf);
+    aTimes.push_back(float(i % 97) * 0.2f);
+  }
+  return ships;
+}
+
+// What each ship's owner does every tick: sample its profile and steer
+void set_controls_(RigidBodies& aShips, std::vector<float>& aTimes) {
+  for (std::size_t i = 0; i < aShips.size(); ++i) {
+    aTimes[i] += kSimulationStep;
+    ThrustKey const control = sample_thrust_profile(kProfile, aTimes[i]);
+    aShips.thrust[i] = control.thrust;
+    Vec3f const torque = attitude_torque(
+        aShips, i, make_quat_rotation_z(control.tilt), 4.f);
+    aShips.tx[i] = torque.x;
+    aShips.ty[i] = torque.y;
+    aShips.tz[i] = torque.z;
+  }
+}
+
+void bench_rigid_body_() {
+  JobSystem jobs;
+  std::vector<float> times;
+
+  for (std::size_t count : {1000u, 10000u, 100000u}) {
+    RigidBodies ships = make_ships_(count, times);
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "controls, %zu ships", count);
+    print_timing(label, time_iterations(
+                            1000, [&] { set_controls_(ships, times); }));
+    std::snprintf(label, sizeof(label), "integrate, %zu ships", count);
+    print_timing(label, time_iterations(1000, [&] {
+                   integrate_rigid_bodies(ships, kGravity, kSimulationStep,
+                                          0, ships.size());
+                 }));
+    std::snprintf(label, sizeof(label), "integrate, jobs, %zu ships",
+                  count);
+    print_timing(label, time_iterations(1000, [&] {
+                   integrate_rigid_bodies(jobs, ships, kGravity,
+                                          kSimulationStep);
+                 }));
+  }
+}
+
+BenchmarkRegistration const kRigidBodyBenchmark("rigid_body",
+                                                &bench_rigid_body_);
+}  // namespace
@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+#include "../benchmark.hpp"
+#include "../scene_file.hpp"
+
+namespace {
+constexpr std::size_t kInstanceCount = 100000;
+
+// A scene with kInstanceCount instances of a few meshes, plus what every
+// scene needs
+void write_scene_(std::filesystem::path const& aPath) {
+  std::ofstream out(aPath);
+  out << "terrain mesh ground.obj baked ground.terrain texture ground.jpg\n"
+      << "camera main at 0 1 0\n"
+      << "ship at 0 0 0 scale 0.04\n"
+      << "part hull sphere scale 0.5 color 0.1 0.1 0.1 shininess 100\n";
+  for (int i = 0; i < 3; ++i)
+    out << "light at 0 " << i << " 0 ambient 0 0 0 diffuse 1 1 1\n";
+  for (int i = 0; i < 8; ++i)
+    out << "mesh m" << i << " path m" << i << ".obj\n";
+
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> pos(-100.f, 100.f);
+  std::uniform_real_distribution<float> angle(0.f, 360.f);
+  for (std::size_t i = 0; i < kInstanceCount; ++i) {
+    out << "instance m" << i % 8 << " at " << pos(rng) << " 0 " << pos(rng)
+        << " rotate 0 1 0 " << angle(rng) << " scale 1.5\n";
+  }
+}
+
+void bench_scene_file_() {
+  std::filesystem::path const dir = std::filesystem::temp_directory_path();
+  std::filesystem::path const text = dir / "bench_scene.txt";
+  std::filesystem::path const binary = dir / "bench_scene.bin";
+  write_scene_(text);
+
+  char label[64];
+  std::snprintf(label, sizeof(label), "compile, %zu instances",
+                kInstanceCount);
+  print_timing(label, time_iterations(3, [&] {
+                 compile_scene(text.string().c_str(), binary.string().c_str());
+               }));
+
+  // What start-up pays: one mmap, a validation pass, then the records in
+  // place
+  float checksum = 0.f;
+  print_timing("map and walk", time_iterations(20, [&] {
+                 SceneFile const scene(binary.string().c_str());
+                 for (SceneInstance const& instance : scene.instances())
+                   checksum += instance.transform.translation.x;
+               }));
+  std::printf("  %.1f KiB text, %.1f KiB binary (checksum %g)\n",
+              double(std::filesystem::file_size(text)) / 1024.0,
+              double(std::filesystem::file_size(binary)) / 1024.0,
+              double(checksum));
+
+  std::filesystem::remove(text);
+  std::filesystem::remove(binary);
+}
+
+BenchmarkRegistration const kSceneFileBenchmark("scene_file",
+                                                &bench_scene_file_);
+}  // namespace
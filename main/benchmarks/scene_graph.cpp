@@ -0,0 +1,48 @@
+#include <cstdio>
+#include <vector>
+
+#include "../benchmark.hpp"
+#include "../scene_graph.hpp"
+
+namespace {
+constexpr std::size_t kRoots = 10000;
+constexpr std::size_t kChildrenPerRoot = 9;  // e.g. a ship and its parts
+
+void bench_scene_graph_() {
+  SceneGraph graph;
+  Aabb const unitBox{{-1.f, -1.f, -1.f}, {1.f, 1.f, 1.f}};
+  std::vector<NodeId> roots;
+  for (std::size_t r = 0; r < kRoots; ++r) {
+    roots.push_back(
+        graph.add(kNoNode, TrsTransform{{float(r), 0.f, 0.f}}, unitBox));
+    for (std::size_t c = 0; c < kChildrenPerRoot; ++c) {
+      graph.add(roots.back(),
+                TrsTransform{{0.f, float(c), 0.f},
+                             make_quat_rotation_y(0.1f * float(c))},
+                unitBox);
+    }
+  }
+  graph.update();
+
+  std::printf("%zu nodes\n", graph.size());
+  for (std::size_t every : {1u, 10u, 100u}) {
+    char label[64];
+    std::snprintf(label, sizeof(label), "update, 1 in %zu roots moved",
+                  every);
+    float t = 0.f;
+    print_timing(label, time_iterations(200, [&] {
+                   t += 0.01f;
+                   for (std::size_t r = 0; r < kRoots; r += every) {
+                     graph.setLocal(roots[r],
+                                    TrsTransform{{float(r), t, 0.f}});
+                   }
+                   graph.update();
+                 }));
+  }
+  print_timing("update, nothing moved",
+               time_iterations(200, [&] { graph.update(); }));
+}
+
+BenchmarkRegistration const kSceneGraphBenchmark("scene_graph",
+                                                 &bench_scene_graph_);
+}  // namespace
@@ -0,0 +1,103 @@
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+#include "../benchmark.hpp"
+#include "../terrain.hpp"
+
+namespace {
+// Synthetic ground: kGridQuads^2 quads over kGroundSize^2 units
+constexpr std::size_t kGridQuads = 512;
+constexpr float kGroundSize = 400.f;
+
+float ground_height_(float aX, float aZ) {
+  return 2.f * std::sin(0.05f * aX) * std::cos(0.07f * aZ) +
+         0.3f * std::sin(0.5f * aX + 0.3f * aZ);
+}
+
+MeshData make_ground_mesh_() {
+  MeshData mesh;
+  float const step = kGroundSize / float(kGridQuads);
+  auto vertex = [&](std::size_t aI, std::size_t aJ) {
+    float const x = step * float(aI) - 0.5f * kGroundSize;
+    float const z = step * float(aJ) - 0.5f * kGroundSize;
+    mesh.positions.push_back({x, ground_height_(x, z), z});
+    mesh.normals.push_back({0.f, 1.f, 0.f});
+    mesh.texcoords.push_back(
+        {float(aI) / float(kGridQuads), float(aJ) / float(kGridQuads)});
+  };
+  for (std::size_t j = 0; j < kGridQuads; ++j) {
+    for (std::size_t i = 0; i < kGridQuads; ++i) {
+      vertex(i, j);
+      vertex(i, j + 1);
+      vertex(i + 1, j);
+      vertex(i + 1, j);
+      vertex(i, j + 1);
+      vertex(i + 1, j + 1);
+    }
+  }
+  return mesh;
+}
+
+void bench_terrain_() {
+  std::filesystem::path const path =
+      std::filesystem::temp_directory_path() / "bench.terrain";
+  MeshData const mesh = make_ground_mesh_();
+
+  char label[64];
+  std::snprintf(label, sizeof(label), "bake, %zu triangles",
+                mesh.positions.size() / 3);
+  print_timing(label, time_iterations(3, [&] {
+                 bake_terrain(mesh, path.string().c_str());
+               }));
+
+  TerrainFile const file(path.string().c_str());
+  TerrainFileHeader const& header = file.header();
+  std::printf("  %u x %u tiles, spacing %.3f, %.1f MiB\n", header.tilesX,
+              header.tilesZ, double(header.spacing),
+              double(std::filesystem::file_size(path)) / (1024.0 * 1024.0));
+
+  // What a streaming update pays per tile, without the GL upload
+  std::vector<std::uint16_t> samples(kTerrainTileSamples);
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<std::size_t> pick(0, file.tileCount() - 1);
+  print_timing("read 64 tiles", time_iterations(20, [&] {
+                 for (int i = 0; i < 64; ++i)
+                   file.readTile(pick(rng), samples.data());
+               }));
+
+  // Vertical error of the reconstructed full-detail surface
+  float worst = 0.f;
+  for (std::size_t t = 0; t < file.tileCount(); ++t) {
+    TerrainTileInfo const& info = file.tile(t);
+    Aabb const box = file.tileBounds(t);
+    file.readTile(t, samples.data());
+    float const scale = (info.maxHeight - info.minHeight) / 65535.f;
+    for (std::uint32_t j = 0; j <= kTerrainTileQuads; ++j) {
+      for (std::uint32_t i = 0; i <= kTerrainTileQuads; ++i) {
+        float const x = box.min.x + header.spacing * float(i);
+        float const z = box.min.z + header.spacing * float(j);
+        if (x > 0.5f * kGroundSize || z > 0.5f * kGroundSize) continue;
+        float const h =
+            info.minHeight +
+            scale * float(samples[(j + 1) * kTerrainTileSide + i + 1]);
+        worst = std::max(worst, std::abs(h - ground_height_(x, z)));
+      }
+    }
+  }
+  std::printf("  largest height error %.4f\n", double(worst));
+
+  std::size_t levels[kTerrainLevels] = {};
+  for (float distance = 1.f; distance < 100.f; distance += 1.f)
+    ++levels[select_terrain_level(file.tile(0), distance, 600.f)];
+  std::printf("  levels over 1-100 units:");
+  for (std::size_t count : levels) std::printf(" %zu", count);
+  std::printf("\n");
+
+  std::filesystem::remove(path);
+}
+
+BenchmarkRegistration const kTerrainBenchmark("terrain", &bench_terrain_);
+}  // namespace
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "../benchmark.hpp"
+#include "../job_system.hpp"
+#include "../simulation.hpp"
+#include "../trajectory.hpp"
+
+namespace {
+// aCount ships on pads over a square, each a different time into its
+// launch
+RigidBodies make_ships_(std::size_t aCount, std::vector<ShipFlight>& aFlights) {
+  RigidBodies ships;
+  aFlights.clear();
+  Vec3f const moments = make_cylinder_moments(1.f, 0.2f, 0.4f);
+  for (std::size_t i = 0; i < aCount; ++i) {
+    Vec3f const pad{float(i % 100), 0.f, float(i / 100)};
+    ships.add(1.f, moments, pad, kIdentityQuatf);
+    ShipFlight flight;
+    flight.engineOn = true;
+    flight.time = float(i % 97) * 0.2f;
+    flight.pad = pad;
+    aFlights.push_back(flight);
+  }
+  return ships;
+}
+
+void bench_trajectory_() {
+  JobSystem jobs;
+  std::vector<ShipFlight> flights;
+  char label[64];
+
+  for (std::size_t count : {1u, 1000u, 10000u}) {
+    RigidBodies ships = make_ships_(count, flights);
+    std::size_t const iterations = count < 10000 ? 20 : 5;
+
+    // Every path from the start, as after a reset
+    std::snprintf(label, sizeof(label), "predict afresh, %zu ships", count);
+    print_timing(label, time_iterations(iterations, [&] {
+                   TrajectoryPredictor predictor;
+                   predictor.update(ships, flights);
+                 }));
+    std::snprintf(label, sizeof(label), "predict afresh, jobs, %zu ships",
+                  count);
+    print_timing(label, time_iterations(iterations, [&] {
+                   TrajectoryPredictor predictor;
+                   predictor.update(jobs, ships, flights);
+                 }));
+
+    // What each tick costs once the paths are there: every ship flies a
+    // tick and its path is reused
+    TrajectoryPredictor predictor;
+    predictor.update(jobs, ships, flights);
+    std::size_t repredicted = 0;
+    std::snprintf(label, sizeof(label), "tick + reuse, jobs, %zu ships",
+                  count);
+    print_timing(label, time_iterations(200, [&] {
+                   fly_ships(ships, flights, kSimulationStep, 0, count);
+                   predictor.update(jobs, ships, flights);
+                   repredicted += predictor.repredicted();
+                 }));
+    std::printf("  %-40s %zu of %zu ship ticks\n", "flown again",
+                repredicted, 201 * count);
+
+    // The last point of a reused path against one flown afresh
+    TrajectoryPredictor fresh;
+    fresh.update(ships, flights);
+    float worst = 0.f;
+    for (std::size_t i = 0; i < count; ++i) {
+      worst = std::max(worst, length(fresh.point(i, fresh.steps()) -
+                                     predictor.point(i, predictor.steps())));
+    }
+    std::printf("  %-40s %.6f\n", "reused path drift", double(worst));
+  }
+}
+
+BenchmarkRegistration const kTrajectoryBenchmark("trajectory",
+                                                 &bench_trajectory_);
+}  // namespace
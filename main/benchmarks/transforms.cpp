@@ -0,0 +1,56 @@
+#include <cstdio>
+#include <vector>
+
+#include "../../vmlib/affine34.hpp"
+#include "../benchmark.hpp"
+#include "../spaceship.hpp"
+
+namespace {
+constexpr std::size_t kObjects = 10000;
+
+// Per-object model-to-world and normal matrix, as Spaceship::draw() needs
+void bench_transforms_() {
+  std::vector<float> angles(kObjects);
+  std::vector<SpaceshipPose> poses(kObjects);
+  for (std::size_t i = 0; i < kObjects; ++i) {
+    angles[i] = 0.001f * float(i);
+    poses[i] = {{float(i), 0.5f, -1.f}, make_quat_rotation_z(angles[i]),
+                0.f};
+  }
+  std::vector<Mat44f> model2world(kObjects);
+  std::vector<Mat33f> normals(kObjects);
+
+  char label[64];
+  std::snprintf(label, sizeof(label), "4x4 invert(), %zu objects", kObjects);
+  print_timing(label, time_iterations(200, [&] {
+                 for (std::size_t i = 0; i < kObjects; ++i) {
+                   model2world[i] = make_translation(poses[i].position) *
+                                    make_rotation_z(angles[i]);
+                   normals[i] = mat44_to_mat33(
+                       transpose(invert(model2world[i])));
+                 }
+               }));
+
+  std::snprintf(label, sizeof(label), "Affine34f, %zu objects", kObjects);
+  print_timing(label, time_iterations(200, [&] {
+                 for (std::size_t i = 0; i < kObjects; ++i) {
+                   Affine34f const m = to_affine34(make_model2world(poses[i]));
+                   model2world[i] = to_mat44(m);
+                   normals[i] = normal_matrix(m);
+                 }
+               }));
+
+  std::snprintf(label, sizeof(label), "RigidTransform, %zu objects",
+                kObjects);
+  print_timing(label, time_iterations(200, [&] {
+                 for (std::size_t i = 0; i < kObjects; ++i) {
+                   RigidTransform const t = make_model2world(poses[i]);
+                   model2world[i] = to_mat44(t);
+                   normals[i] = normal_matrix(t);
+                 }
+               }));
+}
+
+BenchmarkRegistration const kTransformsBenchmark("transforms",
+                                                 &bench_transforms_);
+}  // namespace
@@ -5,25 +5,29 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 
 #include "../vmlib/vec2.hpp"
 #include "../vmlib/vec4.hpp"
-#include "mesh.hpp"
 #include "state.hpp"
+#include "text.hpp"
+#include "ui_batch.hpp"
 
 class Button {
  public:
   Button(const std::string& text, Vec4f (*genScreenCoords)(float, float),
          const Vec4f& idleColor, const Vec4f& activeColor,
          const Vec4f& pressedColor, float borderWidth, const Vec4f& borderColor,
-         void (*callback)(State*))
+         const Vec4f& labelColor, void (*callback)(State*))
       : text(text),
+        caption(text),
         genScreenCoords(genScreenCoords),
         idleColor(idleColor),
         activeColor(activeColor),
         pressedColor(pressedColor),
         borderWidth(borderWidth),
         borderColor(borderColor),
+        labelColor(labelColor),
         callback(callback) {
     prevFbwidth = 0.f;
     prevFbheight = 0.f;
@@ -32,10 +36,6 @@ class Button {
 
     // Other initialisation
     currentColor = &this->idleColor;
-    fillVao = 0;
-    fillVertices = 0;
-    outlineVao = 0;
-    outlineVertices = 0;
     screenRect = Vec4f{0.f, 0.f, 0.f, 0.f};
   }
 
@@ -49,91 +49,26 @@ class Button {
 
     // Use provided genScreenCoords
     screenRect = genScreenCoords(fbwidth, fbheight);
-
-    // Construct Fill Data
-    std::vector<Vec2f> fillData = {
-        {screenRect.x, screenRect.y}, {screenRect.z, screenRect.y},
-        {screenRect.z, screenRect.w}, {screenRect.x, screenRect.y},
-        {screenRect.z, screenRect.w}, {screenRect.x, screenRect.w}};
-
-    // Construct Ouline Data
-    float w = borderWidth;
-    std::vector<Vec2f> outlineData = {{screenRect.x - w, screenRect.y - w},
-                                      {screenRect.z + w, screenRect.y - w},
-                                      {screenRect.x - w, screenRect.y},
-
-                                      {screenRect.x - w, screenRect.y},
-                                      {screenRect.z + w, screenRect.y - w},
-                                      {screenRect.z + w, screenRect.y},
-
-                                      {screenRect.x - w, screenRect.w},
-                                      {screenRect.z + w, screenRect.w},
-                                      {screenRect.x - w, screenRect.w + w},
-
-                                      {screenRect.x - w, screenRect.w + w},
-                                      {screenRect.z + w, screenRect.w},
-                                      {screenRect.z + w, screenRect.w + w},
-
-                                      {screenRect.x - w, screenRect.y},
-                                      {screenRect.x, screenRect.y},
-                                      {screenRect.x - w, screenRect.w},
-
-                                      {screenRect.x - w, screenRect.w},
-                                      {screenRect.x, screenRect.y},
-                                      {screenRect.x, screenRect.w},
-
-                                      {screenRect.z, screenRect.y},
-                                      {screenRect.z + w, screenRect.y},
-                                      {screenRect.z, screenRect.w},
-
-                                      {screenRect.z, screenRect.w},
-                                      {screenRect.z + w, screenRect.y},
-                                      {screenRect.z + w, screenRect.w}};
-
-    fillVao = createVao(fillData);
-    fillVertices = GLuint(fillData.size());
-
-    outlineVao = createVao(outlineData);
-    outlineVertices = GLuint(outlineData.size());
   }
 
-  GLuint createVao(std::vector<Vec2f> data) const {
-    // Convert to NDC System
-    for (Vec2f& v : data) {
-      v.x = 2 * v.x / prevFbwidth - 1;
-      v.y = 2 * v.y / prevFbheight - 1;
-    }
-
-    GLuint positionVBO = 0;
-    glGenBuffers(1, &positionVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
-    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vec2f), data.data(),
-                 GL_STATIC_DRAW);
-
-    GLuint vao = 0;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(0);
-
-    // Clean Up State
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glDeleteBuffers(1, &positionVBO);
-    return vao;
+  // Shows aValue after the text; reuses the caption's storage
+  void setValue(std::string_view aValue) {
+    caption.assign(text);
+    caption.append(aValue);
   }
 
-  void draw() const {
-    //// Outline
-    glUniform4fv(0, 1, &borderColor.x);
-    glBindVertexArray(outlineVao);
-    glDrawArrays(GL_TRIANGLES, 0, outlineVertices);
+  void draw(UiBatch& batch) {
+    //// Outline, then fill
+    batch.addFrame(screenRect, borderWidth, borderColor);
+    batch.addRect(screenRect, *currentColor);
+  }
 
-    //// Then Fill
-    glUniform4fv(0, 1, &currentColor->x);
-    glBindVertexArray(fillVao);
-    glDrawArrays(GL_TRIANGLES, 0, fillVertices);
+  // Caption, centred; throws Error
+  void drawLabel(TextRenderer& textRenderer) {
+    Vec2f const centre{0.5f * (screenRect.x + screenRect.z),
+                       0.5f * (screenRect.y + screenRect.w)};
+    label.set(textRenderer, caption, centre, kTextSize, labelColor);
+    textRenderer.add(label.vertices());
   }
 
   void updateMouseMove(double aX, double aY) {
@@ -151,6 +86,8 @@ class Button {
     }
   }
 
+  bool isHovered() const { return isInRect; }
+
   void updateMousePress(int aButton, int aAction, State* state) {
     if (isInRect) {
     }
@@ -168,7 +105,11 @@ class Button {
   }
 
  private:
+  static constexpr float kTextSize = 22.f;  // pixels
+
   std::string text;
+  std::string caption;
+  TextLabel label;
 
   // Rectangle with bottomleft, topright
   Vec4f (*genScreenCoords)(float, float);
@@ -176,12 +117,6 @@ class Button {
   float prevFbwidth;
   float prevFbheight;
 
-  // Data
-  GLuint fillVao;
-  GLuint outlineVao;
-  GLsizei fillVertices;
-  GLsizei outlineVertices;
-
   // Appearance
   Vec4f idleColor;
   Vec4f activeColor;
@@ -189,6 +124,7 @@ class Button {
   Vec4f* currentColor;
   float borderWidth;
   Vec4f borderColor;
+  Vec4f labelColor;
 
   // State
   bool isInRect;
@@ -205,6 +141,17 @@ Vec4f topLeft(float, float fbheight) {
                fbheight - margin};
 }
 
+// Under topLeft
+Vec4f topLeftBelow(float, float fbheight) {
+  float margin = 40.f;
+  float gap = 10.f;
+  float width = 160.f;
+  float height = 50.f;
+
+  float top = fbheight - margin - height - gap;
+  return Vec4f{margin, top - height, margin + width, top};
+}
+
 Vec4f bottomCentreLeft(float fbwidth, float) {
   float margin = 40.f;
   float width = 140.f;
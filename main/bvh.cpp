@@ -0,0 +1,201 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+constexpr std::size_t kSahBins = 16;
+// Nodes of up to kMinLeafSize objects are never split; up to kMaxLeafSize
+// only when the SAH says so
+constexpr std::uint32_t kMinLeafSize = 2;
+constexpr std::uint32_t kMaxLeafSize = 8;
+// Relative cost of visiting a node, against testing one object
+constexpr float kTraversalCost = 1.f;
+
+Vec4f row_(Mat44f const& aM, std::size_t aRow) {
+  return Vec4f{aM(aRow, 0), aM(aRow, 1), aM(aRow, 2), aM(aRow, 3)};
+}
+}  // namespace
+
+Ray make_pick_ray(Mat44f const& aProjection, float aNdcX, float aNdcY) {
+  Mat44f const inverse = invert(aProjection);
+  Vec4f const nearH = inverse * Vec4f{aNdcX, aNdcY, -1.f, 1.f};
+  Vec4f const farH = inverse * Vec4f{aNdcX, aNdcY, 1.f, 1.f};
+  Vec3f const nearP = Vec3f{nearH.x, nearH.y, nearH.z} / nearH.w;
+  Vec3f const farP = Vec3f{farH.x, farH.y, farH.z} / farH.w;
+  return Ray{nearP, normalize(farP - nearP)};
+}
+
+float intersect(Ray const& aRay, Vec3f aInvDirection, Aabb const& aBox,
+                float aMaxDistance) {
+  float tNear = 0.f;
+  float tFar = aMaxDistance;
+  for (std::size_t i = 0; i < 3; ++i) {
+    float const t0 = (aBox.min[i] - aRay.origin[i]) * aInvDirection[i];
+    float const t1 = (aBox.max[i] - aRay.origin[i]) * aInvDirection[i];
+    // 0 * inf: the ray runs along one of this axis's planes, so it stays
+    // within the slab and the axis does not clip it
+    if (std::isnan(t0) || std::isnan(t1)) continue;
+    tNear = std::max(tNear, std::min(t0, t1));
+    tFar = std::min(tFar, std::max(t0, t1));
+  }
+  return tNear <= tFar ? tNear : std::numeric_limits<float>::infinity();
+}
+
+Frustum make_frustum(Mat44f const& aProjection) {
+  // Gribb and Hartmann: -w <= x, y, z <= w in clip space
+  Vec4f const r0 = row_(aProjection, 0);
+  Vec4f const r1 = row_(aProjection, 1);
+  Vec4f const r2 = row_(aProjection, 2);
+  Vec4f const r3 = row_(aProjection, 3);
+  return Frustum{{r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + r2, r3 - r2}};
+}
+
+bool intersects(Frustum const& aFrustum, Aabb const& aBox) {
+  for (Vec4f const& p : aFrustum.planes) {
+    // The corner furthest along the plane normal
+    float const x = p.x >= 0.f ? aBox.max.x : aBox.min.x;
+    float const y = p.y >= 0.f ? aBox.max.y : aBox.min.y;
+    float const z = p.z >= 0.f ? aBox.max.z : aBox.min.z;
+    if (p.x * x + p.y * y + p.z * z + p.w < 0.f) return false;
+  }
+  return true;
+}
+
+void Bvh::build(std::span<Aabb const> aBounds) {
+  bounds.assign(aBounds.begin(), aBounds.end());
+  objects.resize(bounds.size());
+  std::iota(objects.begin(), objects.end(), ObjectId(0));
+  centroids.resize(bounds.size());
+  for (std::size_t i = 0; i < bounds.size(); ++i)
+    centroids[i] = center(bounds[i]);
+
+  nodes.clear();
+  if (bounds.empty()) return;
+  nodes.reserve(2 * bounds.size());
+  nodes.push_back(Node{});
+  subdivide(0, 0, std::uint32_t(objects.size()), 0);
+  builtCost = cost();
+}
+
+void Bvh::subdivide(std::uint32_t aNode, std::uint32_t aBegin,
+                    std::uint32_t aEnd, std::size_t aDepth) {
+  Aabb box, centroidBox;
+  for (std::uint32_t i = aBegin; i < aEnd; ++i) {
+    box = merge(box, bounds[objects[i]]);
+    centroidBox = merge(centroidBox, centroids[objects[i]]);
+  }
+  nodes[aNode] = Node{box, aBegin, aEnd - aBegin};
+
+  std::uint32_t const count = aEnd - aBegin;
+  if (count <= kMinLeafSize || aDepth + 1 >= kMaxDepth) return;
+
+  // Binned SAH: try kSahBins - 1 planes along each axis
+  float bestCost = std::numeric_limits<float>::infinity();
+  std::size_t bestAxis = 0, bestSplit = 0;
+  for (std::size_t axis = 0; axis < 3; ++axis) {
+    float const lo = centroidBox.min[axis];
+    float const extentAxis = centroidBox.max[axis] - lo;
+    if (!(extentAxis > 0.f)) continue;
+    float const scale = float(kSahBins) / extentAxis;
+
+    std::array<Aabb, kSahBins> binBounds{};
+    std::array<std::uint32_t, kSahBins> binCounts{};
+    for (std::uint32_t i = aBegin; i < aEnd; ++i) {
+      auto const bin = std::min(
+          std::size_t((centroids[objects[i]][axis] - lo) * scale),
+          kSahBins - 1);
+      binBounds[bin] = merge(binBounds[bin], bounds[objects[i]]);
+      ++binCounts[bin];
+    }
+
+    // Sweep from the right, then from the left
+    std::array<float, kSahBins> rightCost{};
+    Aabb acc;
+    std::uint32_t n = 0;
+    for (std::size_t b = kSahBins - 1; b > 0; --b) {
+      acc = merge(acc, binBounds[b]);
+      n += binCounts[b];
+      rightCost[b] = n > 0 ? half_area(acc) * float(n) : 0.f;
+    }
+    acc = Aabb{};
+    n = 0;
+    for (std::size_t b = 0; b + 1 < kSahBins; ++b) {
+      acc = merge(acc, binBounds[b]);
+      n += binCounts[b];
+      float const c = (n > 0 ? half_area(acc) * float(n) : 0.f) +
+                      rightCost[b + 1];
+      if (c < bestCost) {
+        bestCost = c;
+        bestAxis = axis;
+        bestSplit = b + 1;
+      }
+    }
+  }
+
+  // Keep the leaf if no split beats testing every object
+  float const area = half_area(box);
+  float const leafCost = area * float(count);
+  if (!(bestCost < std::numeric_limits<float>::infinity())) return;
+  if (kTraversalCost * area + bestCost >= leafCost && count <= kMaxLeafSize)
+    return;
+
+  float const lo = centroidBox.min[bestAxis];
+  float const scale = float(kSahBins) / (centroidBox.max[bestAxis] - lo);
+  auto* const mid = std::partition(
+      objects.data() + aBegin, objects.data() + aEnd, [&](ObjectId aObject) {
+        auto const bin = std::min(
+            std::size_t((centroids[aObject][bestAxis] - lo) * scale),
+            kSahBins - 1);
+        return bin < bestSplit;
+      });
+  auto split = std::uint32_t(mid - objects.data());
+  if (split == aBegin || split == aEnd) split = aBegin + count / 2;
+
+  auto const left = std::uint32_t(nodes.size());
+  nodes.push_back(Node{});
+  nodes.push_back(Node{});
+  nodes[aNode].first = left;
+  nodes[aNode].count = 0;
+  subdivide(left, aBegin, split, aDepth + 1);
+  subdivide(left + 1, split, aEnd, aDepth + 1);
+}
+
+void Bvh::refit() {
+  // Children always come after their parent
+  for (std::size_t i = nodes.size(); i-- > 0;) {
+    Node& node = nodes[i];
+    Aabb box;
+    if (node.count > 0) {
+      for (std::uint32_t j = node.first; j < node.first + node.count; ++j)
+        box = merge(box, bounds[objects[j]]);
+    } else {
+      box = merge(nodes[node.first].bounds, nodes[node.first + 1].bounds);
+    }
+    node.bounds = box;
+  }
+}
+
+float Bvh::cost() const {
+  if (nodes.empty()) return 0.f;
+  float sum = 0.f;
+  for (Node const& node : nodes) {
+    sum += half_area(node.bounds) *
+           (node.count > 0 ? float(node.count) : kTraversalCost);
+  }
+  return sum / std::max(half_area(nodes.front().bounds),
+                        std::numeric_limits<float>::min());
+}
+
+float Bvh::costRatio() const {
+  return builtCost > 0.f ? cost() / builtCost : 1.f;
+}
+
+Bvh::Hit Bvh::raycast(Ray const& aRay) const {
+  Vec3f const invDir{1.f / aRay.direction.x, 1.f / aRay.direction.y,
+                     1.f / aRay.direction.z};
+  return raycast(aRay, [&](ObjectId aObject, float aMaxDistance) {
+    return intersect(aRay, invDir, bounds[aObject], aMaxDistance);
+  });
+}
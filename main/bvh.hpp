@@ -0,0 +1,187 @@
+#ifndef BVH_HPP_3A7E5C92_D14B_4F06_8B2D_E96F0A1C47B3
+#define BVH_HPP_3A7E5C92_D14B_4F06_8B2D_E96F0A1C47B3
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "../vmlib/aabb.hpp"
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+
+struct Ray {
+  Vec3f origin;
+  Vec3f direction;  // need not be normalized; hit distances are in its units
+};
+
+// Ray through the given point of the view, in normalized device coordinates
+// ([-1, 1], y up), for a camera projection such as Camera::getProjection()
+Ray make_pick_ray(Mat44f const& aProjection, float aNdcX, float aNdcY);
+
+// Entry distance of the ray into the box, or infinity on a miss.
+// aInvDirection is 1 / direction per component.
+float intersect(Ray const& aRay, Vec3f aInvDirection, Aabb const& aBox,
+                float aMaxDistance = std::numeric_limits<float>::infinity());
+
+// The six clip planes of a projection, pointing inwards (ax + by + cz + d)
+struct Frustum {
+  std::array<Vec4f, 6> planes;
+};
+
+Frustum make_frustum(Mat44f const& aProjection);
+
+// Conservative: may accept boxes just outside a frustum corner
+bool intersects(Frustum const&, Aabb const&);
+
+/* Bvh: bounding volume hierarchy over objects identified by their index
+ *
+ * build() makes a binned SAH tree. Objects that move are handled by
+ * setBounds() followed by refit(), which updates the boxes bottom-up without
+ * changing the tree; rebuild once costRatio() shows the tree has degraded.
+ * Queries call aFn(ObjectId) for every object whose box passes the test.
+ */
+class Bvh {
+ public:
+  using ObjectId = std::uint32_t;
+
+  void build(std::span<Aabb const> aBounds);
+
+  std::size_t objectCount() const { return bounds.size(); }
+  std::size_t nodeCount() const { return nodes.size(); }
+
+  void setBounds(ObjectId aObject, Aabb const& aBounds) {
+    bounds[aObject] = aBounds;
+  }
+  void refit();
+  // SAH cost now relative to when it was built (1 = as good as new)
+  float costRatio() const;
+
+  template <typename Fn>
+  void queryFrustum(Frustum const&, Fn&& aFn) const;
+  template <typename Fn>
+  void queryAabb(Aabb const&, Fn&& aFn) const;
+  // Objects whose box comes within aRadius of aCenter
+  template <typename Fn>
+  void querySphere(Vec3f aCenter, float aRadius, Fn&& aFn) const;
+
+  // Closest hit along the ray. aFn(ObjectId, float aMaxDistance) returns the
+  // distance to the object, or infinity; the default tests the object's box.
+  struct Hit {
+    ObjectId object = std::numeric_limits<ObjectId>::max();
+    float distance = std::numeric_limits<float>::infinity();
+  };
+  Hit raycast(Ray const&) const;
+  template <typename Fn>
+  Hit raycast(Ray const&, Fn&& aFn) const;
+
+ private:
+  struct Node {
+    Aabb bounds;
+    std::uint32_t first;  // first child (internal) or first object (leaf)
+    std::uint32_t count;  // 0 for internal nodes
+  };
+  static constexpr std::size_t kMaxDepth = 64;
+
+  float cost() const;
+  void subdivide(std::uint32_t aNode, std::uint32_t aBegin,
+                 std::uint32_t aEnd, std::size_t aDepth);
+
+  template <typename Test, typename Fn>
+  void query(Test&& aTest, Fn&& aFn) const;
+
+  std::vector<Node> nodes;
+  std::vector<ObjectId> objects;  // leaves index ranges of this
+  std::vector<Aabb> bounds;       // by ObjectId
+  std::vector<Vec3f> centroids;   // build scratch
+  float builtCost = 0.f;
+};
+
+template <typename Test, typename Fn>
+void Bvh::query(Test&& aTest, Fn&& aFn) const {
+  if (nodes.empty()) return;
+
+  std::array<std::uint32_t, kMaxDepth * 2> stack;
+  std::size_t top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    Node const& node = nodes[stack[--top]];
+    if (!aTest(node.bounds)) continue;
+
+    if (node.count > 0) {
+      for (std::uint32_t i = node.first; i < node.first + node.count; ++i) {
+        if (aTest(bounds[objects[i]])) aFn(objects[i]);
+      }
+    } else {
+      stack[top++] = node.first;
+      stack[top++] = node.first + 1;
+    }
+  }
+}
+
+template <typename Fn>
+void Bvh::queryFrustum(Frustum const& aFrustum, Fn&& aFn) const {
+  query([&](Aabb const& aBox) { return intersects(aFrustum, aBox); }, aFn);
+}
+
+template <typename Fn>
+void Bvh::queryAabb(Aabb const& aBox, Fn&& aFn) const {
+  query([&](Aabb const& aOther) { return overlaps(aBox, aOther); }, aFn);
+}
+
+template <typename Fn>
+void Bvh::querySphere(Vec3f aCenter, float aRadius, Fn&& aFn) const {
+  float const r2 = aRadius * aRadius;
+  query(
+      [&](Aabb const& aBox) {
+        Vec3f const closest =
+            component_min(component_max(aCenter, aBox.min), aBox.max);
+        Vec3f const d = closest - aCenter;
+        return dot(d, d) <= r2;
+      },
+      aFn);
+}
+
+template <typename Fn>
+Bvh::Hit Bvh::raycast(Ray const& aRay, Fn&& aFn) const {
+  Hit hit;
+  if (nodes.empty()) return hit;
+
+  Vec3f const invDir{1.f / aRay.direction.x, 1.f / aRay.direction.y,
+                     1.f / aRay.direction.z};
+  std::array<std::uint32_t, kMaxDepth * 2> stack;
+  std::size_t top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    Node const& node = nodes[stack[--top]];
+    if (intersect(aRay, invDir, node.bounds, hit.distance) >= hit.distance)
+      continue;
+
+    if (node.count > 0) {
+      for (std::uint32_t i = node.first; i < node.first + node.count; ++i) {
+        float const t = aFn(objects[i], hit.distance);
+        if (t < hit.distance) hit = Hit{objects[i], t};
+      }
+      continue;
+    }
+
+    // Visit the nearer child first so that it can prune the other
+    Node const& left = nodes[node.first];
+    Node const& right = nodes[node.first + 1];
+    float const tLeft = intersect(aRay, invDir, left.bounds, hit.distance);
+    float const tRight = intersect(aRay, invDir, right.bounds, hit.distance);
+    if (tLeft <= tRight) {
+      if (tRight < hit.distance) stack[top++] = node.first + 1;
+      if (tLeft < hit.distance) stack[top++] = node.first;
+    } else {
+      if (tLeft < hit.distance) stack[top++] = node.first;
+      if (tRight < hit.distance) stack[top++] = node.first + 1;
+    }
+  }
+  return hit;
+}
+
+#endif  // BVH_HPP_3A7E5C92_D14B_4F06_8B2D_E96F0A1C47B3
@@ -1,5 +1,6 @@
 #include "camera.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <numbers>
@@ -65,7 +66,11 @@ void Camera::pointAt(const Vec3f& position) {
   yaw = atan(direction.z / direction.x) - std::numbers::pi_v<float> / 2.f;
 }
 
-void Camera::resetState(GLFWwindow* aWindow) {
+void Camera::keepAbove(float aGroundHeight) {
+  pos.y = std::max(pos.y, aGroundHeight + kGroundClearance);
+}
+
+void Camera::resetState() {
   mouseActive = false;
   aForward = false;
   aBackward = false;
@@ -75,13 +80,23 @@ void Camera::resetState(GLFWwindow* aWindow) {
   aDown = false;
   aSpeedUp = false;
   aSlowDown = false;
-  glfwSetInputMode(aWindow, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+}
+
+Mat44f camera_projection(CameraPose const& aPose, float aspect) {
+  // rotation * translation(-pos)
+  RigidTransform world2camera{to_mat33(aPose.orientation), {}};
+  world2camera.translation = -(world2camera.rotation * aPose.pos);
+  return make_perspective_projection(kFieldOfView, aspect, kNearPlane,
+                                     kFarPlane) *
+         to_mat44(world2camera);
+}
+
+Quatf Camera::orientation() const {
+  return make_quat_rotation_x(pitch) * make_quat_rotation_y(yaw);
 }
 
 const Mat44f Camera::getProjection(float aspect) const {
-  return make_perspective_projection(std::numbers::pi_v<float> / 3.f, aspect,
-                                     0.1f, 100.0f) *
-         make_rotation_x(pitch) * make_rotation_y(yaw) * make_translation(-pos);
+  return camera_projection(getPose(), aspect);
 }
 
 void Camera::updateKeyActions(int aKey, int aAction) {
@@ -168,21 +183,9 @@ void Camera::updateMouseMovement(double aX, double aY) {
   lastMouseY = float(aY);
 }
 
-void Camera::updateMouseClicked(GLFWwindow* aWindow, int aButton, int aAction) {
-  if (aButton == GLFW_MOUSE_BUTTON_RIGHT && aAction == GLFW_PRESS) {
-    mouseActive = !mouseActive;
-
-    if (mouseActive)
-      glfwSetInputMode(aWindow, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
-    else
-      glfwSetInputMode(aWindow, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-  }
-}
-
 void Camera::moveDirection(const Vec3f& dir) {
-  Vec4f addDirection = make_rotation_x(-pitch) * make_rotation_y(-yaw) *
-                       Vec4f{dir.x, dir.y, dir.z, 1.f};
-  pos -= Vec3f{addDirection.x, addDirection.y, addDirection.z};
+  // Camera space to world space
+  pos -= rotate(conjugate(orientation()), dir);
 }
 
 void Camera::moveAngle(float addPitch, float addYaw) {
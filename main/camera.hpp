@@ -4,32 +4,52 @@
 #include <GLFW/glfw3.h>
 
 #include <iostream>
+#include <numbers>
 
 #include "../vmlib/mat44.hpp"
+#include "../vmlib/quat.hpp"
 #include "../vmlib/vec3.hpp"
 
 constexpr float kMovementPerSecond = 1.f;   // units per second
 constexpr float kMouseSensitivity = 0.01f;  // radians per pixel
 constexpr float kSpeedFactor = 5.f;
 constexpr float kSlowFactor = 0.2f;
+constexpr float kFieldOfView = std::numbers::pi_v<float> / 3.f;  // vertical
+constexpr float kNearPlane = 0.1f;
+constexpr float kFarPlane = 100.f;
+// Least height above the ground, so the near plane does not cut into it
+constexpr float kGroundClearance = kNearPlane;
+
+// The part of a camera's state needed for rendering. `orientation` rotates
+// world directions into camera space.
+struct CameraPose {
+  Vec3f pos;
+  Quatf orientation;
+};
+
+Mat44f camera_projection(CameraPose const&, float aspect);
 
 class Camera {
  public:
   Camera(Vec3f pos);
   const Vec3f getCamWorldPosition() const { return pos; }
+  CameraPose getPose() const { return CameraPose{pos, orientation()}; }
 
   // Camera position methods
   void updateState(float dt);
   void track(const Vec3f& position);
   void pointAt(const Vec3f& position);
+  // Lifts the camera to kGroundClearance above aGroundHeight if it is lower
+  void keepAbove(float aGroundHeight);
 
-  void resetState(GLFWwindow* aWindow);
+  // Stops moving and looking around
+  void resetState();
   const Mat44f getProjection(float aspect) const;
 
-  // Input polling
+  // Input (see input.hpp); the window shows or hides the cursor itself
   void updateKeyActions(int aKey, int aAction);
   void updateMouseMovement(double aX, double aY);
-  void updateMouseClicked(GLFWwindow* aWindow, int aButton, int aAction);
+  void setMouseLook(bool aOn) { mouseActive = aOn; }
 
  private:
   Vec3f pos;
@@ -42,6 +62,9 @@ class Camera {
 
   float lastMouseX, lastMouseY;
 
+  // pitch and yaw are kept for mouse input; everything else uses this
+  Quatf orientation() const;
+
   void moveDirection(const Vec3f& dir);
 
   void moveAngle(float addPitch, float addYaw);
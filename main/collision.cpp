@@ -0,0 +1,521 @@
+#include "collision.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace {
+// Capsules across a flat cylinder, evenly spread over half a turn
+constexpr int kStarCapsules = 4;
+// Entries swept by one job, and bodies gathered by one job
+constexpr std::size_t kSweepChunk = 1024;
+constexpr std::size_t kGatherGrain = 16384;
+// Slabs are about this many average boxes wide, and hold at least this many
+// bodies on average
+constexpr double kSlabBoxes = 4.0;
+constexpr std::size_t kMinSlabBodies = 64;
+constexpr std::size_t kMaxSlabs = 4096;
+// The insertion sort gives up after this many moves per body on average
+constexpr std::size_t kMaxSortMoves = 8;
+// The sweep axis only changes once another axis is this much more spread
+// out, so that it does not flip back and forth between ticks
+constexpr double kAxisSwitchRatio = 1.5;
+
+constexpr float kEpsilon = 1e-12f;
+
+Aabb capsule_bounds_(Capsule const& aCapsule) {
+  Vec3f const r{aCapsule.radius, aCapsule.radius, aCapsule.radius};
+  return Aabb{component_min(aCapsule.a, aCapsule.b) - r,
+              component_max(aCapsule.a, aCapsule.b) + r};
+}
+
+// Closest points of the segments p1-q1 and p2-q2, as parameters along
+// them (Ericson, Real-Time Collision Detection, 5.1.9)
+void closest_segment_points_(Vec3f aP1, Vec3f aQ1, Vec3f aP2, Vec3f aQ2,
+                             float& aS, float& aT) {
+  Vec3f const d1 = aQ1 - aP1;
+  Vec3f const d2 = aQ2 - aP2;
+  Vec3f const r = aP1 - aP2;
+  float const a = dot(d1, d1);
+  float const e = dot(d2, d2);
+  float const f = dot(d2, r);
+
+  if (a <= kEpsilon && e <= kEpsilon) {
+    aS = aT = 0.f;
+    return;
+  }
+  if (a <= kEpsilon) {
+    aS = 0.f;
+    aT = std::clamp(f / e, 0.f, 1.f);
+    return;
+  }
+  float const c = dot(d1, r);
+  if (e <= kEpsilon) {
+    aT = 0.f;
+    aS = std::clamp(-c / a, 0.f, 1.f);
+    return;
+  }
+
+  float const b = dot(d1, d2);
+  float const denominator = a * e - b * b;
+  aS = denominator > 0.f
+           ? std::clamp((b * f - c * e) / denominator, 0.f, 1.f)
+           : 0.f;
+  aT = (b * aS + f) / e;
+  if (aT < 0.f) {
+    aT = 0.f;
+    aS = std::clamp(-c / a, 0.f, 1.f);
+  } else if (aT > 1.f) {
+    aT = 1.f;
+    aS = std::clamp((b - c) / a, 0.f, 1.f);
+  }
+}
+
+// Two unit vectors perpendicular to aAxis and to each other
+void make_perpendicular_basis_(Vec3f aAxis, Vec3f& aU, Vec3f& aV) {
+  Vec3f const other = std::abs(aAxis.x) < 0.9f ? Vec3f{1.f, 0.f, 0.f}
+                                               : Vec3f{0.f, 1.f, 0.f};
+  aU = normalize(cross(aAxis, other));
+  aV = cross(aAxis, aU);
+}
+
+std::vector<float> const& pick_axis_(int aAxis, std::vector<float> const& aX,
+                                     std::vector<float> const& aY,
+                                     std::vector<float> const& aZ) {
+  return 0 == aAxis ? aX : 1 == aAxis ? aY : aZ;
+}
+}  // namespace
+
+void add_cylinder_capsules(CollisionShape& aShape, Vec3f aBase, Vec3f aTip,
+                           float aRadius, bool aCone) {
+  float const radius = aCone ? 0.5f * aRadius : aRadius;
+  Vec3f const axis = aTip - aBase;
+  float const len = length(axis);
+  if (len <= 0.f) return;
+  Vec3f const direction = axis / len;
+
+  if (len >= 2.f * radius) {
+    aShape.capsules.push_back(Capsule{aBase + direction * radius,
+                                      aTip - direction * radius, radius});
+    return;
+  }
+
+  // Flat: capsules as thick as the part, across its face
+  float const half = 0.5f * len;
+  Vec3f const centre = aBase + direction * half;
+  Vec3f u, v;
+  make_perpendicular_basis_(direction, u, v);
+  for (int i = 0; i < kStarCapsules; ++i) {
+    float const angle =
+        std::numbers::pi_v<float> * float(i) / float(kStarCapsules);
+    Vec3f const across =
+        (u * std::cos(angle) + v * std::sin(angle)) * (radius - half);
+    aShape.capsules.push_back(
+        Capsule{centre - across, centre + across, half});
+  }
+}
+
+void add_ellipsoid_capsule(CollisionShape& aShape, Vec3f aCentre,
+                           Vec3f const (&aAxes)[3]) {
+  float lengths[3];
+  for (int i = 0; i < 3; ++i) lengths[i] = length(aAxes[i]);
+  int const longest = int(std::max_element(lengths, lengths + 3) - lengths);
+  float const radius = std::max(lengths[(longest + 1) % 3],
+                                lengths[(longest + 2) % 3]);
+
+  Vec3f along{0.f, 0.f, 0.f};
+  if (lengths[longest] > radius) {
+    along = aAxes[longest] * ((lengths[longest] - radius) /
+                              lengths[longest]);
+  }
+  aShape.capsules.push_back(
+      Capsule{aCentre - along, aCentre + along, radius});
+}
+
+void update_bounds(CollisionShape& aShape) {
+  aShape.boundingRadius = 0.f;
+  aShape.bounds = Aabb{};
+  for (Capsule const& capsule : aShape.capsules) {
+    aShape.boundingRadius =
+        std::max(aShape.boundingRadius,
+                 std::max(length(capsule.a), length(capsule.b)) +
+                     capsule.radius);
+    aShape.bounds = merge(aShape.bounds, capsule_bounds_(capsule));
+  }
+}
+
+bool intersect(Capsule const& aFirst, Capsule const& aSecond,
+               Contact& aContact) {
+  float s, t;
+  closest_segment_points_(aFirst.a, aFirst.b, aSecond.a, aSecond.b, s, t);
+  Vec3f const onFirst = aFirst.a + (aFirst.b - aFirst.a) * s;
+  Vec3f const onSecond = aSecond.a + (aSecond.b - aSecond.a) * t;
+
+  Vec3f const apart = onFirst - onSecond;
+  float const reach = aFirst.radius + aSecond.radius;
+  float const distanceSquared = dot(apart, apart);
+  if (distanceSquared > reach * reach) return false;
+
+  // Axes that cross get pushed apart upwards
+  float const distance = std::sqrt(distanceSquared);
+  aContact.normal = distance > 0.f ? apart / distance
+                                   : Vec3f{0.f, 1.f, 0.f};
+  aContact.depth = reach - distance;
+  aContact.point =
+      onSecond + aContact.normal * (aSecond.radius - 0.5f * aContact.depth);
+  return true;
+}
+
+bool collide(CollisionShape const& aFirst, RigidTransform const& aFirstPose,
+             CollisionShape const& aSecond,
+             RigidTransform const& aSecondPose, Contact& aContact) {
+  Vec3f const apart = aFirstPose.translation - aSecondPose.translation;
+  float const reach = aFirst.boundingRadius + aSecond.boundingRadius;
+  if (dot(apart, apart) > reach * reach) return false;
+
+  // Work in the second shape's frame, so only the first's capsules move
+  RigidTransform const toSecond = invert(aSecondPose) * aFirstPose;
+
+  bool found = false;
+  aContact.depth = 0.f;
+  for (Capsule const& first : aFirst.capsules) {
+    Capsule const moved{transform_point(toSecond, first.a),
+                        transform_point(toSecond, first.b), first.radius};
+    // Skip capsules that miss the second shape's bounding sphere
+    Vec3f const along = moved.b - moved.a;
+    float const lengthSquared = dot(along, along);
+    float const t = lengthSquared > kEpsilon
+                        ? std::clamp(-dot(moved.a, along) / lengthSquared,
+                                     0.f, 1.f)
+                        : 0.f;
+    Vec3f const nearest = moved.a + along * t;
+    float const near = aSecond.boundingRadius + moved.radius;
+    if (dot(nearest, nearest) > near * near) continue;
+    // and its box, which is tighter for long thin shapes
+    Aabb const movedBox = capsule_bounds_(moved);
+    if (!overlaps(movedBox, aSecond.bounds)) continue;
+
+    for (Capsule const& second : aSecond.capsules) {
+      Contact contact;
+      if (overlaps(movedBox, capsule_bounds_(second)) &&
+          intersect(moved, second, contact) &&
+          (!found || contact.depth > aContact.depth)) {
+        aContact = contact;
+        found = true;
+      }
+    }
+  }
+  if (found) {
+    aContact.point = transform_point(aSecondPose, aContact.point);
+    aContact.normal = transform_vector(aSecondPose, aContact.normal);
+  }
+  return found;
+}
+
+BroadPhase::BodyId BroadPhase::add(Aabb const& aBounds) {
+  auto const body = BodyId(size());
+  minX.push_back(aBounds.min.x);
+  minY.push_back(aBounds.min.y);
+  minZ.push_back(aBounds.min.z);
+  maxX.push_back(aBounds.max.x);
+  maxY.push_back(aBounds.max.y);
+  maxZ.push_back(aBounds.max.z);
+  order.push_back(body);  // the next sort moves it into place
+  return body;
+}
+
+void BroadPhase::setBounds(BodyId aBody, Aabb const& aBounds) {
+  minX[aBody] = aBounds.min.x;
+  minY[aBody] = aBounds.min.y;
+  minZ[aBody] = aBounds.min.z;
+  maxX[aBody] = aBounds.max.x;
+  maxY[aBody] = aBounds.max.y;
+  maxZ[aBody] = aBounds.max.z;
+}
+
+void BroadPhase::clear() {
+  for (auto* v : {&minX, &minY, &minZ, &maxX, &maxY, &maxZ}) v->clear();
+  order.clear();
+  axis = -1;
+  slabStart.assign(1, 0);
+  ranges.clear();
+  found.clear();
+}
+
+void BroadPhase::update() {
+  prepare();
+  gather(0, size());
+  deal();
+  rangePairs.resize(ranges.size());
+  for (std::size_t r = 0; r < ranges.size(); ++r) {
+    rangePairs[r].clear();
+    sweep(ranges[r], rangePairs[r]);
+  }
+  join();
+}
+
+void BroadPhase::update(JobSystem& aJobs) {
+  prepare();
+  aJobs.parallel_for(0, size(), kGatherGrain,
+                     [this](std::size_t aBegin, std::size_t aEnd) {
+                       gather(aBegin, aEnd);
+                     });
+  deal();
+  rangePairs.resize(ranges.size());
+  aJobs.parallel_for(0, ranges.size(), 1, [this](std::size_t aBegin,
+                                                 std::size_t aEnd) {
+    for (std::size_t r = aBegin; r < aEnd; ++r) {
+      rangePairs[r].clear();
+      sweep(ranges[r], rangePairs[r]);
+    }
+  });
+  join();
+}
+
+void BroadPhase::prepare() {
+  std::size_t const count = size();
+  for (int i = 0; i < 3; ++i) {
+    sortedMin[i].resize(count);
+    sortedMax[i].resize(count);
+  }
+  if (0 == count) {
+    slabStart.assign(1, 0);
+    return;
+  }
+
+  // Spread of the box centres, and size of the boxes, along each axis
+  std::vector<float> const* const mins[3] = {&minX, &minY, &minZ};
+  std::vector<float> const* const maxs[3] = {&maxX, &maxY, &maxZ};
+  double variance[3];
+  double extent[3];
+  float low[3];
+  float high[3];
+  for (int a = 0; a < 3; ++a) {
+    std::vector<float> const& from = *mins[a];
+    std::vector<float> const& to = *maxs[a];
+    double sum = 0.0;
+    double sumSquared = 0.0;
+    double sizes = 0.0;
+    low[a] = from[0];
+    high[a] = to[0];
+    for (std::size_t i = 0; i < count; ++i) {
+      double const centre = double(from[i]) + to[i];
+      sum += centre;
+      sumSquared += centre * centre;
+      sizes += double(to[i]) - from[i];
+      low[a] = std::min(low[a], from[i]);
+      high[a] = std::max(high[a], to[i]);
+    }
+    variance[a] = sumSquared - sum * sum / double(count);
+    extent[a] = sizes / double(count);
+  }
+
+  int const widest = int(std::max_element(variance, variance + 3) - variance);
+  if (axis < 0 || variance[widest] > kAxisSwitchRatio * variance[axis]) {
+    axis = widest;
+    sortFromScratch();
+  } else if (!sortIncrementally()) {
+    sortFromScratch();
+  }
+
+  // Slabs a few boxes wide across the next widest axis, but not so many
+  // that they hold only a handful of bodies each
+  int const first = (axis + 1) % 3;
+  int const second = (axis + 2) % 3;
+  slabAxis = variance[first] >= variance[second] ? first : second;
+  double const span = double(high[slabAxis]) - low[slabAxis];
+  double const width = kSlabBoxes * extent[slabAxis];
+  std::size_t slabs = 1;
+  if (std::isfinite(span) && span > 0.0 && width > 0.0) {
+    slabs = std::size_t(std::clamp(std::ceil(span / width), 1.0,
+                                   double(kMaxSlabs)));
+    slabs = std::max<std::size_t>(1, std::min(slabs, count / kMinSlabBodies));
+  }
+  slabOrigin = low[slabAxis];
+  slabScale = slabs > 1 ? float(double(slabs) / span) : 0.f;
+  slabStart.assign(slabs + 1, 0);
+}
+
+bool BroadPhase::sortIncrementally() {
+  std::vector<float> const& mins = pick_axis_(axis, minX, minY, minZ);
+  std::size_t const count = order.size();
+  keys.resize(count);
+  for (std::size_t k = 0; k < count; ++k) keys[k] = mins[order[k]];
+
+  std::size_t moves = 0;
+  std::size_t const maxMoves = kMaxSortMoves * count;
+  for (std::size_t k = 1; k < count; ++k) {
+    float const key = keys[k];
+    BodyId const body = order[k];
+    std::size_t j = k;
+    for (; j > 0 && key < keys[j - 1]; --j) {
+      keys[j] = keys[j - 1];
+      order[j] = order[j - 1];
+    }
+    keys[j] = key;
+    order[j] = body;
+    moves += k - j;
+    if (moves > maxMoves) return false;
+  }
+  return true;
+}
+
+void BroadPhase::sortFromScratch() {
+  std::vector<float> const& mins = pick_axis_(axis, minX, minY, minZ);
+  std::sort(order.begin(), order.end(), [&](BodyId aLeft, BodyId aRight) {
+    return mins[aLeft] < mins[aRight] ||
+           (mins[aLeft] == mins[aRight] && aLeft < aRight);
+  });
+}
+
+void BroadPhase::gather(std::size_t aBegin, std::size_t aEnd) {
+  std::vector<float> const* const mins[3] = {&minX, &minY, &minZ};
+  std::vector<float> const* const maxs[3] = {&maxX, &maxY, &maxZ};
+  int const axes[3] = {axis, slabAxis, 3 - axis - slabAxis};
+  for (int i = 0; i < 3; ++i) {
+    std::vector<float> const& from = *mins[axes[i]];
+    std::vector<float> const& to = *maxs[axes[i]];
+    for (std::size_t k = aBegin; k < aEnd; ++k) {
+      sortedMin[i][k] = from[order[k]];
+      sortedMax[i][k] = to[order[k]];
+    }
+  }
+}
+
+void BroadPhase::deal() {
+  std::size_t const slabs = slabStart.size() - 1;
+  float const last = float(slabs - 1);
+  auto const slab_of = [&](float aCoordinate) {
+    float const s = (aCoordinate - slabOrigin) * slabScale;
+    return std::uint32_t(std::clamp(s, 0.f, last));
+  };
+
+  // Count, then place; going through the bodies in sweep order keeps each
+  // slab sorted
+  std::size_t const count = size();
+  slabRange.resize(count);
+  for (std::size_t k = 0; k < count; ++k) {
+    std::uint32_t const begin = slab_of(sortedMin[1][k]);
+    std::uint32_t const end = slab_of(sortedMax[1][k]);
+    slabRange[k] = SlabRange{begin, end};
+    for (std::uint32_t s = begin; s <= end; ++s) ++slabStart[s + 1];
+  }
+  for (std::size_t s = 0; s < slabs; ++s) slabStart[s + 1] += slabStart[s];
+
+  std::size_t const entries = slabStart[slabs];
+  for (int i = 0; i < 3; ++i) {
+    entryMin[i].resize(entries);
+    entryMax[i].resize(entries);
+  }
+  entryBody.resize(entries);
+  entryFirstSlab.resize(entries);
+
+  float* const min0 = entryMin[0].data();
+  float* const max0 = entryMax[0].data();
+  float* const min1 = entryMin[1].data();
+  float* const max1 = entryMax[1].data();
+  float* const min2 = entryMin[2].data();
+  float* const max2 = entryMax[2].data();
+  BodyId* const body = entryBody.data();
+  std::uint32_t* const first = entryFirstSlab.data();
+  slabFill.assign(slabStart.begin(), slabStart.end() - 1);
+  for (std::size_t k = 0; k < count; ++k) {
+    SlabRange const range = slabRange[k];
+    for (std::uint32_t s = range.first; s <= range.last; ++s) {
+      std::size_t const e = slabFill[s]++;
+      min0[e] = sortedMin[0][k];
+      max0[e] = sortedMax[0][k];
+      min1[e] = sortedMin[1][k];
+      max1[e] = sortedMax[1][k];
+      min2[e] = sortedMin[2][k];
+      max2[e] = sortedMax[2][k];
+      body[e] = order[k];
+      first[e] = range.first;
+    }
+  }
+
+  ranges.clear();
+  for (std::size_t s = 0; s < slabs; ++s) {
+    for (std::size_t b = slabStart[s]; b < slabStart[s + 1];
+         b += kSweepChunk) {
+      ranges.push_back(SweepRange{b, std::min(b + kSweepChunk,
+                                              slabStart[s + 1]),
+                                  slabStart[s + 1], std::uint32_t(s)});
+    }
+  }
+}
+
+void BroadPhase::sweep(SweepRange const& aRange,
+                       std::vector<BroadPhasePair>& aOut) const {
+  std::size_t const end = aRange.slabEnd;
+  float const* const min0 = entryMin[0].data();
+  float const* const min1 = entryMin[1].data();
+  float const* const max1 = entryMax[1].data();
+  float const* const min2 = entryMin[2].data();
+  float const* const max2 = entryMax[2].data();
+
+  // Boxes in several slabs are only reported by the first they share
+  auto const emit = [&](std::size_t aI, std::size_t aJ) {
+    if (std::max(entryFirstSlab[aI], entryFirstSlab[aJ]) != aRange.slab)
+      return;
+    BodyId const first = entryBody[aI];
+    BodyId const second = entryBody[aJ];
+    aOut.push_back(first < second ? BroadPhasePair{first, second}
+                                  : BroadPhasePair{second, first});
+  };
+
+  for (std::size_t i = aRange.begin; i < aRange.end; ++i) {
+    float const end0 = entryMax[0][i];
+    std::size_t j = i + 1;
+    bool done = false;
+
+#if defined(__AVX__)
+    // Eight candidates at a time; same tests as the loop below. Boxes are
+    // sorted by where they start, so once one starts past end0 all later
+    // ones do too.
+    __m256 const vEnd0 = _mm256_set1_ps(end0);
+    __m256 const vMin1 = _mm256_set1_ps(min1[i]);
+    __m256 const vMax1 = _mm256_set1_ps(max1[i]);
+    __m256 const vMin2 = _mm256_set1_ps(min2[i]);
+    __m256 const vMax2 = _mm256_set1_ps(max2[i]);
+    for (; j + 8 <= end; j += 8) {
+      __m256 const starts =
+          _mm256_cmp_ps(_mm256_loadu_ps(min0 + j), vEnd0, _CMP_LE_OQ);
+      __m256 const overlap1 = _mm256_and_ps(
+          _mm256_cmp_ps(_mm256_loadu_ps(min1 + j), vMax1, _CMP_LE_OQ),
+          _mm256_cmp_ps(_mm256_loadu_ps(max1 + j), vMin1, _CMP_GE_OQ));
+      __m256 const overlap2 = _mm256_and_ps(
+          _mm256_cmp_ps(_mm256_loadu_ps(min2 + j), vMax2, _CMP_LE_OQ),
+          _mm256_cmp_ps(_mm256_loadu_ps(max2 + j), vMin2, _CMP_GE_OQ));
+      auto mask = unsigned(_mm256_movemask_ps(
+          _mm256_and_ps(starts, _mm256_and_ps(overlap1, overlap2))));
+      while (mask != 0) {
+        emit(i, j + std::size_t(std::countr_zero(mask)));
+        mask &= mask - 1;
+      }
+      if (_mm256_movemask_ps(starts) != 0xff) {
+        done = true;
+        break;
+      }
+    }
+#endif
+
+    if (done) continue;
+    for (; j < end && min0[j] <= end0; ++j) {
+      if (min1[j] <= max1[i] && max1[j] >= min1[i] && min2[j] <= max2[i] &&
+          max2[j] >= min2[i])
+        emit(i, j);
+    }
+  }
+}
+
+void BroadPhase::join() {
+  found.clear();
+  for (std::vector<BroadPhasePair> const& pairs : rangePairs)
+    found.insert(found.end(), pairs.begin(), pairs.end());
+}
@@ -0,0 +1,144 @@
+#ifndef COLLISION_HPP_E7B20C5A_3F94_4D1E_8A6C_2D05B9F47E13
+#define COLLISION_HPP_E7B20C5A_3F94_4D1E_8A6C_2D05B9F47E13
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "../vmlib/aabb.hpp"
+#include "../vmlib/affine34.hpp"
+#include "../vmlib/vec3.hpp"
+#include "job_system.hpp"
+
+// The points within radius of the segment a-b; a sphere when a == b
+struct Capsule {
+  Vec3f a, b;
+  float radius;
+};
+
+// A body's shape as capsules in its own frame, and the radius of a sphere
+// about the body's origin and the box that hold them all
+struct CollisionShape {
+  std::vector<Capsule> capsules;
+  float boundingRadius = 0.f;
+  Aabb bounds;
+};
+
+// Capsules that fill a cylinder or cone from aBase to aTip; a cone counts
+// as a cylinder of half its base radius. Long parts become one capsule
+// spanning the part, flat ones a star of capsules across it.
+void add_cylinder_capsules(CollisionShape&, Vec3f aBase, Vec3f aTip,
+                           float aRadius, bool aCone);
+// One capsule along the longest axis of an ellipsoid with the given
+// centre and semi-axes, which must be orthogonal
+void add_ellipsoid_capsule(CollisionShape&, Vec3f aCentre,
+                           Vec3f const (&aAxes)[3]);
+void update_bounds(CollisionShape&);
+
+// Where two shapes touch. The normal points from the second shape to the
+// first; moving the first by normal * depth separates them.
+struct Contact {
+  Vec3f point;
+  Vec3f normal;
+  float depth;
+};
+
+bool intersect(Capsule const&, Capsule const&, Contact&);
+// Deepest contact of two posed shapes
+bool collide(CollisionShape const& aFirst, RigidTransform const& aFirstPose,
+             CollisionShape const& aSecond,
+             RigidTransform const& aSecondPose, Contact&);
+
+// Overlapping boxes found by BroadPhase; a < b
+struct BroadPhasePair {
+  std::uint32_t a, b;
+};
+
+/* BroadPhase: sweep and prune over moving boxes
+ *
+ * Bodies are numbered in the order they are added. Their boxes are kept as
+ * structure of arrays; update() then finds every pair whose boxes overlap.
+ *
+ * The bodies are kept sorted by where their boxes start along the sweep
+ * axis, the one along which they are most spread out. Between ticks bodies
+ * move little, so last tick's order is nearly sorted and an insertion sort
+ * puts it right in about linear time; after large jumps, or when the axis
+ * changes, it is sorted from scratch.
+ *
+ * Sweeping one sorted list compares each box with every box that starts
+ * along the sweep axis before it ends, however far away they are along the
+ * other axes. So the bodies are first dealt, in sorted order, into slabs
+ * across the next most spread out axis, a few boxes wide; a box spanning
+ * several slabs goes into each. Every slab is then swept on its own, eight
+ * boxes at a time, and a pair is only reported by the first slab the two
+ * boxes share. The sweep runs as jobs over pieces of the slabs, each
+ * collecting its own pairs, which are joined in order so the result does
+ * not depend on scheduling.
+ */
+class BroadPhase {
+ public:
+  using BodyId = std::uint32_t;
+
+  std::size_t size() const { return minX.size(); }
+  BodyId add(Aabb const&);
+  void setBounds(BodyId aBody, Aabb const&);
+  void clear();
+
+  void update();
+  void update(JobSystem& aJobs);
+
+  std::span<BroadPhasePair const> pairs() const { return found; }
+  int sweepAxis() const { return axis; }
+  std::size_t slabCount() const { return slabStart.size() - 1; }
+
+ private:
+  // Entries [begin, end) of one slab, which ends at slabEnd
+  struct SweepRange {
+    std::size_t begin, end, slabEnd;
+    std::uint32_t slab;
+  };
+
+  void prepare();
+  // Returns false if the insertion sort gave up
+  bool sortIncrementally();
+  void sortFromScratch();
+  void gather(std::size_t aBegin, std::size_t aEnd);
+  void deal();
+  void sweep(SweepRange const&, std::vector<BroadPhasePair>& aOut) const;
+  void join();
+
+  // By body
+  std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+  // Bodies in sweep order, with their boxes in that order: [0] along the
+  // sweep axis, [1] across the slabs, [2] along the remaining axis
+  std::vector<BodyId> order;
+  std::vector<float> keys;  // sort scratch
+  std::vector<float> sortedMin[3], sortedMax[3];
+  int axis = -1;
+  int slabAxis = 1;
+
+  // Slab s covers [slabOrigin + s / slabScale, ...) across the slabs; the
+  // first and last slab extend to infinity
+  float slabOrigin = 0.f;
+  float slabScale = 0.f;
+  // Entries by slab, each slab in sweep order; slab s holds entries
+  // [slabStart[s], slabStart[s + 1])
+  std::vector<std::size_t> slabStart{0};
+  std::vector<float> entryMin[3], entryMax[3];
+  std::vector<BodyId> entryBody;
+  std::vector<std::uint32_t> entryFirstSlab;
+  // deal() scratch
+  struct SlabRange {
+    std::uint32_t first, last;
+  };
+  std::vector<SlabRange> slabRange;
+  std::vector<std::size_t> slabFill;
+
+  std::vector<SweepRange> ranges;
+  std::vector<std::vector<BroadPhasePair>> rangePairs;
+  std::vector<BroadPhasePair> found;
+};
+
+#endif  // COLLISION_HPP_E7B20C5A_3F94_4D1E_8A6C_2D05B9F47E13
@@ -0,0 +1,289 @@
+#include "fleet.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "spaceship.hpp"
+
+namespace {
+// Ships stand on a square grid around this point
+constexpr Vec3f kFleetCentre{0.f, 0.1f, -15.f};
+constexpr float kFleetSpacing = 0.5f;
+// Launches are spread over this many seconds
+constexpr float kMaxLaunchDelay = 10.f;
+// Rebuild the BVH once refitting has made it this much worse than new
+constexpr float kMaxBvhCostRatio = 2.f;
+
+// Launch curve that Spaceship's thrust profile follows; each fleet ship
+// varies it by up to +-kCurveVariation
+constexpr float kCurveX = 0.005f;
+constexpr float kCurveY = 0.08f;
+constexpr float kCurveVariation = 0.3f;
+
+// One ship of Fleet::update(). The rotation is atan2(dy, dx) - pi/2, whose
+// cosine and sine are dy/|d| and -dx/|d|.
+inline void update_ship_(float aTime, float aDelay, float aKX, float aKY,
+                         float aX0, float aY0, float& aX, float& aY,
+                         float& aCos, float& aSin) {
+  float const t = std::max(aTime - aDelay, 0.f);
+  float const t2 = t * t;
+  aX = aX0 + aKX * (t2 * t);
+  aY = aY0 + aKY * t2;
+
+  float const dx = 3.f * (aKX * t2);
+  float const dy = 2.f * (aKY * t);
+  float const r2 = dx * dx + dy * dy;
+  if (r2 > 0.f) {
+    float const invR = 1.f / std::sqrt(r2);
+    aCos = dy * invR;
+    aSin = -dx * invR;
+  } else {
+    aCos = 1.f;
+    aSin = 0.f;
+  }
+}
+}  // namespace
+
+void FleetPoses::resize(std::size_t aCount) {
+  x.resize(aCount);
+  y.resize(aCount);
+  z.resize(aCount);
+  cosZ.resize(aCount);
+  sinZ.resize(aCount);
+}
+
+Fleet::Fleet(std::size_t aCount, std::uint32_t aSeed) {
+  std::mt19937 rng(aSeed);
+  std::uniform_real_distribution<float> delayDist(0.f, kMaxLaunchDelay);
+  std::uniform_real_distribution<float> curveDist(1.f - kCurveVariation,
+                                                  1.f + kCurveVariation);
+
+  auto const side = std::size_t(std::ceil(std::sqrt(float(aCount))));
+  float const halfWidth = 0.5f * kFleetSpacing * float(side - 1);
+
+  poses.resize(aCount);
+  initialX.resize(aCount);
+  initialY.resize(aCount);
+  initialZ.resize(aCount);
+  offsetX.resize(aCount);
+  offsetY.resize(aCount);
+  offsetZ.resize(aCount);
+  delay.resize(aCount);
+  kX.resize(aCount);
+  kY.resize(aCount);
+  for (std::size_t i = 0; i < aCount; ++i) {
+    initialX[i] = kFleetCentre.x - halfWidth + kFleetSpacing * float(i % side);
+    initialY[i] = kFleetCentre.y;
+    initialZ[i] = kFleetCentre.z - halfWidth + kFleetSpacing * float(i / side);
+    delay[i] = delayDist(rng);
+    kX[i] = kCurveX * curveDist(rng);
+    kY[i] = kCurveY * curveDist(rng);
+  }
+
+  resetState();
+}
+
+void Fleet::resetState() {
+  time = 0.f;
+  running = false;
+
+  std::copy(initialX.begin(), initialX.end(), poses.x.begin());
+  std::copy(initialY.begin(), initialY.end(), poses.y.begin());
+  std::copy(initialZ.begin(), initialZ.end(), poses.z.begin());
+  for (auto* v : {&offsetX, &offsetY, &offsetZ})
+    std::fill(v->begin(), v->end(), 0.f);
+  std::fill(poses.cosZ.begin(), poses.cosZ.end(), 1.f);
+  std::fill(poses.sinZ.begin(), poses.sinZ.end(), 0.f);
+}
+
+void Fleet::update(float dt) {
+  if (!running) return;
+  time += dt;
+
+  std::size_t const count = size();
+  std::size_t i = 0;
+
+#if defined(__AVX__)
+  // Eight ships at a time; same arithmetic as update_ship_()
+  __m256 const vTime = _mm256_set1_ps(time);
+  __m256 const zero = _mm256_setzero_ps();
+  __m256 const one = _mm256_set1_ps(1.f);
+  __m256 const two = _mm256_set1_ps(2.f);
+  __m256 const three = _mm256_set1_ps(3.f);
+  for (; i + 8 <= count; i += 8) {
+    __m256 const t =
+        _mm256_max_ps(_mm256_sub_ps(vTime, _mm256_loadu_ps(&delay[i])), zero);
+    __m256 const t2 = _mm256_mul_ps(t, t);
+    __m256 const kx = _mm256_loadu_ps(&kX[i]);
+    __m256 const ky = _mm256_loadu_ps(&kY[i]);
+
+    __m256 const x0 = _mm256_add_ps(_mm256_loadu_ps(&initialX[i]),
+                                    _mm256_loadu_ps(&offsetX[i]));
+    __m256 const y0 = _mm256_add_ps(_mm256_loadu_ps(&initialY[i]),
+                                    _mm256_loadu_ps(&offsetY[i]));
+    __m256 const t3 = _mm256_mul_ps(t2, t);
+    _mm256_storeu_ps(&poses.x[i], _mm256_add_ps(x0, _mm256_mul_ps(kx, t3)));
+    _mm256_storeu_ps(&poses.y[i], _mm256_add_ps(y0, _mm256_mul_ps(ky, t2)));
+    _mm256_storeu_ps(&poses.z[i], _mm256_add_ps(_mm256_loadu_ps(&initialZ[i]),
+                                                _mm256_loadu_ps(&offsetZ[i])));
+
+    __m256 const dx = _mm256_mul_ps(three, _mm256_mul_ps(kx, t2));
+    __m256 const dy = _mm256_mul_ps(two, _mm256_mul_ps(ky, t));
+    __m256 const r2 =
+        _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    __m256 const moving = _mm256_cmp_ps(r2, zero, _CMP_GT_OQ);
+    __m256 const invR = _mm256_div_ps(one, _mm256_sqrt_ps(r2));
+
+    _mm256_storeu_ps(&poses.cosZ[i],
+                     _mm256_blendv_ps(one, _mm256_mul_ps(dy, invR), moving));
+    _mm256_storeu_ps(&poses.sinZ[i],
+                     _mm256_blendv_ps(zero,
+                                      _mm256_mul_ps(_mm256_sub_ps(zero, dx),
+                                                    invR),
+                                      moving));
+  }
+#endif
+
+  for (; i < count; ++i) {
+    update_ship_(time, delay[i], kX[i], kY[i], initialX[i] + offsetX[i],
+                 initialY[i] + offsetY[i], poses.x[i], poses.y[i],
+                 poses.cosZ[i], poses.sinZ[i]);
+    poses.z[i] = initialZ[i] + offsetZ[i];
+  }
+}
+
+void Fleet::displace(std::size_t aShip, Vec3f aBy) {
+  offsetX[aShip] += aBy.x;
+  offsetY[aShip] += aBy.y;
+  offsetZ[aShip] += aBy.z;
+  poses.x[aShip] += aBy.x;
+  poses.y[aShip] += aBy.y;
+  poses.z[aShip] += aBy.z;
+}
+
+void Fleet::updateKeyActions(int aKey, int aAction) {
+  // Same keys as the player's ship
+  if (GLFW_KEY_F == aKey && GLFW_PRESS == aAction) {
+    launch();
+  }
+  if (GLFW_KEY_R == aKey && GLFW_PRESS == aAction) {
+    resetState();
+  }
+}
+
+void build_instance_transforms(FleetPoses const& aFrom, FleetPoses const& aTo,
+                               float aT, InstanceTransform* aOut) {
+  std::size_t const count = aFrom.size();
+  for (std::size_t i = 0; i < count; ++i) {
+    float const x = aFrom.x[i] + aT * (aTo.x[i] - aFrom.x[i]);
+    float const y = aFrom.y[i] + aT * (aTo.y[i] - aFrom.y[i]);
+    float const z = aFrom.z[i] + aT * (aTo.z[i] - aFrom.z[i]);
+    // Not renormalised: the change per tick is tiny
+    float const c = aFrom.cosZ[i] + aT * (aTo.cosZ[i] - aFrom.cosZ[i]);
+    float const s = aFrom.sinZ[i] + aT * (aTo.sinZ[i] - aFrom.sinZ[i]);
+
+    // translation * rotation_z
+    aOut[i].rows[0] = Vec4f{c, -s, 0.f, x};
+    aOut[i].rows[1] = Vec4f{s, c, 0.f, y};
+    aOut[i].rows[2] = Vec4f{0.f, 0.f, 1.f, z};
+  }
+}
+
+FleetRenderer::FleetRenderer(SceneFile const& aScene) : instanceVBO(0) {
+  // The instanced shader only decodes the packed format
+  lod = create_lod_chain(make_spaceship_meshes(aScene), nullptr,
+                         VertexFormat::packed);
+
+  glGenBuffers(1, &instanceVBO);
+
+  glBindVertexArray(lod.vao);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  for (GLuint row = 0; row < 3; ++row) {
+    GLuint const index = 7 + row;
+    glVertexAttribPointer(
+        index, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+        reinterpret_cast<void const*>(std::size_t(row) * sizeof(Vec4f)));
+    glVertexAttribDivisor(index, 1);
+    glEnableVertexAttribArray(index);
+  }
+
+  // Reset State
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void FleetRenderer::update(FleetPoses const& aFrom, FleetPoses const& aTo,
+                           float aT) {
+  instances.resize(aFrom.size());
+  build_instance_transforms(aFrom, aTo, aT, instances.data());
+
+  shipBounds.resize(instances.size());
+  for (std::size_t i = 0; i < instances.size(); ++i) {
+    Affine34f model2world;
+    std::memcpy(model2world.v, instances[i].rows, sizeof(model2world.v));
+    shipBounds[i] = transform(model2world, lod.bounds);
+  }
+
+  if (bvh.objectCount() != shipBounds.size() ||
+      bvh.costRatio() > kMaxBvhCostRatio) {
+    bvh.build(shipBounds);
+  } else {
+    for (std::size_t i = 0; i < shipBounds.size(); ++i)
+      bvh.setBounds(Bvh::ObjectId(i), shipBounds[i]);
+    bvh.refit();
+  }
+}
+
+void FleetRenderer::draw(const Mat44f& cameraProjection, const LodView& view) {
+  visible.clear();
+  bvh.queryFrustum(make_frustum(cameraProjection),
+                   [&](Bvh::ObjectId aShip) { visible.push_back(aShip); });
+  if (visible.empty()) return;
+
+  // Bucket the visible instances by level (counting sort)
+  std::array<std::size_t, kMaxLodLevels + 1> offsets{};
+  levels.resize(visible.size());
+  for (std::size_t i = 0; i < visible.size(); ++i) {
+    auto const& r = instances[visible[i]].rows;
+    Vec3f const c = lod.boundsCenter;
+    Vec3f const centre{r[0].x * c.x + r[0].y * c.y + r[0].z * c.z + r[0].w,
+                       r[1].x * c.x + r[1].y * c.y + r[1].z * c.z + r[1].w,
+                       r[2].x * c.x + r[2].y * c.y + r[2].z * c.z + r[2].w};
+    float const dist =
+        std::max(length(centre - view.cameraPosition), lod.boundsRadius);
+
+    levels[i] = std::uint8_t(
+        lod_level_for(lod, lod.boundsRadius / dist * view.pixelScale));
+    ++offsets[levels[i] + 1];
+  }
+  for (std::size_t l = 1; l < offsets.size(); ++l) offsets[l] += offsets[l - 1];
+
+  sorted.resize(visible.size());
+  auto next = offsets;
+  for (std::size_t i = 0; i < visible.size(); ++i)
+    sorted[next[levels[i]]++] = instances[visible[i]];
+
+  // Orphan the previous contents rather than waiting for the GPU to finish
+  // with them
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  glBufferData(GL_ARRAY_BUFFER, sorted.size() * sizeof(InstanceTransform),
+               nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0,
+                  sorted.size() * sizeof(InstanceTransform), sorted.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glUniformMatrix4fv(0, 1, GL_TRUE, cameraProjection.v);
+  for (std::size_t l = 0; l < lod.levelCount; ++l) {
+    auto const count = GLsizei(offsets[l + 1] - offsets[l]);
+    if (count > 0) draw_lod_instanced(lod, l, count, GLuint(offsets[l]));
+  }
+}
@@ -0,0 +1,113 @@
+#ifndef FLEET_HPP_0B9E4D27_C1A3_4F58_8D6E_37A2F95C1B40
+#define FLEET_HPP_0B9E4D27_C1A3_4F58_8D6E_37A2F95C1B40
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "bvh.hpp"
+#include "lod.hpp"
+#include "scene_file.hpp"
+
+// Ships in the scene besides the player's
+constexpr std::size_t kFleetSize = 2048;
+
+// Poses of all ships, structure of arrays. (cosZ, sinZ) is the rotation
+// about the Z axis (Spaceship's rotationZ).
+struct FleetPoses {
+  std::vector<float> x, y, z;
+  std::vector<float> cosZ, sinZ;
+
+  std::size_t size() const { return x.size(); }
+  void resize(std::size_t aCount);
+};
+
+/* Fleet: many ships flying the Spaceship launch curve
+ *
+ * State is kept as structure of arrays and update() advances all ships in
+ * one SIMD loop. Each ship has its own launch delay and curve coefficients.
+ * The rotation is kept as cos/sin, computed directly from the velocity
+ * instead of through atan2. displace() moves a ship off its curve, e.g. out
+ * of a collision; it then flies the curve shifted by that much.
+ */
+class Fleet {
+ public:
+  explicit Fleet(std::size_t aCount, std::uint32_t aSeed = 1);
+
+  std::size_t size() const { return poses.size(); }
+  FleetPoses const& getPoses() const { return poses; }
+
+  void launch() { running = !running; }
+  void resetState();
+  void update(float dt);
+  void updateKeyActions(int aKey, int aAction);
+  void displace(std::size_t aShip, Vec3f aBy);
+
+ private:
+  FleetPoses poses;
+
+  // Launch curve of each ship: p = initial + offset + (kX t^3, kY t^2, 0)
+  // for t = time - delay
+  std::vector<float> initialX, initialY, initialZ;
+  std::vector<float> offsetX, offsetY, offsetZ;
+  std::vector<float> delay;
+  std::vector<float> kX, kY;
+
+  float time;
+  bool running;
+};
+
+// Model-to-world transform of one instance: the first three rows of the
+// matrix, as uploaded to the GPU
+struct InstanceTransform {
+  Vec4f rows[3];
+};
+
+// Interpolates aFrom -> aTo (by aT in [0,1]) into aOut[0 .. aFrom.size())
+void build_instance_transforms(FleetPoses const& aFrom, FleetPoses const& aTo,
+                               float aT, InstanceTransform* aOut);
+
+/* FleetRenderer: draws all fleet ships with one instanced call per LOD level
+ *
+ * Uses its own packed copy of the spaceship mesh, with the instance
+ * transforms in attributes 7-9. Draw with colorBlinnPhongFleet.vert.
+ *
+ * update() also keeps a BVH over the ships' world boxes: refitted every
+ * frame and rebuilt once refitting has let it degrade. draw() only submits
+ * the ships it finds in the view frustum, and pick()/queryNear() use it too.
+ */
+class FleetRenderer {
+ public:
+  explicit FleetRenderer(SceneFile const& aScene);
+
+  // Once per frame
+  void update(FleetPoses const& aFrom, FleetPoses const& aTo, float aT);
+  // Once per viewport
+  void draw(const Mat44f& cameraProjection, const LodView& view);
+
+  // Closest ship whose box the ray hits, as of the last update()
+  Bvh::Hit pick(Ray const& aRay) const { return bvh.raycast(aRay); }
+  // Calls aFn(ship) for ships whose box comes within aRadius of aCenter
+  template <typename Fn>
+  void queryNear(Vec3f aCenter, float aRadius, Fn&& aFn) const {
+    bvh.querySphere(aCenter, aRadius, aFn);
+  }
+
+ private:
+  LodChain lod;
+  GLuint instanceVBO;
+
+  std::vector<InstanceTransform> instances;
+  std::vector<Aabb> shipBounds;
+  Bvh bvh;
+  std::vector<Bvh::ObjectId> visible;
+  std::vector<InstanceTransform> sorted;  // grouped by level
+  std::vector<std::uint8_t> levels;
+};
+
+#endif  // FLEET_HPP_0B9E4D27_C1A3_4F58_8D6E_37A2F95C1B40
@@ -0,0 +1,208 @@
+#include "gpu_particles.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "../support/error.hpp"
+#include "../vmlib/affine34.hpp"
+#include "../vmlib/quat.hpp"
+#include "particles.hpp"
+
+namespace {
+// One particle in the storage buffers (std430)
+struct GpuParticle {
+  float x, y, z, fade;
+  float vx, vy, vz, invLife;
+};
+static_assert(sizeof(GpuParticle) == 32);
+
+// The counters and indirect commands shared by the passes (std430)
+struct ParticleControl {
+  std::uint32_t sourceCount;  // particles in the source buffer
+  std::uint32_t targetCount;  // appended to the target buffer so far
+  std::uint32_t padding0[2];
+  // DrawArraysIndirectCommand
+  std::uint32_t drawCount, drawInstances, drawFirst, drawBaseInstance;
+  // DispatchIndirectCommand for the update pass
+  std::uint32_t groupsX, groupsY, groupsZ;
+  std::uint32_t padding1;
+};
+static_assert(sizeof(ParticleControl) == 48);
+constexpr GLintptr kDrawCommandOffset = offsetof(ParticleControl, drawCount);
+constexpr GLintptr kDispatchCommandOffset =
+    offsetof(ParticleControl, groupsX);
+
+// local_size_x of the update and emit passes
+constexpr std::uint32_t kParticleGroupSize = 256;
+
+// Buffer bindings of the compute shaders
+constexpr GLuint kSourceBinding = 0;
+constexpr GLuint kTargetBinding = 1;
+constexpr GLuint kControlBinding = 2;
+
+// Uniform locations in particlesUpdate.comp
+constexpr GLint kUpdateDtLocation = 0;
+constexpr GLint kUpdateDampingLocation = 1;
+constexpr GLint kUpdateGravityLocation = 2;
+
+// Uniform locations in particlesEmit.comp
+constexpr GLint kEmitCountLocation = 0;
+constexpr GLint kEmitSeedLocation = 1;
+constexpr GLint kEmitCapacityLocation = 2;
+constexpr GLint kEmitOriginLocation = 3;
+constexpr GLint kEmitAxisLocation = 4;
+constexpr GLint kEmitTangentLocation = 5;
+constexpr GLint kEmitBitangentLocation = 6;
+constexpr GLint kEmitShipVelocityLocation = 7;
+constexpr GLint kEmitCosSpreadLocation = 8;
+constexpr GLint kEmitSpeedLocation = 9;
+constexpr GLint kEmitLifeLocation = 10;
+constexpr GLint kEmitDtLocation = 11;
+
+// Uniform location in particlesPrepare.comp
+constexpr GLint kPrepareCapacityLocation = 0;
+
+void set_uniform_(GLint aLocation, Vec3f aValue) {
+  glUniform3f(aLocation, aValue.x, aValue.y, aValue.z);
+}
+}  // namespace
+
+GpuParticleSystem::GpuParticleSystem(std::size_t aCapacity)
+    : emitProg({{GL_COMPUTE_SHADER, "assets/cw2/particlesEmit.comp"}}),
+      updateProg({{GL_COMPUTE_SHADER, "assets/cw2/particlesUpdate.comp"}}),
+      prepareProg({{GL_COMPUTE_SHADER, "assets/cw2/particlesPrepare.comp"}}),
+      particleCapacity(aCapacity),
+      particles{0, 0},
+      vaos{0, 0},
+      source(0),
+      control(0),
+      seed(1) {
+  GLint64 maxBlock = 0;
+  glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlock);
+  if (GLint64(aCapacity * sizeof(GpuParticle)) > maxBlock) {
+    throw Error("%zu particles exceed the largest storage buffer (%lld B)",
+                aCapacity, static_cast<long long>(maxBlock));
+  }
+
+  glGenBuffers(2, particles);
+  glGenVertexArrays(2, vaos);
+  for (std::size_t i = 0; i < 2; ++i) {
+    glBindBuffer(GL_ARRAY_BUFFER, particles[i]);
+    glBufferData(GL_ARRAY_BUFFER, aCapacity * sizeof(GpuParticle), nullptr,
+                 GL_DYNAMIC_COPY);
+
+    // Attributes 0-3 of particles.vert: x, y, z and fade
+    glBindVertexArray(vaos[i]);
+    for (GLuint index = 0; index < 4; ++index) {
+      glVertexAttribPointer(index, 1, GL_FLOAT, GL_FALSE, sizeof(GpuParticle),
+                            reinterpret_cast<void const*>(
+                                std::size_t(index) * sizeof(float)));
+      glVertexAttribDivisor(index, 1);
+      glEnableVertexAttribArray(index);
+    }
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  ParticleControl initial{};
+  initial.drawCount = 4;  // one triangle strip quad per particle
+  initial.groupsY = 1;
+  initial.groupsZ = 1;
+  glGenBuffers(1, &control);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, control);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(initial), &initial,
+               GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+GpuParticleSystem::~GpuParticleSystem() {
+  glDeleteBuffers(1, &control);
+  glDeleteVertexArrays(2, vaos);
+  glDeleteBuffers(2, particles);
+}
+
+void GpuParticleSystem::update(std::span<SceneEmitter const> aEmitters,
+                               SpaceshipPose const& aPose,
+                               Vec3f aShipVelocity, float dt) {
+  std::size_t const target = 1 - source;
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kSourceBinding,
+                   particles[source]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kTargetBinding,
+                   particles[target]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kControlBinding, control);
+  glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, control);
+
+  // Survivors of the source buffer; the group count was written by the
+  // previous frame's prepare pass
+  glUseProgram(updateProg.programId());
+  glUniform1f(kUpdateDtLocation, dt);
+  glUniform1f(kUpdateDampingLocation, std::exp(-kParticleDrag * dt));
+  glUniform1f(kUpdateGravityLocation, kParticleGravity);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+  glDispatchComputeIndirect(kDispatchCommandOffset);
+
+  // New particles, appended after the survivors
+  carry.resize(aEmitters.size(), 0.f);
+  if (aPose.throttle > 0.f && dt > 0.f) {
+    RigidTransform const model2world = make_model2world(aPose);
+    glUseProgram(emitProg.programId());
+    glUniform1ui(kEmitCapacityLocation, GLuint(particleCapacity));
+    set_uniform_(kEmitShipVelocityLocation, aShipVelocity);
+    glUniform1f(kEmitDtLocation, dt);
+
+    for (std::size_t e = 0; e < aEmitters.size(); ++e) {
+      SceneEmitter const& emitter = aEmitters[e];
+      std::size_t const count =
+          particles_to_emit(emitter, aPose.throttle, dt, carry[e]);
+      if (0 == count) continue;
+
+      // Same cone as ParticleSystem::emit()
+      Vec3f const axis = rotate(aPose.orientation, emitter.direction);
+      Vec3f tangent, bitangent;
+      make_exhaust_basis(axis, tangent, bitangent);
+
+      glUniform1ui(kEmitCountLocation, GLuint(count));
+      glUniform1ui(kEmitSeedLocation, seed++);
+      set_uniform_(kEmitOriginLocation,
+                   transform_point(model2world, emitter.offset));
+      set_uniform_(kEmitAxisLocation, axis);
+      set_uniform_(kEmitTangentLocation, tangent);
+      set_uniform_(kEmitBitangentLocation, bitangent);
+      glUniform1f(kEmitCosSpreadLocation, std::cos(emitter.spread));
+      glUniform1f(kEmitSpeedLocation, emitter.speed);
+      glUniform1f(kEmitLifeLocation, emitter.life);
+
+      glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+      glDispatchCompute(
+          GLuint((count + kParticleGroupSize - 1) / kParticleGroupSize), 1,
+          1);
+    }
+  } else {
+    std::fill(carry.begin(), carry.end(), 0.f);
+  }
+
+  // Counts -> next dispatch and this frame's draw
+  glUseProgram(prepareProg.programId());
+  glUniform1ui(kPrepareCapacityLocation, GLuint(particleCapacity));
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  glDispatchCompute(1, 1, 1);
+
+  glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+  glUseProgram(0);
+  source = target;
+}
+
+void GpuParticleSystem::draw() const {
+  // The prepare pass wrote the draw command and the update and emit passes
+  // the attributes
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT |
+                  GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, control);
+  glBindVertexArray(vaos[source]);
+  glDrawArraysIndirect(GL_TRIANGLE_STRIP,
+                       reinterpret_cast<void const*>(kDrawCommandOffset));
+  glBindVertexArray(0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,72 @@
+#ifndef GPU_PARTICLES_HPP_C4E81A3D_72F5_4B09_9D6A_1F3B85E2C7A0
+#define GPU_PARTICLES_HPP_C4E81A3D_72F5_4B09_9D6A_1F3B85E2C7A0
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "../support/program.hpp"
+#include "../vmlib/vec3.hpp"
+#include "scene_file.hpp"
+#include "spaceship.hpp"
+
+/* GpuParticleSystem: the exhaust of ParticleSystem, simulated on the GPU
+ *
+ * Particles live in two shader storage buffers. Each frame the update pass
+ * (particlesUpdate.comp) moves the survivors of one buffer into the other,
+ * the emit pass (particlesEmit.comp) appends new particles after them, and
+ * a one-thread pass (particlesPrepare.comp) turns the resulting count into
+ * the arguments of the next frame's update dispatch and of the draw. The
+ * buffers then swap. The CPU only supplies emitter positions and particle
+ * counts, and never reads anything back.
+ *
+ * Survivors are compacted with atomics, so particles change order from
+ * frame to frame; exhaust is drawn additively, so order does not matter.
+ * When the buffers are full, new particles are dropped rather than
+ * replacing old ones.
+ *
+ * draw() feeds the particles to particles.vert as per-instance attributes,
+ * so it draws with the same program and state as ParticleRenderer.
+ * Construction throws Error if the compute shaders do not build; use
+ * ParticleSystem then.
+ */
+class GpuParticleSystem {
+ public:
+  explicit GpuParticleSystem(std::size_t aCapacity);  // throws Error
+  ~GpuParticleSystem();
+
+  GpuParticleSystem(GpuParticleSystem const&) = delete;
+  GpuParticleSystem& operator=(GpuParticleSystem const&) = delete;
+
+  std::size_t capacity() const { return particleCapacity; }
+
+  // Ages and moves the particles, then emits dt's worth from each emitter
+  // (see ParticleSystem::emit())
+  void update(std::span<SceneEmitter const> aEmitters,
+              SpaceshipPose const& aPose, Vec3f aShipVelocity, float dt);
+  // Call set_particle_uniforms() first
+  void draw() const;
+
+ private:
+  ShaderProgram emitProg;
+  ShaderProgram updateProg;
+  ShaderProgram prepareProg;
+
+  std::size_t particleCapacity;
+
+  // Particle buffers and a VAO reading each; [source] holds the particles
+  // drawn this frame
+  GLuint particles[2];
+  GLuint vaos[2];
+  std::size_t source;
+
+  GLuint control;  // ParticleControl
+
+  std::vector<float> carry;  // per emitter, see particles_to_emit()
+  std::uint32_t seed;
+};
+
+#endif  // GPU_PARTICLES_HPP_C4E81A3D_72F5_4B09_9D6A_1F3B85E2C7A0
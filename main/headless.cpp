@@ -0,0 +1,80 @@
+#include "headless.hpp"
+
+#include <glad/glad.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#include "camera.hpp"
+#include "fleet.hpp"
+#include "heightfield.hpp"
+#include "mesh.hpp"
+#include "scene_file.hpp"
+#include "simulation.hpp"
+#include "spaceship.hpp"
+#include "terrain.hpp"
+
+namespace {
+// FNV-1a over the snapshot's channels
+std::uint64_t hash_snapshot_(WorldSnapshot const& aSnapshot) {
+  std::array<float, kSnapshotChannels> channels;
+  write_snapshot_channels(aSnapshot, channels);
+  unsigned char bytes[sizeof(channels)];
+  std::memcpy(bytes, channels.data(), sizeof(bytes));
+
+  std::uint64_t hash = 14695981039346656037ull;
+  for (unsigned char b : bytes) {
+    hash ^= b;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+}  // namespace
+
+int run_input_replay(char const* aPath) {
+  // The same objects as with a window, less everything drawn
+  SceneFile const sceneFile = load_scene(kScenePath);
+  SceneFileHeader const& header = sceneFile.header();
+  char const* const terrainPath = sceneFile.string(header.terrainBaked);
+  if (!std::filesystem::exists(terrainPath)) {
+    bake_terrain(
+        load_wavefront_obj(sceneFile.string(header.terrainMesh), true),
+        terrainPath);
+  }
+  Heightfield const ground{TerrainFile(terrainPath)};
+
+  Camera firstPersonCamera(sceneFile.cameraPosition("firstPerson"));
+  Camera trackingCamera(sceneFile.cameraPosition("tracking"));
+  Camera groundedCamera(sceneFile.cameraPosition("grounded"));
+  Spaceship spaceship(sceneFile);
+  spaceship.setGround(&ground);
+  Fleet fleet(kFleetSize);
+
+  Simulation simulation(spaceship, fleet, ground, firstPersonCamera,
+                        trackingCamera, groundedCamera,
+                        SimulationClock::manual);
+  std::uint64_t const ticks = simulation.replayInput(aPath);
+
+  auto const start = Clock::now();
+  for (std::uint64_t i = 0; i < ticks; ++i) simulation.step();
+  double const ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - start)
+          .count();
+
+  SimulationFrame const& frame = simulation.read();
+  Vec3f const ship = frame.current.spaceship.position;
+  std::printf("Replayed %llu ticks (%.1f s simulated) in %.1f ms, %.2f us "
+              "per tick\n",
+              static_cast<unsigned long long>(ticks),
+              double(ticks) * double(kSimulationStep), ms,
+              ticks > 0 ? 1e3 * ms / double(ticks) : 0.0);
+  std::printf("Ship at (%.4f, %.4f, %.4f)\n", double(ship.x), double(ship.y),
+              double(ship.z));
+  std::printf("State hash %016llx\n",
+              static_cast<unsigned long long>(hash_snapshot_(frame.current)));
+  return 0;
+}
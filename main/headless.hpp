@@ -0,0 +1,15 @@
+#ifndef HEADLESS_HPP_8C1F4E27_9A3B_4D60_B5E2_17D8A0C93F4B
+#define HEADLESS_HPP_8C1F4E27_9A3B_4D60_B5E2_17D8A0C93F4B
+
+/* Headless input replay
+ *
+ * Run with `main --replay-input <path>` on input recorded with
+ * `main --record-input <path>`. The scene is simulated without a window,
+ * every tick a fixed step, as fast as it goes, with the recorded input
+ * applied at the ticks it was recorded at. Prints the time taken and a hash
+ * of the final state: two runs, or two builds, that simulate the same way
+ * print the same hash.
+ */
+int run_input_replay(char const* aPath);
+
+#endif  // HEADLESS_HPP_8C1F4E27_9A3B_4D60_B5E2_17D8A0C93F4B
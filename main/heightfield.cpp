@@ -0,0 +1,262 @@
+#include "heightfield.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+namespace {
+// Queries per job
+constexpr std::size_t kHeightGrain = 4096;
+constexpr std::size_t kRayGrain = 64;
+
+// Möller and Trumbore; distance to the triangle or infinity
+float intersect_triangle_(Ray const& aRay, Vec3f aA, Vec3f aB, Vec3f aC,
+                          float aMaxDistance) {
+  constexpr float kInf = std::numeric_limits<float>::infinity();
+  Vec3f const e1 = aB - aA;
+  Vec3f const e2 = aC - aA;
+  Vec3f const p = cross(aRay.direction, e2);
+  float const det = dot(e1, p);
+  if (std::abs(det) < 1e-12f) return kInf;
+  float const invDet = 1.f / det;
+  Vec3f const s = aRay.origin - aA;
+  float const u = dot(s, p) * invDet;
+  if (u < 0.f || u > 1.f) return kInf;
+  Vec3f const q = cross(s, e1);
+  float const v = dot(aRay.direction, q) * invDet;
+  if (v < 0.f || u + v > 1.f) return kInf;
+  float const t = dot(e2, q) * invDet;
+  return t >= 0.f && t < aMaxDistance ? t : kInf;
+}
+}  // namespace
+
+Heightfield::Heightfield(TerrainFile const& aFile) {
+  TerrainFileHeader const& header = aFile.header();
+  originX = header.originX;
+  originZ = header.originZ;
+  spacing = header.spacing;
+  samplesX = header.tilesX * kTerrainTileQuads + 1;
+  samplesZ = header.tilesZ * kTerrainTileQuads + 1;
+  heights.resize(std::size_t(samplesX) * samplesZ);
+
+  // Each tile's own samples, without the apron. Neighbours share their
+  // edge samples.
+  std::vector<std::uint16_t> samples(kTerrainTileSamples);
+  for (std::size_t t = 0; t < aFile.tileCount(); ++t) {
+    aFile.readTile(t, samples.data());
+    TerrainTileInfo const& info = aFile.tile(t);
+    float const scale = (info.maxHeight - info.minHeight) / 65535.f;
+    std::uint32_t const x0 = std::uint32_t(t % header.tilesX) *
+                             kTerrainTileQuads;
+    std::uint32_t const z0 = std::uint32_t(t / header.tilesX) *
+                             kTerrainTileQuads;
+    for (std::uint32_t j = 0; j <= kTerrainTileQuads; ++j) {
+      std::uint16_t const* const row =
+          samples.data() + std::size_t(j + 1) * kTerrainTileSide + 1;
+      float* const out = heights.data() + std::size_t(z0 + j) * samplesX + x0;
+      for (std::uint32_t i = 0; i <= kTerrainTileQuads; ++i)
+        out[i] = info.minHeight + scale * float(row[i]);
+    }
+  }
+
+  // Level 1 from the samples, every further level from the one below,
+  // until a single cell covers everything
+  std::uint32_t const quadsX = samplesX - 1;
+  std::uint32_t const quadsZ = samplesZ - 1;
+  std::uint32_t shift = 1;
+  do {
+    Level level;
+    level.cellsX = ((quadsX - 1) >> shift) + 1;
+    level.cellsZ = ((quadsZ - 1) >> shift) + 1;
+    level.minHeight.resize(std::size_t(level.cellsX) * level.cellsZ);
+    level.maxHeight.resize(level.minHeight.size());
+    for (std::uint32_t cz = 0; cz < level.cellsZ; ++cz) {
+      for (std::uint32_t cx = 0; cx < level.cellsX; ++cx) {
+        float lo = std::numeric_limits<float>::infinity();
+        float hi = -lo;
+        if (levels.empty()) {
+          std::uint32_t const i1 = std::min((cx + 1) << shift, quadsX);
+          std::uint32_t const j1 = std::min((cz + 1) << shift, quadsZ);
+          for (std::uint32_t j = cz << shift; j <= j1; ++j) {
+            for (std::uint32_t i = cx << shift; i <= i1; ++i) {
+              lo = std::min(lo, sample(i, j));
+              hi = std::max(hi, sample(i, j));
+            }
+          }
+        } else {
+          Level const& below = levels.back();
+          std::uint32_t const i1 = std::min(2 * cx + 2, below.cellsX);
+          std::uint32_t const j1 = std::min(2 * cz + 2, below.cellsZ);
+          for (std::uint32_t j = 2 * cz; j < j1; ++j) {
+            for (std::uint32_t i = 2 * cx; i < i1; ++i) {
+              std::size_t const c = std::size_t(j) * below.cellsX + i;
+              lo = std::min(lo, below.minHeight[c]);
+              hi = std::max(hi, below.maxHeight[c]);
+            }
+          }
+        }
+        std::size_t const c = std::size_t(cz) * level.cellsX + cx;
+        level.minHeight[c] = lo;
+        level.maxHeight[c] = hi;
+      }
+    }
+    bool const top = 1 == level.cellsX && 1 == level.cellsZ;
+    levels.push_back(std::move(level));
+    if (top) break;
+    ++shift;
+  } while (true);
+}
+
+Aabb Heightfield::bounds() const {
+  Level const& top = levels.back();
+  return Aabb{{originX, top.minHeight[0], originZ},
+              {originX + spacing * float(samplesX - 1), top.maxHeight[0],
+               originZ + spacing * float(samplesZ - 1)}};
+}
+
+float Heightfield::heightAt(float aX, float aZ) const {
+  float const x =
+      std::clamp((aX - originX) / spacing, 0.f, float(samplesX - 1));
+  float const z =
+      std::clamp((aZ - originZ) / spacing, 0.f, float(samplesZ - 1));
+  std::uint32_t const i = std::min(std::uint32_t(x), samplesX - 2);
+  std::uint32_t const j = std::min(std::uint32_t(z), samplesZ - 2);
+  float const fx = x - float(i);
+  float const fz = z - float(j);
+
+  // The triangle Terrain draws there
+  float const h00 = sample(i, j);
+  float const h10 = sample(i + 1, j);
+  float const h01 = sample(i, j + 1);
+  float const h11 = sample(i + 1, j + 1);
+  if (fx + fz <= 1.f) return h00 + fx * (h10 - h00) + fz * (h01 - h00);
+  return h11 + (1.f - fx) * (h01 - h11) + (1.f - fz) * (h10 - h11);
+}
+
+void Heightfield::heightsAt(std::span<Vec3f const> aPoints,
+                            std::span<float> aHeights, std::size_t aBegin,
+                            std::size_t aEnd) const {
+  assert(aHeights.size() >= aPoints.size());
+  for (std::size_t i = aBegin; i < aEnd; ++i)
+    aHeights[i] = heightAt(aPoints[i].x, aPoints[i].z);
+}
+
+void Heightfield::heightsAt(JobSystem& aJobs, std::span<Vec3f const> aPoints,
+                            std::span<float> aHeights) const {
+  aJobs.parallel_for(0, aPoints.size(), kHeightGrain,
+                     [&](std::size_t aBegin, std::size_t aEnd) {
+                       heightsAt(aPoints, aHeights, aBegin, aEnd);
+                     });
+}
+
+float Heightfield::intersectQuad(Ray const& aRay, std::uint32_t aI,
+                                 std::uint32_t aJ, float aMaxDistance) const {
+  float const x0 = float(aI);
+  float const z0 = float(aJ);
+  Vec3f const v00{x0, sample(aI, aJ), z0};
+  Vec3f const v10{x0 + 1.f, sample(aI + 1, aJ), z0};
+  Vec3f const v01{x0, sample(aI, aJ + 1), z0 + 1.f};
+  Vec3f const v11{x0 + 1.f, sample(aI + 1, aJ + 1), z0 + 1.f};
+  float const t = intersect_triangle_(aRay, v00, v01, v10, aMaxDistance);
+  return std::min(t, intersect_triangle_(aRay, v10, v01, v11,
+                                         std::min(t, aMaxDistance)));
+}
+
+float Heightfield::raycast(Ray const& aRay, float aMaxDistance) const {
+  constexpr float kInf = std::numeric_limits<float>::infinity();
+
+  // In grid space x and z count samples. Scaling x and z keeps the
+  // distances along the ray.
+  Ray const ray{Vec3f{(aRay.origin.x - originX) / spacing, aRay.origin.y,
+                      (aRay.origin.z - originZ) / spacing},
+                Vec3f{aRay.direction.x / spacing, aRay.direction.y,
+                      aRay.direction.z / spacing}};
+  Vec3f const invDir{1.f / ray.direction.x, 1.f / ray.direction.y,
+                     1.f / ray.direction.z};
+  std::uint32_t const quadsX = samplesX - 1;
+  std::uint32_t const quadsZ = samplesZ - 1;
+
+  struct Cell {
+    float distance;
+    std::uint32_t level, x, z;
+  };
+  auto const enter = [&](std::uint32_t aLevel, std::uint32_t aX,
+                         std::uint32_t aZ, float aMax) {
+    Level const& level = levels[aLevel - 1];
+    std::size_t const c = std::size_t(aZ) * level.cellsX + aX;
+    Aabb const box{
+        {float(aX << aLevel), level.minHeight[c], float(aZ << aLevel)},
+        {float(std::min((aX + 1) << aLevel, quadsX)), level.maxHeight[c],
+         float(std::min((aZ + 1) << aLevel, quadsZ))}};
+    return intersect(ray, invDir, box, aMax);
+  };
+
+  // Four children per level at most, plus the root
+  Cell stack[4 * 32 + 1];
+  std::size_t depth = 0;
+  float best = aMaxDistance;
+  std::uint32_t const top = std::uint32_t(levels.size());
+  if (float const t = enter(top, 0, 0, best); t < kInf)
+    stack[depth++] = Cell{t, top, 0, 0};
+
+  bool hit = false;
+  while (depth > 0) {
+    Cell const cell = stack[--depth];
+    if (cell.distance >= best) continue;
+
+    if (1 == cell.level) {
+      std::uint32_t const i1 = std::min(2 * cell.x + 2, quadsX);
+      std::uint32_t const j1 = std::min(2 * cell.z + 2, quadsZ);
+      for (std::uint32_t j = 2 * cell.z; j < j1; ++j) {
+        for (std::uint32_t i = 2 * cell.x; i < i1; ++i) {
+          float const t = intersectQuad(ray, i, j, best);
+          if (t < best) {
+            best = t;
+            hit = true;
+          }
+        }
+      }
+      continue;
+    }
+
+    // Children the ray enters, pushed furthest first so the nearest is
+    // visited next
+    std::uint32_t const childLevel = cell.level - 1;
+    Level const& below = levels[childLevel - 1];
+    Cell children[4];
+    std::size_t count = 0;
+    std::uint32_t const i1 = std::min(2 * cell.x + 2, below.cellsX);
+    std::uint32_t const j1 = std::min(2 * cell.z + 2, below.cellsZ);
+    for (std::uint32_t j = 2 * cell.z; j < j1; ++j) {
+      for (std::uint32_t i = 2 * cell.x; i < i1; ++i) {
+        if (float const t = enter(childLevel, i, j, best); t < kInf)
+          children[count++] = Cell{t, childLevel, i, j};
+      }
+    }
+    for (std::size_t c = 1; c < count; ++c) {
+      for (std::size_t d = c;
+           d > 0 && children[d - 1].distance < children[d].distance; --d)
+        std::swap(children[d - 1], children[d]);
+    }
+    for (std::size_t c = 0; c < count; ++c) stack[depth++] = children[c];
+  }
+  return hit ? best : kInf;
+}
+
+void Heightfield::raycast(std::span<Ray const> aRays,
+                          std::span<float> aDistances, float aMaxDistance,
+                          std::size_t aBegin, std::size_t aEnd) const {
+  assert(aDistances.size() >= aRays.size());
+  for (std::size_t i = aBegin; i < aEnd; ++i)
+    aDistances[i] = raycast(aRays[i], aMaxDistance);
+}
+
+void Heightfield::raycast(JobSystem& aJobs, std::span<Ray const> aRays,
+                          std::span<float> aDistances,
+                          float aMaxDistance) const {
+  aJobs.parallel_for(0, aRays.size(), kRayGrain,
+                     [&](std::size_t aBegin, std::size_t aEnd) {
+                       raycast(aRays, aDistances, aMaxDistance, aBegin, aEnd);
+                     });
+}
@@ -0,0 +1,78 @@
+#ifndef HEIGHTFIELD_HPP_8B3E61D4_2A7C_4F95_B0D8_C54E19A37F26
+#define HEIGHTFIELD_HPP_8B3E61D4_2A7C_4F95_B0D8_C54E19A37F26
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "../vmlib/aabb.hpp"
+#include "../vmlib/vec3.hpp"
+#include "bvh.hpp"
+#include "job_system.hpp"
+#include "terrain.hpp"
+
+/* Heightfield: the ground of a terrain file, for queries
+ *
+ * All tiles are decoded at load into one grid of heights, the same samples
+ * Terrain draws at full detail, so queries agree with the drawn surface:
+ * each quad is split into the triangles (00, 01, 10) and (10, 01, 11).
+ * Outside the grid heightAt() uses the nearest edge and rays miss.
+ *
+ * Rays are cast through a min/max quadtree over the quads. Level l has a
+ * cell for every 2^l x 2^l quads holding the lowest and highest height
+ * under it; the top level is a single cell. A ray visits the cells whose
+ * boxes it enters, nearest first, and stops at the first triangle hit
+ * nearer than every remaining cell.
+ *
+ * Immutable once built, so any thread may query it.
+ */
+class Heightfield {
+ public:
+  explicit Heightfield(TerrainFile const&);  // throws Error
+
+  // Samples along x and z
+  std::uint32_t sizeX() const { return samplesX; }
+  std::uint32_t sizeZ() const { return samplesZ; }
+  Aabb bounds() const;
+
+  float heightAt(float aX, float aZ) const;
+  // Height under each point's x and z
+  void heightsAt(std::span<Vec3f const> aPoints, std::span<float> aHeights,
+                 std::size_t aBegin, std::size_t aEnd) const;
+  void heightsAt(JobSystem& aJobs, std::span<Vec3f const> aPoints,
+                 std::span<float> aHeights) const;
+
+  // Distance to the first hit in direction units, or infinity on a miss
+  float raycast(Ray const&, float aMaxDistance =
+                                std::numeric_limits<float>::infinity()) const;
+  void raycast(std::span<Ray const> aRays, std::span<float> aDistances,
+               float aMaxDistance, std::size_t aBegin,
+               std::size_t aEnd) const;
+  void raycast(JobSystem& aJobs, std::span<Ray const> aRays,
+               std::span<float> aDistances,
+               float aMaxDistance =
+                   std::numeric_limits<float>::infinity()) const;
+
+ private:
+  struct Level {
+    std::uint32_t cellsX, cellsZ;
+    std::vector<float> minHeight, maxHeight;
+  };
+
+  float sample(std::uint32_t aI, std::uint32_t aJ) const {
+    return heights[std::size_t(aJ) * samplesX + aI];
+  }
+  // Nearest hit with the two triangles of quad (aI, aJ), in grid space
+  float intersectQuad(Ray const& aRay, std::uint32_t aI, std::uint32_t aJ,
+                      float aMaxDistance) const;
+
+  float originX, originZ, spacing;
+  std::uint32_t samplesX, samplesZ;
+  std::vector<float> heights;  // row by row, x fastest
+  // levels[l - 1] is level l; level 0 is the quads themselves
+  std::vector<Level> levels;
+};
+
+#endif  // HEIGHTFIELD_HPP_8B3E61D4_2A7C_4F95_B0D8_C54E19A37F26
@@ -0,0 +1,150 @@
+#include "input.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+#include "../support/error.hpp"
+
+namespace {
+constexpr char kInputMagic[4] = {'S', 'I', 'N', 'P'};
+constexpr std::uint32_t kInputVersion = 1;
+}  // namespace
+
+InputEvent make_input_event(InputKind aKind) {
+  return InputEvent{0, 0.f, 0.f, 0, 0, aKind};
+}
+
+InputEvent make_key_event(InputKind aKind, int aKey, int aAction) {
+  return InputEvent{0, 0.f, 0.f, std::int16_t(aKey), std::uint8_t(aAction),
+                    aKind};
+}
+
+// Cursor positions are whole pixels, or close, so floats lose nothing the
+// camera would see
+InputEvent make_cursor_event(double aX, double aY) {
+  return InputEvent{0, float(aX), float(aY), 0, 0, InputKind::cursor};
+}
+
+bool InputQueue::push(InputEvent const& aEvent) {
+  if (ring.push(Queued{aEvent, Clock::now()})) return true;
+  dropped.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void InputQueue::drain(std::vector<InputEvent>& aOut) {
+  auto const now = Clock::now();
+  std::uint64_t count = 0;
+  std::uint64_t total = 0;
+  std::uint64_t longest = maxNs.load(std::memory_order_relaxed);
+  Queued queued;
+  while (ring.pop(queued)) {
+    aOut.push_back(queued.event);
+    // An event pushed after now was read, but still popped here, waited
+    // about nothing rather than a negative time
+    auto const ns = std::uint64_t(std::max<std::int64_t>(
+        0, std::chrono::duration_cast<std::chrono::nanoseconds>(
+               now - queued.pushed)
+               .count()));
+    ++count;
+    total += ns;
+    longest = std::max(longest, ns);
+  }
+  if (0 == count) return;
+
+  // Only this thread writes these
+  drained.fetch_add(count, std::memory_order_relaxed);
+  totalNs.fetch_add(total, std::memory_order_relaxed);
+  maxNs.store(longest, std::memory_order_relaxed);
+}
+
+InputLatency InputQueue::latency() const {
+  InputLatency latency;
+  latency.events = drained.load(std::memory_order_relaxed);
+  latency.dropped = dropped.load(std::memory_order_relaxed);
+  if (latency.events > 0) {
+    latency.meanUs = 1e-3 * double(totalNs.load(std::memory_order_relaxed)) /
+                     double(latency.events);
+  }
+  latency.maxUs = 1e-3 * double(maxNs.load(std::memory_order_relaxed));
+  return latency;
+}
+
+InputRecorder::InputRecorder(char const* aPath, float aTickRate)
+    : file(aPath) {
+  InputRecordingHeader header{};
+  std::memcpy(header.magic, kInputMagic, sizeof(header.magic));
+  header.version = kInputVersion;
+  header.tickRate = aTickRate;
+  header.eventSize = sizeof(InputEvent);
+  file.append(&header, sizeof(header));
+}
+
+InputRecorder::~InputRecorder() {
+  try {
+    close(lastTick + 1);
+  } catch (Error const&) {
+    // Playback stops at the last whole event
+  }
+}
+
+void InputRecorder::write(InputEvent const& aEvent) {
+  file.append(&aEvent, sizeof(aEvent));
+  lastTick = aEvent.tick;
+}
+
+void InputRecorder::close(std::uint64_t aTick) {
+  if (!file.isOpen()) return;
+
+  InputEvent end = make_input_event(InputKind::end);
+  end.tick = std::max(aTick, lastTick);
+  file.append(&end, sizeof(end));
+  file.close();
+}
+
+InputPlayback::InputPlayback(char const* aPath, float aTickRate)
+    : file(aPath) {
+  std::span<std::byte const> const bytes = file.bytes();
+  if (bytes.size() < sizeof(InputRecordingHeader))
+    throw Error("'%s' is not an input recording", aPath);
+  auto const* header =
+      reinterpret_cast<InputRecordingHeader const*>(bytes.data());
+  if (0 != std::memcmp(header->magic, kInputMagic, sizeof(kInputMagic)) ||
+      kInputVersion != header->version ||
+      sizeof(InputEvent) != header->eventSize) {
+    throw Error("'%s' is not a version %u input recording", aPath,
+                kInputVersion);
+  }
+  if (aTickRate != header->tickRate) {
+    throw Error("'%s' was recorded at %g ticks per second, not %g", aPath,
+                double(header->tickRate), double(aTickRate));
+  }
+
+  // A recording cut short, e.g. by a crash, is followed by zeros; it is
+  // played up to its last event in order
+  std::size_t const count =
+      (bytes.size() - sizeof(InputRecordingHeader)) / sizeof(InputEvent);
+  events = std::span(reinterpret_cast<InputEvent const*>(
+                         bytes.data() + sizeof(InputRecordingHeader)),
+                     count);
+  for (std::size_t i = 0; i < events.size(); ++i) {
+    if (events[i].kind > kLastInputKind ||
+        (i > 0 && events[i].tick < events[i - 1].tick)) {
+      events = events.first(i);
+      break;
+    }
+  }
+  if (!events.empty() && InputKind::end == events.back().kind) {
+    ticks = events.back().tick;
+    events = events.first(events.size() - 1);
+  } else {
+    ticks = events.empty() ? 0 : events.back().tick + 1;
+  }
+}
+
+void InputPlayback::take(std::uint64_t aTick,
+                         std::vector<InputEvent>& aOut) {
+  while (next < events.size() && events[next].tick <= aTick)
+    aOut.push_back(events[next++]);
+}
@@ -0,0 +1,146 @@
+#ifndef INPUT_HPP_5D2A8F61_B3C4_47E9_8A1D_06F9C2E7B435
+#define INPUT_HPP_5D2A8F61_B3C4_47E9_8A1D_06F9C2E7B435
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "defaults.hpp"
+#include "mapped_file.hpp"
+#include "spsc_ring.hpp"
+
+/* Input events
+ *
+ * The window's callbacks do not touch the simulated objects. They decide
+ * what an input means, e.g. whether the first-person camera is looking,
+ * and push an InputEvent; the simulation takes the events at the start of
+ * a tick, stamps them with it and applies them. Given the same events at
+ * the same ticks, the simulation does the same thing, so a session's
+ * events can be recorded and replayed exactly (see InputRecorder).
+ */
+// Stored in recordings, so new kinds go at the end
+enum class InputKind : std::uint8_t {
+  cameraKey,   // key and action, for the first-person camera
+  shipKey,     // key and action, for the ship and the fleet
+  cursor,      // the cursor moved to x, y
+  mouseLook,   // the first-person camera's mouse look turned on or off
+  cameraStop,  // the first-person camera stops moving and looking
+  launch,      // launch button
+  reset,       // reset button
+  end,         // the end of a recording
+  replaySeek,  // key: skip or restart a replayed recording
+};
+
+constexpr InputKind kLastInputKind = InputKind::replaySeek;
+
+struct InputEvent {
+  std::uint64_t tick;  // applied before this tick runs
+  float x, y;
+  std::int16_t key;
+  std::uint8_t action;
+  InputKind kind;
+  // Written to recordings, so no byte is left as padding: the same input
+  // gives the same file
+  std::uint32_t reserved = 0;
+};
+
+static_assert(sizeof(InputEvent) == 24);
+
+InputEvent make_input_event(InputKind);
+InputEvent make_key_event(InputKind, int aKey, int aAction);
+InputEvent make_cursor_event(double aX, double aY);
+
+// How long events waited in an InputQueue, over all drained so far
+struct InputLatency {
+  std::uint64_t events = 0;
+  std::uint64_t dropped = 0;  // pushed while the queue was full
+  double meanUs = 0.0;
+  double maxUs = 0.0;
+};
+
+/* InputQueue: events on their way to the simulation
+ *
+ * The thread polling the window's events push()es, the simulation drains
+ * the queue once per tick. An SpscRing sits between them, so neither ever
+ * waits: an event pushed while the queue is full is dropped, and counted.
+ * Events carry the time they were pushed, so drain() measures how long
+ * they waited, at most about a tick.
+ */
+class InputQueue {
+ public:
+  static constexpr std::size_t kCapacity = 1024;
+
+  // Producer side; false if the event was dropped
+  bool push(InputEvent const&);
+  // Consumer side. Appends every event pushed so far to aOut, oldest first.
+  void drain(std::vector<InputEvent>& aOut);
+
+  // Any thread
+  InputLatency latency() const;
+
+ private:
+  struct Queued {
+    InputEvent event;
+    Clock::time_point pushed;
+  };
+  SpscRing<Queued, kCapacity> ring;
+
+  std::atomic<std::uint64_t> drained{0};
+  std::atomic<std::uint64_t> dropped{0};
+  std::atomic<std::uint64_t> totalNs{0};
+  std::atomic<std::uint64_t> maxNs{0};
+};
+
+/* Input recording file (*.inp)
+ *
+ *   InputRecordingHeader
+ *   InputEvent events[]              by tick, in the order they were applied
+ *
+ * The last event is InputKind::end, at the tick after the last one run.
+ * Written in the host's byte order.
+ */
+struct InputRecordingHeader {
+  char magic[4];
+  std::uint32_t version;
+  float tickRate;  // ticks per second
+  std::uint32_t eventSize;
+};
+
+static_assert(sizeof(InputRecordingHeader) == 16);
+
+// Writes the events a simulation applies to a new file
+class InputRecorder {
+ public:
+  InputRecorder(char const* aPath, float aTickRate);  // throws Error
+  ~InputRecorder();
+
+  void write(InputEvent const&);  // throws Error
+  // Ends the recording before aTick; throws Error
+  void close(std::uint64_t aTick);
+
+ private:
+  MappedAppendFile file;
+  std::uint64_t lastTick = 0;
+};
+
+// Hands out a recording's events tick by tick
+class InputPlayback {
+ public:
+  // The file must have been recorded at aTickRate; throws Error
+  InputPlayback(char const* aPath, float aTickRate);
+
+  // Ticks to run: the tick of the end event
+  std::uint64_t tickCount() const { return ticks; }
+  // Appends the events stamped aTick to aOut. Ticks are taken in order.
+  void take(std::uint64_t aTick, std::vector<InputEvent>& aOut);
+
+ private:
+  MappedFile file;
+  std::span<InputEvent const> events;  // without the end
+  std::size_t next = 0;
+  std::uint64_t ticks = 0;
+};
+
+#endif  // INPUT_HPP_5D2A8F61_B3C4_47E9_8A1D_06F9C2E7B435
@@ -0,0 +1,242 @@
+#include "job_system.hpp"
+
+#include <limits>
+
+namespace {
+constexpr std::size_t kNotAWorker = std::numeric_limits<std::size_t>::max();
+// Failed find() rounds before an idle worker goes to sleep
+constexpr int kIdleSpins = 64;
+
+thread_local std::size_t tWorkerIndex = kNotAWorker;
+
+struct JobRing {
+  std::unique_ptr<Job[]> jobs;
+  std::size_t next = 0;
+};
+thread_local JobRing tJobRing;
+}  // namespace
+
+bool WorkStealingDeque::push(Job* aJob) {
+  std::int64_t const b = bottom.load(std::memory_order_relaxed);
+  std::int64_t const t = top.load(std::memory_order_acquire);
+  if (b - t > kMask) return false;
+
+  buffer[std::size_t(b & kMask)].store(aJob, std::memory_order_relaxed);
+  bottom.store(b + 1, std::memory_order_release);
+  return true;
+}
+
+Job* WorkStealingDeque::pop() {
+  std::int64_t const b = bottom.load(std::memory_order_relaxed) - 1;
+  bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  std::int64_t t = top.load(std::memory_order_relaxed);
+
+  if (t > b) {  // empty
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  Job* job = buffer[std::size_t(b & kMask)].load(std::memory_order_relaxed);
+  if (t == b) {
+    // Last job: race against thieves for it
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed))
+      job = nullptr;
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+Job* WorkStealingDeque::steal() {
+  std::int64_t t = top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  std::int64_t const b = bottom.load(std::memory_order_acquire);
+  if (t >= b) return nullptr;
+
+  Job* job = buffer[std::size_t(t & kMask)].load(std::memory_order_relaxed);
+  if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                   std::memory_order_relaxed))
+    return nullptr;
+  return job;
+}
+
+JobSystem::JobSystem(std::size_t aWorkerCount) {
+  aWorkerCount = std::max<std::size_t>(aWorkerCount, 1);
+  for (std::size_t i = 0; i < aWorkerCount; ++i)
+    deques.push_back(std::make_unique<WorkStealingDeque>());
+
+  // The creating thread is worker 0
+  tWorkerIndex = 0;
+  for (std::size_t i = 1; i < aWorkerCount; ++i)
+    threads.emplace_back([this, i] { workerLoop(i); });
+}
+
+JobSystem::~JobSystem() {
+  stopping.store(true, std::memory_order_release);
+  wakeCounter.fetch_add(1, std::memory_order_release);
+  wakeCounter.notify_all();
+  for (auto& thread : threads) thread.join();
+
+  tWorkerIndex = kNotAWorker;
+}
+
+std::size_t JobSystem::default_worker_count() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void JobSystem::addDependency(Job* aJob, Job* aDependency) {
+  aJob->pending.fetch_add(1, std::memory_order_relaxed);
+
+  auto const index =
+      aDependency->continuationCount.fetch_add(1, std::memory_order_relaxed);
+  assert(index < std::int32_t(kMaxJobContinuations));
+  aDependency->continuations[std::size_t(index)] = aJob;
+}
+
+void JobSystem::run(Job* aJob) {
+  if (1 == aJob->pending.fetch_sub(1, std::memory_order_acq_rel)) push(aJob);
+}
+
+void JobSystem::wait(Job const* aJob) {
+  while (!finished(aJob)) {
+    if (Job* job = find())
+      execute(job);
+    else
+      std::this_thread::yield();
+  }
+}
+
+void JobSystem::runOnMainThread(std::function<void()> aFn) {
+  std::scoped_lock lock(mainThreadMutex);
+  mainThreadJobs.push_back(std::move(aFn));
+}
+
+std::size_t JobSystem::runMainThreadJobs() {
+  {
+    std::scoped_lock lock(mainThreadMutex);
+    std::swap(mainThreadJobs, mainThreadRunning);
+  }
+  for (auto& fn : mainThreadRunning) fn();
+
+  std::size_t const count = mainThreadRunning.size();
+  mainThreadRunning.clear();
+  return count;
+}
+
+Job* JobSystem::allocate(Job* aParent) {
+  if (!tJobRing.jobs) tJobRing.jobs = std::make_unique<Job[]>(kMaxJobsPerThread);
+
+  Job* job = &tJobRing.jobs[tJobRing.next++ % kMaxJobsPerThread];
+  // The ring wrapped onto a job that is still in flight; help it along
+  while (!finished(job)) {
+    if (Job* other = find())
+      execute(other);
+    else
+      std::this_thread::yield();
+  }
+
+  job->function = nullptr;
+  job->parent = aParent;
+  job->unfinished.store(1, std::memory_order_relaxed);
+  job->pending.store(1, std::memory_order_relaxed);
+  job->continuationCount.store(0, std::memory_order_relaxed);
+  if (aParent) aParent->unfinished.fetch_add(1, std::memory_order_relaxed);
+  return job;
+}
+
+void JobSystem::push(Job* aJob) {
+  std::size_t const index = tWorkerIndex;
+  if (index < deques.size()) {
+    // A full deque means plenty of queued work; run this one right away
+    if (!deques[index]->push(aJob)) {
+      execute(aJob);
+      return;
+    }
+  } else {
+    std::scoped_lock lock(injectedMutex);
+    injected.push_back(aJob);
+    injectedCount.fetch_add(1, std::memory_order_release);
+  }
+
+  wakeCounter.fetch_add(1, std::memory_order_release);
+  if (sleepingWorkers.load(std::memory_order_acquire) > 0)
+    wakeCounter.notify_one();
+}
+
+Job* JobSystem::find() {
+  std::size_t const index = tWorkerIndex;
+  if (index < deques.size()) {
+    if (Job* job = deques[index]->pop()) return job;
+  }
+
+  if (injectedCount.load(std::memory_order_acquire) > 0) {
+    std::scoped_lock lock(injectedMutex);
+    if (!injected.empty()) {
+      Job* job = injected.back();
+      injected.pop_back();
+      injectedCount.fetch_sub(1, std::memory_order_relaxed);
+      return job;
+    }
+  }
+
+  // Steal, starting after our own deque so that thieves spread out
+  std::size_t const count = deques.size();
+  std::size_t const start = index < count ? index + 1 : 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::size_t const victim = (start + i) % count;
+    if (victim == index) continue;
+    if (Job* job = deques[victim]->steal()) return job;
+  }
+  return nullptr;
+}
+
+void JobSystem::execute(Job* aJob) {
+  aJob->function(*aJob);
+  finish(aJob);
+}
+
+void JobSystem::finish(Job* aJob) {
+  // Read everything needed before the job can be reused
+  Job* const parent = aJob->parent;
+  auto const continuationCount = std::size_t(
+      aJob->continuationCount.load(std::memory_order_relaxed));
+  std::array<Job*, kMaxJobContinuations> const continuations =
+      aJob->continuations;
+
+  if (1 != aJob->unfinished.fetch_sub(1, std::memory_order_acq_rel)) return;
+
+  for (std::size_t i = 0; i < continuationCount; ++i) run(continuations[i]);
+  if (parent) finish(parent);
+}
+
+void JobSystem::workerLoop(std::size_t aIndex) {
+  tWorkerIndex = aIndex;
+
+  int idle = 0;
+  while (!stopping.load(std::memory_order_acquire)) {
+    if (Job* job = find()) {
+      execute(job);
+      idle = 0;
+      continue;
+    }
+    if (++idle < kIdleSpins) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // Sleep until something is pushed. The counter is read before the last
+    // look for work, so a push in between is not missed.
+    std::uint32_t const seen = wakeCounter.load(std::memory_order_acquire);
+    sleepingWorkers.fetch_add(1, std::memory_order_acq_rel);
+    if (Job* job = find()) {
+      sleepingWorkers.fetch_sub(1, std::memory_order_acq_rel);
+      execute(job);
+      idle = 0;
+      continue;
+    }
+    wakeCounter.wait(seen, std::memory_order_acquire);
+    sleepingWorkers.fetch_sub(1, std::memory_order_acq_rel);
+    idle = 0;
+  }
+}
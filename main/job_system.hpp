@@ -0,0 +1,186 @@
+#ifndef JOB_SYSTEM_HPP_8F1C4B6E_2A97_4D03_B5E8_C39D07A61F52
+#define JOB_SYSTEM_HPP_8F1C4B6E_2A97_4D03_B5E8_C39D07A61F52
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Capacity of each worker's deque and of each thread's job ring
+constexpr std::size_t kMaxJobsPerThread = 4096;
+// Inline storage for a job's callable
+constexpr std::size_t kJobDataSize = 64;
+constexpr std::size_t kMaxJobContinuations = 4;
+
+/* Job: a unit of work for the JobSystem
+ *
+ * Jobs are allocated from a per-thread ring of kMaxJobsPerThread entries, so
+ * a thread must not have more than that many jobs in flight. A job is
+ * finished once its function and all of its children have run.
+ */
+struct alignas(64) Job {
+  void (*function)(Job&);
+  Job* parent;
+  std::atomic<std::int32_t> unfinished;  // self + unfinished children
+  std::atomic<std::int32_t> pending;     // unmet dependencies + 1 until run()
+  std::atomic<std::int32_t> continuationCount;
+  std::array<Job*, kMaxJobContinuations> continuations;
+  alignas(16) std::byte data[kJobDataSize];
+};
+
+/* WorkStealingDeque: Chase-Lev deque of jobs (Lê et al. 2013 orderings)
+ *
+ * The owning worker pushes and pops at the bottom; other threads steal from
+ * the top.
+ */
+class WorkStealingDeque {
+ public:
+  bool push(Job*);  // false if full
+  Job* pop();
+  Job* steal();
+
+ private:
+  static constexpr std::int64_t kMask = std::int64_t(kMaxJobsPerThread) - 1;
+  static_assert((kMaxJobsPerThread & (kMaxJobsPerThread - 1)) == 0);
+
+  alignas(64) std::atomic<std::int64_t> top{0};
+  alignas(64) std::atomic<std::int64_t> bottom{0};
+  alignas(64) std::array<std::atomic<Job*>, kMaxJobsPerThread> buffer{};
+};
+
+/* JobSystem: work-stealing scheduler
+ *
+ * One worker thread per core besides the thread that creates the system,
+ * which counts as worker 0 and runs jobs while it wait()s. Each worker pushes
+ * new jobs onto its own deque and, when that runs dry, steals from the
+ * others. Threads that are not workers (e.g. the simulation thread) submit
+ * through a shared queue and may wait() as well.
+ *
+ * Jobs can have children (the parent finishes after them) and dependencies
+ * (a job is queued only once the jobs it depends on have finished).
+ * Functions that must run on the main thread (GL calls) are queued with
+ * runOnMainThread() and executed by runMainThreadJobs().
+ *
+ * Only one JobSystem may exist at a time.
+ */
+class JobSystem {
+ public:
+  explicit JobSystem(std::size_t aWorkerCount = default_worker_count());
+  ~JobSystem();
+
+  JobSystem(JobSystem const&) = delete;
+  JobSystem& operator=(JobSystem const&) = delete;
+
+  static std::size_t default_worker_count();
+  std::size_t workerCount() const { return deques.size(); }
+
+  // aFn must be callable as aFn() and fit in kJobDataSize bytes
+  template <typename Fn>
+  Job* create(Fn&& aFn);
+  template <typename Fn>
+  Job* createChild(Job* aParent, Fn&& aFn);
+
+  // aJob will not start before aDependency has finished. Both must not have
+  // been run() yet.
+  void addDependency(Job* aJob, Job* aDependency);
+
+  // Queues the job (once its dependencies are met)
+  void run(Job*);
+  // Runs other jobs until aJob has finished
+  void wait(Job const*);
+  static bool finished(Job const* aJob) {
+    return 0 == aJob->unfinished.load(std::memory_order_acquire);
+  }
+
+  // Calls aFn(begin, end) on subranges of [aBegin, aEnd) of about aGrain
+  // elements, in parallel, and waits for all of them
+  template <typename Fn>
+  void parallel_for(std::size_t aBegin, std::size_t aEnd, std::size_t aGrain,
+                    Fn&& aFn);
+
+  void runOnMainThread(std::function<void()> aFn);
+  // Called by the main loop; returns the number of functions run
+  std::size_t runMainThreadJobs();
+
+ private:
+  Job* allocate(Job* aParent);
+  void push(Job*);
+  Job* find();
+  void execute(Job*);
+  void finish(Job*);
+  void workerLoop(std::size_t aIndex);
+
+  std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+  std::vector<std::thread> threads;
+
+  // Jobs submitted by threads that are not workers
+  std::mutex injectedMutex;
+  std::vector<Job*> injected;
+  std::atomic<std::size_t> injectedCount{0};
+
+  std::mutex mainThreadMutex;
+  std::vector<std::function<void()>> mainThreadJobs;
+  std::vector<std::function<void()>> mainThreadRunning;
+
+  // Bumped on every push; idle workers wait for it to change
+  alignas(64) std::atomic<std::uint32_t> wakeCounter{0};
+  std::atomic<std::uint32_t> sleepingWorkers{0};
+  std::atomic<bool> stopping{false};
+};
+
+template <typename Fn>
+Job* JobSystem::create(Fn&& aFn) {
+  return createChild(nullptr, std::forward<Fn>(aFn));
+}
+
+template <typename Fn>
+Job* JobSystem::createChild(Job* aParent, Fn&& aFn) {
+  using F = std::decay_t<Fn>;
+  static_assert(sizeof(F) <= kJobDataSize, "job callable too large");
+  static_assert(alignof(F) <= 16, "job callable over-aligned");
+
+  Job* job = allocate(aParent);
+  ::new (static_cast<void*>(job->data)) F(std::forward<Fn>(aFn));
+  job->function = [](Job& aJob) {
+    F* fn = std::launder(reinterpret_cast<F*>(aJob.data));
+    (*fn)();
+    fn->~F();
+  };
+  return job;
+}
+
+template <typename Fn>
+void JobSystem::parallel_for(std::size_t aBegin, std::size_t aEnd,
+                             std::size_t aGrain, Fn&& aFn) {
+  if (aBegin >= aEnd) return;
+  aGrain = std::max<std::size_t>(aGrain, 1);
+  if (aEnd - aBegin <= aGrain) {
+    aFn(aBegin, aEnd);
+    return;
+  }
+
+  // Keep well within the job ring
+  constexpr std::size_t kMaxChunks = kMaxJobsPerThread / 4;
+  aGrain = std::max(aGrain, (aEnd - aBegin + kMaxChunks - 1) / kMaxChunks);
+
+  Job* root = create([] {});
+  auto* fn = &aFn;
+  for (std::size_t begin = aBegin; begin < aEnd; begin += aGrain) {
+    std::size_t const end = std::min(begin + aGrain, aEnd);
+    run(createChild(root, [fn, begin, end] { (*fn)(begin, end); }));
+  }
+  run(root);
+  wait(root);
+}
+
+#endif  // JOB_SYSTEM_HPP_8F1C4B6E_2A97_4D03_B5E8_C39D07A61F52
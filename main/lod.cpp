@@ -0,0 +1,212 @@
+#include "lod.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+
+#include "mesh_optimize.hpp"
+#include "simplify.hpp"
+
+namespace {
+// Each new level must drop at least this fraction of the previous triangles
+constexpr float kMinLodReduction = 0.15f;
+// Allowed ACMR increase when splitting into clusters for overdraw sorting
+constexpr float kOverdrawThreshold = 1.05f;
+
+LodStats gLodStats;
+
+LodChainData finish_lod_chain_(MeshData aVertices,
+                               std::vector<std::vector<std::uint32_t>> aLevels,
+                               std::vector<float> const& aErrors,
+                               LodChainReport* aReport) {
+  assert(!aLevels.empty() && aLevels.size() <= kMaxLodLevels);
+
+  float const acmrBefore = compute_acmr(aLevels.front());
+  for (auto& level : aLevels) {
+    level = optimize_overdraw(
+        optimize_vertex_cache(level, aVertices.positions.size()),
+        aVertices.positions, kOverdrawThreshold);
+  }
+  optimize_vertex_fetch(aVertices, aLevels);
+
+  if (aReport) {
+    aReport->acmrBefore = acmrBefore;
+    aReport->acmrAfter = compute_acmr(aLevels.front());
+    aReport->vertexCount = aVertices.positions.size();
+    aReport->floatVertexBytes = vertex_size(aVertices, VertexFormat::floats);
+  }
+
+  LodChainData data;
+  LodChain& ret = data.chain;
+  ret.levelCount = aLevels.size();
+
+  IndexedMeshData& mesh = data.mesh;
+  for (std::size_t i = 0; i < aLevels.size(); ++i) {
+    ret.indexOffset[i] = mesh.indices.size();
+    ret.indexCount[i] = GLsizei(aLevels[i].size());
+    ret.error[i] = aErrors[i];
+    mesh.indices.insert(mesh.indices.end(), aLevels[i].begin(),
+                        aLevels[i].end());
+  }
+
+  // Bounding sphere around the AABB centre
+  if (!aVertices.positions.empty()) {
+    ret.bounds = compute_bounds(aVertices.positions);
+    ret.boundsCenter = center(ret.bounds);
+    for (auto const& p : aVertices.positions)
+      ret.boundsRadius =
+          std::max(ret.boundsRadius, length(p - ret.boundsCenter));
+  }
+
+  mesh.vertices = std::move(aVertices);
+  return data;
+}
+}  // namespace
+
+LodChainData build_lod_chain(MeshData const& aMesh, LodChainReport* aReport) {
+  IndexedMeshData indexed = make_indexed(aMesh);
+
+  std::vector<std::vector<std::uint32_t>> levels;
+  std::vector<float> errors;
+  levels.push_back(std::move(indexed.indices));
+  errors.push_back(0.f);
+
+  while (levels.size() < kMaxLodLevels) {
+    auto const& prev = levels.back();
+    float error = 0.f;
+    auto next = simplify_mesh(indexed.vertices.positions, prev,
+                              prev.size() / 2, &error);
+    if (float(next.size()) > (1.f - kMinLodReduction) * float(prev.size()))
+      break;
+
+    levels.push_back(std::move(next));
+    errors.push_back(std::max(error, errors.back()));
+  }
+
+  return finish_lod_chain_(std::move(indexed.vertices), std::move(levels),
+                           errors, aReport);
+}
+
+LodChainData build_lod_chain(std::vector<MeshData> const& aLevels,
+                             LodChainReport* aReport) {
+  MeshData vertices;
+  std::vector<std::vector<std::uint32_t>> levels;
+  for (auto const& level : aLevels) {
+    IndexedMeshData indexed = make_indexed(level);
+
+    auto const base = std::uint32_t(vertices.positions.size());
+    for (auto& i : indexed.indices) i += base;
+
+    vertices = concatenate(std::move(vertices), indexed.vertices);
+    levels.push_back(std::move(indexed.indices));
+  }
+
+  // The error of hand-made levels is not known
+  std::vector<float> const errors(levels.size(), 0.f);
+  return finish_lod_chain_(std::move(vertices), std::move(levels), errors,
+                           aReport);
+}
+
+LodChain upload_lod_chain(LodChainData const& aData, VertexFormat aFormat,
+                          LodChainReport* aReport) {
+  if (aReport) aReport->vertexBytes = vertex_size(aData.mesh.vertices, aFormat);
+
+  LodChain ret = aData.chain;
+  ret.format = aFormat;
+  if (VertexFormat::packed == aFormat)
+    ret.vao = create_packed_vao(aData.mesh, ret.positionDecode);
+  else
+    ret.vao = create_vao(aData.mesh);
+  return ret;
+}
+
+LodChain create_lod_chain(MeshData const& aMesh, LodChainReport* aReport,
+                          VertexFormat aFormat) {
+  return upload_lod_chain(build_lod_chain(aMesh, aReport), aFormat, aReport);
+}
+
+LodChain create_lod_chain(std::vector<MeshData> const& aLevels,
+                          LodChainReport* aReport, VertexFormat aFormat) {
+  return upload_lod_chain(build_lod_chain(aLevels, aReport), aFormat, aReport);
+}
+
+void print_lod_report(char const* aName, LodChainReport const& aReport) {
+  std::printf("%s: ACMR %.3f -> %.3f, %zu vertices x %zu bytes (was %zu)\n",
+              aName, aReport.acmrBefore, aReport.acmrAfter,
+              aReport.vertexCount, aReport.vertexBytes,
+              aReport.floatVertexBytes);
+}
+
+float lod_pixel_scale(float aViewportHeight, float aFovInRadians) {
+  return aViewportHeight / (2.f * std::tan(aFovInRadians / 2.f));
+}
+
+std::size_t select_lod(LodChain const& aChain, LodState& aState,
+                       LodView const& aView, Mat44f const& aModel2World) {
+  assert(aView.index < kMaxLodViews);
+  std::size_t& level = aState.level[aView.index];
+  level = std::min(level, aChain.levelCount - 1);
+
+  // World space bounding sphere. Scale by the longest basis vector.
+  Vec4f const c = aModel2World * Vec4f{aChain.boundsCenter.x,
+                                       aChain.boundsCenter.y,
+                                       aChain.boundsCenter.z, 1.f};
+  float scale2 = 0.f;
+  for (std::size_t j = 0; j < 3; ++j) {
+    Vec3f const axis{aModel2World(0, j), aModel2World(1, j),
+                     aModel2World(2, j)};
+    scale2 = std::max(scale2, dot(axis, axis));
+  }
+  float const radius = aChain.boundsRadius * std::sqrt(scale2);
+  float const dist = length(Vec3f{c.x, c.y, c.z} - aView.cameraPosition);
+  if (dist <= radius) {
+    level = 0;
+    return level;
+  }
+
+  float const projected = radius / dist * aView.pixelScale;
+  while (level + 1 < aChain.levelCount &&
+         projected < kLodScreenRadius[level + 1] * (1.f - kLodHysteresis))
+    ++level;
+  while (level > 0 &&
+         projected > kLodScreenRadius[level] * (1.f + kLodHysteresis))
+    --level;
+
+  return level;
+}
+
+std::size_t lod_level_for(LodChain const& aChain, float aProjectedRadius) {
+  std::size_t level = 0;
+  while (level + 1 < aChain.levelCount &&
+         aProjectedRadius < kLodScreenRadius[level + 1])
+    ++level;
+  return level;
+}
+
+void draw_lod(LodChain const& aChain, std::size_t aLevel) {
+  draw_lod_instanced(aChain, aLevel, 1, 0);
+}
+
+void draw_lod_instanced(LodChain const& aChain, std::size_t aLevel,
+                        GLsizei aCount, GLuint aBaseInstance) {
+  assert(aLevel < aChain.levelCount);
+  gLodStats.trianglesDrawn +=
+      std::uint64_t(aChain.indexCount[aLevel] / 3) * std::uint64_t(aCount);
+  gLodStats.trianglesFull +=
+      std::uint64_t(aChain.indexCount[0] / 3) * std::uint64_t(aCount);
+
+  if (VertexFormat::packed == aChain.format) {
+    glUniform3fv(kPositionOriginLocation, 1, &aChain.positionDecode.origin.x);
+    glUniform3fv(kPositionScaleLocation, 1, &aChain.positionDecode.scale.x);
+  }
+
+  glBindVertexArray(aChain.vao);
+  glDrawElementsInstancedBaseInstance(
+      GL_TRIANGLES, aChain.indexCount[aLevel], GL_UNSIGNED_INT,
+      reinterpret_cast<void const*>(aChain.indexOffset[aLevel] *
+                                    sizeof(std::uint32_t)),
+      aCount, aBaseInstance);
+}
+
+LodStats& lod_stats() { return gLodStats; }
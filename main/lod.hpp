@@ -0,0 +1,125 @@
+#ifndef LOD_HPP_31C4FEDD_216F_42FA_B892_655E423D4352
+#define LOD_HPP_31C4FEDD_216F_42FA_B892_655E423D4352
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "../vmlib/aabb.hpp"
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/vec3.hpp"
+#include "mesh.hpp"
+
+constexpr std::size_t kMaxLodLevels = 4;
+// Separate LOD state is kept for each viewport (left/right in split screen)
+constexpr std::size_t kMaxLodViews = 2;
+
+// Projected bounding sphere radius (in pixels) below which level i is used.
+// Level 0 is always acceptable.
+constexpr std::array<float, kMaxLodLevels> kLodScreenRadius = {0.f, 160.f,
+                                                               64.f, 24.f};
+// Relative band around each threshold in which the current level is kept
+constexpr float kLodHysteresis = 0.15f;
+
+/* LodChain: one VAO holding all levels of detail of a mesh
+ *
+ * All levels share the vertex buffer; each level is a range in the index
+ * buffer. Level 0 is the full-detail mesh. Before upload, every level is
+ * optimised for the post-transform cache and overdraw, and the vertices are
+ * sorted for fetch locality (see mesh_optimize.hpp). Packed chains must be
+ * drawn with the *Packed.vert shaders.
+ */
+struct LodChain {
+  GLuint vao = 0;
+  std::size_t levelCount = 0;
+  std::array<GLsizei, kMaxLodLevels> indexCount{};
+  std::array<std::size_t, kMaxLodLevels> indexOffset{};
+  std::array<float, kMaxLodLevels> error{};  // in model units
+
+  VertexFormat format = VertexFormat::floats;
+  PositionDecode positionDecode{};  // only used by VertexFormat::packed
+
+  // Model-space bounding sphere and box
+  Vec3f boundsCenter{};
+  float boundsRadius = 0.f;
+  Aabb bounds{};
+};
+
+// Current level of one object, per viewport
+struct LodState {
+  std::array<std::size_t, kMaxLodViews> level{};
+};
+
+// Camera information needed for LOD selection
+struct LodView {
+  std::size_t index;  // viewport, < kMaxLodViews
+  Vec3f cameraPosition;
+  float pixelScale;  // pixels per world unit at distance 1
+};
+
+// Frame counters for the profiler output
+struct LodStats {
+  std::uint64_t trianglesDrawn = 0;
+  std::uint64_t trianglesFull = 0;
+};
+
+// Vertex cache efficiency of level 0 before and after optimisation, and the
+// vertex buffer size
+struct LodChainReport {
+  float acmrBefore = 0.f;
+  float acmrAfter = 0.f;
+  std::size_t vertexCount = 0;
+  std::size_t vertexBytes = 0;       // per vertex, as uploaded
+  std::size_t floatVertexBytes = 0;  // per vertex, as VertexFormat::floats
+};
+
+// Prints the report on one line, prefixed with aName
+void print_lod_report(char const* aName, LodChainReport const&);
+
+// A LodChain before upload. Building it (simplification and optimisation)
+// needs no GL context, so it can run on any thread; upload_lod_chain() must
+// run on the GL thread.
+struct LodChainData {
+  LodChain chain;  // no VAO yet
+  IndexedMeshData mesh;
+};
+
+// Simplifies the mesh into up to kMaxLodLevels levels (quadric error metric)
+LodChainData build_lod_chain(MeshData const&, LodChainReport* = nullptr);
+// Uses caller-provided levels, ordered from finest to coarsest
+LodChainData build_lod_chain(std::vector<MeshData> const&,
+                             LodChainReport* = nullptr);
+// Fills in the report's vertexBytes
+LodChain upload_lod_chain(LodChainData const&,
+                          VertexFormat = kDefaultVertexFormat,
+                          LodChainReport* = nullptr);
+
+// build_lod_chain() followed by upload_lod_chain()
+LodChain create_lod_chain(MeshData const&, LodChainReport* = nullptr,
+                          VertexFormat = kDefaultVertexFormat);
+LodChain create_lod_chain(std::vector<MeshData> const&,
+                          LodChainReport* = nullptr,
+                          VertexFormat = kDefaultVertexFormat);
+
+float lod_pixel_scale(float aViewportHeight, float aFovInRadians);
+
+// Picks the level for aModel2World as seen from aView, updating aState
+std::size_t select_lod(LodChain const&, LodState&, LodView const&,
+                       Mat44f const& aModel2World);
+
+// Level for a bounding sphere that projects to aProjectedRadius pixels.
+// Stateless (no hysteresis), for instances that keep no LodState.
+std::size_t lod_level_for(LodChain const&, float aProjectedRadius);
+
+// Draws the given level; the VAO is left bound. For packed chains this also
+// sets the position decode uniforms of the current program.
+void draw_lod(LodChain const&, std::size_t aLevel);
+// Instanced version; instances [aBaseInstance, aBaseInstance + aCount)
+void draw_lod_instanced(LodChain const&, std::size_t aLevel, GLsizei aCount,
+                        GLuint aBaseInstance);
+
+LodStats& lod_stats();
+
+#endif  // LOD_HPP_31C4FEDD_216F_42FA_B892_655E423D4352
@@ -4,12 +4,20 @@
 // Preserve include order
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <array>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <iostream>
 #include <numbers>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <typeinfo>
+#include <utility>
+#include <vector>
 
 #include "../support/checkpoint.hpp"
 #include "../support/debug_output.hpp"
@@ -18,18 +26,37 @@
 #include "../vmlib/mat33.hpp"
 #include "../vmlib/mat44.hpp"
 #include "../vmlib/vec4.hpp"
+#include "benchmark.hpp"
+#include "bvh.hpp"
 #include "button.hpp"
 #include "defaults.hpp"
+#include "fleet.hpp"
+#include "gpu_particles.hpp"
+#include "headless.hpp"
+#include "input.hpp"
+#include "job_system.hpp"
+#include "lod.hpp"
 #include "mesh.hpp"
+#include "particles.hpp"
 #include "performance.hpp"
 #include "scene.hpp"
+#include "scene_file.hpp"
+#include "scene_graph.hpp"
+#include "simulation.hpp"
 #include "state.hpp"
+#include "text.hpp"
 #include "texture.hpp"
+#include "trajectory.hpp"
+#include "ui_batch.hpp"
 
 using namespace std::chrono;
 
 namespace {
 constexpr char const *kWindowTitle = "COMP3811 - CW2";
+// Exhaust particle size at the nozzle, world units
+constexpr float kExhaustParticleSize = 0.004f;
+// Longest step the particles take, e.g. after a stall
+constexpr float kMaxParticleStep = 0.1f;
 
 void glfw_callback_error_(int, char const *);
 
@@ -37,6 +64,26 @@ void glfw_callback_key_(GLFWwindow *, int, int, int, int);
 void glfw_callback_motion_(GLFWwindow *, double, double);
 void glfw_callback_button_(GLFWwindow *, int, int, int);
 
+// From the window's callbacks to the simulation applying the events
+void print_input_latency_(InputLatency const &);
+
+// Whether the first-person camera is shown, and so takes input
+bool first_person_active_(State const &);
+
+// Reports the fleet ship or the ground under the cursor
+void pick_(GLFWwindow *, State const &);
+
+// Formats the live values shown on readout buttons
+void update_readouts_(
+    std::span<std::pair<Button *, SceneButtonReadout> const>,
+    SimulationFrame const &, WorldSnapshot const &, Heightfield const &);
+
+// What the scene file's button records refer to
+using ScreenRectFn = Vec4f (*)(float, float);
+using ButtonCallback = void (*)(State *);
+ScreenRectFn button_anchor_(SceneButtonAnchor);
+ButtonCallback button_action_(SceneButtonAction);
+
 struct GLFWCleanupHelper {
   ~GLFWCleanupHelper();
 };
@@ -47,7 +94,30 @@ struct GLFWWindowDeleter {
 
 }  // namespace
 
-int main() try {
+int main(int argc, char **argv) try {
+  // CPU benchmarks run without a window
+  if (argc >= 2 && 0 == std::strcmp(argv[1], "--bench"))
+    return run_benchmarks(argc >= 3 ? argv[2] : "");
+
+  // Recorded input is replayed without a window
+  if (argc >= 3 && 0 == std::strcmp(argv[1], "--replay-input"))
+    return run_input_replay(argv[2]);
+
+  // --record <path> records the session, --replay <path> shows a recorded
+  // one; --record-input <path> records the input for --replay-input
+  char const *recordPath = nullptr;
+  char const *replayPath = nullptr;
+  char const *recordInputPath = nullptr;
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (0 == std::strcmp(argv[i], "--record")) {
+      recordPath = argv[++i];
+    } else if (0 == std::strcmp(argv[i], "--replay")) {
+      replayPath = argv[++i];
+    } else if (0 == std::strcmp(argv[i], "--record-input")) {
+      recordInputPath = argv[++i];
+    }
+  }
+
   // Initialize GLFW
   if (GLFW_TRUE != glfwInit()) {
     char const *msg = nullptr;
@@ -135,14 +205,28 @@ int main() try {
   ShaderProgram normalsProg(
       {{GL_VERTEX_SHADER, "assets/cw2/normalsColor.vert"},
        {GL_FRAGMENT_SHADER, "assets/cw2/normalsColor.frag"}});
-  ShaderProgram textureBlinnPhong(
-      {{GL_VERTEX_SHADER, "assets/cw2/textureBlinnPhong.vert"},
+  // Packed meshes (see create_packed_vao()) need their own vertex shaders
+  bool const packed = VertexFormat::packed == kDefaultVertexFormat;
+  ShaderProgram terrainProg(
+      {{GL_VERTEX_SHADER, "assets/cw2/terrain.vert"},
        {GL_FRAGMENT_SHADER, "assets/cw2/textureBlinnPhong.frag"}});
   ShaderProgram colorBlinnPhong(
-      {{GL_VERTEX_SHADER, "assets/cw2/colorBlinnPhong.vert"},
+      {{GL_VERTEX_SHADER, packed ? "assets/cw2/colorBlinnPhongPacked.vert"
+                                 : "assets/cw2/colorBlinnPhong.vert"},
+       {GL_FRAGMENT_SHADER, "assets/cw2/colorBlinnPhong.frag"}});
+  ShaderProgram fleetProg(
+      {{GL_VERTEX_SHADER, "assets/cw2/colorBlinnPhongFleet.vert"},
        {GL_FRAGMENT_SHADER, "assets/cw2/colorBlinnPhong.frag"}});
   ShaderProgram uiProg({{GL_VERTEX_SHADER, "assets/cw2/ui.vert"},
                         {GL_FRAGMENT_SHADER, "assets/cw2/ui.frag"}});
+  ShaderProgram textProg({{GL_VERTEX_SHADER, "assets/cw2/text.vert"},
+                          {GL_FRAGMENT_SHADER, "assets/cw2/text.frag"}});
+  ShaderProgram particleProg(
+      {{GL_VERTEX_SHADER, "assets/cw2/particles.vert"},
+       {GL_FRAGMENT_SHADER, "assets/cw2/particles.frag"}});
+  ShaderProgram trajectoryProg(
+      {{GL_VERTEX_SHADER, "assets/cw2/trajectory.vert"},
+       {GL_FRAGMENT_SHADER, "assets/cw2/ui.frag"}});
 
   OGL_CHECKPOINT_ALWAYS();
 
@@ -154,29 +238,84 @@ int main() try {
   QueryTimer onePointfive("onePointfive");
 #endif
 
+  // Worker threads; this thread is worker 0
+  JobSystem jobs;
+
   // Objects
-  Camera firstPersonCamera({-5.0f, 0.2f, 4.f});
-  Camera trackingCamera({0.f, 0.f, 0.f});
-  Camera groundedCamera({-3.0f, 0.2f, 5.f});
+  SceneFile const sceneFile = load_scene(kScenePath);
+  SceneGraph sceneGraph;
+  Camera firstPersonCamera(sceneFile.cameraPosition("firstPerson"));
+  Camera trackingCamera(sceneFile.cameraPosition("tracking"));
+  Camera groundedCamera(sceneFile.cameraPosition("grounded"));
 
-  Scene scene;
+  Scene scene(jobs, sceneGraph, sceneFile);
   Lighting light;
-  Spaceship spaceship;
-
-  // UI
-  Button altitudeLabel("Altitude: ", topLeft, {0.f, 0.f, 1.f, 0.2f},
-                       {0.f, 0.f, 1.f, 0.2f}, {0.f, 0.f, 1.f, 0.2f}, 1.f,
-                       {0.f, 0.f, 0.f, 1.f}, [](State *) {});
-
-  Button launchButton("Launch", bottomCentreLeft, {0.f, 1.f, 0.f, 0.5f},
-                      {0.f, 1.f, 0.f, 1.f}, {1.f, 1.f, 1.f, 1.f}, 3.f,
-                      {0.f, 0.f, 0.f, 1.f},
-                      [](State *state) { state->spaceship->launch(); });
+  Spaceship spaceship(sceneGraph, sceneFile);
+  Fleet fleet(kFleetSize);
+  FleetRenderer fleetRenderer(sceneFile);
+
+  // Exhaust: simulated by compute shaders, or on the CPU if those do not
+  // build here
+  std::optional<GpuParticleSystem> gpuExhaust;
+  std::optional<ParticleSystem> exhaust;
+  std::optional<ParticleRenderer> exhaustRenderer;
+  try {
+    gpuExhaust.emplace(kMaxParticles);
+  } catch (Error const &eErr) {
+    std::fprintf(stderr, "GPU particles unavailable, using the CPU:\n%s\n",
+                 eErr.what());
+    exhaust.emplace(kMaxParticles);
+    exhaustRenderer.emplace(kMaxParticles);
+  }
+  auto const drawExhaust = [&](Mat44f const &aCameraProjection,
+                               CameraPose const &aCamera) {
+    // After everything opaque
+    glUseProgram(particleProg.programId());
+    set_particle_uniforms(aCameraProjection, aCamera, kExhaustParticleSize);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    glDepthMask(GL_FALSE);
+    if (gpuExhaust) {
+      gpuExhaust->draw();
+    } else {
+      exhaustRenderer->draw();
+    }
+    glDepthMask(GL_TRUE);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_BLEND);
+  };
 
-  Button resetButton("Reset", bottomCentreRight, {1.f, 0.f, 0.f, 0.5f},
-                     {1.f, 0.f, 0.f, 1.f}, {1.f, 1.f, 1.f, 1.f}, 3.f,
-                     {0.f, 0.f, 0.f, 1.f},
-                     [](State *state) { state->spaceship->resetState(); });
+  // Predicted flight path, drawn after the opaque objects
+  TrajectoryRenderer trajectoryRenderer;
+  auto const drawTrajectories = [&](Mat44f const &aCameraProjection) {
+    glUseProgram(trajectoryProg.programId());
+    glEnable(GL_BLEND);
+    glDepthMask(GL_FALSE);
+    trajectoryRenderer.draw(aCameraProjection);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+  };
+
+  // UI. Buttons point into themselves, so they are kept where they are
+  // created.
+  UiBatch uiBatch;
+  // Without the font the buttons are drawn without their captions
+  std::optional<TextRenderer> textRenderer;
+  try {
+    textRenderer.emplace(kFontPath);
+  } catch (Error const &eErr) {
+    std::fprintf(stderr, "HUD text unavailable:\n%s\n", eErr.what());
+  }
+  std::deque<Button> buttons;
+  std::vector<std::pair<Button *, SceneButtonReadout>> readouts;
+  for (SceneButton const &b : sceneFile.buttons()) {
+    buttons.emplace_back(sceneFile.string(b.text), button_anchor_(b.anchor),
+                         b.idleColor, b.activeColor, b.pressedColor,
+                         b.borderWidth, b.borderColor, b.labelColor,
+                         button_action_(b.action));
+    if (SceneButtonReadout::none != b.readout)
+      readouts.emplace_back(&buttons.back(), b.readout);
+  }
 
   // State
   state.firstPersonCamera = &firstPersonCamera;
@@ -185,27 +324,52 @@ int main() try {
   state.leftScreenCamera = state.firstPersonCamera;
   state.rightScreenCamera = state.firstPersonCamera;
   state.splitScreen = false;
+  state.mouseLook = false;
+  state.leftCameraPose = firstPersonCamera.getPose();
+  state.rightCameraPose = firstPersonCamera.getPose();
 
   state.spaceship = &spaceship;
+  state.fleet = &fleet;
+  state.ground = &scene.getGround();
+  spaceship.setGround(&scene.getGround());
+
+  // Ground around the starting viewpoint, so the first frame has it
+  {
+    Vec3f const start = firstPersonCamera.getCamWorldPosition();
+    while (scene.updateGround(std::span(&start, 1)) > 0)
+      scene.finishGroundLoads();
+  }
 
-  state.buttons.push_back(&altitudeLabel);
-  state.buttons.push_back(&launchButton);
-  state.buttons.push_back(&resetButton);
+  // Ticks on its own thread from here on
+  Simulation simulation(spaceship, fleet, scene.getGround(), firstPersonCamera,
+                        trackingCamera, groundedCamera);
+  state.simulation = &simulation;
+  {
+    auto const lock = simulation.lock();
+    if (recordPath) simulation.record(recordPath);
+    if (replayPath) simulation.replay(replayPath);
+    if (recordInputPath) simulation.recordInput(recordInputPath);
+  }
+  state.fleetRenderer = &fleetRenderer;
 
-  OGL_CHECKPOINT_ALWAYS();
+  for (Button &b : buttons) state.buttons.push_back(&b);
 
-  // Clock
-  auto lastClock = Clock::now();
+  OGL_CHECKPOINT_ALWAYS();
 
 #if defined(BENCHMARKING)
   auto lastChrono = high_resolution_clock::now();
 #endif
 
+  auto lastFrame = Clock::now();
+
   // Main loop
   while (!glfwWindowShouldClose(window)) {
     // Let GLFW process events
     glfwPollEvents();
 
+    // GL work handed back by jobs
+    jobs.runMainThreadJobs();
+
     // Check if window was resized.
     float fbwidth, fbheight;
     {
@@ -225,9 +389,46 @@ int main() try {
       }
     }
     // #### Update State ####//
-    auto const now = Clock::now();
-    float dt = std::chrono::duration_cast<Secondsf>(now - lastClock).count();
-    lastClock = now;
+    SimulationFrame const &frame = simulation.read();
+    float const blend = interpolation_factor(frame);
+    WorldSnapshot const world =
+        interpolate(frame.previous, frame.current, blend);
+    fleetRenderer.update(frame.fleetPrevious, frame.fleetCurrent, blend);
+    spaceship.updateNodes(sceneGraph, world.spaceship);
+    sceneGraph.update();
+    trajectoryRenderer.update(frame.paths, kPredictionSteps + 1);
+
+    // Exhaust moves with the frames rather than the simulation ticks
+    {
+      auto const now = Clock::now();
+      float const dt = std::min(Secondsf(now - lastFrame).count(),
+                                kMaxParticleStep);
+      lastFrame = now;
+      Vec3f const shipVelocity = (frame.current.spaceship.position -
+                                  frame.previous.spaceship.position) *
+                                 kSimulationRate;
+      if (gpuExhaust) {
+        gpuExhaust->update(spaceship.getEmitters(), world.spaceship,
+                           shipVelocity, dt);
+      } else {
+        exhaust->update(jobs, dt);
+        exhaust->emit(spaceship.getEmitters(), world.spaceship, shipVelocity,
+                      dt);
+        exhaustRenderer->update(*exhaust);
+      }
+    }
+    auto poseOf = [&](Camera const *aCamera) -> CameraPose const & {
+      if (aCamera == state.trackingCamera) return world.trackingCamera;
+      if (aCamera == state.groundedCamera) return world.groundedCamera;
+      return world.firstPersonCamera;
+    };
+    CameraPose const &leftCamera = poseOf(state.leftScreenCamera);
+    CameraPose const &rightCamera = poseOf(state.rightScreenCamera);
+    state.leftCameraPose = leftCamera;
+    state.rightCameraPose = rightCamera;
+    std::array<Vec3f, 2> const viewpoints{leftCamera.pos, rightCamera.pos};
+    scene.updateGround(
+        std::span(viewpoints).first(state.splitScreen ? 2 : 1));
 
     // Benchmarking
 #if defined(BENCHMARKING)
@@ -237,16 +438,11 @@ int main() try {
     std::cout << "Frame time: " << frameTime.count() << " seconds" << std::endl;
 #endif
 
-    // Update state
-    spaceship.animate(dt);
-    firstPersonCamera.updateState(dt);
-    trackingCamera.track(spaceship.getPosition());
-    groundedCamera.pointAt(spaceship.getPosition());
-
     // Update UI
     for (Button *b : state.buttons) {
       b->updateSize(fbwidth, fbheight);
     }
+    update_readouts_(readouts, frame, world, scene.getGround());
 
     // Draw
     OGL_CHECKPOINT_DEBUG();
@@ -268,20 +464,24 @@ int main() try {
       glViewport(0, 0, GLsizei(fbwidth), GLsizei(fbheight));
     }
 
+    lod_stats() = LodStats{};
+    float const lodPixelScale = lod_pixel_scale(fbheight, kFieldOfView);
+
     // Draw Left Screen
-    light.updateLighting(state.leftScreenCamera->getCamWorldPosition(),
-                         spaceship.getLightPos(), spaceship.getLightAmbient(),
+    LodView const leftLodView{0, leftCamera.pos, lodPixelScale};
+    light.updateLighting(leftCamera.pos, spaceship.getLightPos(world.spaceship),
+                         spaceship.getLightAmbient(),
                          spaceship.getLightDiffuse());
-    Mat44f leftCamProjection = state.leftScreenCamera->getProjection(aspect);
+    Mat44f leftCamProjection = camera_projection(leftCamera, aspect);
 
     // Draw Ground
-    glUseProgram(textureBlinnPhong.programId());
+    glUseProgram(terrainProg.programId());
     light.setLighting();
 
 #if defined(BENCHMARKING)
     onePointtwo.startQuery();  ///--------------------------start query
 #endif
-    scene.drawGround(leftCamProjection);
+    scene.drawGround(leftCamProjection, leftLodView);
 #if defined(BENCHMARKING)
     onePointtwo.stopQuery();  ///------------------------------stop query
 #endif
@@ -292,7 +492,7 @@ int main() try {
 #if defined(BENCHMARKING)
     onePointfour.startQuery();  ///-----------------------start query
 #endif
-    scene.drawLaunchpads(leftCamProjection);
+    scene.drawInstances(leftCamProjection, leftLodView, sceneGraph);
 #if defined(BENCHMARKING)
     onePointfour.stopQuery();  ///----------------------stop query
 #endif
@@ -300,43 +500,70 @@ int main() try {
 #if defined(BENCHMARKING)
     onePointfive.startQuery();  ///------------------------start query
 #endif
-    spaceship.draw(leftCamProjection);
+    spaceship.draw(leftCamProjection, leftLodView, sceneGraph);
 #if defined(BENCHMARKING)
     onePointfive.stopQuery();  ///----------------------stop query
 #endif
 
+    glUseProgram(fleetProg.programId());
+    light.setLighting();
+    fleetRenderer.draw(leftCamProjection, leftLodView);
+
+    drawTrajectories(leftCamProjection);
+    drawExhaust(leftCamProjection, leftCamera);
+
     // Conditionally Draw Right Screen
     if (state.splitScreen) {
       glViewport(GLsizei(fbwidth / 2), 0, GLsizei(fbwidth / 2),
                  GLsizei(fbheight));
 
-      light.updateLighting(state.rightScreenCamera->getCamWorldPosition(),
-                           spaceship.getLightPos(), spaceship.getLightAmbient(),
-                           spaceship.getLightDiffuse());
-      Mat44f rightCamProjection =
-          state.rightScreenCamera->getProjection(aspect);
+      LodView const rightLodView{1, rightCamera.pos, lodPixelScale};
+      light.updateLighting(
+          rightCamera.pos, spaceship.getLightPos(world.spaceship),
+          spaceship.getLightAmbient(), spaceship.getLightDiffuse());
+      Mat44f rightCamProjection = camera_projection(rightCamera, aspect);
 
       // Draw Ground
-      glUseProgram(textureBlinnPhong.programId());
+      glUseProgram(terrainProg.programId());
       light.setLighting();
-      scene.drawGround(rightCamProjection);
+      scene.drawGround(rightCamProjection, rightLodView);
 
       // Draw Launchpads and Spaceship
       glUseProgram(colorBlinnPhong.programId());
       light.setLighting();
-      scene.drawLaunchpads(rightCamProjection);
-      spaceship.draw(rightCamProjection);
+      scene.drawInstances(rightCamProjection, rightLodView, sceneGraph);
+      spaceship.draw(rightCamProjection, rightLodView, sceneGraph);
+
+      glUseProgram(fleetProg.programId());
+      light.setLighting();
+      fleetRenderer.draw(rightCamProjection, rightLodView);
+      drawTrajectories(rightCamProjection);
+      drawExhaust(rightCamProjection, rightCamera);
     }
 
     // UI Drawing
     glViewport(0, 0, GLsizei(fbwidth), GLsizei(fbheight));
+    uiBatch.begin(fbwidth, fbheight);
+    for (Button *b : state.buttons) {
+      b->draw(uiBatch);
+    }
+
     glUseProgram(uiProg.programId());
     // GL Setup
     glDisable(GL_DEPTH_TEST);
     glEnable(GL_BLEND);
 
-    for (Button *b : state.buttons) {
-      b->draw();
+    uiBatch.draw();
+    if (textRenderer) {
+      try {
+        textRenderer->begin(fbwidth, fbheight);
+        for (Button *b : state.buttons) b->drawLabel(*textRenderer);
+        glUseProgram(textProg.programId());
+        textRenderer->draw();
+      } catch (Error const &eErr) {
+        std::fprintf(stderr, "HUD text stopped:\n%s\n", eErr.what());
+        textRenderer.reset();
+      }
     }
 
     glEnable(GL_DEPTH_TEST);
@@ -363,12 +590,18 @@ int main() try {
     onePointtwo.printResult();
     onePointfour.printResult();
     onePointfive.printResult();
+    std::cout << "LOD triangles: " << lod_stats().trianglesDrawn << " drawn, "
+              << lod_stats().trianglesFull - lod_stats().trianglesDrawn
+              << " saved" << std::endl;
+    std::cout << "Simulation ticks: " << simulation.tickCount() << std::endl;
+    print_input_latency_(simulation.getInput().latency());
     std::cout << std::endl;
 #endif
 
     // Display results
     glfwSwapBuffers(window);
   }
+  print_input_latency_(simulation.getInput().latency());
   state.prog = nullptr;
   return 0;
 } catch (std::exception const &eErr) {
@@ -391,6 +624,16 @@ void glfw_callback_key_(GLFWwindow *aWindow, int aKey, int, int aAction,
   }
 
   if (auto *state = static_cast<State *>(glfwGetWindowUserPointer(aWindow))) {
+    InputQueue &input = state->simulation->getInput();
+
+    // Seek through a replay: arrows skip, Home restarts
+    if (state->simulation->isReplaying() &&
+        (GLFW_KEY_LEFT == aKey || GLFW_KEY_RIGHT == aKey ||
+         GLFW_KEY_HOME == aKey) &&
+        (GLFW_PRESS == aAction || GLFW_REPEAT == aAction)) {
+      input.push(make_key_event(InputKind::replaySeek, aKey, aAction));
+    }
+
     // Split Screen Toggle
     if (GLFW_KEY_V == aKey && GLFW_PRESS == aAction) {
       state->splitScreen = !state->splitScreen;
@@ -416,27 +659,24 @@ void glfw_callback_key_(GLFWwindow *aWindow, int aKey, int, int aAction,
         }
       }
       // Reset First Person Camera State
-      if (state->leftScreenCamera != state->firstPersonCamera &&
-          (state->rightScreenCamera != state->firstPersonCamera ||
-           !state->splitScreen)) {
-        state->firstPersonCamera->resetState(aWindow);
+      if (!first_person_active_(*state)) {
+        input.push(make_input_event(InputKind::cameraStop));
+        state->mouseLook = false;
+        glfwSetInputMode(aWindow, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
       }
     }
 
     // Update first person camera if active
-    if (state->leftScreenCamera == state->firstPersonCamera ||
-        (state->rightScreenCamera == state->firstPersonCamera &&
-         state->splitScreen)) {
-      state->firstPersonCamera->updateKeyActions(aKey, aAction);
-    }
+    if (first_person_active_(*state))
+      input.push(make_key_event(InputKind::cameraKey, aKey, aAction));
     // Update spaceship animation
-    state->spaceship->updateKeyActions(aKey, aAction);
+    input.push(make_key_event(InputKind::shipKey, aKey, aAction));
   }
 }
 
 void glfw_callback_motion_(GLFWwindow *aWindow, double aX, double aY) {
   if (auto *state = static_cast<State *>(glfwGetWindowUserPointer(aWindow))) {
-    state->firstPersonCamera->updateMouseMovement(aX, aY);
+    state->simulation->getInput().push(make_cursor_event(aX, aY));
 
     // UI
     for (Button *b : state->buttons) {
@@ -447,16 +687,131 @@ void glfw_callback_motion_(GLFWwindow *aWindow, double aX, double aY) {
 
 void glfw_callback_button_(GLFWwindow *aWindow, int aButton, int aAction, int) {
   if (auto *state = static_cast<State *>(glfwGetWindowUserPointer(aWindow))) {
-    if (state->leftScreenCamera == state->firstPersonCamera ||
-        (state->rightScreenCamera == state->firstPersonCamera &&
-         state->splitScreen)) {
-      state->firstPersonCamera->updateMouseClicked(aWindow, aButton, aAction);
+    // The right button turns mouse look on and off
+    if (first_person_active_(*state) && GLFW_MOUSE_BUTTON_RIGHT == aButton &&
+        GLFW_PRESS == aAction) {
+      state->mouseLook = !state->mouseLook;
+      InputEvent look = make_input_event(InputKind::mouseLook);
+      look.action = state->mouseLook ? 1 : 0;
+      state->simulation->getInput().push(look);
+      glfwSetInputMode(aWindow, GLFW_CURSOR,
+                       state->mouseLook ? GLFW_CURSOR_HIDDEN
+                                        : GLFW_CURSOR_NORMAL);
     }
     // UI
+    bool onButton = false;
     for (Button *b : state->buttons) {
+      onButton = onButton || b->isHovered();
       b->updateMousePress(aButton, aAction, state);
     }
+
+    if (aButton == GLFW_MOUSE_BUTTON_LEFT && aAction == GLFW_PRESS &&
+        !onButton) {
+      pick_(aWindow, *state);
+    }
+  }
+}
+
+void print_input_latency_(InputLatency const &aLatency) {
+  std::printf("Input latency: %llu events, mean %.1f us, max %.1f us, "
+              "%llu dropped\n",
+              static_cast<unsigned long long>(aLatency.events),
+              aLatency.meanUs, aLatency.maxUs,
+              static_cast<unsigned long long>(aLatency.dropped));
+}
+
+bool first_person_active_(State const &aState) {
+  return aState.leftScreenCamera == aState.firstPersonCamera ||
+         (aState.rightScreenCamera == aState.firstPersonCamera &&
+          aState.splitScreen);
+}
+
+void pick_(GLFWwindow *aWindow, State const &aState) {
+  int width, height;
+  glfwGetFramebufferSize(aWindow, &width, &height);
+  double x, y;
+  glfwGetCursorPos(aWindow, &x, &y);
+  if (0 == width || 0 == height || !aState.fleetRenderer || !aState.ground)
+    return;
+
+  // Cursor -> NDC of the viewport it is over, seen as it was drawn
+  CameraPose const *camera = &aState.leftCameraPose;
+  float viewportX = float(x);
+  float viewportWidth = float(width);
+  if (aState.splitScreen) {
+    viewportWidth *= 0.5f;
+    if (viewportX >= viewportWidth) {
+      camera = &aState.rightCameraPose;
+      viewportX -= viewportWidth;
+    }
+  }
+  float const ndcX = 2.f * viewportX / viewportWidth - 1.f;
+  float const ndcY = 1.f - 2.f * float(y) / float(height);
+
+  Ray const ray = make_pick_ray(
+      camera_projection(*camera, viewportWidth / float(height)), ndcX, ndcY);
+  Bvh::Hit const hit = aState.fleetRenderer->pick(ray);
+  // Ships behind a hill are hidden
+  float const ground = aState.ground->raycast(ray, hit.distance);
+  if (ground < hit.distance) {
+    Vec3f const p = ray.origin + ground * ray.direction;
+    std::cout << "Picked the ground at (" << p.x << ", " << p.y << ", "
+              << p.z << "), distance " << ground << std::endl;
+  } else if (hit.object != Bvh::Hit{}.object) {
+    std::cout << "Picked fleet ship " << hit.object << " at distance "
+              << hit.distance << std::endl;
+  }
+}
+
+void update_readouts_(
+    std::span<std::pair<Button *, SceneButtonReadout> const> aReadouts,
+    SimulationFrame const &aFrame, WorldSnapshot const &aWorld,
+    Heightfield const &aGround) {
+  // Height above the ground below, speed over the last tick
+  Vec3f const position = aWorld.spaceship.position;
+  float const altitude = position.y - aGround.heightAt(position.x, position.z);
+  float const speed = length(aFrame.current.spaceship.position -
+                             aFrame.previous.spaceship.position) *
+                      kSimulationRate;
+
+  char value[32];
+  for (auto const &[button, readout] : aReadouts) {
+    float const v = SceneButtonReadout::altitude == readout ? altitude : speed;
+    std::snprintf(value, sizeof(value), "%.2f", double(v));
+    button->setValue(value);
+  }
+}
+
+ScreenRectFn button_anchor_(SceneButtonAnchor aAnchor) {
+  switch (aAnchor) {
+    case SceneButtonAnchor::topLeft:
+      return topLeft;
+    case SceneButtonAnchor::topLeftBelow:
+      return topLeftBelow;
+    case SceneButtonAnchor::bottomCentreLeft:
+      return bottomCentreLeft;
+    case SceneButtonAnchor::bottomCentreRight:
+      break;
+  }
+  return bottomCentreRight;
+}
+
+ButtonCallback button_action_(SceneButtonAction aAction) {
+  switch (aAction) {
+    case SceneButtonAction::launch:
+      return [](State *state) {
+        state->simulation->getInput().push(
+            make_input_event(InputKind::launch));
+      };
+    case SceneButtonAction::reset:
+      return [](State *state) {
+        state->simulation->getInput().push(
+            make_input_event(InputKind::reset));
+      };
+    case SceneButtonAction::none:
+      break;
   }
+  return [](State *) {};
 }
 }  // namespace
 namespace {
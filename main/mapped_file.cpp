@@ -0,0 +1,248 @@
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../support/error.hpp"
+
+MappedFile::MappedFile(char const* aPath) {
+#if defined(_WIN32)
+  HANDLE const file =
+      CreateFileA(aPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                  FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (INVALID_HANDLE_VALUE == file)
+    throw Error("Unable to open '%s' (error %lu)", aPath, GetLastError());
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize)) {
+    CloseHandle(file);
+    throw Error("Unable to size '%s' (error %lu)", aPath, GetLastError());
+  }
+  size = std::size_t(fileSize.QuadPart);
+  if (0 == size) {
+    CloseHandle(file);
+    return;
+  }
+
+  HANDLE const mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!mapping)
+    throw Error("Unable to map '%s' (error %lu)", aPath, GetLastError());
+  data = static_cast<std::byte const*>(
+      MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  CloseHandle(mapping);
+  if (!data)
+    throw Error("Unable to map '%s' (error %lu)", aPath, GetLastError());
+#else
+  int const fd = open(aPath, O_RDONLY);
+  if (fd < 0) throw Error("Unable to open '%s'", aPath);
+
+  struct stat info;
+  if (0 != fstat(fd, &info)) {
+    close(fd);
+    throw Error("Unable to size '%s'", aPath);
+  }
+  size = std::size_t(info.st_size);
+  if (0 == size) {
+    close(fd);
+    return;
+  }
+
+  void* const mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // the mapping keeps the file open
+  if (MAP_FAILED == mapped) throw Error("Unable to map '%s'", aPath);
+  data = static_cast<std::byte const*>(mapped);
+#endif
+}
+
+MappedFile::~MappedFile() {
+  if (!data) return;
+#if defined(_WIN32)
+  UnmapViewOfFile(data);
+#else
+  munmap(const_cast<std::byte*>(data), size);
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& aOther) noexcept
+    : data(std::exchange(aOther.data, nullptr)),
+      size(std::exchange(aOther.size, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& aOther) noexcept {
+  std::swap(data, aOther.data);
+  std::swap(size, aOther.size);
+  return *this;
+}
+
+namespace {
+// Windows start at multiples of this, which suits both mmap() and
+// MapViewOfFile()
+constexpr std::uint64_t kWindowAlignment = 64 * 1024;
+constexpr std::size_t kWindowSize =
+    MappedAppendFile::kMaxAppend + kWindowAlignment;
+}  // namespace
+
+MappedAppendFile::MappedAppendFile(char const* aPath) {
+#if defined(_WIN32)
+  HANDLE const handle =
+      CreateFileA(aPath, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                  CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (INVALID_HANDLE_VALUE == handle)
+    throw Error("Unable to create '%s' (error %lu)", aPath, GetLastError());
+  file = handle;
+#else
+  fd = open(aPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) throw Error("Unable to create '%s'", aPath);
+#endif
+
+  try {
+    map(0);
+  } catch (...) {
+#if defined(_WIN32)
+    CloseHandle(file);
+    file = nullptr;
+#else
+    ::close(fd);
+    fd = -1;
+#endif
+    throw;
+  }
+}
+
+MappedAppendFile::~MappedAppendFile() {
+  try {
+    close();
+  } catch (Error const&) {
+    // The file keeps the unwritten rest of its last window
+  }
+}
+
+MappedAppendFile::MappedAppendFile(MappedAppendFile&& aOther) noexcept
+#if defined(_WIN32)
+    : file(std::exchange(aOther.file, nullptr)),
+      mapping(std::exchange(aOther.mapping, nullptr)),
+#else
+    : fd(std::exchange(aOther.fd, -1)),
+#endif
+      window(std::exchange(aOther.window, nullptr)),
+      windowOffset(std::exchange(aOther.windowOffset, 0)),
+      written(std::exchange(aOther.written, 0)) {}
+
+MappedAppendFile& MappedAppendFile::operator=(
+    MappedAppendFile&& aOther) noexcept {
+#if defined(_WIN32)
+  std::swap(file, aOther.file);
+  std::swap(mapping, aOther.mapping);
+#else
+  std::swap(fd, aOther.fd);
+#endif
+  std::swap(window, aOther.window);
+  std::swap(windowOffset, aOther.windowOffset);
+  std::swap(written, aOther.written);
+  return *this;
+}
+
+bool MappedAppendFile::isOpen() const {
+#if defined(_WIN32)
+  return nullptr != file;
+#else
+  return fd >= 0;
+#endif
+}
+
+std::byte* MappedAppendFile::reserve(std::size_t aBytes) {
+  assert(isOpen() && aBytes <= kMaxAppend);
+  if (written + aBytes > windowOffset + kWindowSize) {
+    // The new window starts at most kWindowAlignment - 1 before the end
+    unmap();
+    map(written & ~(kWindowAlignment - 1));
+  }
+  return window + (written - windowOffset);
+}
+
+void MappedAppendFile::append(void const* aData, std::size_t aBytes) {
+  auto const* bytes = static_cast<std::byte const*>(aData);
+  while (aBytes > 0) {
+    std::size_t const chunk = std::min(aBytes, kMaxAppend);
+    std::memcpy(reserve(chunk), bytes, chunk);
+    commit(chunk);
+    bytes += chunk;
+    aBytes -= chunk;
+  }
+}
+
+void MappedAppendFile::close() {
+  if (!isOpen()) return;
+  unmap();
+
+#if defined(_WIN32)
+  LARGE_INTEGER size;
+  size.QuadPart = LONGLONG(written);
+  bool const cut = SetFilePointerEx(file, size, nullptr, FILE_BEGIN) &&
+                   SetEndOfFile(file);
+  DWORD const error = GetLastError();
+  CloseHandle(file);
+  file = nullptr;
+  if (!cut) throw Error("Unable to truncate a mapped file (error %lu)", error);
+#else
+  bool const cut = 0 == ftruncate(fd, off_t(written));
+  ::close(fd);
+  fd = -1;
+  if (!cut) throw Error("Unable to truncate a mapped file");
+#endif
+}
+
+void MappedAppendFile::map(std::uint64_t aOffset) {
+  std::uint64_t const end = aOffset + kWindowSize;
+#if defined(_WIN32)
+  // Mapping past the end grows the file
+  mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                               DWORD(end >> 32), DWORD(end), nullptr);
+  if (!mapping)
+    throw Error("Unable to grow a mapped file (error %lu)", GetLastError());
+  window = static_cast<std::byte*>(
+      MapViewOfFile(mapping, FILE_MAP_WRITE, DWORD(aOffset >> 32),
+                    DWORD(aOffset), kWindowSize));
+  if (!window) {
+    DWORD const error = GetLastError();
+    CloseHandle(mapping);
+    mapping = nullptr;
+    throw Error("Unable to map a file window (error %lu)", error);
+  }
+#else
+  if (0 != ftruncate(fd, off_t(end)))
+    throw Error("Unable to grow a mapped file to %llu bytes",
+                static_cast<unsigned long long>(end));
+  void* const mapped = mmap(nullptr, kWindowSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fd, off_t(aOffset));
+  if (MAP_FAILED == mapped) throw Error("Unable to map a file window");
+  window = static_cast<std::byte*>(mapped);
+#endif
+  windowOffset = aOffset;
+}
+
+void MappedAppendFile::unmap() {
+  if (!window) return;
+#if defined(_WIN32)
+  UnmapViewOfFile(window);
+  CloseHandle(mapping);
+  mapping = nullptr;
+#else
+  munmap(window, kWindowSize);
+#endif
+  window = nullptr;
+}
@@ -0,0 +1,76 @@
+#ifndef MAPPED_FILE_HPP_7B3E91C4_58D2_4A6F_9E07_C2D5A8B14F63
+#define MAPPED_FILE_HPP_7B3E91C4_58D2_4A6F_9E07_C2D5A8B14F63
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/* MappedFile: a whole file mapped read-only into memory
+ *
+ * The mapping is page aligned and stays at the same address when the
+ * MappedFile is moved, so pointers into it remain valid.
+ */
+class MappedFile {
+ public:
+  MappedFile() = default;
+  explicit MappedFile(char const* aPath);  // throws Error
+  ~MappedFile();
+
+  MappedFile(MappedFile&&) noexcept;
+  MappedFile& operator=(MappedFile&&) noexcept;
+
+  std::span<std::byte const> bytes() const { return {data, size}; }
+
+ private:
+  std::byte const* data = nullptr;
+  std::size_t size = 0;
+};
+
+/* MappedAppendFile: a file written at its end through a writable mapping
+ *
+ * Only a window at the end of the file is mapped, so memory stays bounded
+ * however large the file grows. The file is grown a window at a time and
+ * cut to what was written by close(). Bytes before the window can no
+ * longer be changed.
+ */
+class MappedAppendFile {
+ public:
+  // Largest reserve(); windows are kMaxAppend plus their alignment
+  static constexpr std::size_t kMaxAppend = std::size_t(1) << 20;
+
+  MappedAppendFile() = default;
+  // Creates the file, or empties it; throws Error
+  explicit MappedAppendFile(char const* aPath);
+  ~MappedAppendFile();
+
+  MappedAppendFile(MappedAppendFile&&) noexcept;
+  MappedAppendFile& operator=(MappedAppendFile&&) noexcept;
+
+  bool isOpen() const;
+  std::uint64_t size() const { return written; }
+
+  // Room for up to aBytes (at most kMaxAppend) at the end of the file;
+  // fill some of it, then commit() them. Throws Error.
+  std::byte* reserve(std::size_t aBytes);
+  void commit(std::size_t aBytes) { written += aBytes; }
+  void append(void const* aData, std::size_t aBytes);  // throws Error
+
+  // Unmaps the window and cuts the file to size(); throws Error
+  void close();
+
+ private:
+  void map(std::uint64_t aOffset);  // throws Error
+  void unmap();
+
+#if defined(_WIN32)
+  void* file = nullptr;
+  void* mapping = nullptr;
+#else
+  int fd = -1;
+#endif
+  std::byte* window = nullptr;
+  std::uint64_t windowOffset = 0;
+  std::uint64_t written = 0;
+};
+
+#endif  // MAPPED_FILE_HPP_7B3E91C4_58D2_4A6F_9E07_C2D5A8B14F63
@@ -2,7 +2,39 @@
 
 #include <rapidobj/rapidobj.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+
 #include "../support/error.hpp"
+#include "../vmlib/quantize.hpp"
+
+namespace {
+GLuint create_vao_(MeshData const&, std::vector<std::uint32_t> const*);
+
+// Visits each (non-empty) attribute array of a MeshData
+template <typename MeshT, typename Fn>
+void for_each_attribute_(MeshT& aMesh, Fn&& aFn) {
+  aFn(aMesh.positions);
+  aFn(aMesh.normals);
+  aFn(aMesh.texcoords);
+  aFn(aMesh.ambient);
+  aFn(aMesh.diffuse);
+  aFn(aMesh.specular);
+  aFn(aMesh.shininess);
+  aFn(aMesh.emissive);
+}
+
+// True if every component of every element lies in [0,1]
+template <typename T>
+bool in_unit_range_(std::vector<T> const& aValues) {
+  return std::all_of(aValues.begin(), aValues.end(), [](T const& aV) {
+    auto const* f = reinterpret_cast<float const*>(&aV);
+    return std::all_of(f, f + sizeof(T) / sizeof(float),
+                       [](float aX) { return aX >= 0.f && aX <= 1.f; });
+  });
+}
+}  // namespace
 
 MeshData concatenate(MeshData aM, MeshData const& aN) {
   aM.positions.insert(aM.positions.end(), aN.positions.begin(),
@@ -20,7 +52,219 @@ MeshData concatenate(MeshData aM, MeshData const& aN) {
   return aM;
 }
 
+IndexedMeshData make_indexed(MeshData const& aMesh) {
+  std::size_t const count = aMesh.positions.size();
+
+  // Hash the raw bits of all attributes of a vertex (FNV-1a)
+  auto hash = [&](std::size_t aVertex) {
+    std::uint64_t h = 14695981039346656037ull;
+    for_each_attribute_(aMesh, [&](auto const& aAttrib) {
+      if (aAttrib.empty()) return;
+      auto const* bytes =
+          reinterpret_cast<unsigned char const*>(&aAttrib[aVertex]);
+      for (std::size_t i = 0; i < sizeof(aAttrib[aVertex]); ++i) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+      }
+    });
+    return h;
+  };
+  auto equal = [&](std::size_t aA, std::size_t aB) {
+    bool same = true;
+    for_each_attribute_(aMesh, [&](auto const& aAttrib) {
+      if (!aAttrib.empty())
+        same = same && 0 == std::memcmp(&aAttrib[aA], &aAttrib[aB],
+                                        sizeof(aAttrib[aA]));
+    });
+    return same;
+  };
+
+  // Open addressing table of unique vertex ids
+  std::size_t tableSize = 1;
+  while (tableSize < 2 * count) tableSize *= 2;
+  std::vector<std::uint32_t> table(tableSize, ~std::uint32_t(0));
+
+  IndexedMeshData ret;
+  ret.indices.resize(count);
+  std::vector<std::uint32_t> unique;
+  unique.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    std::size_t slot = std::size_t(hash(i)) & (tableSize - 1);
+    while (table[slot] != ~std::uint32_t(0) && !equal(unique[table[slot]], i))
+      slot = (slot + 1) & (tableSize - 1);
+
+    if (table[slot] == ~std::uint32_t(0)) {
+      table[slot] = std::uint32_t(unique.size());
+      unique.push_back(std::uint32_t(i));
+    }
+    ret.indices[i] = table[slot];
+  }
+
+  // Gather the unique vertices
+  auto gather = [&](auto& aDst, auto const& aSrc) {
+    if (aSrc.empty()) return;
+    aDst.reserve(unique.size());
+    for (auto v : unique) aDst.push_back(aSrc[v]);
+  };
+  gather(ret.vertices.positions, aMesh.positions);
+  gather(ret.vertices.normals, aMesh.normals);
+  gather(ret.vertices.texcoords, aMesh.texcoords);
+  gather(ret.vertices.ambient, aMesh.ambient);
+  gather(ret.vertices.diffuse, aMesh.diffuse);
+  gather(ret.vertices.specular, aMesh.specular);
+  gather(ret.vertices.shininess, aMesh.shininess);
+  gather(ret.vertices.emissive, aMesh.emissive);
+  return ret;
+}
+
 GLuint create_vao(MeshData const& aMeshData) {
+  return create_vao_(aMeshData, nullptr);
+}
+
+GLuint create_vao(IndexedMeshData const& aMesh) {
+  return create_vao_(aMesh.vertices, &aMesh.indices);
+}
+
+GLuint create_packed_vao(IndexedMeshData const& aMesh,
+                         PositionDecode& aDecode) {
+  MeshData const& mesh = aMesh.vertices;
+  std::size_t const count = mesh.positions.size();
+
+  // Quantisation grid spans the AABB. Flat axes get a unit scale to avoid
+  // dividing by zero.
+  aDecode = PositionDecode{};
+  if (count > 0) {
+    Vec3f lo = mesh.positions.front();
+    Vec3f hi = lo;
+    for (auto const& p : mesh.positions) {
+      lo = Vec3f{std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z)};
+      hi = Vec3f{std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z)};
+    }
+    Vec3f const extent = hi - lo;
+    aDecode.origin = lo;
+    aDecode.scale = Vec3f{extent.x > 0.f ? extent.x : 1.f,
+                          extent.y > 0.f ? extent.y : 1.f,
+                          extent.z > 0.f ? extent.z : 1.f};
+  }
+
+  GLuint vao = 0;
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
+  // Each attribute gets its own buffer, as in create_vao()
+  std::vector<GLuint> vbos;
+  GLuint index = 0;
+  auto attribute = [&](auto const& aData, GLint aSize, GLenum aType,
+                       GLboolean aNormalized) {
+    GLuint vbo = 0;
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, aData.size() * sizeof(aData[0]),
+                 aData.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(index, aSize, aType, aNormalized, 0, 0);
+    glEnableVertexAttribArray(index);
+    ++index;
+    vbos.push_back(vbo);
+  };
+  auto colour = [&](std::vector<Vec3f> const& aColours) {
+    if (in_unit_range_(aColours)) {
+      std::vector<std::uint32_t> packed(count);
+      for (std::size_t i = 0; i < count; ++i)
+        packed[i] = pack_unorm_1010102(aColours[i]);
+      attribute(packed, 4, GL_UNSIGNED_INT_2_10_10_10_REV, GL_TRUE);
+    } else {
+      std::vector<std::array<std::uint16_t, 4>> packed(count);
+      for (std::size_t i = 0; i < count; ++i)
+        packed[i] = {float_to_half(aColours[i].x), float_to_half(aColours[i].y),
+                     float_to_half(aColours[i].z), float_to_half(1.f)};
+      attribute(packed, 4, GL_HALF_FLOAT, GL_FALSE);
+    }
+  };
+
+  if (!mesh.positions.empty()) {
+    std::vector<std::array<std::uint16_t, 3>> packed(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      Vec3f const p = mesh.positions[i] - aDecode.origin;
+      packed[i] = {quantize_unorm16(p.x / aDecode.scale.x),
+                   quantize_unorm16(p.y / aDecode.scale.y),
+                   quantize_unorm16(p.z / aDecode.scale.z)};
+    }
+    attribute(packed, 3, GL_UNSIGNED_SHORT, GL_TRUE);
+  }
+  if (!mesh.normals.empty()) {
+    std::vector<std::array<std::int16_t, 2>> packed(count);
+    for (std::size_t i = 0; i < count; ++i)
+      packed[i] = oct_encode_snorm16(normalize(mesh.normals[i]));
+    attribute(packed, 2, GL_SHORT, GL_TRUE);
+  }
+  if (!mesh.texcoords.empty()) {
+    std::vector<std::array<std::uint16_t, 2>> packed(count);
+    if (in_unit_range_(mesh.texcoords)) {
+      for (std::size_t i = 0; i < count; ++i)
+        packed[i] = {quantize_unorm16(mesh.texcoords[i].x),
+                     quantize_unorm16(mesh.texcoords[i].y)};
+      attribute(packed, 2, GL_UNSIGNED_SHORT, GL_TRUE);
+    } else {
+      for (std::size_t i = 0; i < count; ++i)
+        packed[i] = {float_to_half(mesh.texcoords[i].x),
+                     float_to_half(mesh.texcoords[i].y)};
+      attribute(packed, 2, GL_HALF_FLOAT, GL_FALSE);
+    }
+  }
+  if (!mesh.ambient.empty()) colour(mesh.ambient);
+  if (!mesh.diffuse.empty()) colour(mesh.diffuse);
+  if (!mesh.specular.empty()) colour(mesh.specular);
+  if (!mesh.shininess.empty()) {
+    std::vector<std::uint16_t> packed(count);
+    for (std::size_t i = 0; i < count; ++i)
+      packed[i] = float_to_half(mesh.shininess[i]);
+    attribute(packed, 1, GL_HALF_FLOAT, GL_FALSE);
+  }
+  if (!mesh.emissive.empty()) colour(mesh.emissive);
+
+  GLuint indexEBO = 0;
+  if (!aMesh.indices.empty()) {
+    glGenBuffers(1, &indexEBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 aMesh.indices.size() * sizeof(std::uint32_t),
+                 aMesh.indices.data(), GL_STATIC_DRAW);
+  }
+
+  // Reset State
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glDeleteBuffers(1, &indexEBO);
+  glDeleteBuffers(GLsizei(vbos.size()), vbos.data());
+
+  return vao;
+}
+
+std::size_t vertex_size(MeshData const& aMesh, VertexFormat aFormat) {
+  std::size_t ret = 0;
+  if (VertexFormat::floats == aFormat) {
+    for_each_attribute_(aMesh, [&](auto const& aAttrib) {
+      if (!aAttrib.empty()) ret += sizeof(aAttrib[0]);
+    });
+    return ret;
+  }
+
+  auto colour = [](std::vector<Vec3f> const& aColours) -> std::size_t {
+    if (aColours.empty()) return 0;
+    return in_unit_range_(aColours) ? 4 : 8;
+  };
+  if (!aMesh.positions.empty()) ret += 6;
+  if (!aMesh.normals.empty()) ret += 4;
+  if (!aMesh.texcoords.empty()) ret += 4;
+  if (!aMesh.shininess.empty()) ret += 2;
+  return ret + colour(aMesh.ambient) + colour(aMesh.diffuse) +
+         colour(aMesh.specular) + colour(aMesh.emissive);
+}
+
+namespace {
+GLuint create_vao_(MeshData const& aMeshData,
+                   std::vector<std::uint32_t> const* aIndices) {
   GLuint positionVBO = 0;
   GLuint normalVBO = 0;
   GLuint textureVBO = 0;
@@ -133,9 +377,21 @@ GLuint create_vao(MeshData const& aMeshData) {
     index++;
   }
 
+  // Index buffer binding is part of the VAO state
+  GLuint indexEBO = 0;
+  if (aIndices && aIndices->size() > 0) {
+    glGenBuffers(1, &indexEBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 aIndices->size() * sizeof(std::uint32_t), aIndices->data(),
+                 GL_STATIC_DRAW);
+  }
+
   // Reset State
   glBindVertexArray(0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glDeleteBuffers(1, &indexEBO);
   glDeleteBuffers(1, &positionVBO);
   glDeleteBuffers(1, &normalVBO);
   glDeleteBuffers(1, &textureVBO);
@@ -147,6 +403,7 @@ GLuint create_vao(MeshData const& aMeshData) {
 
   return vao;
 }
+}  // namespace
 
 MeshData load_wavefront_obj(char const* aPath, bool useTexture) {
   // rapidobj to load file
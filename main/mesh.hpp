@@ -3,6 +3,7 @@
 
 #include <glad/glad.h>
 
+#include <cstdint>
 #include <vector>
 
 #include "../vmlib/vec2.hpp"
@@ -24,9 +25,51 @@ struct MeshData {
   std::vector<Vec3f> emissive;
 };
 
+// Indexed triangle list. Every vertex in `vertices` is unique.
+struct IndexedMeshData {
+  MeshData vertices;
+  std::vector<std::uint32_t> indices;
+};
+
 MeshData concatenate(MeshData, MeshData const&);
 
+// How vertex attributes are stored on the GPU
+enum class VertexFormat {
+  floats,  // 32-bit floats throughout
+  packed   // quantised, see create_packed_vao()
+};
+constexpr VertexFormat kDefaultVertexFormat = VertexFormat::packed;
+
+// Packed positions are decoded as origin + scale * p (p in [0,1]^3)
+struct PositionDecode {
+  Vec3f origin{0.f, 0.f, 0.f};
+  Vec3f scale{1.f, 1.f, 1.f};
+};
+// Uniform locations of PositionDecode::origin and ::scale in the packed
+// vertex shaders (after the lighting uniforms, 3 - 15)
+constexpr GLint kPositionOriginLocation = 16;
+constexpr GLint kPositionScaleLocation = 17;
+
+// Welds identical vertices of a triangle soup into an indexed mesh
+IndexedMeshData make_indexed(MeshData const&);
+
 GLuint create_vao(MeshData const&);
+// Also uploads the indices as the VAO's element array buffer
+GLuint create_vao(IndexedMeshData const&);
+
+/* Uploads a quantised copy of the mesh. Attributes keep the locations used by
+ * create_vao() but are stored as
+ *   positions   3 x UNORM16 relative to the mesh AABB (see aDecode)
+ *   normals     octahedral, 2 x SNORM16
+ *   texcoords   2 x UNORM16 if all lie in [0,1], 2 x half otherwise
+ *   colours     UNORM 2_10_10_10 if all lie in [0,1], 4 x half otherwise
+ *   shininess   half
+ * The vertex shader must apply aDecode to positions and decode normals.
+ */
+GLuint create_packed_vao(IndexedMeshData const&, PositionDecode& aDecode);
+
+// Size of one vertex of the mesh in the given format
+std::size_t vertex_size(MeshData const&, VertexFormat);
 
 MeshData load_wavefront_obj(char const* aPath, bool useTexture);
 
@@ -0,0 +1,358 @@
+#include "mesh_optimize.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+
+namespace {
+// Forsyth's scoring parameters, see
+// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+constexpr std::size_t kForsythCacheSize = 32;
+constexpr float kCacheDecayPower = 1.5f;
+constexpr float kLastTriScore = 0.75f;
+constexpr float kValenceBoostScale = 2.f;
+constexpr float kValenceBoostPower = 0.5f;
+constexpr std::size_t kMaxValenceScore = 32;
+
+struct ScoreTables {
+  std::array<float, kForsythCacheSize> cache;
+  std::array<float, kMaxValenceScore> valence;
+};
+
+ScoreTables make_score_tables_() {
+  ScoreTables ret{};
+  for (std::size_t i = 0; i < kForsythCacheSize; ++i) {
+    if (i < 3) {
+      // The most recent triangle's vertices get a fixed score, so that the
+      // next triangle does not simply reuse them in the same order.
+      ret.cache[i] = kLastTriScore;
+    } else {
+      float const scaler = 1.f / float(kForsythCacheSize - 3);
+      ret.cache[i] = std::pow(1.f - float(i - 3) * scaler, kCacheDecayPower);
+    }
+  }
+  for (std::size_t i = 1; i < kMaxValenceScore; ++i)
+    ret.valence[i] = kValenceBoostScale * std::pow(float(i), -kValenceBoostPower);
+  return ret;
+}
+
+float vertex_score_(ScoreTables const& aTables, int aCachePos,
+                    std::uint32_t aValence) {
+  if (0 == aValence) return -1.f;  // no triangles left
+
+  float score = aCachePos >= 0 ? aTables.cache[std::size_t(aCachePos)] : 0.f;
+  score += aTables.valence[std::min<std::size_t>(aValence, kMaxValenceScore - 1)];
+  return score;
+}
+
+// Simulated FIFO vertex cache. Returns the number of misses of a triangle.
+struct FifoCache {
+  explicit FifoCache(std::size_t aSize) : size(aSize), time(0) {}
+
+  std::uint32_t insert(std::uint32_t aVertex) {
+    if (aVertex >= stamp.size()) stamp.resize(aVertex + 1, 0);
+    // Cached if inserted within the last `size` misses
+    if (stamp[aVertex] != 0 && time - stamp[aVertex] < size) return 0;
+    stamp[aVertex] = ++time;
+    return 1;
+  }
+
+  void clear() { time += size; }
+
+  std::size_t size;
+  std::size_t time;
+  std::vector<std::size_t> stamp;
+};
+}  // namespace
+
+float compute_acmr(std::vector<std::uint32_t> const& aIndices,
+                   std::size_t aCacheSize) {
+  if (aIndices.empty()) return 0.f;
+
+  FifoCache cache(aCacheSize);
+  std::size_t misses = 0;
+  for (auto i : aIndices) misses += cache.insert(i);
+  return float(misses) / float(aIndices.size() / 3);
+}
+
+std::vector<std::uint32_t> optimize_vertex_cache(
+    std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount) {
+  static ScoreTables const tables = make_score_tables_();
+
+  // Degenerate triangles draw nothing; dropping them keeps the adjacency
+  // bookkeeping below simple.
+  std::vector<std::uint32_t> indices;
+  indices.reserve(aIndices.size());
+  for (std::size_t t = 0; t + 2 < aIndices.size(); t += 3) {
+    auto const a = aIndices[t], b = aIndices[t + 1], c = aIndices[t + 2];
+    if (a != b && b != c && c != a) indices.insert(indices.end(), {a, b, c});
+  }
+
+  std::size_t const triCount = indices.size() / 3;
+  if (0 == triCount) return {};
+
+  // Vertex -> triangle adjacency (CSR)
+  std::vector<std::uint32_t> valence(aVertexCount, 0);
+  for (auto i : indices) ++valence[i];
+
+  std::vector<std::uint32_t> adjOffset(aVertexCount + 1, 0);
+  for (std::size_t v = 0; v < aVertexCount; ++v)
+    adjOffset[v + 1] = adjOffset[v] + valence[v];
+  std::vector<std::uint32_t> adjTris(indices.size());
+  {
+    std::vector<std::uint32_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+    for (std::size_t t = 0; t < triCount; ++t) {
+      for (std::size_t k = 0; k < 3; ++k)
+        adjTris[fill[indices[3 * t + k]]++] = std::uint32_t(t);
+    }
+  }
+
+  std::vector<int> cachePos(aVertexCount, -1);
+  std::vector<float> vertexScore(aVertexCount);
+  for (std::size_t v = 0; v < aVertexCount; ++v)
+    vertexScore[v] = vertex_score_(tables, -1, valence[v]);
+
+  std::vector<float> triScore(triCount);
+  std::vector<bool> emitted(triCount, false);
+  for (std::size_t t = 0; t < triCount; ++t) {
+    triScore[t] = vertexScore[indices[3 * t + 0]] +
+                  vertexScore[indices[3 * t + 1]] +
+                  vertexScore[indices[3 * t + 2]];
+  }
+
+  // LRU cache, with room for the three vertices pushed out by a new triangle
+  std::array<std::uint32_t, kForsythCacheSize + 3> cache{};
+  std::size_t cacheCount = 0;
+
+  std::vector<std::uint32_t> ret;
+  ret.reserve(indices.size());
+
+  std::size_t scanCursor = 0;
+  std::size_t best = 0;
+  float bestScore = triScore[0];
+  for (std::size_t t = 1; t < triCount; ++t) {
+    if (triScore[t] > bestScore) {
+      best = t;
+      bestScore = triScore[t];
+    }
+  }
+
+  for (std::size_t emittedCount = 0; emittedCount < triCount; ++emittedCount) {
+    emitted[best] = true;
+    std::array<std::uint32_t, 3> const tri = {indices[3 * best + 0],
+                                              indices[3 * best + 1],
+                                              indices[3 * best + 2]};
+    ret.insert(ret.end(), tri.begin(), tri.end());
+
+    // Move the triangle's vertices to the front of the cache
+    std::array<std::uint32_t, kForsythCacheSize + 3> newCache;
+    std::size_t newCount = 0;
+    for (auto v : tri) newCache[newCount++] = v;
+    for (std::size_t i = 0; i < cacheCount; ++i) {
+      auto const v = cache[i];
+      if (v != tri[0] && v != tri[1] && v != tri[2]) newCache[newCount++] = v;
+    }
+
+    // Remove the emitted triangle from the adjacency of its vertices
+    for (auto v : tri) {
+      auto* const begin = adjTris.data() + adjOffset[v];
+      auto* const end = begin + valence[v];
+      auto* const it = std::find(begin, end, std::uint32_t(best));
+      assert(it != end);
+      *it = *(end - 1);
+      --valence[v];
+    }
+
+    // Update scores of all vertices that were or are in the cache
+    for (std::size_t i = 0; i < newCount; ++i) {
+      auto const v = newCache[i];
+      cachePos[v] = i < kForsythCacheSize ? int(i) : -1;
+      vertexScore[v] = vertex_score_(tables, cachePos[v], valence[v]);
+    }
+
+    // Rescore the triangles touching the cache and pick the best one
+    bestScore = -1.f;
+    best = triCount;
+    for (std::size_t i = 0; i < newCount; ++i) {
+      auto const v = newCache[i];
+      for (std::size_t a = 0; a < valence[v]; ++a) {
+        auto const t = adjTris[adjOffset[v] + a];
+        float const score = vertexScore[indices[3 * t + 0]] +
+                            vertexScore[indices[3 * t + 1]] +
+                            vertexScore[indices[3 * t + 2]];
+        triScore[t] = score;
+        if (score > bestScore) {
+          bestScore = score;
+          best = t;
+        }
+      }
+    }
+
+    cacheCount = std::min(newCount, kForsythCacheSize);
+    std::copy(newCache.begin(), newCache.begin() + cacheCount, cache.begin());
+
+    // Nothing adjacent to the cache; continue with any remaining triangle
+    if (best == triCount) {
+      while (scanCursor < triCount && emitted[scanCursor]) ++scanCursor;
+      best = scanCursor;
+      if (best == triCount) break;
+    }
+  }
+
+  return ret;
+}
+
+std::vector<std::uint32_t> optimize_overdraw(
+    std::vector<std::uint32_t> const& aIndices,
+    std::vector<Vec3f> const& aPositions, float aThreshold) {
+  std::size_t const triCount = aIndices.size() / 3;
+  if (triCount < 2) return aIndices;
+
+  // Hard cluster boundaries: triangles where all three vertices miss, i.e.
+  // where the vertex cache optimiser had to restart.
+  std::vector<std::size_t> hard;
+  {
+    FifoCache cache(kAcmrCacheSize);
+    for (std::size_t t = 0; t < triCount; ++t) {
+      std::uint32_t misses = 0;
+      for (std::size_t k = 0; k < 3; ++k)
+        misses += cache.insert(aIndices[3 * t + k]);
+      if (0 == t || 3 == misses) hard.push_back(t);
+    }
+    hard.push_back(triCount);
+  }
+
+  // Soft boundaries: split hard clusters wherever the ACMR of the part so
+  // far is within aThreshold of the ACMR of the whole hard cluster.
+  std::vector<std::size_t> clusters;
+  for (std::size_t h = 0; h + 1 < hard.size(); ++h) {
+    std::size_t const begin = hard[h], end = hard[h + 1];
+
+    FifoCache cache(kAcmrCacheSize);
+    std::size_t clusterMisses = 0;
+    for (std::size_t t = begin; t < end; ++t) {
+      for (std::size_t k = 0; k < 3; ++k)
+        clusterMisses += cache.insert(aIndices[3 * t + k]);
+    }
+    float const clusterAcmr = float(clusterMisses) / float(end - begin);
+
+    cache.clear();
+    std::size_t start = begin;
+    std::size_t misses = 0;
+    clusters.push_back(begin);
+    for (std::size_t t = begin; t < end; ++t) {
+      for (std::size_t k = 0; k < 3; ++k)
+        misses += cache.insert(aIndices[3 * t + k]);
+
+      float const acmr = float(misses) / float(t - start + 1);
+      if (t + 1 < end && acmr <= clusterAcmr * aThreshold) {
+        clusters.push_back(t + 1);
+        start = t + 1;
+        misses = 0;
+        cache.clear();
+      }
+    }
+  }
+  clusters.push_back(triCount);
+
+  // Mesh centroid
+  Vec3f meshCentroid{0.f, 0.f, 0.f};
+  float meshArea = 0.f;
+  auto triangle = [&](std::size_t aT, Vec3f& aCentroid, Vec3f& aNormal) {
+    Vec3f const p0 = aPositions[aIndices[3 * aT + 0]];
+    Vec3f const p1 = aPositions[aIndices[3 * aT + 1]];
+    Vec3f const p2 = aPositions[aIndices[3 * aT + 2]];
+    aCentroid = (p0 + p1 + p2) / 3.f;
+    aNormal = cross(p1 - p0, p2 - p0);  // length is twice the area
+    return length(aNormal);
+  };
+  for (std::size_t t = 0; t < triCount; ++t) {
+    Vec3f c, n;
+    float const area = triangle(t, c, n);
+    meshCentroid += area * c;
+    meshArea += area;
+  }
+  if (meshArea > 0.f) meshCentroid /= meshArea;
+
+  // Sort clusters outside-in by how much they face away from the centre;
+  // those are likely to occlude the others.
+  std::size_t const clusterCount = clusters.size() - 1;
+  std::vector<float> sortKey(clusterCount);
+  for (std::size_t c = 0; c < clusterCount; ++c) {
+    Vec3f centroid{0.f, 0.f, 0.f};
+    Vec3f normal{0.f, 0.f, 0.f};
+    float area = 0.f;
+    for (std::size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+      Vec3f tc, tn;
+      float const a = triangle(t, tc, tn);
+      centroid += a * tc;
+      normal += tn;
+      area += a;
+    }
+    if (area > 0.f) centroid /= area;
+    float const len = length(normal);
+    if (len > 0.f) normal /= len;
+    sortKey[c] = dot(centroid - meshCentroid, normal);
+  }
+
+  std::vector<std::size_t> order(clusterCount);
+  std::iota(order.begin(), order.end(), std::size_t(0));
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t aA, std::size_t aB) {
+                     return sortKey[aA] > sortKey[aB];
+                   });
+
+  std::vector<std::uint32_t> ret;
+  ret.reserve(aIndices.size());
+  for (auto c : order) {
+    ret.insert(ret.end(), aIndices.begin() + 3 * clusters[c],
+               aIndices.begin() + 3 * clusters[c + 1]);
+  }
+  return ret;
+}
+
+void optimize_vertex_fetch(MeshData& aVertices,
+                           std::span<std::vector<std::uint32_t>> aIndexLists) {
+  std::size_t const vertexCount = aVertices.positions.size();
+
+  constexpr auto kUnused = ~std::uint32_t(0);
+  std::vector<std::uint32_t> remap(vertexCount, kUnused);
+  std::vector<std::uint32_t> order;
+  order.reserve(vertexCount);
+  for (auto const& list : aIndexLists) {
+    for (auto i : list) {
+      if (kUnused == remap[i]) {
+        remap[i] = std::uint32_t(order.size());
+        order.push_back(i);
+      }
+    }
+  }
+  for (std::uint32_t v = 0; v < vertexCount; ++v) {
+    if (kUnused == remap[v]) {
+      remap[v] = std::uint32_t(order.size());
+      order.push_back(v);
+    }
+  }
+
+  for (auto& list : aIndexLists) {
+    for (auto& i : list) i = remap[i];
+  }
+
+  auto reorder = [&](auto& aAttrib) {
+    if (aAttrib.empty()) return;
+    std::remove_reference_t<decltype(aAttrib)> sorted;
+    sorted.reserve(aAttrib.size());
+    for (auto v : order) sorted.push_back(aAttrib[v]);
+    aAttrib = std::move(sorted);
+  };
+  reorder(aVertices.positions);
+  reorder(aVertices.normals);
+  reorder(aVertices.texcoords);
+  reorder(aVertices.ambient);
+  reorder(aVertices.diffuse);
+  reorder(aVertices.specular);
+  reorder(aVertices.shininess);
+  reorder(aVertices.emissive);
+}
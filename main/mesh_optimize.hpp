@@ -0,0 +1,43 @@
+#ifndef MESH_OPTIMIZE_HPP_96FD0991_2BF1_4685_B9B0_B3100706577D
+#define MESH_OPTIMIZE_HPP_96FD0991_2BF1_4685_B9B0_B3100706577D
+
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <vector>
+
+#include "../vmlib/vec3.hpp"
+#include "mesh.hpp"
+
+/* Post-load optimisation passes for indexed triangle lists
+ *
+ * The intended order is
+ *   1. optimize_vertex_cache() - Forsyth's linear-speed vertex cache
+ *      optimisation, reduces vertex shader invocations,
+ *   2. optimize_overdraw() - splits the result into clusters and sorts them
+ *      outside-in (Sander et al. '07), keeping most of the cache locality,
+ *   3. optimize_vertex_fetch() - renumbers vertices in order of first use so
+ *      that vertex fetches walk the buffers linearly.
+ */
+
+// FIFO cache size used when reporting ACMR
+constexpr std::size_t kAcmrCacheSize = 16;
+
+// Average cache miss ratio: transformed vertices per triangle (0.5 - 3.0)
+float compute_acmr(std::vector<std::uint32_t> const& aIndices,
+                   std::size_t aCacheSize = kAcmrCacheSize);
+
+std::vector<std::uint32_t> optimize_vertex_cache(
+    std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount);
+
+// aThreshold: how much the ACMR of each cluster may grow (1.05 = 5%)
+std::vector<std::uint32_t> optimize_overdraw(
+    std::vector<std::uint32_t> const& aIndices,
+    std::vector<Vec3f> const& aPositions, float aThreshold = 1.05f);
+
+// Reorders aVertices by first use in aIndexLists (in order) and remaps the
+// lists. Unreferenced vertices move to the end.
+void optimize_vertex_fetch(MeshData& aVertices,
+                           std::span<std::vector<std::uint32_t>> aIndexLists);
+
+#endif  // MESH_OPTIMIZE_HPP_96FD0991_2BF1_4685_B9B0_B3100706577D
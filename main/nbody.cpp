@@ -0,0 +1,520 @@
+#include "nbody.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace {
+// Bits of each coordinate in a Morton code, and so the deepest tree level
+constexpr std::uint32_t kMortonLevels = 21;
+// Cells with this many bodies or fewer are leaves
+constexpr std::uint32_t kLeafSize = 8;
+// The force pass walks the tree once for each group: the largest cells
+// with at most this many bodies
+constexpr std::uint32_t kGroupSize = 64;
+// Subtrees from this level down are built by jobs, if big enough to be
+// worth one
+constexpr std::uint32_t kSubtreeLevel = 2;
+constexpr std::uint32_t kMinSubtreeSize = 1024;
+// Sizes of the pieces of work handed to the jobs
+constexpr std::size_t kBodyGrain = 4096;
+constexpr std::size_t kGroupGrain = 16;
+constexpr std::size_t kMinSortChunk = 4096;
+// Cells waiting in the force traversal: each level opens at most 8
+constexpr std::size_t kTraversalStack = 8 * kMortonLevels;
+
+// Spreads the low 21 bits of aV out to every third bit
+std::uint64_t expand_bits_(std::uint64_t aV) {
+  aV &= 0x1fffff;
+  aV = (aV | aV << 32) & 0x1f00000000ffff;
+  aV = (aV | aV << 16) & 0x1f0000ff0000ff;
+  aV = (aV | aV << 8) & 0x100f00f00f00f00f;
+  aV = (aV | aV << 4) & 0x10c30c30c30c30c3;
+  aV = (aV | aV << 2) & 0x1249249249249249;
+  return aV;
+}
+
+// Adds m r / (|r|^2 + soft2)^1.5 for aCount point masses to aA, without
+// G. A mass at the point itself (the body) adds nothing.
+void add_accelerations_(float const* aX, float const* aY, float const* aZ,
+                        float const* aMass, std::size_t aCount, Vec3f aPoint,
+                        float aSoft2, Vec3f& aA) {
+  std::size_t j = 0;
+
+#if defined(__AVX__)
+  // Eight masses at a time; the same sum as the loop below
+  __m256 const px = _mm256_set1_ps(aPoint.x);
+  __m256 const py = _mm256_set1_ps(aPoint.y);
+  __m256 const pz = _mm256_set1_ps(aPoint.z);
+  __m256 const soft2 = _mm256_set1_ps(aSoft2);
+  __m256 const zero = _mm256_setzero_ps();
+  __m256 const half = _mm256_set1_ps(0.5f);
+  __m256 const threeHalves = _mm256_set1_ps(1.5f);
+  __m256 sumX = zero, sumY = zero, sumZ = zero;
+  for (; j + 8 <= aCount; j += 8) {
+    __m256 const dx = _mm256_sub_ps(_mm256_loadu_ps(&aX[j]), px);
+    __m256 const dy = _mm256_sub_ps(_mm256_loadu_ps(&aY[j]), py);
+    __m256 const dz = _mm256_sub_ps(_mm256_loadu_ps(&aZ[j]), pz);
+    __m256 const d2 = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+        _mm256_mul_ps(dz, dz));
+    __m256 const r2 = _mm256_add_ps(d2, soft2);
+    // 12-bit estimate of 1 / sqrt(r2) and one Newton step, good to about
+    // float precision and much cheaper than sqrt and divide
+    __m256 const y0 = _mm256_rsqrt_ps(r2);
+    __m256 const invR = _mm256_mul_ps(
+        y0, _mm256_sub_ps(threeHalves,
+                          _mm256_mul_ps(_mm256_mul_ps(half, r2),
+                                        _mm256_mul_ps(y0, y0))));
+    __m256 const s = _mm256_and_ps(
+        _mm256_mul_ps(_mm256_loadu_ps(&aMass[j]),
+                      _mm256_mul_ps(invR, _mm256_mul_ps(invR, invR))),
+        _mm256_cmp_ps(d2, zero, _CMP_GT_OQ));
+    sumX = _mm256_add_ps(sumX, _mm256_mul_ps(dx, s));
+    sumY = _mm256_add_ps(sumY, _mm256_mul_ps(dy, s));
+    sumZ = _mm256_add_ps(sumZ, _mm256_mul_ps(dz, s));
+  }
+  alignas(32) float lanes[3][8];
+  _mm256_store_ps(lanes[0], sumX);
+  _mm256_store_ps(lanes[1], sumY);
+  _mm256_store_ps(lanes[2], sumZ);
+  for (int k = 0; k < 8; ++k) {
+    aA.x += lanes[0][k];
+    aA.y += lanes[1][k];
+    aA.z += lanes[2][k];
+  }
+#endif
+
+  for (; j < aCount; ++j) {
+    float const dx = aX[j] - aPoint.x, dy = aY[j] - aPoint.y,
+                dz = aZ[j] - aPoint.z;
+    float const d2 = dx * dx + dy * dy + dz * dz;
+    if (!(d2 > 0.f)) continue;
+    float const invR = 1.f / std::sqrt(d2 + aSoft2);
+    float const s = aMass[j] * invR * invR * invR;
+    aA.x += dx * s;
+    aA.y += dy * s;
+    aA.z += dz * s;
+  }
+}
+
+// What acts on a group of bodies: distant cells and the bodies of nearby
+// leaves, as one structure of arrays of point masses
+struct InteractionList {
+  std::vector<float> x, y, z, mass;
+
+  std::size_t size() const { return x.size(); }
+  void clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    mass.clear();
+  }
+  void add(float aX, float aY, float aZ, float aMass) {
+    x.push_back(aX);
+    y.push_back(aY);
+    z.push_back(aZ);
+    mass.push_back(aMass);
+  }
+  void add(NBodyBodies const& aBodies, std::uint32_t aBegin,
+           std::uint32_t aEnd) {
+    x.insert(x.end(), aBodies.x.begin() + aBegin, aBodies.x.begin() + aEnd);
+    y.insert(y.end(), aBodies.y.begin() + aBegin, aBodies.y.begin() + aEnd);
+    z.insert(z.end(), aBodies.z.begin() + aBegin, aBodies.z.begin() + aEnd);
+    mass.insert(mass.end(), aBodies.mass.begin() + aBegin,
+                aBodies.mass.begin() + aEnd);
+  }
+};
+
+std::uint64_t quantise_(float aV, float aOrigin, float aScale) {
+  constexpr float kMax = float((1u << kMortonLevels) - 1);
+  return std::uint64_t(std::clamp((aV - aOrigin) * aScale, 0.f, kMax));
+}
+}  // namespace
+
+void NBodyBodies::resize(std::size_t aCount) {
+  for (auto* v : {&x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass})
+    v->resize(aCount);
+  id.resize(aCount);
+}
+
+NBody::NBody(NBodyParams aParams)
+    : nbodyParams(aParams),
+      haveAccelerations(false),
+      origin{0.f, 0.f, 0.f},
+      extent(1.f) {}
+
+std::uint32_t NBody::add(Vec3f aPosition, Vec3f aVelocity, float aMass) {
+  auto const id = std::uint32_t(state.size());
+  state.resize(state.size() + 1);
+  state.x.back() = aPosition.x;
+  state.y.back() = aPosition.y;
+  state.z.back() = aPosition.z;
+  state.vx.back() = aVelocity.x;
+  state.vy.back() = aVelocity.y;
+  state.vz.back() = aVelocity.z;
+  state.mass.back() = aMass;
+  state.id.back() = id;
+  haveAccelerations = false;
+  return id;
+}
+
+void NBody::clear() {
+  state.resize(0);
+  nodes.clear();
+  haveAccelerations = false;
+}
+
+void NBody::sortBodies(JobSystem& aJobs) {
+  std::size_t const count = state.size();
+
+  // Bounding cube
+  Vec3f lo{state.x[0], state.y[0], state.z[0]};
+  Vec3f hi = lo;
+  for (std::size_t i = 1; i < count; ++i) {
+    lo = {std::min(lo.x, state.x[i]), std::min(lo.y, state.y[i]),
+          std::min(lo.z, state.z[i])};
+    hi = {std::max(hi.x, state.x[i]), std::max(hi.y, state.y[i]),
+          std::max(hi.z, state.z[i])};
+  }
+  origin = lo;
+  extent = std::max({hi.x - lo.x, hi.y - lo.y, hi.z - lo.z});
+  extent = extent > 0.f ? extent * 1.0001f : 1.f;
+
+  keys.resize(count);
+  keyScratch.resize(count);
+  float const scale = float(1u << kMortonLevels) / extent;
+  aJobs.parallel_for(0, count, kBodyGrain,
+                     [&](std::size_t aBegin, std::size_t aEnd) {
+                       for (std::size_t i = aBegin; i < aEnd; ++i) {
+                         std::uint64_t const code =
+                             expand_bits_(quantise_(state.x[i], origin.x,
+                                                    scale)) << 2 |
+                             expand_bits_(quantise_(state.y[i], origin.y,
+                                                    scale)) << 1 |
+                             expand_bits_(quantise_(state.z[i], origin.z,
+                                                    scale));
+                         keys[i] = Key{code, std::uint32_t(i)};
+                       }
+                     });
+
+  // Sort a chunk per worker, then merge pairs of runs in parallel
+  auto const byCode = [](Key const& aA, Key const& aB) {
+    return aA.code < aB.code;
+  };
+  std::size_t const chunks = std::clamp<std::size_t>(
+      count / kMinSortChunk, 1, aJobs.workerCount());
+  std::size_t const run = (count + chunks - 1) / chunks;
+  aJobs.parallel_for(0, chunks, 1, [&](std::size_t aBegin, std::size_t aEnd) {
+    for (std::size_t c = aBegin; c < aEnd; ++c) {
+      std::size_t const first = c * run;
+      std::size_t const last = std::min(first + run, count);
+      std::sort(keys.begin() + first, keys.begin() + last, byCode);
+    }
+  });
+  for (std::size_t width = run; width < count; width *= 2) {
+    std::size_t const pairs = (count + 2 * width - 1) / (2 * width);
+    aJobs.parallel_for(0, pairs, 1, [&](std::size_t aBegin, std::size_t aEnd) {
+      for (std::size_t p = aBegin; p < aEnd; ++p) {
+        std::size_t const first = p * 2 * width;
+        std::size_t const middle = std::min(first + width, count);
+        std::size_t const last = std::min(first + 2 * width, count);
+        std::merge(keys.begin() + first, keys.begin() + middle,
+                   keys.begin() + middle, keys.begin() + last,
+                   keyScratch.begin() + first, byCode);
+      }
+    });
+    std::swap(keys, keyScratch);
+  }
+
+  // Bodies into Morton order. Accelerations are recomputed after this, so
+  // they are not carried along.
+  scratch.resize(count);
+  aJobs.parallel_for(0, count, kBodyGrain,
+                     [&](std::size_t aBegin, std::size_t aEnd) {
+                       for (std::size_t i = aBegin; i < aEnd; ++i) {
+                         std::uint32_t const from = keys[i].index;
+                         scratch.x[i] = state.x[from];
+                         scratch.y[i] = state.y[from];
+                         scratch.z[i] = state.z[from];
+                         scratch.vx[i] = state.vx[from];
+                         scratch.vy[i] = state.vy[from];
+                         scratch.vz[i] = state.vz[from];
+                         scratch.mass[i] = state.mass[from];
+                         scratch.id[i] = state.id[from];
+                       }
+                     });
+  for (auto member : {&NBodyBodies::x, &NBodyBodies::y, &NBodyBodies::z,
+                      &NBodyBodies::vx, &NBodyBodies::vy, &NBodyBodies::vz,
+                      &NBodyBodies::mass}) {
+    std::swap(state.*member, scratch.*member);
+  }
+  std::swap(state.id, scratch.id);
+}
+
+void NBody::buildNode(std::vector<Node>& aNodes, std::uint32_t aIndex,
+                      std::uint32_t aLevel, bool aDefer) {
+  std::uint32_t const begin = aNodes[aIndex].begin;
+  std::uint32_t const end = aNodes[aIndex].end;
+  aNodes[aIndex].firstChild = 0;
+  aNodes[aIndex].childCount = 0;
+  if (end - begin <= kLeafSize || kMortonLevels == aLevel) return;
+
+  if (aDefer && kSubtreeLevel == aLevel && end - begin >= kMinSubtreeSize) {
+    subtrees.push_back(Subtree{aIndex, aLevel});
+    return;
+  }
+
+  // The bodies of each octant are a run of the cell's range, in order
+  std::uint32_t const shift = 3 * (kMortonLevels - 1 - aLevel);
+  std::uint32_t bounds[9];
+  std::uint32_t childCount = 0;
+  bounds[0] = begin;
+  for (std::uint32_t b = begin; b < end;) {
+    std::uint64_t const octant = keys[b].code >> shift & 7;
+    auto const last = std::partition_point(
+        keys.begin() + b, keys.begin() + end,
+        [&](Key const& aKey) { return (aKey.code >> shift & 7) <= octant; });
+    b = std::uint32_t(last - keys.begin());
+    bounds[++childCount] = b;
+  }
+
+  auto const first = std::uint32_t(aNodes.size());
+  float const childSize = 0.5f * aNodes[aIndex].size;
+  aNodes[aIndex].firstChild = first;
+  aNodes[aIndex].childCount = childCount;
+  aNodes.resize(first + childCount);
+  for (std::uint32_t c = 0; c < childCount; ++c) {
+    Node& child = aNodes[first + c];
+    child.size = childSize;
+    child.begin = bounds[c];
+    child.end = bounds[c + 1];
+  }
+  for (std::uint32_t c = 0; c < childCount; ++c)
+    buildNode(aNodes, first + c, aLevel + 1, aDefer);
+}
+
+void NBody::computeMoments(std::vector<Node>& aNodes, std::size_t aFirst,
+                           std::size_t aEnd) const {
+  // Children come after their parents
+  for (std::size_t n = aEnd; n-- > aFirst;) {
+    Node& node = aNodes[n];
+    float mass = 0.f, mx = 0.f, my = 0.f, mz = 0.f;
+    if (0 == node.childCount) {
+      for (std::uint32_t i = node.begin; i < node.end; ++i) {
+        mass += state.mass[i];
+        mx += state.mass[i] * state.x[i];
+        my += state.mass[i] * state.y[i];
+        mz += state.mass[i] * state.z[i];
+      }
+    } else {
+      for (std::uint32_t c = 0; c < node.childCount; ++c) {
+        Node const& child = aNodes[node.firstChild + c];
+        mass += child.mass;
+        mx += child.mass * child.comX;
+        my += child.mass * child.comY;
+        mz += child.mass * child.comZ;
+      }
+    }
+    node.mass = mass;
+    if (mass > 0.f) {
+      node.comX = mx / mass;
+      node.comY = my / mass;
+      node.comZ = mz / mass;
+    } else {
+      node.comX = state.x[node.begin];
+      node.comY = state.y[node.begin];
+      node.comZ = state.z[node.begin];
+    }
+  }
+}
+
+void NBody::buildTree(JobSystem& aJobs) {
+  // Top levels here; the big cells at kSubtreeLevel are left to jobs
+  nodes.clear();
+  subtrees.clear();
+  nodes.push_back(Node{});
+  nodes[0].size = extent;
+  nodes[0].begin = 0;
+  nodes[0].end = std::uint32_t(state.size());
+  buildNode(nodes, 0, 0, true);
+  std::size_t const topCount = nodes.size();
+
+  subtreeNodes.resize(subtrees.size());
+  aJobs.parallel_for(0, subtrees.size(), 1,
+                     [&](std::size_t aBegin, std::size_t aEnd) {
+                       for (std::size_t s = aBegin; s < aEnd; ++s) {
+                         std::vector<Node>& local = subtreeNodes[s];
+                         local.assign(1, nodes[subtrees[s].node]);
+                         buildNode(local, 0, subtrees[s].level, false);
+                         computeMoments(local, 0, local.size());
+                       }
+                     });
+
+  // Splice each subtree in after the top levels; its root replaces the
+  // cell it was built for
+  std::vector<std::size_t> offsets(subtrees.size());
+  std::size_t total = topCount;
+  for (std::size_t s = 0; s < subtrees.size(); ++s) {
+    offsets[s] = total;
+    total += subtreeNodes[s].size() - 1;
+  }
+  nodes.resize(total);
+  aJobs.parallel_for(0, subtrees.size(), 1,
+                     [&](std::size_t aBegin, std::size_t aEnd) {
+                       for (std::size_t s = aBegin; s < aEnd; ++s) {
+                         std::vector<Node> const& local = subtreeNodes[s];
+                         auto const relocate = [&](Node aNode) {
+                           if (aNode.childCount > 0)
+                             aNode.firstChild += std::uint32_t(offsets[s] - 1);
+                           return aNode;
+                         };
+                         nodes[subtrees[s].node] = relocate(local[0]);
+                         for (std::size_t i = 1; i < local.size(); ++i)
+                           nodes[offsets[s] + i - 1] = relocate(local[i]);
+                       }
+                     });
+
+  computeMoments(nodes, 0, topCount);
+}
+
+void NBody::accumulate(std::size_t aFirstGroup, std::size_t aEndGroup) {
+  float const theta = nbodyParams.theta;
+  float const soft2 = nbodyParams.softening * nbodyParams.softening;
+  float const* const x = state.x.data();
+  float const* const y = state.y.data();
+  float const* const z = state.z.data();
+
+  InteractionList list;
+  std::uint32_t stack[kTraversalStack];
+  for (std::size_t g = aFirstGroup; g < aEndGroup; ++g) {
+    Node const& group = nodes[groups[g]];
+
+    // Bounds of the group's bodies
+    Vec3f lo{x[group.begin], y[group.begin], z[group.begin]};
+    Vec3f hi = lo;
+    for (std::uint32_t i = group.begin + 1; i < group.end; ++i) {
+      lo = {std::min(lo.x, x[i]), std::min(lo.y, y[i]), std::min(lo.z, z[i])};
+      hi = {std::max(hi.x, x[i]), std::max(hi.y, y[i]), std::max(hi.z, z[i])};
+    }
+
+    // One walk for the whole group: a cell far enough from every body in
+    // it becomes a point mass, other leaves contribute their bodies
+    list.clear();
+    std::size_t top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+      Node const& node = nodes[stack[--top]];
+
+      if (0 == node.childCount) {
+        list.add(state, node.begin, node.end);
+        continue;
+      }
+
+      // Distance from the centre of mass to the group's box; cells that
+      // hold the group are always opened
+      bool const holdsGroup =
+          node.begin <= group.begin && group.begin < node.end;
+      float const dx = std::max({lo.x - node.comX, 0.f, node.comX - hi.x});
+      float const dy = std::max({lo.y - node.comY, 0.f, node.comY - hi.y});
+      float const dz = std::max({lo.z - node.comZ, 0.f, node.comZ - hi.z});
+      float const distance2 = dx * dx + dy * dy + dz * dz;
+      if (!holdsGroup && node.size * node.size < theta * theta * distance2) {
+        list.add(node.comX, node.comY, node.comZ, node.mass);
+      } else {
+        // Last child first, so the children are visited in order
+        for (std::uint32_t c = node.childCount; c-- > 0;)
+          stack[top++] = node.firstChild + c;
+      }
+    }
+
+    for (std::uint32_t i = group.begin; i < group.end; ++i) {
+      Vec3f const p{x[i], y[i], z[i]};
+      Vec3f a{0.f, 0.f, 0.f};
+      add_accelerations_(list.x.data(), list.y.data(), list.z.data(),
+                         list.mass.data(), list.size(), p, soft2, a);
+      state.ax[i] = nbodyParams.gravity * a.x;
+      state.ay[i] = nbodyParams.gravity * a.y;
+      state.az[i] = nbodyParams.gravity * a.z;
+    }
+  }
+}
+
+void NBody::computeAccelerations(JobSystem& aJobs) {
+  haveAccelerations = true;
+  if (0 == state.size()) return;
+
+  sortBodies(aJobs);
+  buildTree(aJobs);
+
+  // Groups in Morton order, so each job walks a compact region and mostly
+  // the same cells
+  groups.clear();
+  std::uint32_t stack[kTraversalStack];
+  std::size_t top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    std::uint32_t const n = stack[--top];
+    Node const& node = nodes[n];
+    if (node.end - node.begin <= kGroupSize || 0 == node.childCount) {
+      groups.push_back(n);
+      continue;
+    }
+    for (std::uint32_t c = node.childCount; c-- > 0;)
+      stack[top++] = node.firstChild + c;
+  }
+  aJobs.parallel_for(0, groups.size(), kGroupGrain,
+                     [this](std::size_t aBegin, std::size_t aEnd) {
+                       accumulate(aBegin, aEnd);
+                     });
+}
+
+void NBody::step(JobSystem& aJobs, float dt) {
+  if (!haveAccelerations) computeAccelerations(aJobs);
+
+  float const half = 0.5f * dt;
+  auto const kick = [this, half](std::size_t aBegin, std::size_t aEnd) {
+    for (std::size_t i = aBegin; i < aEnd; ++i) {
+      state.vx[i] += state.ax[i] * half;
+      state.vy[i] += state.ay[i] * half;
+      state.vz[i] += state.az[i] * half;
+    }
+  };
+
+  aJobs.parallel_for(0, state.size(), kBodyGrain,
+                     [&](std::size_t aBegin, std::size_t aEnd) {
+                       kick(aBegin, aEnd);
+                       for (std::size_t i = aBegin; i < aEnd; ++i) {
+                         state.x[i] += state.vx[i] * dt;
+                         state.y[i] += state.vy[i] * dt;
+                         state.z[i] += state.vz[i] * dt;
+                       }
+                     });
+  computeAccelerations(aJobs);
+  aJobs.parallel_for(0, state.size(), kBodyGrain, kick);
+}
+
+Vec3f direct_acceleration(NBodyBodies const& aBodies, std::size_t aIndex,
+                          NBodyParams const& aParams) {
+  float const soft2 = aParams.softening * aParams.softening;
+  float const px = aBodies.x[aIndex], py = aBodies.y[aIndex],
+              pz = aBodies.z[aIndex];
+  // Accumulated in double, as the reference for the tree
+  double ax = 0.0, ay = 0.0, az = 0.0;
+  for (std::size_t j = 0; j < aBodies.size(); ++j) {
+    if (j == aIndex) continue;
+    double const dx = aBodies.x[j] - px, dy = aBodies.y[j] - py,
+                 dz = aBodies.z[j] - pz;
+    double const r2 = dx * dx + dy * dy + dz * dz + soft2;
+    double const s = aBodies.mass[j] / (r2 * std::sqrt(r2));
+    ax += dx * s;
+    ay += dy * s;
+    az += dz * s;
+  }
+  return Vec3f{float(aParams.gravity * ax), float(aParams.gravity * ay),
+               float(aParams.gravity * az)};
+}
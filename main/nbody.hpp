@@ -0,0 +1,122 @@
+#ifndef NBODY_HPP_93D5A7C2_4E18_4B6F_A2D9_6C0E81F3B457
+#define NBODY_HPP_93D5A7C2_4E18_4B6F_A2D9_6C0E81F3B457
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../vmlib/vec3.hpp"
+#include "job_system.hpp"
+
+// Constants of an N-body simulation, in the simulation's own units
+struct NBodyParams {
+  float gravity = 1.f;     // G
+  float theta = 0.5f;      // Barnes-Hut opening angle; 0 is exact
+  float softening = 0.01f; // keeps close encounters finite
+};
+
+// All bodies, structure of arrays. The order changes whenever the tree is
+// rebuilt; id[i] is the index add() returned for the body now at i.
+struct NBodyBodies {
+  std::vector<float> x, y, z;
+  std::vector<float> vx, vy, vz;
+  std::vector<float> ax, ay, az;
+  std::vector<float> mass;
+  std::vector<std::uint32_t> id;
+
+  std::size_t size() const { return x.size(); }
+  void resize(std::size_t aCount);
+};
+
+/* NBody: bodies under mutual gravity
+ *
+ * Accelerations come from a Barnes-Hut octree: a cell whose size seen from
+ * a body is below params().theta acts as a point mass at its centre of
+ * mass; nearer cells are opened. This costs O(N log N) rather than the
+ * O(N^2) of summing all pairs (see direct_acceleration()).
+ *
+ * The tree is rebuilt for every force evaluation. Bodies are sorted along
+ * a Morton curve so that each cell is a contiguous range of bodies and
+ * neighbouring bodies sit next to each other in memory. The sort, the
+ * subtrees below the top levels and the force pass all run as jobs.
+ *
+ * The force pass walks the tree once per group of up to 64 nearby bodies
+ * rather than once per body: cells are accepted against the group's
+ * bounding box, and the resulting list of point masses is summed for each
+ * body of the group eight masses at a time.
+ *
+ * step() is kick-drift-kick leapfrog: symplectic and time reversible, so
+ * energy errors stay bounded over long runs instead of drifting.
+ */
+class NBody {
+ public:
+  explicit NBody(NBodyParams aParams = {});
+
+  NBodyParams const& params() const { return nbodyParams; }
+  void setTheta(float aTheta) { nbodyParams.theta = aTheta; }
+
+  std::size_t size() const { return state.size(); }
+  NBodyBodies const& bodies() const { return state; }
+  std::size_t nodeCount() const { return nodes.size(); }
+
+  // Returns the body's id
+  std::uint32_t add(Vec3f aPosition, Vec3f aVelocity, float aMass);
+  void clear();
+
+  // Rebuilds the tree and sets the accelerations of all bodies
+  void computeAccelerations(JobSystem& aJobs);
+  void step(JobSystem& aJobs, float dt);
+
+ private:
+  // An octree cell; its bodies are [begin, end) in the current order
+  struct Node {
+    float comX, comY, comZ, mass;  // centre of mass
+    float size;                    // edge length of the cell
+    std::uint32_t firstChild;      // children are contiguous; 0 in leaves
+    std::uint32_t childCount;
+    std::uint32_t begin, end;
+  };
+  // A cell whose subtree is built by a job of its own
+  struct Subtree {
+    std::uint32_t node;
+    std::uint32_t level;
+  };
+
+  void sortBodies(JobSystem& aJobs);
+  void buildTree(JobSystem& aJobs);
+  // Splits cell aIndex of aNodes and its children; with aDefer, big cells
+  // at kSubtreeLevel are queued in subtrees instead
+  void buildNode(std::vector<Node>& aNodes, std::uint32_t aIndex,
+                 std::uint32_t aLevel, bool aDefer);
+  void computeMoments(std::vector<Node>& aNodes, std::size_t aFirst,
+                      std::size_t aEnd) const;
+  // Accelerations of the bodies in groups[aFirstGroup, aEndGroup)
+  void accumulate(std::size_t aFirstGroup, std::size_t aEndGroup);
+
+  NBodyParams nbodyParams;
+  NBodyBodies state;
+  bool haveAccelerations;
+
+  // Bounding cube of the bodies
+  Vec3f origin;
+  float extent;
+
+  // Morton code and index of each body, sorted; plus sort scratch
+  struct Key {
+    std::uint64_t code;
+    std::uint32_t index;
+  };
+  std::vector<Key> keys, keyScratch;
+  NBodyBodies scratch;
+
+  std::vector<Node> nodes;
+  std::vector<Subtree> subtrees;
+  std::vector<std::vector<Node>> subtreeNodes;
+  std::vector<std::uint32_t> groups;  // cells, in Morton order
+};
+
+// Acceleration of body aIndex summed over all other bodies, O(N)
+Vec3f direct_acceleration(NBodyBodies const&, std::size_t aIndex,
+                          NBodyParams const&);
+
+#endif  // NBODY_HPP_93D5A7C2_4E18_4B6F_A2D9_6C0E81F3B457
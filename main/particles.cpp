@@ -0,0 +1,262 @@
+#include "particles.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "../vmlib/affine34.hpp"
+#include "../vmlib/quat.hpp"
+
+namespace {
+// Particles per update job
+constexpr std::size_t kParticleGrain = 16384;
+// A dead particle; also the value of entries that were never used
+constexpr float kDeadFade = 2.f;
+
+// Uniform locations in particles.vert
+constexpr GLint kProjCameraWorldLocation = 0;
+constexpr GLint kCameraRightLocation = 1;
+constexpr GLint kCameraUpLocation = 2;
+constexpr GLint kParticleSizeLocation = 3;
+}  // namespace
+
+void make_exhaust_basis(Vec3f aAxis, Vec3f& aU, Vec3f& aV) {
+  Vec3f const other = std::abs(aAxis.x) < 0.9f ? Vec3f{1.f, 0.f, 0.f}
+                                               : Vec3f{0.f, 1.f, 0.f};
+  aU = normalize(cross(aAxis, other));
+  aV = cross(aAxis, aU);
+}
+
+std::size_t particles_to_emit(SceneEmitter const& aEmitter, float aThrottle,
+                              float dt, float& aCarry) {
+  float const wanted = aCarry + aEmitter.rate * aThrottle * dt;
+  float const whole = std::floor(wanted);
+  aCarry = wanted - whole;
+  return std::size_t(whole);
+}
+
+void set_particle_uniforms(Mat44f const& aCameraProjection,
+                           CameraPose const& aCamera, float aParticleSize) {
+  // Camera axes in world space
+  Quatf const cameraToWorld = conjugate(aCamera.orientation);
+  Vec3f const right = rotate(cameraToWorld, Vec3f{1.f, 0.f, 0.f});
+  Vec3f const up = rotate(cameraToWorld, Vec3f{0.f, 1.f, 0.f});
+
+  glUniformMatrix4fv(kProjCameraWorldLocation, 1, GL_TRUE,
+                     aCameraProjection.v);
+  glUniform3f(kCameraRightLocation, right.x, right.y, right.z);
+  glUniform3f(kCameraUpLocation, up.x, up.y, up.z);
+  glUniform1f(kParticleSizeLocation, aParticleSize);
+}
+
+ParticleSystem::ParticleSystem(std::size_t aCapacity, std::uint32_t aSeed)
+    : x(aCapacity),
+      y(aCapacity),
+      z(aCapacity),
+      vx(aCapacity),
+      vy(aCapacity),
+      vz(aCapacity),
+      fade(aCapacity, kDeadFade),
+      invLife(aCapacity),
+      tail(0),
+      live(0),
+      rng(aSeed) {}
+
+void ParticleSystem::clear() {
+  std::fill(fade.begin(), fade.end(), kDeadFade);
+  std::fill(carry.begin(), carry.end(), 0.f);
+  tail = 0;
+  live = 0;
+}
+
+void ParticleSystem::emit(std::span<SceneEmitter const> aEmitters,
+                          SpaceshipPose const& aPose, Vec3f aShipVelocity,
+                          float dt) {
+  carry.resize(aEmitters.size(), 0.f);
+  if (aPose.throttle <= 0.f || dt <= 0.f || 0 == capacity()) {
+    std::fill(carry.begin(), carry.end(), 0.f);
+    return;
+  }
+
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  RigidTransform const model2world = make_model2world(aPose);
+  std::size_t const cap = capacity();
+
+  for (std::size_t e = 0; e < aEmitters.size(); ++e) {
+    SceneEmitter const& emitter = aEmitters[e];
+    std::size_t const emitted =
+        particles_to_emit(emitter, aPose.throttle, dt, carry[e]);
+
+    Vec3f const origin = transform_point(model2world, emitter.offset);
+    Vec3f const axis = rotate(aPose.orientation, emitter.direction);
+    Vec3f u, v;
+    make_exhaust_basis(axis, u, v);
+    float const cosSpread = std::cos(emitter.spread);
+
+    for (std::size_t n = emitted; n > 0; --n) {
+      // Random direction in the cone around the axis
+      float const cosTheta = 1.f - unit(rng) * (1.f - cosSpread);
+      float const sinTheta =
+          std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+      float const phi = 2.f * std::numbers::pi_v<float> * unit(rng);
+      Vec3f const direction =
+          axis * cosTheta +
+          (u * std::cos(phi) + v * std::sin(phi)) * sinTheta;
+      Vec3f const velocity =
+          direction * (emitter.speed * (0.8f + 0.4f * unit(rng))) +
+          aShipVelocity;
+      float const life = emitter.life * (0.75f + 0.5f * unit(rng));
+
+      // Left the nozzle age seconds ago, from where the ship was then
+      float const age = unit(rng) * dt;
+      Vec3f const position =
+          origin - aShipVelocity * age + velocity * age;
+
+      std::size_t const i = (tail + live) % cap;
+      if (live == cap) {
+        tail = (tail + 1) % cap;  // overwrite the oldest
+      } else {
+        ++live;
+      }
+      x[i] = position.x;
+      y[i] = position.y;
+      z[i] = position.z;
+      vx[i] = velocity.x;
+      vy[i] = velocity.y;
+      vz[i] = velocity.z;
+      invLife[i] = 1.f / life;
+      fade[i] = age * invLife[i];
+    }
+  }
+}
+
+void ParticleSystem::integrate(std::size_t aBegin, std::size_t aEnd, float dt,
+                               float aDamping) {
+  float const gravityStep = kParticleGravity * dt;
+  std::size_t i = aBegin;
+
+#if defined(__AVX__)
+  // Eight particles at a time; same arithmetic as the loop below
+  __m256 const vDt = _mm256_set1_ps(dt);
+  __m256 const damping = _mm256_set1_ps(aDamping);
+  __m256 const gravity = _mm256_set1_ps(gravityStep);
+  for (; i + 8 <= aEnd; i += 8) {
+    __m256 const velX = _mm256_mul_ps(_mm256_loadu_ps(&vx[i]), damping);
+    __m256 const velY = _mm256_add_ps(
+        _mm256_mul_ps(_mm256_loadu_ps(&vy[i]), damping), gravity);
+    __m256 const velZ = _mm256_mul_ps(_mm256_loadu_ps(&vz[i]), damping);
+    _mm256_storeu_ps(&vx[i], velX);
+    _mm256_storeu_ps(&vy[i], velY);
+    _mm256_storeu_ps(&vz[i], velZ);
+
+    _mm256_storeu_ps(&x[i], _mm256_add_ps(_mm256_loadu_ps(&x[i]),
+                                          _mm256_mul_ps(velX, vDt)));
+    _mm256_storeu_ps(&y[i], _mm256_add_ps(_mm256_loadu_ps(&y[i]),
+                                          _mm256_mul_ps(velY, vDt)));
+    _mm256_storeu_ps(&z[i], _mm256_add_ps(_mm256_loadu_ps(&z[i]),
+                                          _mm256_mul_ps(velZ, vDt)));
+    _mm256_storeu_ps(
+        &fade[i],
+        _mm256_add_ps(_mm256_loadu_ps(&fade[i]),
+                      _mm256_mul_ps(_mm256_loadu_ps(&invLife[i]), vDt)));
+  }
+#endif
+
+  for (; i < aEnd; ++i) {
+    vx[i] = vx[i] * aDamping;
+    vy[i] = vy[i] * aDamping + gravityStep;
+    vz[i] = vz[i] * aDamping;
+    x[i] += vx[i] * dt;
+    y[i] += vy[i] * dt;
+    z[i] += vz[i] * dt;
+    fade[i] += invLife[i] * dt;
+  }
+}
+
+void ParticleSystem::update(JobSystem& aJobs, float dt) {
+  if (0 == live) return;
+
+  // Exact decay of the velocity for any dt, rather than 1 - drag * dt
+  float const damping = std::exp(-kParticleDrag * dt);
+  auto const step = [this, dt, damping](std::size_t aBegin,
+                                        std::size_t aEnd) {
+    integrate(aBegin, aEnd, dt, damping);
+  };
+
+  // The live range, as at most two runs of the ring
+  std::size_t const firstRun = std::min(live, capacity() - tail);
+  aJobs.parallel_for(tail, tail + firstRun, kParticleGrain, step);
+  aJobs.parallel_for(0, live - firstRun, kParticleGrain, step);
+
+  while (live > 0 && fade[tail] >= 1.f) {
+    tail = (tail + 1) % capacity();
+    --live;
+  }
+}
+
+ParticleRenderer::ParticleRenderer(std::size_t aCapacity)
+    : vao(0), vbo(0), capacity(aCapacity), first(0), count(0) {
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
+  // x, y, z and fade, one after the other, capacity floats each
+  glGenBuffers(1, &vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, 4 * capacity * sizeof(float), nullptr,
+               GL_STREAM_DRAW);
+  for (GLuint index = 0; index < 4; ++index) {
+    glVertexAttribPointer(index, 1, GL_FLOAT, GL_FALSE, sizeof(float),
+                          reinterpret_cast<void const*>(
+                              std::size_t(index) * capacity * sizeof(float)));
+    glVertexAttribDivisor(index, 1);
+    glEnableVertexAttribArray(index);
+  }
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+ParticleRenderer::~ParticleRenderer() {
+  glDeleteBuffers(1, &vbo);
+  glDeleteVertexArrays(1, &vao);
+}
+
+void ParticleRenderer::update(ParticleSystem const& aParticles) {
+  if (aParticles.wrapped()) {
+    first = 0;
+    count = aParticles.capacity();
+  } else {
+    first = aParticles.oldest();
+    count = aParticles.count();
+  }
+  if (0 == count) return;
+
+  // Orphan the previous contents rather than waiting for the GPU to finish
+  // with them. Only the drawn range is filled; draw() reads nothing else.
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, 4 * capacity * sizeof(float), nullptr,
+               GL_STREAM_DRAW);
+  std::span<float const> const arrays[4] = {
+      aParticles.positionsX(), aParticles.positionsY(),
+      aParticles.positionsZ(), aParticles.fades()};
+  for (std::size_t k = 0; k < 4; ++k) {
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    GLintptr((k * capacity + first) * sizeof(float)),
+                    GLsizeiptr(count * sizeof(float)),
+                    arrays[k].data() + first);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleRenderer::draw() const {
+  if (0 == count) return;
+
+  glBindVertexArray(vao);
+  glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, GLsizei(count),
+                                    GLuint(first));
+  glBindVertexArray(0);
+}
@@ -0,0 +1,126 @@
+#ifndef PARTICLES_HPP_6A2E9F14_3B7C_4D85_A0C1_E58B27D4F9C3
+#define PARTICLES_HPP_6A2E9F14_3B7C_4D85_A0C1_E58B27D4F9C3
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/vec3.hpp"
+#include "camera.hpp"
+#include "job_system.hpp"
+#include "scene_file.hpp"
+#include "spaceship.hpp"
+
+// Particles alive at once before the oldest are overwritten
+constexpr std::size_t kMaxParticles = std::size_t(1) << 20;
+
+// Exhaust slows down in the air and sinks slowly, in world units. Shared
+// with the compute shaders (see GpuParticleSystem).
+constexpr float kParticleDrag = 1.5f;  // per second
+constexpr float kParticleGravity = -0.3f;
+
+// Particles to emit this frame from an emitter, keeping the fraction left
+// over in aCarry
+std::size_t particles_to_emit(SceneEmitter const&, float aThrottle, float dt,
+                              float& aCarry);
+
+// Two unit vectors perpendicular to an emitter's world space axis and to
+// each other; exhaust leaves in a cone around the axis
+void make_exhaust_basis(Vec3f aAxis, Vec3f& aU, Vec3f& aV);
+
+// Camera uniforms of particles.vert; the program must be in use
+void set_particle_uniforms(Mat44f const& aCameraProjection,
+                           CameraPose const& aCamera, float aParticleSize);
+
+/* ParticleSystem: engine exhaust
+ *
+ * Particles are kept as structure of arrays in a ring of fixed capacity:
+ * the live ones are the count() entries from oldest(), wrapping around.
+ * emit() writes new particles after the newest, overwriting the oldest when
+ * the ring is full, so nothing is allocated after construction.
+ *
+ * update() integrates all live particles in one SIMD loop split across the
+ * job system's workers. A particle's age is kept as fade, the fraction of
+ * its life that has passed; particles with fade >= 1 are dead. Dead
+ * particles are retired from the oldest end; one that dies before an older
+ * one stays in the ring, dead, until that one is retired too. Entries
+ * outside the live range are always dead.
+ */
+class ParticleSystem {
+ public:
+  explicit ParticleSystem(std::size_t aCapacity, std::uint32_t aSeed = 1);
+
+  std::size_t capacity() const { return fade.size(); }
+  std::size_t count() const { return live; }
+  std::size_t oldest() const { return tail; }
+  bool wrapped() const { return tail + live > capacity(); }
+
+  // Emits dt's worth of particles from each emitter on the ship, spread
+  // over the last dt seconds of the ship's motion
+  void emit(std::span<SceneEmitter const> aEmitters,
+            SpaceshipPose const& aPose, Vec3f aShipVelocity, float dt);
+  void update(JobSystem& aJobs, float dt);
+  void clear();
+
+  // capacity() entries each
+  std::span<float const> positionsX() const { return x; }
+  std::span<float const> positionsY() const { return y; }
+  std::span<float const> positionsZ() const { return z; }
+  std::span<float const> fades() const { return fade; }
+
+ private:
+  void integrate(std::size_t aBegin, std::size_t aEnd, float dt,
+                 float aDamping);
+
+  std::vector<float> x, y, z;
+  std::vector<float> vx, vy, vz;
+  std::vector<float> fade;
+  std::vector<float> invLife;  // 1 / lifetime in seconds
+
+  std::size_t tail;  // oldest live particle
+  std::size_t live;
+
+  // Fractional particles left over from earlier frames, per emitter
+  std::vector<float> carry;
+  std::minstd_rand rng;
+};
+
+/* ParticleRenderer: draws a ParticleSystem as camera-facing quads
+ *
+ * The position and fade arrays are copied as they are into one buffer and
+ * read as per-instance attributes 0-3, so all particles are drawn with one
+ * instanced call. When the ring has wrapped, the whole ring is drawn; the
+ * dead entries in it collapse to nothing in the vertex shader.
+ *
+ * Draw with particles.vert and particles.frag, additive blending and depth
+ * writes off.
+ */
+class ParticleRenderer {
+ public:
+  explicit ParticleRenderer(std::size_t aCapacity);
+  ~ParticleRenderer();
+
+  ParticleRenderer(ParticleRenderer const&) = delete;
+  ParticleRenderer& operator=(ParticleRenderer const&) = delete;
+
+  // Uploads the live particles; once per frame
+  void update(ParticleSystem const&);
+  // Call set_particle_uniforms() first
+  void draw() const;
+
+ private:
+  GLuint vao;
+  GLuint vbo;
+  std::size_t capacity;
+
+  // Instances drawn by draw()
+  std::size_t first;
+  std::size_t count;
+};
+
+#endif  // PARTICLES_HPP_6A2E9F14_3B7C_4D85_A0C1_E58B27D4F9C3
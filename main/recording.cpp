@@ -0,0 +1,270 @@
+#include "recording.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "../support/error.hpp"
+
+namespace {
+constexpr char kRecordingMagic[4] = {'S', 'R', 'E', 'C'};
+constexpr char kKeyframeMagic[4] = {'K', 'E', 'Y', 'F'};
+constexpr std::uint32_t kRecordingVersion = 1;
+
+// A varint holds 7 bits per byte
+constexpr std::size_t kMaxVarint = 5;
+
+// Every tick must fit one reserve() of the file
+constexpr std::size_t kMaxChannels =
+    MappedAppendFile::kMaxAppend / kMaxVarint;
+
+std::int32_t quantise_(float aValue, float aInvStep) {
+  double const scaled = std::nearbyint(double(aValue) * aInvStep);
+  if (!(scaled == scaled)) return 0;  // NaN
+  return std::int32_t(std::clamp(scaled, -2147483647.0, 2147483647.0));
+}
+
+// Deltas wrap around, so any pair of int32 differ by one; small ones of
+// either sign become small unsigned numbers
+std::uint32_t zigzag_(std::uint32_t aDelta) {
+  return (aDelta << 1) ^ (0u - (aDelta >> 31));
+}
+std::uint32_t unzigzag_(std::uint32_t aValue) {
+  return (aValue >> 1) ^ (0u - (aValue & 1u));
+}
+
+template <typename T>
+T load_(std::byte const* aBytes) {
+  T value;
+  std::memcpy(&value, aBytes, sizeof(T));
+  return value;
+}
+}  // namespace
+
+RecordingWriter::RecordingWriter(char const* aPath,
+                                 std::span<float const> aSteps,
+                                 std::uint32_t aKeyframeInterval)
+    : keyframeInterval(std::max(aKeyframeInterval, 1u)),
+      previous(aSteps.size(), 0) {
+  if (aSteps.empty() || aSteps.size() > kMaxChannels)
+    throw Error("Unable to record %zu channels to '%s'", aSteps.size(),
+                aPath);
+  for (float step : aSteps) {
+    if (!(step > 0.f))
+      throw Error("Recording '%s': quantisation steps must be positive",
+                  aPath);
+    invSteps.push_back(1.f / step);
+  }
+
+  file = MappedAppendFile(aPath);
+  RecordingHeader header{};
+  std::memcpy(header.magic, kRecordingMagic, sizeof(header.magic));
+  header.version = kRecordingVersion;
+  header.channels = std::uint32_t(aSteps.size());
+  header.keyframeInterval = keyframeInterval;
+  file.append(&header, sizeof(header));
+  file.append(aSteps.data(), aSteps.size_bytes());
+}
+
+RecordingWriter::~RecordingWriter() {
+  try {
+    close();
+  } catch (Error const&) {
+    // Readers recover the ticks up to the last keyframe
+  }
+}
+
+void RecordingWriter::append(std::span<float const> aValues) {
+  std::size_t const channels = invSteps.size();
+  if (aValues.size() != channels)
+    throw Error("Recording %zu values, not %zu", aValues.size(), channels);
+
+  if (0 == ticks % keyframeInterval) {
+    keyframes.push_back(file.size());
+    std::byte* const start = file.reserve(sizeof(kKeyframeMagic) +
+                                          channels * sizeof(std::int32_t));
+    std::byte* out = start + sizeof(kKeyframeMagic);
+    for (std::size_t c = 0; c < channels; ++c) {
+      previous[c] = quantise_(aValues[c], invSteps[c]);
+      std::memcpy(out, &previous[c], sizeof(std::int32_t));
+      out += sizeof(std::int32_t);
+    }
+    // The marker goes in last, so a keyframe cut short by a crash has none
+    // and readers do not take the zeros after it for its values
+    std::atomic_signal_fence(std::memory_order_release);
+    std::memcpy(start, kKeyframeMagic, sizeof(kKeyframeMagic));
+    file.commit(sizeof(kKeyframeMagic) + channels * sizeof(std::int32_t));
+  } else {
+    std::byte* const start = file.reserve(channels * kMaxVarint);
+    std::byte* out = start;
+    for (std::size_t c = 0; c < channels; ++c) {
+      std::int32_t const q = quantise_(aValues[c], invSteps[c]);
+      std::uint32_t v =
+          zigzag_(std::uint32_t(q) - std::uint32_t(previous[c]));
+      previous[c] = q;
+      while (v >= 0x80u) {
+        *out++ = std::byte(v | 0x80u);
+        v >>= 7;
+      }
+      *out++ = std::byte(v);
+    }
+    file.commit(std::size_t(out - start));
+  }
+  ++ticks;
+}
+
+void RecordingWriter::close() {
+  if (!file.isOpen()) return;
+
+  RecordingTrailer trailer{};
+  trailer.keyframes = file.size();
+  trailer.ticks = ticks;
+  std::memcpy(trailer.magic, kRecordingMagic, sizeof(trailer.magic));
+  file.append(keyframes.data(), keyframes.size() * sizeof(std::uint64_t));
+  file.append(&trailer, sizeof(trailer));
+  file.close();
+}
+
+RecordingReader::RecordingReader(char const* aPath)
+    : path(aPath), file(aPath), bytes(file.bytes()) {
+  if (bytes.size() < sizeof(RecordingHeader))
+    throw Error("'%s' is not a recording", aPath);
+  auto const header = load_<RecordingHeader>(bytes.data());
+  if (0 != std::memcmp(header.magic, kRecordingMagic,
+                       sizeof(kRecordingMagic)) ||
+      kRecordingVersion != header.version || 0 == header.channels ||
+      header.channels > kMaxChannels || 0 == header.keyframeInterval) {
+    throw Error("'%s' is not a version %u recording", aPath,
+                kRecordingVersion);
+  }
+
+  std::size_t const start =
+      sizeof(RecordingHeader) + header.channels * sizeof(float);
+  if (bytes.size() < start) throw Error("Recording '%s' is truncated", aPath);
+  keyframeInterval = header.keyframeInterval;
+  steps.resize(header.channels);
+  std::memcpy(steps.data(), bytes.data() + sizeof(RecordingHeader),
+              header.channels * sizeof(float));
+  quantised.resize(header.channels);
+  decoded.resize(header.channels);
+
+  // A closed recording ends with its keyframe table
+  if (bytes.size() >= start + sizeof(RecordingTrailer)) {
+    auto const trailer = load_<RecordingTrailer>(
+        bytes.data() + bytes.size() - sizeof(RecordingTrailer));
+    std::uint64_t const count =
+        (trailer.ticks + keyframeInterval - 1) / keyframeInterval;
+    if (0 == std::memcmp(trailer.magic, kRecordingMagic,
+                         sizeof(kRecordingMagic)) &&
+        trailer.keyframes >= start && trailer.keyframes <= bytes.size() &&
+        count <= (bytes.size() - trailer.keyframes) / sizeof(std::uint64_t) &&
+        trailer.keyframes + count * sizeof(std::uint64_t) +
+                sizeof(RecordingTrailer) ==
+            bytes.size()) {
+      end = std::size_t(trailer.keyframes);
+      keyframes.resize(std::size_t(count));
+      std::memcpy(keyframes.data(), bytes.data() + end,
+                  keyframes.size() * sizeof(std::uint64_t));
+      bool const ordered = std::is_sorted(keyframes.begin(), keyframes.end());
+      if (!ordered || (!keyframes.empty() &&
+                       (keyframes.front() < start || keyframes.back() >= end)))
+        throw Error("Recording '%s' has a corrupt keyframe table", aPath);
+      ticks = trailer.ticks;
+      return;
+    }
+  }
+
+  end = bytes.size();
+  scanKeyframes(start);
+}
+
+void RecordingReader::seek(std::uint64_t aTick) {
+  if (aTick >= ticks)
+    throw Error("Recording '%s' has %llu ticks, not %llu", path.c_str(),
+                static_cast<unsigned long long>(ticks),
+                static_cast<unsigned long long>(aTick + 1));
+  if (aTick == current) return;
+
+  // Decode on from the current tick if it is in the same group and before
+  // aTick, otherwise from the group's keyframe
+  if (kNoTick == current || aTick < current ||
+      aTick / keyframeInterval != current / keyframeInterval) {
+    std::uint64_t const group = aTick / keyframeInterval;
+    cursor = std::size_t(keyframes[std::size_t(group)]);
+    current = group * keyframeInterval;
+    if (!readKeyframe(cursor)) {
+      current = kNoTick;
+      throw Error("Recording '%s' is corrupt at tick %llu", path.c_str(),
+                  static_cast<unsigned long long>(group * keyframeInterval));
+    }
+  }
+  while (current < aTick) {
+    if (!readDelta(cursor)) {
+      std::uint64_t const bad = current + 1;
+      current = kNoTick;
+      throw Error("Recording '%s' is corrupt at tick %llu", path.c_str(),
+                  static_cast<unsigned long long>(bad));
+    }
+    ++current;
+  }
+
+  for (std::size_t c = 0; c < steps.size(); ++c)
+    decoded[c] = float(double(quantised[c]) * steps[c]);
+}
+
+bool RecordingReader::next() {
+  std::uint64_t const tick = kNoTick == current ? 0 : current + 1;
+  if (tick >= ticks) return false;
+  seek(tick);
+  return true;
+}
+
+void RecordingReader::scanKeyframes(std::size_t aStart) {
+  // The rest of the file after a crash is zeros, which read as deltas of
+  // nothing, so only complete keyframes count
+  std::size_t at = aStart;
+  for (std::uint64_t tick = 0;; ++tick) {
+    if (0 == tick % keyframeInterval) {
+      std::size_t const keyframe = at;
+      if (!readKeyframe(at)) break;
+      keyframes.push_back(keyframe);
+    } else if (!readDelta(at)) {
+      break;
+    }
+  }
+  ticks = keyframes.empty()
+              ? 0
+              : (keyframes.size() - 1) * std::uint64_t(keyframeInterval) + 1;
+}
+
+bool RecordingReader::readKeyframe(std::size_t& aCursor) {
+  std::size_t const size =
+      sizeof(kKeyframeMagic) + steps.size() * sizeof(std::int32_t);
+  if (end - aCursor < size ||
+      0 != std::memcmp(bytes.data() + aCursor, kKeyframeMagic,
+                       sizeof(kKeyframeMagic)))
+    return false;
+
+  std::memcpy(quantised.data(), bytes.data() + aCursor + sizeof(kKeyframeMagic),
+              steps.size() * sizeof(std::int32_t));
+  aCursor += size;
+  return true;
+}
+
+bool RecordingReader::readDelta(std::size_t& aCursor) {
+  std::byte const* in = bytes.data() + aCursor;
+  std::byte const* const last = bytes.data() + end;
+  for (std::size_t c = 0; c < steps.size(); ++c) {
+    std::uint32_t v = 0;
+    for (unsigned shift = 0;; shift += 7) {
+      if (in == last || shift >= 7 * kMaxVarint) return false;
+      std::uint32_t const byte = std::to_integer<std::uint32_t>(*in++);
+      v |= (byte & 0x7fu) << shift;
+      if (byte < 0x80u) break;
+    }
+    quantised[c] = std::int32_t(std::uint32_t(quantised[c]) + unzigzag_(v));
+  }
+  aCursor = std::size_t(in - bytes.data());
+  return true;
+}
@@ -0,0 +1,133 @@
+#ifndef RECORDING_HPP_9E41B7C3_0D6A_4F28_A5C9_73B2E8D014F6
+#define RECORDING_HPP_9E41B7C3_0D6A_4F28_A5C9_73B2E8D014F6
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+// Ticks from one keyframe to the next: at most this many minus one deltas
+// are decoded per seek
+constexpr std::uint32_t kRecordingKeyframeInterval = 120;
+
+/* Recording file (*.rec)
+ *
+ *   RecordingHeader
+ *   float steps[channels]            quantisation step of each channel
+ *   ticks                            one after the other
+ *   std::uint64_t keyframes[]        byte offset of every keyframe
+ *   RecordingTrailer
+ *
+ * Every tick records the same number of float channels, stored as whole
+ * multiples of their channel's step. Every keyframeInterval-th tick,
+ * starting with the first, is a keyframe: the marker "KEYF" followed by
+ * the multiples as int32. The ticks in between hold the change from the
+ * tick before in each channel as zigzag varints, mostly one or two bytes.
+ * Deltas are between the stored multiples, so decoding is exact: seeking
+ * to a tick gives the same values as playing up to it.
+ *
+ * The keyframe table and the trailer are written when the recording is
+ * closed. A file without them, e.g. after a crash, is read up to its last
+ * keyframe. Written in the host's byte order.
+ */
+struct RecordingHeader {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t channels;
+  std::uint32_t keyframeInterval;
+};
+
+struct RecordingTrailer {
+  std::uint64_t keyframes;  // offset of the keyframe table
+  std::uint64_t ticks;
+  char magic[4];
+  std::uint32_t reserved;
+};
+
+static_assert(sizeof(RecordingHeader) == 16);
+static_assert(sizeof(RecordingTrailer) == 24);
+
+/* RecordingWriter: appends ticks to a new recording file
+ *
+ * The file is written through a MappedAppendFile, so memory stays bounded
+ * by one window of it plus the keyframe table, 8 bytes per keyframe.
+ */
+class RecordingWriter {
+ public:
+  // One channel per step; throws Error
+  RecordingWriter(char const* aPath, std::span<float const> aSteps,
+                  std::uint32_t aKeyframeInterval = kRecordingKeyframeInterval);
+  ~RecordingWriter();
+
+  std::uint64_t tickCount() const { return ticks; }
+  std::uint64_t byteCount() const { return file.size(); }
+
+  // One value per channel; throws Error
+  void append(std::span<float const> aValues);
+  // Writes the keyframe table and trailer; throws Error
+  void close();
+
+ private:
+  MappedAppendFile file;
+  std::vector<float> invSteps;
+  std::uint32_t keyframeInterval;
+  std::uint64_t ticks = 0;
+  std::vector<std::int32_t> previous;
+  std::vector<std::uint64_t> keyframes;
+};
+
+/* RecordingReader: plays a recording file, or seeks to any tick in it
+ *
+ * The file is mapped (see MappedFile). seek() decodes from the keyframe at
+ * or before the tick, or on from the current tick when that is nearer, so
+ * stepping forwards costs a delta per tick.
+ */
+class RecordingReader {
+ public:
+  explicit RecordingReader(char const* aPath);  // throws Error
+
+  std::size_t channelCount() const { return steps.size(); }
+  std::uint64_t tickCount() const { return ticks; }
+  std::uint32_t getKeyframeInterval() const { return keyframeInterval; }
+
+  // The tick decoded last and its values; none before the first seek()
+  std::uint64_t tick() const { return current; }
+  std::span<float const> values() const { return decoded; }
+
+  // aTick < tickCount(); throws Error if the file is damaged
+  void seek(std::uint64_t aTick);
+  // seek(tick() + 1); false at the end
+  bool next();
+
+ private:
+  static constexpr std::uint64_t kNoTick =
+      std::numeric_limits<std::uint64_t>::max();
+
+  // Without a keyframe table, finds the keyframes by decoding every tick
+  // from aStart
+  void scanKeyframes(std::size_t aStart);
+  // Decode one tick into quantised; false if it runs past the ticks or is
+  // not what it should be
+  bool readKeyframe(std::size_t& aCursor);
+  bool readDelta(std::size_t& aCursor);
+
+  std::string path;
+  MappedFile file;
+  std::span<std::byte const> bytes;
+  std::size_t end = 0;  // where the ticks end
+  std::uint32_t keyframeInterval = 1;
+  std::vector<float> steps;
+  std::vector<std::uint64_t> keyframes;
+  std::uint64_t ticks = 0;
+
+  std::uint64_t current = kNoTick;
+  std::size_t cursor = 0;  // where tick current + 1 starts
+  std::vector<std::int32_t> quantised;
+  std::vector<float> decoded;
+};
+
+#endif  // RECORDING_HPP_9E41B7C3_0D6A_4F28_A5C9_73B2E8D014F6
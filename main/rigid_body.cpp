@@ -0,0 +1,281 @@
+#include "rigid_body.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace {
+// Bodies per integration job
+constexpr std::size_t kBodyGrain = 4096;
+
+// Every per-body array
+constexpr std::vector<float> RigidBodies::*kFields_[] = {
+    &RigidBodies::x,  &RigidBodies::y,  &RigidBodies::z,
+    &RigidBodies::vx, &RigidBodies::vy, &RigidBodies::vz,
+    &RigidBodies::qx, &RigidBodies::qy, &RigidBodies::qz, &RigidBodies::qw,
+    &RigidBodies::wx, &RigidBodies::wy, &RigidBodies::wz,
+    &RigidBodies::invMass,
+    &RigidBodies::ix, &RigidBodies::iy, &RigidBodies::iz,
+    &RigidBodies::thrust,
+    &RigidBodies::tx, &RigidBodies::ty, &RigidBodies::tz};
+}  // namespace
+
+std::size_t RigidBodies::add(float aMass, Vec3f aMoments, Vec3f aPosition,
+                             Quatf aOrientation) {
+  std::size_t const index = size();
+  x.push_back(aPosition.x);
+  y.push_back(aPosition.y);
+  z.push_back(aPosition.z);
+  for (auto* v : {&vx, &vy, &vz, &wx, &wy, &wz, &thrust, &tx, &ty, &tz})
+    v->push_back(0.f);
+  qx.push_back(aOrientation.x);
+  qy.push_back(aOrientation.y);
+  qz.push_back(aOrientation.z);
+  qw.push_back(aOrientation.w);
+  invMass.push_back(1.f / aMass);
+  ix.push_back(aMoments.x);
+  iy.push_back(aMoments.y);
+  iz.push_back(aMoments.z);
+  return index;
+}
+
+void RigidBodies::clear() {
+  for (auto* v : {&x, &y, &z, &vx, &vy, &vz, &qx, &qy, &qz, &qw, &wx, &wy,
+                  &wz, &invMass, &ix, &iy, &iz, &thrust, &tx, &ty, &tz})
+    v->clear();
+}
+
+void RigidBodies::resize(std::size_t aCount) {
+  for (auto field : kFields_) (this->*field).resize(aCount);
+}
+
+void RigidBodies::copy(std::size_t aIndex, RigidBodies const& aBodies,
+                       std::size_t aFrom) {
+  for (auto field : kFields_) (this->*field)[aIndex] = (aBodies.*field)[aFrom];
+}
+
+Vec3f make_cylinder_moments(float aMass, float aRadius, float aHeight) {
+  float const across =
+      aMass * (3.f * aRadius * aRadius + aHeight * aHeight) / 12.f;
+  return Vec3f{across, 0.5f * aMass * aRadius * aRadius, across};
+}
+
+void integrate_rigid_bodies(RigidBodies& aBodies, Vec3f aGravity, float dt,
+                            std::size_t aBegin, std::size_t aEnd) {
+  RigidBodies& b = aBodies;
+  float const halfDt = 0.5f * dt;
+  float const gx = aGravity.x * dt;
+  float const gy = aGravity.y * dt;
+  float const gz = aGravity.z * dt;
+  std::size_t i = aBegin;
+
+#if defined(__AVX__)
+  // Eight bodies at a time; same arithmetic as the loop below
+  __m256 const one = _mm256_set1_ps(1.f);
+  __m256 const two = _mm256_set1_ps(2.f);
+  __m256 const vDt = _mm256_set1_ps(dt);
+  __m256 const vHalfDt = _mm256_set1_ps(halfDt);
+  __m256 const gravityX = _mm256_set1_ps(gx);
+  __m256 const gravityY = _mm256_set1_ps(gy);
+  __m256 const gravityZ = _mm256_set1_ps(gz);
+  for (; i + 8 <= aEnd; i += 8) {
+    __m256 const qx = _mm256_loadu_ps(&b.qx[i]);
+    __m256 const qy = _mm256_loadu_ps(&b.qy[i]);
+    __m256 const qz = _mm256_loadu_ps(&b.qz[i]);
+    __m256 const qw = _mm256_loadu_ps(&b.qw[i]);
+
+    // Linear
+    __m256 const ux = _mm256_mul_ps(
+        two, _mm256_sub_ps(_mm256_mul_ps(qx, qy), _mm256_mul_ps(qw, qz)));
+    __m256 const uy = _mm256_sub_ps(
+        one, _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(qx, qx),
+                                              _mm256_mul_ps(qz, qz))));
+    __m256 const uz = _mm256_mul_ps(
+        two, _mm256_add_ps(_mm256_mul_ps(qy, qz), _mm256_mul_ps(qw, qx)));
+    __m256 const kick = _mm256_mul_ps(
+        _mm256_mul_ps(_mm256_loadu_ps(&b.thrust[i]),
+                      _mm256_loadu_ps(&b.invMass[i])),
+        vDt);
+    __m256 const vx = _mm256_add_ps(
+        _mm256_add_ps(_mm256_loadu_ps(&b.vx[i]), _mm256_mul_ps(ux, kick)),
+        gravityX);
+    __m256 const vy = _mm256_add_ps(
+        _mm256_add_ps(_mm256_loadu_ps(&b.vy[i]), _mm256_mul_ps(uy, kick)),
+        gravityY);
+    __m256 const vz = _mm256_add_ps(
+        _mm256_add_ps(_mm256_loadu_ps(&b.vz[i]), _mm256_mul_ps(uz, kick)),
+        gravityZ);
+    _mm256_storeu_ps(&b.vx[i], vx);
+    _mm256_storeu_ps(&b.vy[i], vy);
+    _mm256_storeu_ps(&b.vz[i], vz);
+    _mm256_storeu_ps(&b.x[i], _mm256_add_ps(_mm256_loadu_ps(&b.x[i]),
+                                            _mm256_mul_ps(vx, vDt)));
+    _mm256_storeu_ps(&b.y[i], _mm256_add_ps(_mm256_loadu_ps(&b.y[i]),
+                                            _mm256_mul_ps(vy, vDt)));
+    _mm256_storeu_ps(&b.z[i], _mm256_add_ps(_mm256_loadu_ps(&b.z[i]),
+                                            _mm256_mul_ps(vz, vDt)));
+
+    // Angular
+    __m256 wx = _mm256_loadu_ps(&b.wx[i]);
+    __m256 wy = _mm256_loadu_ps(&b.wy[i]);
+    __m256 wz = _mm256_loadu_ps(&b.wz[i]);
+    __m256 const ix = _mm256_loadu_ps(&b.ix[i]);
+    __m256 const iy = _mm256_loadu_ps(&b.iy[i]);
+    __m256 const iz = _mm256_loadu_ps(&b.iz[i]);
+    __m256 const lx = _mm256_mul_ps(ix, wx);
+    __m256 const ly = _mm256_mul_ps(iy, wy);
+    __m256 const lz = _mm256_mul_ps(iz, wz);
+    __m256 const cx =
+        _mm256_sub_ps(_mm256_mul_ps(wy, lz), _mm256_mul_ps(wz, ly));
+    __m256 const cy =
+        _mm256_sub_ps(_mm256_mul_ps(wz, lx), _mm256_mul_ps(wx, lz));
+    __m256 const cz =
+        _mm256_sub_ps(_mm256_mul_ps(wx, ly), _mm256_mul_ps(wy, lx));
+    wx = _mm256_add_ps(
+        wx, _mm256_mul_ps(
+                _mm256_div_ps(
+                    _mm256_sub_ps(_mm256_loadu_ps(&b.tx[i]), cx), ix),
+                vDt));
+    wy = _mm256_add_ps(
+        wy, _mm256_mul_ps(
+                _mm256_div_ps(
+                    _mm256_sub_ps(_mm256_loadu_ps(&b.ty[i]), cy), iy),
+                vDt));
+    wz = _mm256_add_ps(
+        wz, _mm256_mul_ps(
+                _mm256_div_ps(
+                    _mm256_sub_ps(_mm256_loadu_ps(&b.tz[i]), cz), iz),
+                vDt));
+    _mm256_storeu_ps(&b.wx[i], wx);
+    _mm256_storeu_ps(&b.wy[i], wy);
+    _mm256_storeu_ps(&b.wz[i], wz);
+
+    __m256 const nx = _mm256_add_ps(
+        qx, _mm256_mul_ps(
+                vHalfDt,
+                _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(qw, wx),
+                                            _mm256_mul_ps(qy, wz)),
+                              _mm256_mul_ps(qz, wy))));
+    __m256 const ny = _mm256_add_ps(
+        qy, _mm256_mul_ps(
+                vHalfDt,
+                _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(qw, wy),
+                                            _mm256_mul_ps(qz, wx)),
+                              _mm256_mul_ps(qx, wz))));
+    __m256 const nz = _mm256_add_ps(
+        qz, _mm256_mul_ps(
+                vHalfDt,
+                _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(qw, wz),
+                                            _mm256_mul_ps(qx, wy)),
+                              _mm256_mul_ps(qy, wx))));
+    __m256 const nw = _mm256_sub_ps(
+        qw, _mm256_mul_ps(
+                vHalfDt,
+                _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(qx, wx),
+                                            _mm256_mul_ps(qy, wy)),
+                              _mm256_mul_ps(qz, wz))));
+    __m256 const length = _mm256_sqrt_ps(_mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)),
+        _mm256_add_ps(_mm256_mul_ps(nz, nz), _mm256_mul_ps(nw, nw))));
+    __m256 const inv = _mm256_div_ps(one, length);
+    _mm256_storeu_ps(&b.qx[i], _mm256_mul_ps(nx, inv));
+    _mm256_storeu_ps(&b.qy[i], _mm256_mul_ps(ny, inv));
+    _mm256_storeu_ps(&b.qz[i], _mm256_mul_ps(nz, inv));
+    _mm256_storeu_ps(&b.qw[i], _mm256_mul_ps(nw, inv));
+  }
+#endif
+
+  for (; i < aEnd; ++i) {
+    float const qx = b.qx[i];
+    float const qy = b.qy[i];
+    float const qz = b.qz[i];
+    float const qw = b.qw[i];
+
+    // Linear: thrust along the body's +Y axis in world space, plus gravity
+    float const ux = 2.f * (qx * qy - qw * qz);
+    float const uy = 1.f - 2.f * (qx * qx + qz * qz);
+    float const uz = 2.f * (qy * qz + qw * qx);
+    float const kick = b.thrust[i] * b.invMass[i] * dt;
+    b.vx[i] = b.vx[i] + ux * kick + gx;
+    b.vy[i] = b.vy[i] + uy * kick + gy;
+    b.vz[i] = b.vz[i] + uz * kick + gz;
+    b.x[i] += b.vx[i] * dt;
+    b.y[i] += b.vy[i] * dt;
+    b.z[i] += b.vz[i] * dt;
+
+    // Angular: Euler's equations, I dw/dt = torque - w x (I w)
+    float wx = b.wx[i];
+    float wy = b.wy[i];
+    float wz = b.wz[i];
+    float const lx = b.ix[i] * wx;
+    float const ly = b.iy[i] * wy;
+    float const lz = b.iz[i] * wz;
+    float const cx = wy * lz - wz * ly;
+    float const cy = wz * lx - wx * lz;
+    float const cz = wx * ly - wy * lx;
+    wx = wx + (b.tx[i] - cx) / b.ix[i] * dt;
+    wy = wy + (b.ty[i] - cy) / b.iy[i] * dt;
+    wz = wz + (b.tz[i] - cz) / b.iz[i] * dt;
+    b.wx[i] = wx;
+    b.wy[i] = wy;
+    b.wz[i] = wz;
+
+    // dq/dt = q (0, w) / 2, with w in body space
+    float const nx = qx + halfDt * (qw * wx + qy * wz - qz * wy);
+    float const ny = qy + halfDt * (qw * wy + qz * wx - qx * wz);
+    float const nz = qz + halfDt * (qw * wz + qx * wy - qy * wx);
+    float const nw = qw - halfDt * (qx * wx + qy * wy + qz * wz);
+    float const inv =
+        1.f / std::sqrt((nx * nx + ny * ny) + (nz * nz + nw * nw));
+    b.qx[i] = nx * inv;
+    b.qy[i] = ny * inv;
+    b.qz[i] = nz * inv;
+    b.qw[i] = nw * inv;
+  }
+}
+
+void integrate_rigid_bodies(JobSystem& aJobs, RigidBodies& aBodies,
+                            Vec3f aGravity, float dt) {
+  aJobs.parallel_for(0, aBodies.size(), kBodyGrain,
+                     [&](std::size_t aBegin, std::size_t aEnd) {
+                       integrate_rigid_bodies(aBodies, aGravity, dt, aBegin,
+                                              aEnd);
+                     });
+}
+
+ThrustKey sample_thrust_profile(std::span<ThrustKey const> aKeys,
+                                float aTime) {
+  if (aKeys.empty()) return ThrustKey{aTime, 0.f, 0.f};
+
+  auto const next = std::upper_bound(
+      aKeys.begin(), aKeys.end(), aTime,
+      [](float aT, ThrustKey const& aKey) { return aT < aKey.time; });
+  if (next == aKeys.begin()) return ThrustKey{aTime, next->thrust, next->tilt};
+  auto const previous = next - 1;
+  if (next == aKeys.end())
+    return ThrustKey{aTime, previous->thrust, previous->tilt};
+
+  float const t = (aTime - previous->time) / (next->time - previous->time);
+  return ThrustKey{aTime, previous->thrust + t * (next->thrust -
+                                                  previous->thrust),
+                   previous->tilt + t * (next->tilt - previous->tilt)};
+}
+
+Vec3f attitude_torque(RigidBodies const& aBodies, std::size_t aIndex,
+                      Quatf aTarget, float aFrequency) {
+  // Rotation still to go, in body space, as axis times angle. For the
+  // shorter way round, w must not be negative.
+  Quatf const error = conjugate(aBodies.orientation(aIndex)) * aTarget;
+  float const sign = error.w < 0.f ? -2.f : 2.f;
+  Vec3f const angle{sign * error.x, sign * error.y, sign * error.z};
+
+  Vec3f const w = aBodies.angularVelocity(aIndex);
+  Vec3f const acceleration = aFrequency * aFrequency * angle -
+                             2.f * aFrequency * w;
+  return Vec3f{aBodies.ix[aIndex] * acceleration.x,
+               aBodies.iy[aIndex] * acceleration.y,
+               aBodies.iz[aIndex] * acceleration.z};
+}
@@ -0,0 +1,89 @@
+#ifndef RIGID_BODY_HPP_5F1C8A3E_D27B_4E96_B0A4_93E6C1D85F2A
+#define RIGID_BODY_HPP_5F1C8A3E_D27B_4E96_B0A4_93E6C1D85F2A
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "../vmlib/quat.hpp"
+#include "../vmlib/vec3.hpp"
+#include "job_system.hpp"
+
+/* RigidBodies: ships as rigid bodies, structure of arrays
+ *
+ * Each body has a mass and an inertia tensor that is diagonal in its own
+ * frame, i.e. the body axes are its principal axes; moments holds the
+ * diagonal. Orientation rotates body to world space. Angular velocity,
+ * torque and the moments are in body space, where the tensor is constant.
+ *
+ * The controls, thrust along the body's +Y axis and torque, are set by the
+ * owner of each body before every step and stay until changed.
+ */
+struct RigidBodies {
+  std::vector<float> x, y, z;         // position
+  std::vector<float> vx, vy, vz;      // velocity
+  std::vector<float> qx, qy, qz, qw;  // orientation
+  std::vector<float> wx, wy, wz;      // angular velocity
+  std::vector<float> invMass;
+  std::vector<float> ix, iy, iz;      // principal moments of inertia
+  std::vector<float> thrust;
+  std::vector<float> tx, ty, tz;      // torque
+
+  std::size_t size() const { return x.size(); }
+  // Returns the body's index; it starts at rest with the controls at zero
+  std::size_t add(float aMass, Vec3f aMoments, Vec3f aPosition,
+                  Quatf aOrientation);
+  void clear();
+  // New bodies are zero throughout; set them with copy()
+  void resize(std::size_t aCount);
+  // Makes body aIndex a copy of body aFrom of aBodies, controls included
+  void copy(std::size_t aIndex, RigidBodies const& aBodies,
+            std::size_t aFrom);
+
+  Vec3f position(std::size_t aIndex) const {
+    return Vec3f{x[aIndex], y[aIndex], z[aIndex]};
+  }
+  Vec3f velocity(std::size_t aIndex) const {
+    return Vec3f{vx[aIndex], vy[aIndex], vz[aIndex]};
+  }
+  Quatf orientation(std::size_t aIndex) const {
+    return Quatf{qx[aIndex], qy[aIndex], qz[aIndex], qw[aIndex]};
+  }
+  Vec3f angularVelocity(std::size_t aIndex) const {
+    return Vec3f{wx[aIndex], wy[aIndex], wz[aIndex]};
+  }
+};
+
+// Principal moments of a solid cylinder along the Y axis
+Vec3f make_cylinder_moments(float aMass, float aRadius, float aHeight);
+
+/* One fixed step of semi-implicit (symplectic) Euler for bodies
+ * [aBegin, aEnd): the velocities take the forces of the current state, then
+ * the positions and orientations move with the new velocities. Rotation
+ * includes the gyroscopic term of Euler's equations, and orientations are
+ * renormalised every step. Eight bodies at a time with AVX.
+ */
+void integrate_rigid_bodies(RigidBodies&, Vec3f aGravity, float dt,
+                            std::size_t aBegin, std::size_t aEnd);
+// All bodies, split across the job system's workers
+void integrate_rigid_bodies(JobSystem& aJobs, RigidBodies&, Vec3f aGravity,
+                            float dt);
+
+// A control setting of a thrust profile. Tilt is a rotation about the
+// world Z axis, in radians; negative tilts +Y towards +X.
+struct ThrustKey {
+  float time;  // seconds since the start of the profile
+  float thrust;
+  float tilt;
+};
+
+// Thrust and tilt at aTime, linear between keys and held after the last.
+// The keys are sorted by time.
+ThrustKey sample_thrust_profile(std::span<ThrustKey const>, float aTime);
+
+// Torque turning body aIndex towards aTarget like a critically damped
+// spring with the given natural frequency (rad/s)
+Vec3f attitude_torque(RigidBodies const&, std::size_t aIndex, Quatf aTarget,
+                      float aFrequency);
+
+#endif  // RIGID_BODY_HPP_5F1C8A3E_D27B_4E96_B0A4_93E6C1D85F2A
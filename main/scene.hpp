@@ -4,11 +4,25 @@
 #include <glad/glad.h>
 
 #include <array>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
 
 #include "../support/program.hpp"
+#include "../vmlib/quat.hpp"
 #include "../vmlib/mat33.hpp"
 #include "../vmlib/mat44.hpp"
+#include "bvh.hpp"
+#include "heightfield.hpp"
+#include "job_system.hpp"
+#include "lod.hpp"
 #include "mesh.hpp"
+#include "scene_file.hpp"
+#include "scene_graph.hpp"
+#include "terrain.hpp"
 #include "texture.hpp"
 
 // Lighting
@@ -56,72 +70,139 @@ class Lighting {
   std::array<Vec3f, 3> pointLightDiffuse;
 };
 
+/* Scene: the ground and the static meshes of a scene file
+ *
+ * The ground is baked from the terrain record's OBJ into a tiled terrain
+ * file on first use, which is also decoded into a Heightfield for ground
+ * queries. Each instance record is a scene graph node.
+ */
 class Scene {
  public:
-  Scene() {
-    MeshData groundMesh = load_wavefront_obj("assets/cw2/langerso.obj", true);
-    groundVao = create_vao(groundMesh);
-    groundVertices = GLuint(groundMesh.positions.size());
-    groundTexture = load_texture_2d("assets/cw2/L3211E-4k.jpg");
-
-    // Launchpad
-    MeshData lpadMesh = load_wavefront_obj("assets/cw2/landingpad.obj", false);
-    lpadVao = create_vao(lpadMesh);
-    lpadVertices = GLuint(lpadMesh.positions.size());
-
-    lpadModel2World1 =
-        make_translation({5.f, 0.f, -5.f}) * make_rotation_y(1.f);
-    lpadModel2World2 =
-        make_translation({-5.f, 0.f, 3.5f}) * make_rotation_y(-0.5f);
-
-    lpadNormalMatrix1 = mat44_to_mat33(transpose(invert(lpadModel2World1)));
-    lpadNormalMatrix2 = mat44_to_mat33(transpose(invert(lpadModel2World2)));
+  Scene(JobSystem& aJobs, SceneGraph& aGraph, SceneFile const& aScene) {
+    // Simplifying the meshes and baking the terrain dominate start-up, so
+    // they run as jobs while this thread loads the texture. The jobs write
+    // to locals and members, so nothing may throw until they have finished:
+    // errors, the texture's too, are held and rethrown after the wait.
+    SceneFileHeader const& header = aScene.header();
+    char const* const groundObjPath = aScene.string(header.terrainMesh);
+    char const* const groundTerrainPath = aScene.string(header.terrainBaked);
+
+    std::span<SceneMesh const> const meshes = aScene.meshes();
+    std::vector<LodChainData> meshData(meshes.size());
+    std::vector<LodChainReport> meshReports(meshes.size());
+    std::vector<std::exception_ptr> meshErrors(meshes.size());
+    std::exception_ptr groundError;
+
+    Job* root = aJobs.create([] {});
+    aJobs.run(aJobs.createChild(root, [&] {
+      try {
+        if (!std::filesystem::exists(groundTerrainPath)) {
+          bake_terrain(load_wavefront_obj(groundObjPath, true),
+                       groundTerrainPath);
+        }
+      } catch (...) {
+        groundError = std::current_exception();
+      }
+    }));
+    for (std::size_t i = 0; i < meshes.size(); ++i) {
+      aJobs.run(aJobs.createChild(root, [&, i] {
+        try {
+          meshData[i] = build_lod_chain(
+              load_wavefront_obj(aScene.string(meshes[i].path), false),
+              &meshReports[i]);
+        } catch (...) {
+          meshErrors[i] = std::current_exception();
+        }
+      }));
+    }
+    aJobs.run(root);
+
+    std::exception_ptr textureError;
+    try {
+      groundTexture = load_texture_2d(aScene.string(header.terrainTexture));
+    } catch (...) {
+      textureError = std::current_exception();
+    }
+
+    aJobs.wait(root);
+    if (textureError) std::rethrow_exception(textureError);
+    if (groundError) std::rethrow_exception(groundError);
+    for (std::exception_ptr const& error : meshErrors) {
+      if (error) std::rethrow_exception(error);
+    }
+
+    terrain.emplace(aJobs, groundTerrainPath);
+    ground.emplace(terrain->getFile());
+
+    // Meshes
+    meshLods.reserve(meshes.size());
+    for (std::size_t i = 0; i < meshes.size(); ++i) {
+      meshLods.push_back(upload_lod_chain(meshData[i], kDefaultVertexFormat,
+                                          &meshReports[i]));
+      print_lod_report(aScene.string(meshes[i].name), meshReports[i]);
+    }
+
+    for (SceneInstance const& instance : aScene.instances()) {
+      NodeId const node = aGraph.add(kNoNode, instance.transform,
+                                     meshLods[instance.mesh].bounds);
+      instances.push_back(Instance{instance.mesh, node, {}});
+    }
   }
 
-  void drawGround(const Mat44f& cameraProjection) const {
+  // Heights and rays against the drawn ground; any thread
+  Heightfield const& getGround() const { return *ground; }
+
+  // Streams the ground tiles around the cameras; once per frame. Returns
+  // the number of tile loads started.
+  std::size_t updateGround(std::span<Vec3f const> aCameras) {
+    return terrain->update(aCameras);
+  }
+  // Loads everything the last updateGround() asked for, e.g. before the
+  // first frame
+  void finishGroundLoads() { terrain->finishLoads(); }
+
+  void drawGround(const Mat44f& cameraProjection, const LodView& view) {
+    // Must use terrain.vert and set lighting first
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, groundTexture);
-    glUniformMatrix4fv(0, 1, GL_TRUE, cameraProjection.v);
-    glUniformMatrix4fv(1, 1, GL_TRUE, kIdentity44f.v);
-    glUniformMatrix3fv(2, 1, GL_TRUE, kIdentity33f.v);
-
-    glBindVertexArray(groundVao);
-    glDrawArrays(GL_TRIANGLES, 0, groundVertices);
+    terrain->draw(cameraProjection, view);
   }
 
-  void drawLaunchpads(const Mat44f& cameraProjection) const {
+  void drawInstances(const Mat44f& cameraProjection, const LodView& view,
+                     const SceneGraph& graph) {
     // Must set lighting first
+    for (Instance& instance : instances)
+      drawNode(meshLods[instance.mesh], instance.lodState, instance.node,
+               cameraProjection, view, graph);
+  }
 
-    // Launchpad 1
-    glUniformMatrix4fv(0, 1, GL_TRUE, cameraProjection.v);
-    glUniformMatrix4fv(1, 1, GL_TRUE, lpadModel2World1.v);
-    glUniformMatrix3fv(2, 1, GL_TRUE, lpadNormalMatrix1.v);
-    glBindVertexArray(lpadVao);
-    glDrawArrays(GL_TRIANGLES, 0, lpadVertices);
+ private:
+  void drawNode(const LodChain& lod, LodState& lodState, NodeId node,
+                const Mat44f& cameraProjection, const LodView& view,
+                const SceneGraph& graph) {
+    if (!intersects(make_frustum(cameraProjection), graph.subtreeBounds(node)))
+      return;
 
-    // Launchpad 2
+    Mat44f const model2world = graph.worldMatrix(node);
     glUniformMatrix4fv(0, 1, GL_TRUE, cameraProjection.v);
-    glUniformMatrix4fv(1, 1, GL_TRUE, lpadModel2World2.v);
-    glUniformMatrix3fv(2, 1, GL_TRUE, lpadNormalMatrix2.v);
-    glBindVertexArray(lpadVao);
-    glDrawArrays(GL_TRIANGLES, 0, lpadVertices);
+    glUniformMatrix4fv(1, 1, GL_TRUE, model2world.v);
+    glUniformMatrix3fv(2, 1, GL_TRUE, graph.normalMatrix(node).v);
+    draw_lod(lod, select_lod(lod, lodState, view, model2world));
   }
 
- private:
   // Ground
-  GLuint groundVao;
-  GLsizei groundVertices;
+  std::optional<Terrain> terrain;
+  std::optional<Heightfield> ground;
   GLuint groundTexture;
 
-  // Launchpad
-  GLuint lpadVao;
-  GLsizei lpadVertices;
-
-  Mat44f lpadModel2World1;
-  Mat44f lpadModel2World2;
-
-  Mat33f lpadNormalMatrix1;
-  Mat33f lpadNormalMatrix2;
+  // Meshes and their instances
+  struct Instance {
+    std::uint32_t mesh;
+    NodeId node;
+    LodState lodState;
+  };
+  std::vector<LodChain> meshLods;
+  std::vector<Instance> instances;
 };
 
 #endif  // SCENE_HPP_D0746DED_C9C6_40CD_B6E0_C6FEF665DD31
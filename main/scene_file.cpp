@@ -0,0 +1,652 @@
+#include "scene_file.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <numbers>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "../support/error.hpp"
+
+namespace {
+constexpr char kSceneMagic[4] = {'S', 'C', 'N', 'B'};
+constexpr std::uint32_t kSceneVersion = 3;
+
+struct FileCloser {
+  void operator()(std::FILE* aFile) const { std::fclose(aFile); }
+};
+using FilePtr = std::unique_ptr<std::FILE, FileCloser>;
+
+// Splits a line into words; quoted words may contain spaces and '#'
+void tokenize_(std::string const& aLine, std::vector<std::string>& aTokens,
+               bool& aUnterminated) {
+  aTokens.clear();
+  aUnterminated = false;
+  std::size_t i = 0;
+  while (i < aLine.size()) {
+    char const c = aLine[i];
+    if (' ' == c || '\t' == c || '\r' == c) {
+      ++i;
+    } else if ('#' == c) {
+      break;
+    } else if ('"' == c) {
+      std::size_t const end = aLine.find('"', i + 1);
+      if (std::string::npos == end) {
+        aUnterminated = true;
+        return;
+      }
+      aTokens.emplace_back(aLine, i + 1, end - i - 1);
+      i = end + 1;
+    } else {
+      std::size_t const end = aLine.find_first_of(" \t\r#", i);
+      aTokens.emplace_back(aLine, i, end - i);
+      i = std::min(end, aLine.size());
+    }
+  }
+}
+
+// The words of one record, read front to back. Errors name the line.
+class Record {
+ public:
+  Record(char const* aPath, std::size_t aLine,
+         std::vector<std::string> const& aTokens)
+      : path(aPath), line(aLine), tokens(aTokens), next(0) {}
+
+  bool done() const { return next == tokens.size(); }
+  bool nextIsNumber() const {
+    return !done() && isNumber(tokens[next]);
+  }
+
+  std::string const& word(char const* aWhat) {
+    if (done()) fail(std::string("expected ") + aWhat);
+    return tokens[next++];
+  }
+  float number() {
+    std::string const& text = word("a number");
+    if (!isNumber(text)) fail("'" + text + "' is not a number");
+    return std::strtof(text.c_str(), nullptr);
+  }
+  Vec3f vec3() {
+    float const x = number();
+    float const y = number();
+    return {x, y, number()};
+  }
+  Vec4f vec4() {
+    Vec3f const xyz = vec3();
+    return {xyz.x, xyz.y, xyz.z, number()};
+  }
+
+  [[noreturn]] void fail(std::string const& aMessage) const {
+    throw Error("%s:%zu: %s", path, line, aMessage.c_str());
+  }
+  [[noreturn]] void unknown(std::string const& aWord) const {
+    fail("unexpected '" + aWord + "'");
+  }
+
+ private:
+  static bool isNumber(std::string const& aText) {
+    char* end = nullptr;
+    std::strtof(aText.c_str(), &end);
+    return !aText.empty() && '\0' == *end;
+  }
+
+  char const* path;
+  std::size_t line;
+  std::vector<std::string> const& tokens;
+  std::size_t next;
+};
+
+// Reads the transform fields shared by several records. Returns false if
+// aField is not one of them.
+bool read_transform_field_(Record& aRecord, std::string const& aField,
+                           TrsTransform& aTransform) {
+  if ("at" == aField) {
+    aTransform.translation = aRecord.vec3();
+  } else if ("rotate" == aField) {
+    Vec3f const axis = aRecord.vec3();
+    float const degrees = aRecord.number();
+    if (0.f == length(axis)) aRecord.fail("rotation axis is zero");
+    aTransform.rotation = make_quat_axis_angle(
+        normalize(axis), degrees * std::numbers::pi_v<float> / 180.f);
+  } else if ("scale" == aField) {
+    float const s = aRecord.number();
+    if (aRecord.nextIsNumber()) {
+      float const y = aRecord.number();
+      aTransform.scale = {s, y, aRecord.number()};
+    } else {
+      aTransform.scale = {s, s, s};
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Everything compile_scene() has read so far
+class SceneBuilder {
+ public:
+  SceneBuilder() : strings(1, '\0'), stringOffsets{{"", 0}}, header{} {}
+
+  void read(Record& aRecord, std::string const& aKind);
+  void finish(char const* aPath) const;
+  void write(char const* aPath);
+
+ private:
+  std::uint32_t intern(std::string const& aString) {
+    auto const [it, added] =
+        stringOffsets.try_emplace(aString, std::uint32_t(strings.size()));
+    if (added) strings.append(aString.c_str(), aString.size() + 1);
+    return it->second;
+  }
+
+  void readTerrain(Record&);
+  void readCamera(Record&);
+  void readMesh(Record&);
+  void readInstance(Record&);
+  void readShip(Record&);
+  void readPart(Record&);
+  void readLeg(Record&);
+  void readLight(Record&);
+  void readButton(Record&);
+  void readEmitter(Record&);
+
+  std::vector<SceneCamera> cameras;
+  std::vector<SceneMesh> meshes;
+  std::vector<SceneInstance> instances;
+  std::vector<ScenePart> parts;
+  std::vector<SceneLeg> legs;
+  std::vector<SceneLight> lights;
+  std::vector<SceneButton> buttons;
+  std::vector<SceneEmitter> emitters;
+
+  std::string strings;  // offset 0 is the empty string
+  std::unordered_map<std::string, std::uint32_t> stringOffsets;
+  std::unordered_map<std::string, std::uint32_t> meshIndices;
+
+  SceneFileHeader header;
+  bool haveTerrain = false;
+  bool haveShip = false;
+};
+
+void SceneBuilder::read(Record& aRecord, std::string const& aKind) {
+  if ("terrain" == aKind) {
+    readTerrain(aRecord);
+  } else if ("camera" == aKind) {
+    readCamera(aRecord);
+  } else if ("mesh" == aKind) {
+    readMesh(aRecord);
+  } else if ("instance" == aKind) {
+    readInstance(aRecord);
+  } else if ("ship" == aKind) {
+    readShip(aRecord);
+  } else if ("part" == aKind) {
+    readPart(aRecord);
+  } else if ("leg" == aKind) {
+    readLeg(aRecord);
+  } else if ("light" == aKind) {
+    readLight(aRecord);
+  } else if ("button" == aKind) {
+    readButton(aRecord);
+  } else if ("emitter" == aKind) {
+    readEmitter(aRecord);
+  } else {
+    aRecord.fail("unknown record '" + aKind + "'");
+  }
+}
+
+void SceneBuilder::readTerrain(Record& aRecord) {
+  if (haveTerrain) aRecord.fail("second terrain record");
+  haveTerrain = true;
+  while (!aRecord.done()) {
+    std::string const& field = aRecord.word("a field");
+    if ("mesh" == field) {
+      header.terrainMesh = intern(aRecord.word("a path"));
+    } else if ("baked" == field) {
+      header.terrainBaked = intern(aRecord.word("a path"));
+    } else if ("texture" == field) {
+      header.terrainTexture = intern(aRecord.word("a path"));
+    } else {
+      aRecord.unknown(field);
+    }
+  }
+  if (0 == header.terrainMesh || 0 == header.terrainBaked ||
+      0 == header.terrainTexture) {
+    aRecord.fail("terrain needs mesh, baked and texture");
+  }
+}
+
+void SceneBuilder::readCamera(Record& aRecord) {
+  SceneCamera camera{intern(aRecord.word("a camera name")), {0.f, 0.f, 0.f}};
+  for (SceneCamera const& other : cameras) {
+    if (other.name == camera.name) aRecord.fail("camera defined twice");
+  }
+  while (!aRecord.done()) {
+    std::string const& field = aRecord.word("a field");
+    if ("at" != field) aRecord.unknown(field);
+    camera.position = aRecord.vec3();
+  }
+  cameras.push_back(camera);
+}
+
+void SceneBuilder::readMesh(Record& aRecord) {
+  std::string const& name = aRecord.word("a mesh name");
+  if (meshIndices.contains(name)) aRecord.fail("mesh defined twice");
+  SceneMesh mesh{intern(name), 0};
+  while (!aRecord.done()) {
+    std::string const& field = aRecord.word("a field");
+    if ("path" != field) aRecord.unknown(field);
+    mesh.path = intern(aRecord.word("a path"));
+  }
+  if (0 == mesh.path) aRecord.fail("mesh needs a path");
+  meshIndices.emplace(name, std::uint32_t(meshes.size()));
+  meshes.push_back(mesh);
+}
+
+void SceneBuilder::readInstance(Record& aRecord) {
+  std::string const& name = aRecord.word("a mesh name");
+  auto const mesh = meshIndices.find(name);
+  if (meshIndices.end() == mesh) aRecord.fail("unknown mesh '" + name + "'");
+  SceneInstance instance{mesh->second, {}};
+  while (!aRecord.done()) {
+    std::string const& field = aRecord.word("a field");
+    if (!read_transform_field_(aRecord, field, instance.transform))
+      aRecord.unknown(field);
+  }
+  instances.push_back(instance);
+}
+
+void SceneBuilder::readShip(Record& aRecord) {
+  if (haveShip) aRecord.fail("second ship record");
+  haveShip = true;
+  header.shipScale = 1.f;
+  while (!aRecord.done()) {
+    std::string const& field = aRecord.word("a field");
+    if ("at" == field) {
+      header.shipPosition = aRecord.vec3();
+    } else if ("scale" == field) {
+      header.shipScale = aRecord.number();
+    } else {
+      aRecord.unknown(field);
+    }
+  }
+}
+
+void SceneBuilder::readPart(Record& aRecord) {
+  ScenePart part{};
+
+  std::string const& group = aRecord.word("hull or leg");
+  if ("hull" == group) {
+    part.group = ScenePartGroup::hull;
+  } else if ("leg" == group) {
+    part.group = ScenePartGroup::leg;
+  } else {
+    aRecord.unknown(group);
+  }
+
+  std::string const& shape = aRecord.word("a shape");
+  if ("cylinder" == shape) {
+    part.shape = SceneShape::cylinder;
+  } else if ("cone" == shape) {
+    part.shape = SceneShape::cone;
+  } else if ("sphere" == shape) {
+    part.shape = SceneShape::sphere;
+  } else {
+    aRecord.unknown(shape);
+  }
+
+  while (!aRecord.done()) {
+    std::string const& field = aRecord.word("a field");
+    if (read_transform_field_(aRecord, field, part.transform)) continue;
+    if ("capped" == field) {
+      part.capped = 1;
+    } else if ("color" == field) {
+      part.ambient = part.diffuse = part.specular = aRecord.vec3();
+    } else if ("ambient" == field) {
+      part.ambient = aRecord.vec3();
+    } else if ("diffuse" == field) {
+      part.diffuse = aRecord.vec3();
+    } else if ("specular" == field) {
+      part.specular = aRecord.vec3();
+    } else if ("emissive" == field) {
+      part.emissive = aRecord.vec3();
+    } else if ("shininess" == field) {
+      part.shininess = aRecord.number();
+    } else {
+      aRecord.unknown(field);
+    }
+  }
+  parts.push_back(part);
+}
+
+void SceneBuilder::readLeg(Record& aRecord) {
+  SceneLeg leg{};
+  while (!aRecord.done()) {
+    std::string const& field = aRecord.word("a field");
+    if (!read_transform_field_(aRecord, field, leg.placement))
+      aRecord.unknown(field);
+  }
+  legs.push_back(leg);
+}
+
+void SceneBuilder::readLight(Record& aRecord) {
+  if (kSceneLightCount == lights.size())
+    aRecord.fail("more than " + std::to_string(kSceneLightCount) + " lights");
+  SceneLight light{};
+  while (!aRecord.done()) {
+    std::string const& field = aRecord.word("a field");
+    if ("at" == field) {
+      light.offset = aRecord.vec3();
+    } else if ("ambient" == field) {
+      light.ambient = aRecord.vec3();
+    } else if ("diffuse" == field) {
+      light.diffuse = aRecord.vec3();
+    } else {
+      aRecord.unknown(field);
+    }
+  }
+  lights.push_back(light);
+}
+
+void SceneBuilder::readButton(Record& aRecord) {
+  SceneButton button{};
+  button.text = intern(aRecord.word("the button text"));
+  button.labelColor = {0.f, 0.f, 0.f, 1.f};
+  while (!aRecord.done()) {
+    std::string const& field = aRecord.word("a field");
+    if ("anchor" == field) {
+      std::string const& anchor = aRecord.word("an anchor");
+      if ("topLeft" == anchor) {
+        button.anchor = SceneButtonAnchor::topLeft;
+      } else if ("bottomCentreLeft" == anchor) {
+        button.anchor = SceneButtonAnchor::bottomCentreLeft;
+      } else if ("bottomCentreRight" == anchor) {
+        button.anchor = SceneButtonAnchor::bottomCentreRight;
+      } else if ("topLeftBelow" == anchor) {
+        button.anchor = SceneButtonAnchor::topLeftBelow;
+      } else {
+        aRecord.unknown(anchor);
+      }
+    } else if ("idle" == field) {
+      button.idleColor = aRecord.vec4();
+    } else if ("active" == field) {
+      button.activeColor = aRecord.vec4();
+    } else if ("pressed" == field) {
+      button.pressedColor = aRecord.vec4();
+    } else if ("border" == field) {
+      button.borderWidth = aRecord.number();
+      button.borderColor = aRecord.vec4();
+    } else if ("label" == field) {
+      button.labelColor = aRecord.vec4();
+    } else if ("action" == field) {
+      std::string const& action = aRecord.word("an action");
+      if ("none" == action) {
+        button.action = SceneButtonAction::none;
+      } else if ("launch" == action) {
+        button.action = SceneButtonAction::launch;
+      } else if ("reset" == action) {
+        button.action = SceneButtonAction::reset;
+      } else {
+        aRecord.unknown(action);
+      }
+    } else if ("readout" == field) {
+      std::string const& readout = aRecord.word("a readout");
+      if ("none" == readout) {
+        button.readout = SceneButtonReadout::none;
+      } else if ("altitude" == readout) {
+        button.readout = SceneButtonReadout::altitude;
+      } else if ("speed" == readout) {
+        button.readout = SceneButtonReadout::speed;
+      } else {
+        aRecord.unknown(readout);
+      }
+    } else {
+      aRecord.unknown(field);
+    }
+  }
+  buttons.push_back(button);
+}
+
+void SceneBuilder::readEmitter(Record& aRecord) {
+  SceneEmitter emitter{};
+  emitter.direction = {0.f, -1.f, 0.f};
+  emitter.life = 1.f;
+  while (!aRecord.done()) {
+    std::string const& field = aRecord.word("a field");
+    if ("at" == field) {
+      emitter.offset = aRecord.vec3();
+    } else if ("direction" == field) {
+      Vec3f const direction = aRecord.vec3();
+      if (0.f == length(direction)) aRecord.fail("direction is zero");
+      emitter.direction = normalize(direction);
+    } else if ("rate" == field) {
+      emitter.rate = aRecord.number();
+    } else if ("speed" == field) {
+      emitter.speed = aRecord.number();
+    } else if ("spread" == field) {
+      emitter.spread = aRecord.number() * std::numbers::pi_v<float> / 180.f;
+    } else if ("life" == field) {
+      emitter.life = aRecord.number();
+    } else {
+      aRecord.unknown(field);
+    }
+  }
+  if (emitter.rate < 0.f || emitter.life <= 0.f)
+    aRecord.fail("emitter needs a rate >= 0 and a life > 0");
+  emitters.push_back(emitter);
+}
+
+void SceneBuilder::finish(char const* aPath) const {
+  if (!haveTerrain) throw Error("%s: no terrain record", aPath);
+  if (!haveShip) throw Error("%s: no ship record", aPath);
+  if (kSceneLightCount != lights.size()) {
+    throw Error("%s: the ship needs %zu lights, not %zu", aPath,
+                kSceneLightCount, lights.size());
+  }
+
+  bool hull = false, leg = false;
+  for (ScenePart const& part : parts) {
+    hull = hull || ScenePartGroup::hull == part.group;
+    leg = leg || ScenePartGroup::leg == part.group;
+  }
+  if (!hull) throw Error("%s: the ship has no hull parts", aPath);
+  if (leg != !legs.empty())
+    throw Error("%s: the ship needs both leg parts and legs, or neither",
+                aPath);
+}
+
+void SceneBuilder::write(char const* aPath) {
+  std::uint32_t offset = sizeof(SceneFileHeader);
+  auto place = [&](SceneSection& aSection, auto const& aRecords) {
+    using Item = typename std::decay_t<decltype(aRecords)>::value_type;
+    static_assert(0 == sizeof(Item) % 4);
+    aSection = {offset, std::uint32_t(aRecords.size())};
+    offset += std::uint32_t(sizeof(Item) * aRecords.size());
+  };
+  std::memcpy(header.magic, kSceneMagic, sizeof(kSceneMagic));
+  header.version = kSceneVersion;
+  place(header.cameras, cameras);
+  place(header.meshes, meshes);
+  place(header.instances, instances);
+  place(header.parts, parts);
+  place(header.legs, legs);
+  place(header.lights, lights);
+  place(header.buttons, buttons);
+  place(header.emitters, emitters);
+  header.strings = {offset, std::uint32_t(strings.size())};
+
+  FilePtr file(std::fopen(aPath, "wb"));
+  bool ok = file && 1 == std::fwrite(&header, sizeof(header), 1, file.get());
+  auto put = [&](auto const& aRecords) {
+    ok = ok && aRecords.size() == std::fwrite(aRecords.data(),
+                                              sizeof(aRecords[0]),
+                                              aRecords.size(), file.get());
+  };
+  put(cameras);
+  put(meshes);
+  put(instances);
+  put(parts);
+  put(legs);
+  put(lights);
+  put(buttons);
+  put(emitters);
+  put(strings);
+  ok = ok && 0 == std::fclose(file.release());
+  if (!ok) throw Error("Unable to write scene file '%s'", aPath);
+}
+}  // namespace
+
+void compile_scene(char const* aTextPath, char const* aBinaryPath) {
+  std::ifstream text(aTextPath);
+  if (!text) throw Error("Unable to open scene '%s'", aTextPath);
+
+  SceneBuilder builder;
+  std::string line;
+  std::vector<std::string> tokens;
+  bool unterminated;
+  for (std::size_t number = 1; std::getline(text, line); ++number) {
+    tokenize_(line, tokens, unterminated);
+    Record record(aTextPath, number, tokens);
+    if (unterminated) record.fail("unterminated string");
+    if (tokens.empty()) continue;
+    std::string const& kind = record.word("a record");
+    builder.read(record, kind);
+  }
+  if (text.bad()) throw Error("Unable to read scene '%s'", aTextPath);
+  builder.finish(aTextPath);
+
+  // Readers never see a half-written file
+  std::string const temporary = std::string(aBinaryPath) + ".tmp";
+  builder.write(temporary.c_str());
+  std::error_code error;
+  std::filesystem::rename(temporary, aBinaryPath, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+    throw Error("Unable to replace scene file '%s'", aBinaryPath);
+  }
+}
+
+template <typename T>
+std::span<T const> SceneFile::section(SceneSection const& aSection) const {
+  return {reinterpret_cast<T const*>(file.bytes().data() + aSection.offset),
+          aSection.count};
+}
+
+SceneFile::SceneFile(char const* aPath) : file(aPath) {
+  std::span<std::byte const> const bytes = file.bytes();
+  fileHeader = reinterpret_cast<SceneFileHeader const*>(bytes.data());
+  if (bytes.size() < sizeof(SceneFileHeader) ||
+      0 != std::memcmp(fileHeader->magic, kSceneMagic, sizeof(kSceneMagic)) ||
+      kSceneVersion != fileHeader->version) {
+    throw Error("'%s' is not a version %u scene file", aPath, kSceneVersion);
+  }
+
+  auto fits = [&](SceneSection const& aSection, std::size_t aRecordSize) {
+    return 0 == aSection.offset % 4 &&
+           std::uint64_t(aSection.offset) +
+                   std::uint64_t(aSection.count) * aRecordSize <=
+               bytes.size();
+  };
+  SceneFileHeader const& h = *fileHeader;
+  if (!fits(h.cameras, sizeof(SceneCamera)) ||
+      !fits(h.meshes, sizeof(SceneMesh)) ||
+      !fits(h.instances, sizeof(SceneInstance)) ||
+      !fits(h.parts, sizeof(ScenePart)) || !fits(h.legs, sizeof(SceneLeg)) ||
+      !fits(h.lights, sizeof(SceneLight)) ||
+      !fits(h.buttons, sizeof(SceneButton)) ||
+      !fits(h.emitters, sizeof(SceneEmitter)) || !fits(h.strings, 1) ||
+      0 == h.strings.count) {
+    throw Error("Scene file '%s' is truncated", aPath);
+  }
+  strings = reinterpret_cast<char const*>(bytes.data() + h.strings.offset);
+
+  bool ok = '\0' == strings[h.strings.count - 1] &&
+            kSceneLightCount == h.lights.count;
+  auto checkString = [&](std::uint32_t aOffset) {
+    ok = ok && aOffset < h.strings.count;
+  };
+  checkString(h.terrainMesh);
+  checkString(h.terrainBaked);
+  checkString(h.terrainTexture);
+  for (SceneCamera const& camera : cameras()) checkString(camera.name);
+  for (SceneMesh const& mesh : meshes()) {
+    checkString(mesh.name);
+    checkString(mesh.path);
+  }
+  for (SceneInstance const& instance : instances())
+    ok = ok && instance.mesh < h.meshes.count;
+  for (ScenePart const& part : parts()) {
+    ok = ok && part.group <= ScenePartGroup::leg &&
+         part.shape <= SceneShape::sphere;
+  }
+  for (SceneButton const& button : buttons()) {
+    checkString(button.text);
+    ok = ok && button.anchor <= SceneButtonAnchor::topLeftBelow &&
+         button.action <= SceneButtonAction::reset &&
+         button.readout <= SceneButtonReadout::speed;
+  }
+  for (SceneEmitter const& emitter : emitters())
+    ok = ok && emitter.rate >= 0.f && emitter.life > 0.f;
+  if (!ok) throw Error("Scene file '%s' is corrupt", aPath);
+}
+
+std::span<SceneCamera const> SceneFile::cameras() const {
+  return section<SceneCamera>(fileHeader->cameras);
+}
+std::span<SceneMesh const> SceneFile::meshes() const {
+  return section<SceneMesh>(fileHeader->meshes);
+}
+std::span<SceneInstance const> SceneFile::instances() const {
+  return section<SceneInstance>(fileHeader->instances);
+}
+std::span<ScenePart const> SceneFile::parts() const {
+  return section<ScenePart>(fileHeader->parts);
+}
+std::span<SceneLeg const> SceneFile::legs() const {
+  return section<SceneLeg>(fileHeader->legs);
+}
+std::span<SceneLight const> SceneFile::lights() const {
+  return section<SceneLight>(fileHeader->lights);
+}
+std::span<SceneButton const> SceneFile::buttons() const {
+  return section<SceneButton>(fileHeader->buttons);
+}
+std::span<SceneEmitter const> SceneFile::emitters() const {
+  return section<SceneEmitter>(fileHeader->emitters);
+}
+
+Vec3f SceneFile::cameraPosition(char const* aName) const {
+  for (SceneCamera const& camera : cameras()) {
+    if (0 == std::strcmp(string(camera.name), aName)) return camera.position;
+  }
+  throw Error("The scene has no camera '%s'", aName);
+}
+
+SceneFile load_scene(char const* aTextPath) {
+  namespace fs = std::filesystem;
+  fs::path binary(aTextPath);
+  binary.replace_extension(".bin");
+
+  // A scene shipped without its text is used as it is
+  std::error_code error;
+  if (!fs::exists(aTextPath, error))
+    return SceneFile(binary.string().c_str());
+
+  if (fs::exists(binary, error) &&
+      fs::last_write_time(aTextPath, error) <=
+          fs::last_write_time(binary, error)) {
+    try {
+      return SceneFile(binary.string().c_str());
+    } catch (Error const&) {
+      // Written by another version; compiled again below
+    }
+  }
+  compile_scene(aTextPath, binary.string().c_str());
+  return SceneFile(binary.string().c_str());
+}
@@ -0,0 +1,193 @@
+#ifndef SCENE_FILE_HPP_E4A1C7D2_3B69_4F80_9D25_6C8B0F17A3E9
+#define SCENE_FILE_HPP_E4A1C7D2_3B69_4F80_9D25_6C8B0F17A3E9
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "../vmlib/quat.hpp"
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "mapped_file.hpp"
+
+// The scene loaded at start-up
+constexpr char const* kScenePath = "assets/cw2/scene.txt";
+
+/* Scene description
+ *
+ * Scenes are written as text (*.txt, see assets/cw2/scene.txt) and compiled
+ * to a binary file (*.bin) next to it, which is what the program reads.
+ *
+ * Text: one record per line. A record is a keyword followed by its fields,
+ * each a keyword and its values; strings with spaces are quoted and '#'
+ * starts a comment. Angles are in degrees.
+ *
+ *   terrain mesh <obj> baked <terrain> texture <image>
+ *   camera <name> at x y z
+ *   mesh <name> path <obj>
+ *   instance <mesh> [at x y z] [rotate ax ay az deg] [scale s | sx sy sz]
+ *   ship at x y z scale s
+ *   part <hull|leg> <cylinder|cone|sphere> [capped] [at/rotate/scale ...]
+ *        [color r g b] [ambient|diffuse|specular|emissive r g b]
+ *        [shininess n]
+ *   leg [rotate ax ay az deg]
+ *   light at x y z ambient r g b diffuse r g b
+ *   emitter at x y z direction x y z rate n speed v spread deg life s
+ *   button <text> anchor <name> idle r g b a active r g b a
+ *          pressed r g b a border w r g b a [label r g b a]
+ *          action <none|launch|reset> [readout <none|altitude|speed>]
+ *
+ * Binary:
+ *
+ *   SceneFileHeader
+ *   record sections   at SceneSection::offset, 4-byte aligned
+ *   string table      NUL-terminated; strings are offsets into it
+ *
+ * Records are plain data, so the whole file is used in place after one
+ * mmap. Written in the host's byte order.
+ */
+struct SceneSection {
+  std::uint32_t offset;  // bytes from the start of the file
+  std::uint32_t count;   // records, or bytes for the string table
+};
+
+struct SceneFileHeader {
+  char magic[4];
+  std::uint32_t version;
+  SceneSection cameras, meshes, instances, parts, legs, lights, buttons;
+  SceneSection emitters;
+  SceneSection strings;
+  Vec3f shipPosition;
+  float shipScale;  // model units to world units
+  std::uint32_t terrainMesh, terrainBaked, terrainTexture;
+  std::uint32_t reserved;
+};
+
+struct SceneCamera {
+  std::uint32_t name;
+  Vec3f position;
+};
+
+struct SceneMesh {
+  std::uint32_t name;
+  std::uint32_t path;
+};
+
+struct SceneInstance {
+  std::uint32_t mesh;  // index into the mesh records
+  TrsTransform transform;
+};
+
+enum class ScenePartGroup : std::uint32_t { hull, leg };
+enum class SceneShape : std::uint32_t { cylinder, cone, sphere };
+
+// One primitive of the ship, in model units. Leg parts are in the space of
+// one leg, which is placed once per leg record.
+struct ScenePart {
+  ScenePartGroup group;
+  SceneShape shape;
+  std::uint32_t capped;
+  TrsTransform transform;
+  Vec3f ambient, diffuse, specular, emissive;
+  float shininess;
+};
+
+struct SceneLeg {
+  TrsTransform placement;
+};
+
+// A point light carried by the ship; the offset is in world units
+struct SceneLight {
+  Vec3f offset;
+  Vec3f ambient, diffuse;
+};
+
+// An exhaust particle emitter carried by the ship; offset and direction
+// are in world units, in the ship's frame
+struct SceneEmitter {
+  Vec3f offset;
+  Vec3f direction;  // unit length
+  float rate;       // particles per second at full throttle
+  float speed;      // relative to the ship
+  float spread;     // half-angle of the exhaust cone, radians
+  float life;       // seconds
+};
+
+enum class SceneButtonAnchor : std::uint32_t {
+  topLeft,
+  bottomCentreLeft,
+  bottomCentreRight,
+  topLeftBelow
+};
+enum class SceneButtonAction : std::uint32_t { none, launch, reset };
+// A live value shown after the button's text
+enum class SceneButtonReadout : std::uint32_t { none, altitude, speed };
+
+struct SceneButton {
+  std::uint32_t text;
+  SceneButtonAnchor anchor;
+  SceneButtonAction action;
+  SceneButtonReadout readout;
+  Vec4f idleColor, activeColor, pressedColor;
+  float borderWidth;
+  Vec4f borderColor;
+  Vec4f labelColor;
+};
+
+static_assert(sizeof(SceneFileHeader) == 112);
+static_assert(sizeof(SceneCamera) == 16);
+static_assert(sizeof(SceneMesh) == 8);
+static_assert(sizeof(SceneInstance) == 44);
+static_assert(sizeof(ScenePart) == 104);
+static_assert(sizeof(SceneLeg) == 40);
+static_assert(sizeof(SceneLight) == 36);
+static_assert(sizeof(SceneButton) == 100);
+static_assert(sizeof(SceneEmitter) == 40);
+
+// The ship carries this many lights (see Lighting)
+constexpr std::size_t kSceneLightCount = 3;
+
+// Compiles a text scene to a binary one. Throws Error, naming the line of
+// the first bad record.
+void compile_scene(char const* aTextPath, char const* aBinaryPath);
+
+/* SceneFile: a compiled scene, mapped into memory
+ *
+ * The constructor checks that every section, string and mesh index lies
+ * within the file, so the accessors need no checks of their own.
+ */
+class SceneFile {
+ public:
+  explicit SceneFile(char const* aPath);  // throws Error
+
+  SceneFileHeader const& header() const { return *fileHeader; }
+
+  std::span<SceneCamera const> cameras() const;
+  std::span<SceneMesh const> meshes() const;
+  std::span<SceneInstance const> instances() const;
+  std::span<ScenePart const> parts() const;
+  std::span<SceneLeg const> legs() const;
+  std::span<SceneLight const> lights() const;
+  std::span<SceneButton const> buttons() const;
+  std::span<SceneEmitter const> emitters() const;
+
+  char const* string(std::uint32_t aOffset) const {
+    return strings + aOffset;
+  }
+  // Position of the named camera; throws Error if there is none
+  Vec3f cameraPosition(char const* aName) const;
+
+ private:
+  template <typename T>
+  std::span<T const> section(SceneSection const&) const;
+
+  MappedFile file;
+  SceneFileHeader const* fileHeader;
+  char const* strings;
+};
+
+// Maps the binary form of the text scene aTextPath, compiling it first if
+// it is missing, older than the text or of another version. Throws Error.
+SceneFile load_scene(char const* aTextPath);
+
+#endif  // SCENE_FILE_HPP_E4A1C7D2_3B69_4F80_9D25_6C8B0F17A3E9
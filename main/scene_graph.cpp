@@ -0,0 +1,66 @@
+#include "scene_graph.hpp"
+
+#include <cassert>
+
+NodeId SceneGraph::add(NodeId aParent, TrsTransform const& aLocal,
+                       Aabb const& aBounds) {
+  assert(kNoNode == aParent || aParent < size());
+
+  auto const id = NodeId(size());
+  parent.push_back(aParent);
+  local.push_back(aLocal);
+  localBounds.push_back(aBounds);
+  flags.push_back(kDirty);
+  worlds.push_back(kIdentity34f);
+  normals.push_back(kIdentity33f);
+  subtrees.push_back(Aabb{});
+
+  anyDirty = true;
+  return id;
+}
+
+void SceneGraph::setLocal(NodeId aNode, TrsTransform const& aLocal) {
+  local[aNode] = aLocal;
+  flags[aNode] |= kDirty;
+  anyDirty = true;
+}
+
+std::size_t SceneGraph::update() {
+  if (!anyDirty) return 0;
+  anyDirty = false;
+
+  std::size_t const count = size();
+  std::size_t updated = 0;
+
+  // Parents first: world transforms of dirty nodes and their descendants
+  for (std::size_t i = 0; i < count; ++i) {
+    NodeId const p = parent[i];
+    bool const changed =
+        (flags[i] & kDirty) || (kNoNode != p && (flags[p] & kWorldChanged));
+    flags[i] = changed ? std::uint8_t(kWorldChanged | kBoundsChanged) : 0;
+    if (!changed) continue;
+
+    Affine34f const l = to_affine34(local[i]);
+    worlds[i] = (kNoNode == p) ? l : worlds[p] * l;
+    normals[i] = normal_matrix(worlds[i]);
+    ++updated;
+  }
+
+  // Children first: mark the ancestors of moved nodes and reset their boxes
+  // to their own bounds
+  for (std::size_t i = count; i-- > 0;) {
+    if (!(flags[i] & kBoundsChanged)) continue;
+    subtrees[i] = transform(worlds[i], localBounds[i]);
+    if (kNoNode != parent[i]) flags[parent[i]] |= kBoundsChanged;
+  }
+
+  // Children first again: fold each subtree into its parent's box. A child
+  // has a higher index than its parent, so its box is complete by then.
+  for (std::size_t i = count; i-- > 0;) {
+    NodeId const p = parent[i];
+    if (kNoNode != p && (flags[p] & kBoundsChanged))
+      subtrees[p] = merge(subtrees[p], subtrees[i]);
+  }
+
+  return updated;
+}
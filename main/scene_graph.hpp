@@ -0,0 +1,71 @@
+#ifndef SCENE_GRAPH_HPP_6D2A9F14_B37C_4E80_91A5_0C8E4B7F3D26
+#define SCENE_GRAPH_HPP_6D2A9F14_B37C_4E80_91A5_0C8E4B7F3D26
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../vmlib/aabb.hpp"
+#include "../vmlib/affine34.hpp"
+#include "../vmlib/mat33.hpp"
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/quat.hpp"
+
+using NodeId = std::uint32_t;
+constexpr NodeId kNoNode = std::numeric_limits<NodeId>::max();
+
+/* SceneGraph: transform hierarchy stored as flat arrays
+ *
+ * Nodes are only ever appended and a parent is always added before its
+ * children, so one forward pass over the arrays visits every parent before
+ * its children and one backward pass visits children first.
+ *
+ * setLocal() marks a node dirty. update() then recomputes the world
+ * transform and normal matrix of dirty nodes and their descendants only,
+ * and the bounds of their ancestors. Everything else is left untouched.
+ *
+ * Bounds: each node may carry model-space bounds (e.g. of its mesh);
+ * subtreeBounds() is the world-space box around the node and all of its
+ * descendants, for hierarchical culling.
+ */
+class SceneGraph {
+ public:
+  NodeId add(NodeId aParent, TrsTransform const& aLocal = {},
+             Aabb const& aBounds = {});
+
+  std::size_t size() const { return parent.size(); }
+  NodeId parentOf(NodeId aNode) const { return parent[aNode]; }
+
+  TrsTransform const& getLocal(NodeId aNode) const { return local[aNode]; }
+  void setLocal(NodeId aNode, TrsTransform const& aLocal);
+
+  // Returns the number of nodes whose world transform was recomputed
+  std::size_t update();
+
+  // Valid after update()
+  Affine34f const& world(NodeId aNode) const { return worlds[aNode]; }
+  Mat44f worldMatrix(NodeId aNode) const { return to_mat44(worlds[aNode]); }
+  Mat33f const& normalMatrix(NodeId aNode) const { return normals[aNode]; }
+  Aabb const& subtreeBounds(NodeId aNode) const { return subtrees[aNode]; }
+
+ private:
+  enum Flags : std::uint8_t {
+    kDirty = 0x1,         // local transform changed
+    kWorldChanged = 0x2,  // this or an ancestor was dirty
+    kBoundsChanged = 0x4  // something in the subtree moved
+  };
+
+  std::vector<NodeId> parent;
+  std::vector<TrsTransform> local;
+  std::vector<Aabb> localBounds;
+  std::vector<std::uint8_t> flags;
+
+  std::vector<Affine34f> worlds;
+  std::vector<Mat33f> normals;
+  std::vector<Aabb> subtrees;
+
+  bool anyDirty = false;
+};
+
+#endif  // SCENE_GRAPH_HPP_6D2A9F14_B37C_4E80_91A5_0C8E4B7F3D26
@@ -2,26 +2,49 @@
 #define SHAPE_HPP_CB812C27_5E45_4ED9_9A7F_D66774954C29
 
 #include <cstdlib>
+#include <span>
 #include <vector>
 
+#include "../vmlib/affine34.hpp"
 #include "../vmlib/mat33.hpp"
 #include "../vmlib/mat44.hpp"
 #include "../vmlib/vec3.hpp"
 #include "mesh.hpp"
+#include "unit_shapes.hpp"
 
-MeshData make_cylinder(bool capped, const std::size_t subdivs,
-                       const Mat44f &preTransform, const Vec3f &ambient,
+// Applies preTransform to a canonical position/normal table and attaches
+// constant Blinn-Phong colouring. Used by the generators below.
+MeshData transform_unit_shape(std::span<const Vec3f> positions,
+                              std::span<const Vec3f> normals,
+                              const Mat44f &preTransform, const Vec3f &ambient,
+                              const Vec3f &diffuse, const Vec3f &specular,
+                              float shininess, const Vec3f &emissive);
+
+template <std::size_t tSubdivs, bool tCapped>
+MeshData make_cylinder(const Mat44f &preTransform, const Vec3f &ambient,
                        const Vec3f &diffuse, const Vec3f &specular,
-                       float shininess, const Vec3f &emissive);
+                       float shininess, const Vec3f &emissive) {
+  auto const &unit = kUnitCylinder<tSubdivs, tCapped>;
+  return transform_unit_shape(unit.positions, unit.normals, preTransform,
+                              ambient, diffuse, specular, shininess, emissive);
+}
 
-MeshData make_cone(bool capped, const std::size_t subdivs,
-                   const Mat44f &preTransform, const Vec3f &ambient,
+template <std::size_t tSubdivs, bool tCapped>
+MeshData make_cone(const Mat44f &preTransform, const Vec3f &ambient,
                    const Vec3f &diffuse, const Vec3f &specular, float shininess,
-                   const Vec3f &emissive);
+                   const Vec3f &emissive) {
+  auto const &unit = kUnitCone<tSubdivs, tCapped>;
+  return transform_unit_shape(unit.positions, unit.normals, preTransform,
+                              ambient, diffuse, specular, shininess, emissive);
+}
 
-MeshData make_sphere(std::size_t subdivLoops, const Mat44f &preTransform,
-                     const Vec3f &ambient, const Vec3f &diffuse,
-                     const Vec3f &specular, float shininess,
-                     const Vec3f &emissive);
+template <std::size_t tSubdivLoops>
+MeshData make_sphere(const Mat44f &preTransform, const Vec3f &ambient,
+                     const Vec3f &diffuse, const Vec3f &specular,
+                     float shininess, const Vec3f &emissive) {
+  auto const &unit = kUnitSphere<tSubdivLoops>;
+  return transform_unit_shape(unit.positions, unit.normals, preTransform,
+                              ambient, diffuse, specular, shininess, emissive);
+}
 
 #endif
@@ -0,0 +1,240 @@
+#include "simplify.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+namespace {
+// Symmetric 4x4 quadric, stored as its upper triangle
+struct Quadric {
+  double a2, ab, ac, ad;
+  double b2, bc, bd;
+  double c2, cd;
+  double d2;
+};
+
+Quadric plane_quadric(Vec3f aNormal, float aDist) {
+  double const a = aNormal.x, b = aNormal.y, c = aNormal.z, d = aDist;
+  return Quadric{a * a, a * b, a * c, a * d, b * b, b * c,
+                 b * d, c * c, c * d, d * d};
+}
+
+Quadric& operator+=(Quadric& aLeft, Quadric const& aRight) {
+  aLeft.a2 += aRight.a2;
+  aLeft.ab += aRight.ab;
+  aLeft.ac += aRight.ac;
+  aLeft.ad += aRight.ad;
+  aLeft.b2 += aRight.b2;
+  aLeft.bc += aRight.bc;
+  aLeft.bd += aRight.bd;
+  aLeft.c2 += aRight.c2;
+  aLeft.cd += aRight.cd;
+  aLeft.d2 += aRight.d2;
+  return aLeft;
+}
+
+// Sum of squared distances of aPos to the planes accumulated in aQ
+double evaluate(Quadric const& aQ, Vec3f aPos) {
+  double const x = aPos.x, y = aPos.y, z = aPos.z;
+  double const r = aQ.a2 * x * x + 2 * aQ.ab * x * y + 2 * aQ.ac * x * z +
+                   2 * aQ.ad * x + aQ.b2 * y * y + 2 * aQ.bc * y * z +
+                   2 * aQ.bd * y + aQ.c2 * z * z + 2 * aQ.cd * z + aQ.d2;
+  return r > 0.0 ? r : 0.0;
+}
+
+struct Collapse {
+  double cost;
+  std::uint32_t from, to;
+  std::uint32_t fromStamp, toStamp;
+
+  bool operator>(Collapse const& aOther) const { return cost > aOther.cost; }
+};
+
+struct PositionHash {
+  std::size_t operator()(Vec3f const& aPos) const {
+    std::uint32_t bits[3];
+    std::memcpy(bits, &aPos, sizeof(bits));
+    return std::size_t(bits[0]) * 73856093u ^ std::size_t(bits[1]) * 19349663u ^
+           std::size_t(bits[2]) * 83492791u;
+  }
+};
+struct PositionEqual {
+  bool operator()(Vec3f const& aA, Vec3f const& aB) const {
+    return aA.x == aB.x && aA.y == aB.y && aA.z == aB.z;
+  }
+};
+}  // namespace
+
+std::vector<std::uint32_t> simplify_mesh(
+    std::vector<Vec3f> const& aPositions,
+    std::vector<std::uint32_t> const& aIndices, std::size_t aTargetIndexCount,
+    float* aResultError) {
+  std::size_t const vertexCount = aPositions.size();
+  std::size_t const triCount = aIndices.size() / 3;
+
+  // Vertices sharing a position: map each to the first one seen
+  std::vector<std::uint32_t> posGroup(vertexCount);
+  std::vector<std::uint32_t> groupSize(vertexCount, 0);
+  {
+    std::unordered_map<Vec3f, std::uint32_t, PositionHash, PositionEqual> first;
+    first.reserve(vertexCount);
+    for (std::uint32_t v = 0; v < vertexCount; ++v) {
+      auto const it = first.emplace(aPositions[v], v).first;
+      posGroup[v] = it->second;
+      ++groupSize[it->second];
+    }
+  }
+
+  std::vector<bool> locked(vertexCount, false);
+  for (std::uint32_t v = 0; v < vertexCount; ++v)
+    locked[v] = groupSize[posGroup[v]] > 1;
+
+  // Open boundaries: undirected edges with a single adjacent triangle
+  {
+    std::unordered_map<std::uint64_t, std::uint32_t> edgeUse;
+    edgeUse.reserve(triCount * 3);
+    auto key = [&](std::uint32_t aA, std::uint32_t aB) {
+      std::uint64_t const a = posGroup[aA], b = posGroup[aB];
+      return a < b ? (a << 32 | b) : (b << 32 | a);
+    };
+    for (std::size_t t = 0; t < triCount; ++t) {
+      for (std::size_t k = 0; k < 3; ++k)
+        ++edgeUse[key(aIndices[3 * t + k], aIndices[3 * t + (k + 1) % 3])];
+    }
+    std::vector<bool> boundaryGroup(vertexCount, false);
+    for (auto const& [edge, uses] : edgeUse) {
+      if (uses == 1) {
+        boundaryGroup[std::uint32_t(edge >> 32)] = true;
+        boundaryGroup[std::uint32_t(edge & 0xffffffffu)] = true;
+      }
+    }
+    for (std::uint32_t v = 0; v < vertexCount; ++v)
+      locked[v] = locked[v] || boundaryGroup[posGroup[v]];
+  }
+
+  // Triangles, per-vertex adjacency and quadrics
+  std::vector<std::array<std::uint32_t, 3>> tris;
+  tris.reserve(triCount);
+  std::vector<std::vector<std::uint32_t>> vertexTris(vertexCount);
+  std::vector<Quadric> quadrics(vertexCount, Quadric{});
+  for (std::size_t t = 0; t < triCount; ++t) {
+    std::array<std::uint32_t, 3> const tri = {
+        aIndices[3 * t + 0], aIndices[3 * t + 1], aIndices[3 * t + 2]};
+    if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0]) continue;
+
+    Vec3f const p0 = aPositions[tri[0]];
+    Vec3f n = cross(aPositions[tri[1]] - p0, aPositions[tri[2]] - p0);
+    float const len = length(n);
+    if (len > 0.f) n /= len;
+    Quadric const q = plane_quadric(n, -dot(n, p0));
+
+    auto const id = std::uint32_t(tris.size());
+    tris.push_back(tri);
+    for (auto v : tri) {
+      vertexTris[v].push_back(id);
+      quadrics[v] += q;
+    }
+  }
+  std::vector<bool> triAlive(tris.size(), true);
+  std::size_t liveTris = tris.size();
+
+  std::vector<bool> vertexAlive(vertexCount, true);
+  std::vector<std::uint32_t> stamp(vertexCount, 0);
+
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>>
+      heap;
+  auto push = [&](std::uint32_t aFrom, std::uint32_t aTo) {
+    if (locked[aFrom]) return;
+    Quadric q = quadrics[aFrom];
+    q += quadrics[aTo];
+    heap.push(Collapse{evaluate(q, aPositions[aTo]), aFrom, aTo, stamp[aFrom],
+                       stamp[aTo]});
+  };
+  for (auto const& tri : tris) {
+    for (std::size_t k = 0; k < 3; ++k) {
+      push(tri[k], tri[(k + 1) % 3]);
+      push(tri[(k + 1) % 3], tri[k]);
+    }
+  }
+
+  // Rejects collapses that would flip (or degenerate) a remaining triangle
+  auto valid = [&](std::uint32_t aFrom, std::uint32_t aTo) {
+    for (auto t : vertexTris[aFrom]) {
+      if (!triAlive[t]) continue;
+      auto const& tri = tris[t];
+      if (tri[0] == aTo || tri[1] == aTo || tri[2] == aTo) continue;
+
+      std::array<Vec3f, 3> p;
+      for (std::size_t k = 0; k < 3; ++k) p[k] = aPositions[tri[k]];
+      Vec3f const before = cross(p[1] - p[0], p[2] - p[0]);
+      for (std::size_t k = 0; k < 3; ++k)
+        if (tri[k] == aFrom) p[k] = aPositions[aTo];
+      Vec3f const after = cross(p[1] - p[0], p[2] - p[0]);
+
+      if (dot(before, after) <= 0.25f * length(before) * length(after))
+        return false;
+    }
+    return true;
+  };
+
+  double maxCost = 0.0;
+  std::vector<std::uint32_t> neighbours;
+  while (liveTris * 3 > aTargetIndexCount && !heap.empty()) {
+    Collapse const c = heap.top();
+    heap.pop();
+
+    if (!vertexAlive[c.from] || !vertexAlive[c.to]) continue;
+    if (stamp[c.from] != c.fromStamp || stamp[c.to] != c.toStamp) continue;
+    if (!valid(c.from, c.to)) continue;
+
+    // Move `from` onto `to`
+    for (auto t : vertexTris[c.from]) {
+      if (!triAlive[t]) continue;
+      auto& tri = tris[t];
+      if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+        triAlive[t] = false;
+        --liveTris;
+        continue;
+      }
+      for (auto& v : tri)
+        if (v == c.from) v = c.to;
+      vertexTris[c.to].push_back(t);
+    }
+    vertexTris[c.from].clear();
+    vertexAlive[c.from] = false;
+    quadrics[c.to] += quadrics[c.from];
+    ++stamp[c.to];
+    maxCost = std::max(maxCost, c.cost);
+
+    // Drop dead entries and requeue all edges touching `to`
+    auto& adjacent = vertexTris[c.to];
+    adjacent.erase(std::remove_if(adjacent.begin(), adjacent.end(),
+                                  [&](std::uint32_t aT) { return !triAlive[aT]; }),
+                   adjacent.end());
+
+    neighbours.clear();
+    for (auto t : adjacent) {
+      for (auto v : tris[t])
+        if (v != c.to) neighbours.push_back(v);
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()),
+                     neighbours.end());
+    for (auto n : neighbours) {
+      push(c.to, n);
+      push(n, c.to);
+    }
+  }
+
+  std::vector<std::uint32_t> ret;
+  ret.reserve(liveTris * 3);
+  for (std::size_t t = 0; t < tris.size(); ++t) {
+    if (triAlive[t]) ret.insert(ret.end(), tris[t].begin(), tris[t].end());
+  }
+
+  if (aResultError) *aResultError = float(std::sqrt(maxCost));
+  return ret;
+}
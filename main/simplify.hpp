@@ -0,0 +1,29 @@
+#ifndef SIMPLIFY_HPP_C984977C_1D98_4766_9ED2_B0AF70B7824E
+#define SIMPLIFY_HPP_C984977C_1D98_4766_9ED2_B0AF70B7824E
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "../vmlib/vec3.hpp"
+
+/* Mesh simplification with quadric error metrics (Garland & Heckbert '97)
+ *
+ * Reduces the indexed triangle list aIndices to (at most) aTargetIndexCount
+ * indices, if possible, by repeatedly collapsing the cheapest edge. Collapses
+ * are half-edge collapses, i.e. one endpoint moves onto the other. The
+ * result therefore references the same vertices as the input, which lets all
+ * levels of a LOD chain share one vertex buffer.
+ *
+ * Vertices on open boundaries and on attribute seams (several vertices at the
+ * same position, e.g. hard edges or material borders) are never moved.
+ *
+ * If aResultError is non-null, it receives the largest error introduced, in
+ * the units of aPositions.
+ */
+std::vector<std::uint32_t> simplify_mesh(
+    std::vector<Vec3f> const& aPositions,
+    std::vector<std::uint32_t> const& aIndices, std::size_t aTargetIndexCount,
+    float* aResultError = nullptr);
+
+#endif  // SIMPLIFY_HPP_C984977C_1D98_4766_9ED2_B0AF70B7824E
@@ -0,0 +1,459 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <utility>
+
+#include "../support/error.hpp"
+
+namespace {
+Vec3f lerp_(Vec3f aFrom, Vec3f aTo, float aT) {
+  return aFrom + aT * (aTo - aFrom);
+}
+
+// nlerp() takes the short way round, so wrapping the yaw by 2 pi does not
+// spin the view
+CameraPose lerp_(CameraPose const& aFrom, CameraPose const& aTo, float aT) {
+  return CameraPose{lerp_(aFrom.pos, aTo.pos, aT),
+                    nlerp(aFrom.orientation, aTo.orientation, aT)};
+}
+
+SpaceshipPose lerp_(SpaceshipPose const& aFrom, SpaceshipPose const& aTo,
+                    float aT) {
+  return SpaceshipPose{lerp_(aFrom.position, aTo.position, aT),
+                       nlerp(aFrom.orientation, aTo.orientation, aT),
+                       aFrom.throttle + aT * (aTo.throttle - aFrom.throttle)};
+}
+
+// Ticks skipped by a replaySeek event
+constexpr std::uint64_t kReplaySeekTicks = 5 * std::uint64_t(kSimulationRate);
+
+constexpr float kPositionStep = 1e-4f;
+constexpr float kOrientationStep = 1.f / 32768.f;
+constexpr float kThrottleStep = 1.f / 65536.f;
+
+// Model-to-world transform of one of the fleet's ships
+RigidTransform fleet_pose_(FleetPoses const& aShips, std::size_t aShip) {
+  float const c = aShips.cosZ[aShip];
+  float const s = aShips.sinZ[aShip];
+  return RigidTransform{Mat33f{c, -s, 0.f, s, c, 0.f, 0.f, 0.f, 1.f},
+                        Vec3f{aShips.x[aShip], aShips.y[aShip],
+                              aShips.z[aShip]}};
+}
+
+// Box of one of the fleet's ships, given aBox in its own frame. The ships
+// only turn about Z, so this is transform() with the Z row and column
+// left out.
+Aabb fleet_bounds_(FleetPoses const& aShips, std::size_t aShip,
+                   Aabb const& aBox) {
+  float const c = aShips.cosZ[aShip];
+  float const s = aShips.sinZ[aShip];
+  Vec3f const m = center(aBox);
+  Vec3f const h = extent(aBox) / 2.f;
+  Vec3f const centre{c * m.x - s * m.y + aShips.x[aShip],
+                     s * m.x + c * m.y + aShips.y[aShip],
+                     m.z + aShips.z[aShip]};
+  Vec3f const r{std::abs(c) * h.x + std::abs(s) * h.y,
+                std::abs(s) * h.x + std::abs(c) * h.y, h.z};
+  return Aabb{centre - r, centre + r};
+}
+
+float* write_(Vec3f aValue, float* aOut) {
+  *aOut++ = aValue.x;
+  *aOut++ = aValue.y;
+  *aOut++ = aValue.z;
+  return aOut;
+}
+float* write_(Quatf aValue, float* aOut) {
+  *aOut++ = aValue.x;
+  *aOut++ = aValue.y;
+  *aOut++ = aValue.z;
+  *aOut++ = aValue.w;
+  return aOut;
+}
+
+float const* read_(Vec3f& aValue, float const* aIn) {
+  aValue = Vec3f{aIn[0], aIn[1], aIn[2]};
+  return aIn + 3;
+}
+// Quantising leaves the quaternion slightly off unit length
+float const* read_(Quatf& aValue, float const* aIn) {
+  aValue = normalize(Quatf{aIn[0], aIn[1], aIn[2], aIn[3]});
+  return aIn + 4;
+}
+}  // namespace
+
+std::array<float, kSnapshotChannels> snapshot_channel_steps() {
+  std::array<float, kSnapshotChannels> steps;
+  float* out = steps.data();
+  auto const pose = [&out] {
+    out = std::fill_n(out, 3, kPositionStep);
+    out = std::fill_n(out, 4, kOrientationStep);
+  };
+  pose();
+  *out++ = kThrottleStep;
+  for (int camera = 0; camera < 3; ++camera) pose();
+  assert(out == steps.data() + steps.size());
+  return steps;
+}
+
+void write_snapshot_channels(WorldSnapshot const& aSnapshot,
+                             std::span<float> aChannels) {
+  assert(aChannels.size() == kSnapshotChannels);
+  float* out = aChannels.data();
+  out = write_(aSnapshot.spaceship.position, out);
+  out = write_(aSnapshot.spaceship.orientation, out);
+  *out++ = aSnapshot.spaceship.throttle;
+  for (CameraPose const* camera :
+       {&aSnapshot.firstPersonCamera, &aSnapshot.trackingCamera,
+        &aSnapshot.groundedCamera}) {
+    out = write_(camera->pos, out);
+    out = write_(camera->orientation, out);
+  }
+}
+
+WorldSnapshot read_snapshot_channels(std::span<float const> aChannels) {
+  assert(aChannels.size() == kSnapshotChannels);
+  WorldSnapshot snapshot;
+  float const* in = aChannels.data();
+  in = read_(snapshot.spaceship.position, in);
+  in = read_(snapshot.spaceship.orientation, in);
+  snapshot.spaceship.throttle = *in++;
+  for (CameraPose* camera : {&snapshot.firstPersonCamera,
+                             &snapshot.trackingCamera,
+                             &snapshot.groundedCamera}) {
+    in = read_(camera->pos, in);
+    in = read_(camera->orientation, in);
+  }
+  return snapshot;
+}
+
+WorldSnapshot interpolate(WorldSnapshot const& aFrom, WorldSnapshot const& aTo,
+                          float aT) {
+  return WorldSnapshot{
+      lerp_(aFrom.spaceship, aTo.spaceship, aT),
+      lerp_(aFrom.firstPersonCamera, aTo.firstPersonCamera, aT),
+      lerp_(aFrom.trackingCamera, aTo.trackingCamera, aT),
+      lerp_(aFrom.groundedCamera, aTo.groundedCamera, aT)};
+}
+
+float interpolation_factor(SimulationFrame const& aFrame,
+                           Clock::time_point aNow) {
+  float const t =
+      std::chrono::duration_cast<Secondsf>(aNow - aFrame.time).count() /
+      kSimulationStep;
+  return std::clamp(t, 0.f, 1.f);
+}
+
+Simulation::Simulation(Spaceship& aSpaceship, Fleet& aFleet,
+                       Heightfield const& aGround, Camera& aFirstPersonCamera,
+                       Camera& aTrackingCamera, Camera& aGroundedCamera,
+                       SimulationClock aClock)
+    : spaceship(aSpaceship),
+      fleet(aFleet),
+      ground(aGround),
+      firstPersonCamera(aFirstPersonCamera),
+      trackingCamera(aTrackingCamera),
+      groundedCamera(aGroundedCamera),
+      frames(SimulationFrame{capture(), capture(), aFleet.getPoses(),
+                             aFleet.getPoses(), Clock::now(), {}}),
+      previous(capture()),
+      fleetPrevious(aFleet.getPoses()) {
+  // Boxes are set every tick
+  for (std::size_t i = 0; i <= aFleet.size(); ++i) broadPhase.add(Aabb{});
+
+  if (SimulationClock::realTime == aClock)
+    thread = std::jthread([this](std::stop_token aStop) { run(aStop); });
+}
+
+Simulation::~Simulation() {
+  thread.request_stop();
+  if (thread.joinable()) thread.join();
+
+  if (inputRecorder) {
+    try {
+      inputRecorder->close(tickCount() - inputStart);
+    } catch (Error const& eErr) {
+      std::fprintf(stderr, "Unable to finish the input recording: %s\n",
+                   eErr.what());
+    }
+  }
+}
+
+void Simulation::step() {
+  assert(!thread.joinable());
+  advance(Clock::now());
+}
+
+void Simulation::run(std::stop_token aStop) {
+  auto const step = std::chrono::duration_cast<Clock::duration>(
+      Secondsf(kSimulationStep));
+
+  auto next = Clock::now();
+  while (!aStop.stop_requested()) {
+    advance(next);
+    next += step;
+
+    // Sleep until the next tick is due. After a long stall (debugger, slow
+    // machine), skip ahead instead of running a burst of ticks.
+    auto const now = Clock::now();
+    if (now - next > kMaxCatchUpTicks * step) next = now;
+    std::this_thread::sleep_until(next);
+  }
+}
+
+void Simulation::advance(Clock::time_point aTime) {
+  // The slot's vectors keep their capacity, so the copies below do not
+  // allocate once running
+  SimulationFrame& frame = frames.writeBuffer();
+  {
+    std::scoped_lock lock(mutex);
+    applyInput();
+    if (player) {
+      replayTick(frame);
+    } else {
+      tick();
+      frame.current = capture();
+      frame.fleetCurrent = fleet.getPoses();
+      predictor.update(spaceship.getBody(),
+                       std::span(&spaceship.getFlight(), 1));
+      predictor.copyPaths(frame.paths);
+      if (recorder) recordTick(frame.current);
+    }
+    // Jumps are shown as jumps rather than blended
+    if (std::exchange(seeked, false)) {
+      previous = frame.current;
+      fleetPrevious = frame.fleetCurrent;
+    }
+  }
+  frame.previous = previous;
+  frame.fleetPrevious = fleetPrevious;
+  frame.time = aTime;
+
+  previous = frame.current;
+  fleetPrevious = frame.fleetCurrent;
+  frames.publish();
+  ticks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Simulation::applyInput() {
+  std::uint64_t const tick = tickCount() - inputStart;
+  events.clear();
+  input.drain(events);
+  if (inputPlayback) {
+    // What is pushed meanwhile is dropped, so the replay stays exact
+    events.clear();
+    inputPlayback->take(tick, events);
+  }
+
+  for (InputEvent& event : events) {
+    event.tick = tick;
+    if (inputRecorder) {
+      try {
+        inputRecorder->write(event);
+      } catch (Error const& eErr) {
+        std::fprintf(stderr, "Input recording stopped: %s\n", eErr.what());
+        inputRecorder.reset();
+      }
+    }
+    apply(event);
+  }
+}
+
+void Simulation::apply(InputEvent const& aEvent) {
+  switch (aEvent.kind) {
+    case InputKind::cameraKey:
+      firstPersonCamera.updateKeyActions(aEvent.key, aEvent.action);
+      break;
+    case InputKind::shipKey:
+      spaceship.updateKeyActions(aEvent.key, aEvent.action);
+      fleet.updateKeyActions(aEvent.key, aEvent.action);
+      break;
+    case InputKind::cursor:
+      firstPersonCamera.updateMouseMovement(aEvent.x, aEvent.y);
+      break;
+    case InputKind::mouseLook:
+      firstPersonCamera.setMouseLook(0 != aEvent.action);
+      break;
+    case InputKind::cameraStop:
+      firstPersonCamera.resetState();
+      break;
+    case InputKind::launch:
+      spaceship.launch();
+      fleet.launch();
+      break;
+    case InputKind::reset:
+      spaceship.resetState();
+      fleet.resetState();
+      break;
+    case InputKind::replaySeek:
+      if (GLFW_KEY_LEFT == aEvent.key) {
+        std::uint64_t const tick = replayTick();
+        seekReplay(tick > kReplaySeekTicks ? tick - kReplaySeekTicks : 0);
+      } else if (GLFW_KEY_RIGHT == aEvent.key) {
+        seekReplay(replayTick() + kReplaySeekTicks);
+      } else if (GLFW_KEY_HOME == aEvent.key) {
+        seekReplay(0);
+      }
+      break;
+    case InputKind::end:
+      break;
+  }
+}
+
+void Simulation::tick() {
+  Vec3f const from = spaceship.getPosition();
+  spaceship.animate(kSimulationStep);
+  fleet.update(kSimulationStep);
+  resolveCollisions(from);
+  firstPersonCamera.updateState(kSimulationStep);
+  trackingCamera.track(spaceship.getPosition());
+  keepCamerasAboveGround();
+  groundedCamera.pointAt(spaceship.getPosition());
+}
+
+void Simulation::resolveCollisions(Vec3f aFrom) {
+  CollisionShape const& shape = spaceship.getCollisionShape();
+  FleetPoses const& ships = fleet.getPoses();
+  std::size_t const count = ships.size();
+
+  // A box of half-width r holds the player's ship however it is turned;
+  // its body's box is the one that swept from aFrom this tick
+  float const r = shape.boundingRadius;
+  Vec3f const reach{r, r, r};
+  Vec3f const position = spaceship.getPosition();
+  broadPhase.setBounds(0, Aabb{component_min(aFrom, position) - reach,
+                               component_max(aFrom, position) + reach});
+
+  // Fleet ships whose box dips into the ground are lifted out first
+  fleetPositions.resize(count);
+  fleetGround.resize(count);
+  for (std::size_t i = 0; i < count; ++i)
+    fleetPositions[i] = Vec3f{ships.x[i], ships.y[i], ships.z[i]};
+  ground.heightsAt(fleetPositions, fleetGround, 0, count);
+  for (std::size_t i = 0; i < count; ++i) {
+    Aabb box = fleet_bounds_(ships, i, shape.bounds);
+    float const below = fleetGround[i] - box.min.y;
+    if (below > 0.f) {
+      fleet.displace(i, Vec3f{0.f, below, 0.f});
+      box.min.y += below;
+      box.max.y += below;
+    }
+    broadPhase.setBounds(BroadPhase::BodyId(i + 1), box);
+  }
+  broadPhase.update();
+
+  // The player's ship is pushed all the way out of a fleet ship, which
+  // keeps to its curve; two fleet ships are pushed apart half way each
+  for (BroadPhasePair const& pair : broadPhase.pairs()) {
+    std::size_t const b = pair.b - 1;
+    Contact contact;
+    if (0 == pair.a) {
+      if (collide(shape, make_model2world(spaceship.getPose()), shape,
+                  fleet_pose_(ships, b), contact))
+        spaceship.resolveContact(contact);
+    } else {
+      std::size_t const a = pair.a - 1;
+      if (collide(shape, fleet_pose_(ships, a), shape, fleet_pose_(ships, b),
+                  contact)) {
+        Vec3f const half = contact.normal * (0.5f * contact.depth);
+        fleet.displace(a, half);
+        fleet.displace(b, -half);
+      }
+    }
+  }
+}
+
+void Simulation::keepCamerasAboveGround() {
+  Camera* const cameras[] = {&firstPersonCamera, &trackingCamera,
+                             &groundedCamera};
+  Vec3f positions[std::size(cameras)];
+  float heights[std::size(cameras)];
+  for (std::size_t i = 0; i < std::size(cameras); ++i)
+    positions[i] = cameras[i]->getCamWorldPosition();
+  ground.heightsAt(positions, heights, 0, std::size(cameras));
+  for (std::size_t i = 0; i < std::size(cameras); ++i)
+    cameras[i]->keepAbove(heights[i]);
+}
+
+WorldSnapshot Simulation::capture() const {
+  return WorldSnapshot{spaceship.getPose(), firstPersonCamera.getPose(),
+                       trackingCamera.getPose(), groundedCamera.getPose()};
+}
+
+void Simulation::record(char const* aPath) {
+  recorder.reset();
+  recorder.emplace(aPath, snapshot_channel_steps());
+}
+
+void Simulation::replay(char const* aPath) {
+  RecordingReader reader(aPath);
+  if (kSnapshotChannels != reader.channelCount() || 0 == reader.tickCount())
+    throw Error("'%s' is not a recording of the simulation", aPath);
+  reader.seek(0);
+  player.emplace(std::move(reader));
+  replaying.store(true, std::memory_order_relaxed);
+  seeked = true;
+}
+
+std::uint64_t Simulation::replayTick() const {
+  return player ? player->tick() : 0;
+}
+
+void Simulation::seekReplay(std::uint64_t aTick) {
+  if (!player) return;
+  try {
+    player->seek(std::min(aTick, player->tickCount() - 1));
+  } catch (Error const& eErr) {
+    stopReplay(eErr.what());
+  }
+  seeked = true;
+}
+
+void Simulation::stopReplay(char const* aReason) {
+  // The simulation carries on from where it was before the replay
+  std::fprintf(stderr, "Replay stopped: %s\n", aReason);
+  player.reset();
+  replaying.store(false, std::memory_order_relaxed);
+  seeked = true;
+}
+
+void Simulation::recordInput(char const* aPath) {
+  inputRecorder.reset();
+  inputRecorder.emplace(aPath, kSimulationRate);
+  inputStart = tickCount();
+}
+
+std::uint64_t Simulation::replayInput(char const* aPath) {
+  inputPlayback.reset();
+  inputPlayback.emplace(aPath, kSimulationRate);
+  inputStart = tickCount();
+  return inputPlayback->tickCount();
+}
+
+void Simulation::recordTick(WorldSnapshot const& aSnapshot) {
+  write_snapshot_channels(aSnapshot, recorded);
+  try {
+    recorder->append(recorded);
+  } catch (Error const& eErr) {
+    // Most likely out of disk space; what was written so far is kept
+    std::fprintf(stderr, "Recording stopped: %s\n", eErr.what());
+    recorder.reset();
+  }
+}
+
+void Simulation::replayTick(SimulationFrame& aFrame) {
+  // A seek has already decoded the tick to show
+  try {
+    if (!seeked) player->next();
+    aFrame.current = read_snapshot_channels(player->values());
+  } catch (Error const& eErr) {
+    stopReplay(eErr.what());
+    aFrame.current = previous;  // the tick shown last
+  }
+  aFrame.fleetCurrent = fleet.getPoses();
+  aFrame.paths.clear();
+}
@@ -0,0 +1,199 @@
+#ifndef SIMULATION_HPP_A3F1D2C7_6B48_4E5A_9C0D_8E27B4F61A93
+#define SIMULATION_HPP_A3F1D2C7_6B48_4E5A_9C0D_8E27B4F61A93
+
+#include <glad/glad.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <thread>
+
+#include "camera.hpp"
+#include "collision.hpp"
+#include "defaults.hpp"
+#include "fleet.hpp"
+#include "heightfield.hpp"
+#include "input.hpp"
+#include "recording.hpp"
+#include "spaceship.hpp"
+#include "trajectory.hpp"
+#include "triple_buffer.hpp"
+
+constexpr float kSimulationRate = 120.f;  // ticks per second
+constexpr float kSimulationStep = 1.f / kSimulationRate;
+// If the simulation falls further behind than this, the missed ticks are
+// dropped instead of being run back to back
+constexpr int kMaxCatchUpTicks = 8;
+
+// Everything the renderer needs from one simulation tick
+struct WorldSnapshot {
+  SpaceshipPose spaceship;
+  CameraPose firstPersonCamera;
+  CameraPose trackingCamera;
+  CameraPose groundedCamera;
+};
+
+// A WorldSnapshot as recording channels: the ship's position, orientation
+// and throttle, then each camera's position and orientation
+constexpr std::size_t kSnapshotChannels = 3 + 4 + 1 + 3 * (3 + 4);
+
+// Positions to a tenth of a millimetre, quaternion components to 2^-15
+std::array<float, kSnapshotChannels> snapshot_channel_steps();
+// aChannels holds kSnapshotChannels values
+void write_snapshot_channels(WorldSnapshot const&, std::span<float> aChannels);
+WorldSnapshot read_snapshot_channels(std::span<float const> aChannels);
+
+// The two most recent ticks. `current` became valid at `time`.
+struct SimulationFrame {
+  WorldSnapshot previous;
+  WorldSnapshot current;
+  FleetPoses fleetPrevious;
+  FleetPoses fleetCurrent;
+  Clock::time_point time;
+  // Where the player's ship is going as of `current`, kPredictionSteps + 1
+  // points (see TrajectoryPredictor)
+  std::vector<Vec3f> paths;
+};
+
+// Whether a Simulation ticks on its own thread in real time, or only when
+// step() is called, e.g. to replay input as fast as possible
+enum class SimulationClock { realTime, manual };
+
+// How far aNow is between frame.previous (0) and frame.current (1)
+float interpolation_factor(SimulationFrame const&,
+                           Clock::time_point aNow = Clock::now());
+
+// Blends between the two ticks; aT = 0 gives aFrom, aT = 1 gives aTo
+WorldSnapshot interpolate(WorldSnapshot const& aFrom, WorldSnapshot const& aTo,
+                          float aT);
+
+/* Simulation: advances the ship and cameras at a fixed rate on its own thread
+ *
+ * The renderer calls read() once per frame and draws the frame interpolated by
+ * interpolation_factor(), which lags the newest tick by up to one step in
+ * exchange for smooth motion.
+ * Input reaches the simulated objects only as events pushed to getInput()
+ * (see input.hpp), which are applied at the start of the next tick, so
+ * recorded input replays exactly. Ships are kept out of each other, and
+ * ships and cameras above the ground.
+ *
+ * Every tick can be recorded to a file (see RecordingWriter). A recording
+ * is replayed in place of ticking, from any tick; the fleet stays where it
+ * was, as it is not recorded.
+ */
+class Simulation {
+ public:
+  Simulation(Spaceship& aSpaceship, Fleet& aFleet, Heightfield const& aGround,
+             Camera& aFirstPersonCamera, Camera& aTrackingCamera,
+             Camera& aGroundedCamera,
+             SimulationClock aClock = SimulationClock::realTime);
+  ~Simulation();
+
+  Simulation(Simulation const&) = delete;
+  Simulation& operator=(Simulation const&) = delete;
+
+  std::unique_lock<std::mutex> lock() {
+    return std::unique_lock<std::mutex>(mutex);
+  }
+
+  // Any thread
+  InputQueue& getInput() { return input; }
+
+  // Runs a tick now; SimulationClock::manual only
+  void step();
+
+  // Most recent frame. Valid until the next call; render thread only.
+  SimulationFrame const& read() { return frames.read(); }
+
+  // Number of ticks run so far
+  std::uint64_t tickCount() const {
+    return ticks.load(std::memory_order_relaxed);
+  }
+
+  // Any thread
+  bool isReplaying() const {
+    return replaying.load(std::memory_order_relaxed);
+  }
+
+  // The following hold lock(); record(), replay() and the input ones throw
+  // Error
+
+  // Records every tick from the next on into a new file at aPath
+  void record(char const* aPath);
+  // Shows the ticks recorded in aPath from the first, instead of ticking;
+  // the last is held at the end
+  void replay(char const* aPath);
+  // The tick of the recording shown last, and which to show next. Ticks
+  // past the end are the last. A damaged recording stops the replay, here
+  // or later while it plays.
+  std::uint64_t replayTick() const;
+  void seekReplay(std::uint64_t aTick);
+
+  // Records the input applied from the next tick on into a new file at
+  // aPath; the recording ends with the simulation
+  void recordInput(char const* aPath);
+  // Applies the input recorded in aPath from the next tick on, instead of
+  // what is pushed; returns the ticks the recording covers
+  std::uint64_t replayInput(char const* aPath);
+
+ private:
+  void run(std::stop_token aStop);
+  // One tick, shown from aTime on
+  void advance(Clock::time_point aTime);
+  void applyInput();
+  void apply(InputEvent const&);
+  void tick();
+  // Pushes the ships out of each other and the fleet's out of the ground;
+  // the player's ship was at aFrom before this tick
+  void resolveCollisions(Vec3f aFrom);
+  void keepCamerasAboveGround();
+  WorldSnapshot capture() const;
+  void recordTick(WorldSnapshot const&);
+  void replayTick(SimulationFrame&);
+  // Reports why and goes back to ticking
+  void stopReplay(char const* aReason);
+
+  Spaceship& spaceship;
+  Fleet& fleet;
+  Heightfield const& ground;
+  Camera& firstPersonCamera;
+  Camera& trackingCamera;
+  Camera& groundedCamera;
+
+  TrajectoryPredictor predictor;
+  // Body 0 is the player's ship, body i + 1 the fleet's ship i
+  BroadPhase broadPhase;
+  std::vector<Vec3f> fleetPositions;
+  std::vector<float> fleetGround;  // height under each fleet ship
+
+  std::mutex mutex;
+  TripleBuffer<SimulationFrame> frames;
+  std::atomic<std::uint64_t> ticks{0};
+  // The tick before the last one published; simulation thread only
+  WorldSnapshot previous;
+  FleetPoses fleetPrevious;
+
+  InputQueue input;
+  std::vector<InputEvent> events;  // this tick's
+  std::optional<InputRecorder> inputRecorder;
+  std::optional<InputPlayback> inputPlayback;
+  // Recorded input is stamped with ticks since this one
+  std::uint64_t inputStart = 0;
+
+  std::optional<RecordingWriter> recorder;
+  std::array<float, kSnapshotChannels> recorded{};
+  std::optional<RecordingReader> player;
+  std::atomic<bool> replaying{false};  // player, for other threads
+  // A seek since the last tick; the next frame is not blended with the
+  // one before
+  bool seeked = false;
+
+  // Started last, stopped and joined first (see ~Simulation)
+  std::jthread thread;
+};
+
+#endif  // SIMULATION_HPP_A3F1D2C7_6B48_4E5A_9C0D_8E27B4F61A93
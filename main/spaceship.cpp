@@ -2,157 +2,269 @@
 
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <array>
-#include <numbers>
+#include <cmath>
+#include <span>
 
 #include "../vmlib/mat33.hpp"
 
-Spaceship::Spaceship() {
-  // Global Colours
-  Vec3f red = {1.f, 0.f, 0.f};
-  Vec3f green = {0.f, 1.f, 0.f};
-  Vec3f blue = {0.f, 0.f, 1.f};
-  Vec3f black = {0.f, 0.f, 0.f};
-  Vec3f white = {0.1f, 0.1f, 0.1f};
-
-  // Some parts relative to central body transformation
-  Mat44f centralBody = make_rotation_z(0.5f * std::numbers::pi_v<float>) *
-                       make_scaling(2.f, 5.f, 5.f);
-  MeshData body1 =
-      make_cylinder(true, 32, centralBody, white, white, white, 100, black);
-
-  // Smaller scaling + offset from central body
-  MeshData body2 =
-      make_cylinder(false, 32,
-                    make_translation({0.f, 2.f, 0.f}) * centralBody *
-                        make_scaling(0.5f, 0.8f, 0.81f),
-                    white, white, white, 100, black);
-
-  // Smaller width + offset from central body
-  MeshData cone1 = make_cone(true, 32,
-                             make_translation({0.f, 3.f, 0.f}) * centralBody *
-                                 make_scaling(0.5f, 1.f, 1.f),
-                             white, white, white, 100, black);
-
-  // Larger radius, smaller width + offset from central body
-  MeshData cone2 = make_cone(true, 32,
-                             make_translation({0.f, 1.f, 0.f}) * centralBody *
-                                 make_scaling(0.5f, 1.6f, 1.6f),
-                             white, white, white, 100, black);
-
-  // Smaller width and flipped compared to central body
-  MeshData cone3 =
-      make_cone(false, 32,
-                centralBody * make_rotation_z(std::numbers::pi_v<float>) *
-                    make_scaling(0.5f, 1.f, 1.f),
-                white, white, white, 100, black);
-
-  Mat44f legTransform = make_translation({2.f, 0.f, 0.f}) *
-                        make_rotation_z(-0.5f * std::numbers::pi_v<float>) *
-                        make_scaling(2.f, 0.1f, .1f);
-
-  // Relative to leg transform
-  MeshData leg1 =
-      make_cylinder(true, 32, legTransform, white, white, white, 100, black);
-
-  MeshData leg2 = make_cylinder(
-      true, 32,
-      make_rotation_y(2.f * std::numbers::pi_v<float> / 3.f) * legTransform,
-      white, white, white, 100, black);
-
-  MeshData leg3 = make_cylinder(
-      true, 32,
-      make_rotation_y(4.f * std::numbers::pi_v<float> / 3.f) * legTransform,
-      white, white, white, 100, black);
-
-  MeshData stem =
-      make_cylinder(true, 32,
-                    make_translation({0.f, 4.f, 0.f}) *
-                        make_rotation_z(0.5f * std::numbers::pi_v<float>) *
-                        make_scaling(2.f, 0.05f, 0.05f),
-                    white, white, white, 100, black);
-
-  MeshData ball1 = make_sphere(
-      2, make_translation({0.f, 5.f, 0.f}) * make_scaling(0.5f, 0.5f, 0.5f),
-      white, white, white, 100, black);
-
-  MeshData ball2 = make_sphere(
-      2, make_translation({0.f, 8.f, 0.f}) * make_scaling(0.5f, 2.f, 0.5f),
-      white, white, white, 100, black);
-
-  // Concatenate all parts of the spaceship
-  MeshData mesh = concatenate(std::move(body1), body2);
-  mesh = concatenate(std::move(mesh), cone1);
-  mesh = concatenate(std::move(mesh), cone2);
-  mesh = concatenate(std::move(mesh), cone3);
-  mesh = concatenate(std::move(mesh), leg1);
-  mesh = concatenate(std::move(mesh), leg2);
-  mesh = concatenate(std::move(mesh), leg3);
-  mesh = concatenate(std::move(mesh), ball1);
-  mesh = concatenate(std::move(mesh), ball2);
-  mesh = concatenate(std::move(mesh), stem);
-
-  Mat44f scaling = make_scaling(0.04f, 0.04f, 0.04f);
-  // Apply scaling to all vertices
-  // Normals are not effected
-  for (auto& p : mesh.positions) {
-    Vec4f p4{p.x, p.y, p.z, 1.f};
-    Vec4f t = scaling * p4;
-    t /= t.w;
-    p = Vec3f{t.x, t.y, t.z};
+namespace {
+// Flight model, in world units. Gravity is scaled to the ship, which is
+// about 0.4 units tall.
+constexpr Vec3f kGravity{0.f, -0.5f, 0.f};
+constexpr float kShipMass = 1.f;
+constexpr float kShipRadius = 0.2f;
+constexpr float kShipHeight = 0.4f;
+// How fast the attitude controller turns the ship, rad/s
+constexpr float kAttitudeFrequency = 4.f;
+// Half the width of landingpad.obj; within it of its starting position the
+// ship stands on its pad rather than on the ground
+constexpr float kPadRadius = 0.5f;
+
+// The launch: thrust (mass times acceleration) and tilt that follow the
+// curve x = 0.005 t^3, y = 0.08 t^2 the ship used to be animated along,
+// i.e. the thrust direction and size of its acceleration minus gravity
+constexpr ThrustKey kLaunchProfile[] = {
+    {0.f, 0.66f, 0.f},       {5.f, 0.677f, -0.223f},
+    {10.f, 0.725f, -0.426f}, {20.f, 0.892f, -0.738f},
+    {40.f, 1.369f, -1.068f},
+};
+constexpr float kMaxThrust = 1.369f;
+
+// One primitive of the ship, tessellated for one level of detail
+template <std::size_t tSegments, std::size_t tSphereLoops>
+MeshData make_part_mesh_(ScenePart const& aPart) {
+  Mat44f const transform = to_mat44(aPart.transform);
+  auto make = [&](auto aShape) {
+    return aShape(transform, aPart.ambient, aPart.diffuse, aPart.specular,
+                  aPart.shininess, aPart.emissive);
+  };
+  switch (aPart.shape) {
+    case SceneShape::cylinder:
+      return aPart.capped ? make(make_cylinder<tSegments, true>)
+                          : make(make_cylinder<tSegments, false>);
+    case SceneShape::cone:
+      return aPart.capped ? make(make_cone<tSegments, true>)
+                          : make(make_cone<tSegments, false>);
+    case SceneShape::sphere:
+      break;
+  }
+  return make(make_sphere<tSphereLoops>);
+}
+
+// The parts of one group concatenated, in model units (leg parts are in the
+// space of one leg). Instantiated once per level of detail.
+template <std::size_t tSegments, std::size_t tSphereLoops>
+MeshData make_group_mesh_(SceneFile const& aScene, ScenePartGroup aGroup) {
+  MeshData mesh;
+  for (ScenePart const& part : aScene.parts()) {
+    if (aGroup == part.group) {
+      mesh = concatenate(std::move(mesh),
+                         make_part_mesh_<tSegments, tSphereLoops>(part));
+    }
+  }
+  return mesh;
+}
+
+MeshData transform_mesh_(MeshData aMesh, Affine34f const& aTransform) {
+  Mat33f const normalMatrix = normal_matrix(aTransform);
+  for (auto& p : aMesh.positions) p = transform_point(aTransform, p);
+  for (auto& n : aMesh.normals) n = normalize(normalMatrix * n);
+  return aMesh;
+}
+
+// Capsules of one part, whose unit shape aTransform places in the ship
+void add_part_capsules_(CollisionShape& aShape, ScenePart const& aPart,
+                        Affine34f const& aTransform) {
+  Affine34f const transform = aTransform * to_affine34(aPart.transform);
+  Vec3f const origin = transform_point(transform, Vec3f{0.f, 0.f, 0.f});
+  Vec3f const axes[3] = {transform_vector(transform, Vec3f{1.f, 0.f, 0.f}),
+                         transform_vector(transform, Vec3f{0.f, 1.f, 0.f}),
+                         transform_vector(transform, Vec3f{0.f, 0.f, 1.f})};
+  if (SceneShape::sphere == aPart.shape) {
+    add_ellipsoid_capsule(aShape, origin, axes);
+  } else {
+    add_cylinder_capsules(aShape, origin, origin + axes[0],
+                          std::max(length(axes[1]), length(axes[2])),
+                          SceneShape::cone == aPart.shape);
   }
+}
 
-  vao = create_vao(mesh);
-  numVertices = GLsizei(mesh.positions.size());
+// Levels of detail come from coarser primitive tessellations, which beats
+// simplifying the finest mesh for these analytic shapes.
+std::vector<MeshData> make_group_meshes_(SceneFile const& aScene,
+                                         ScenePartGroup aGroup) {
+  return {make_group_mesh_<32, 2>(aScene, aGroup),
+          make_group_mesh_<16, 1>(aScene, aGroup),
+          make_group_mesh_<8, 1>(aScene, aGroup),
+          make_group_mesh_<6, 0>(aScene, aGroup)};
+}
+}  // namespace
 
+std::vector<MeshData> make_spaceship_meshes(SceneFile const& aScene) {
+  std::vector<MeshData> hull =
+      make_group_meshes_(aScene, ScenePartGroup::hull);
+  std::vector<MeshData> const legs =
+      make_group_meshes_(aScene, ScenePartGroup::leg);
+
+  float const scale = aScene.header().shipScale;
+  Affine34f const scaling = to_affine34(make_scaling(scale, scale, scale));
+  for (std::size_t level = 0; level < hull.size(); ++level) {
+    for (SceneLeg const& leg : aScene.legs()) {
+      hull[level] =
+          concatenate(std::move(hull[level]),
+                      transform_mesh_(legs[level], to_affine34(leg.placement)));
+    }
+    hull[level] = transform_mesh_(std::move(hull[level]), scaling);
+  }
+  return hull;
+}
+
+CollisionShape make_spaceship_collision_shape(SceneFile const& aScene) {
+  float const scale = aScene.header().shipScale;
+  Affine34f const scaling = to_affine34(make_scaling(scale, scale, scale));
+
+  CollisionShape shape;
+  for (ScenePart const& part : aScene.parts()) {
+    if (ScenePartGroup::hull == part.group) {
+      add_part_capsules_(shape, part, scaling);
+    } else {
+      for (SceneLeg const& leg : aScene.legs())
+        add_part_capsules_(shape, part,
+                           scaling * to_affine34(leg.placement));
+    }
+  }
+  update_bounds(shape);
+  return shape;
+}
+
+RigidTransform make_model2world(SpaceshipPose const& aPose) {
+  return {to_mat33(aPose.orientation), aPose.position};
+}
+
+Spaceship::Spaceship(SceneGraph& aGraph, SceneFile const& aScene)
+    : Spaceship(aScene) {
+  hullLod =
+      create_lod_chain(make_group_meshes_(aScene, ScenePartGroup::hull));
+  if (!aScene.legs().empty())
+    legLod = create_lod_chain(make_group_meshes_(aScene, ScenePartGroup::leg));
+
+  // Nodes: ship (pose) -> model (scale) -> hull and legs
+  float const scale = aScene.header().shipScale;
+  rootNode = aGraph.add(kNoNode);
+  NodeId const model = aGraph.add(
+      rootNode, TrsTransform{{0.f, 0.f, 0.f}, kIdentityQuatf,
+                             {scale, scale, scale}});
+  hullNode = aGraph.add(model, {}, hullLod.bounds);
+  for (SceneLeg const& leg : aScene.legs())
+    legNodes.push_back(aGraph.add(model, leg.placement, legLod.bounds));
+  legLodStates.resize(legNodes.size());
+}
+
+Spaceship::Spaceship(SceneFile const& aScene) {
   // Light
-  lightOffsets = {Vec3f{0.21f, -0.02f, 0.f}, Vec3f{-0.21f, -0.02f, 0.f},
-                  Vec3f{0.f, 0.45f, 0.f}};
-  lightAmbient = {red / 1000, green / 1000, blue / 1000};
-  lightDiffuse = {Vec3f{1.f, 0.2f, 0.2f}, Vec3f{0.2f, 1.f, 0.2f},
-                  Vec3f{0.2f, 0.2f, 1.f}};
-  // Animation
-  initialPosition = Vec3f{-5.0f, 0.1f, 3.5};
+  std::span<SceneLight const> const lights = aScene.lights();
+  for (std::size_t i = 0; i < lights.size(); ++i) {
+    lightOffsets[i] = lights[i].offset;
+    lightAmbient[i] = lights[i].ambient;
+    lightDiffuse[i] = lights[i].diffuse;
+  }
+  emitters = aScene.emitters();
+  collisionShape = make_spaceship_collision_shape(aScene);
+
+  // Flight
+  flight.pad = aScene.header().shipPosition;
+  flight.footClearance = 0.f;
+  for (Capsule const& capsule : collisionShape.capsules) {
+    flight.footClearance =
+        std::max(flight.footClearance,
+                 capsule.radius - std::min(capsule.a.y, capsule.b.y));
+  }
 
   resetState();
 }
 
 void Spaceship::resetState() {
-  time = 0.f;
-  position = initialPosition;
-  rotationZ = 0;
-  animationRunning = false;
+  flight.engineOn = false;
+  flight.time = 0.f;
+  throttle = 0.f;
+  position = flight.pad;
+  orientation = kIdentityQuatf;
 
-  updateMatrices();
+  body.clear();
+  body.add(kShipMass,
+           make_cylinder_moments(kShipMass, kShipRadius, kShipHeight),
+           position, orientation);
 }
 
-void Spaceship::updateMatrices() {
-  model2world = make_translation(position) * make_rotation_z(rotationZ);
-  normalMatrix = mat44_to_mat33(transpose(invert(model2world)));
+void fly_ships(RigidBodies& aShips, std::span<ShipFlight> aFlights,
+               float aDt, std::size_t aBegin, std::size_t aEnd) {
+  for (std::size_t i = aBegin; i < aEnd; ++i) {
+    ShipFlight& flight = aFlights[i];
+    ThrustKey control{0.f, 0.f, 0.f};
+    if (flight.engineOn) {
+      flight.time += aDt;
+      control = sample_thrust_profile(kLaunchProfile, flight.time);
+    }
+    aShips.thrust[i] = control.thrust;
+    Vec3f const torque = attitude_torque(
+        aShips, i, make_quat_rotation_z(control.tilt), kAttitudeFrequency);
+    aShips.tx[i] = torque.x;
+    aShips.ty[i] = torque.y;
+    aShips.tz[i] = torque.z;
+  }
+
+  integrate_rigid_bodies(aShips, kGravity, aDt, aBegin, aEnd);
+
+  for (std::size_t i = aBegin; i < aEnd; ++i) {
+    ShipFlight const& flight = aFlights[i];
+    float floor = flight.pad.y;
+    if (flight.ground) {
+      float const dx = aShips.x[i] - flight.pad.x;
+      float const dz = aShips.z[i] - flight.pad.z;
+      float const terrain =
+          flight.ground->heightAt(aShips.x[i], aShips.z[i]) +
+          flight.footClearance;
+      bool const onPad = dx * dx + dz * dz < kPadRadius * kPadRadius;
+      floor = onPad ? std::max(terrain, flight.pad.y) : terrain;
+    }
+    if (aShips.y[i] < floor) {
+      aShips.y[i] = floor;
+      aShips.vx[i] = 0.f;
+      aShips.vy[i] = std::max(aShips.vy[i], 0.f);
+      aShips.vz[i] = 0.f;
+    }
+  }
 }
 
 void Spaceship::animate(float dt) {
-  if (animationRunning) {
-    time += dt;
-    float kX = 0.005f;
-    float kY = 0.08f;
-    float x = kX * time * time * time;
-    float y = kY * time * time;
-    position = initialPosition + Vec3f{x, y, 0.f};
-
-    // Rotation
-    float dx = 3 * kX * time * time;
-    float dy = 2 * kY * time;
-    rotationZ = std::atan2(dy, dx) - 0.5f * std::numbers::pi_v<float>;
-
-    updateMatrices();
+  fly_ships(body, std::span(&flight, 1), dt, 0, 1);
+  throttle = body.thrust[0] / kMaxThrust;
+  position = body.position(0);
+  orientation = body.orientation(0);
+}
+
+void Spaceship::resolveContact(Contact const& aContact) {
+  Vec3f const push = aContact.normal * aContact.depth;
+  body.x[0] += push.x;
+  body.y[0] += push.y;
+  body.z[0] += push.z;
+
+  // Keep only the velocity that leaves the contact
+  float const closing = dot(body.velocity(0), aContact.normal);
+  if (closing < 0.f) {
+    body.vx[0] -= aContact.normal.x * closing;
+    body.vy[0] -= aContact.normal.y * closing;
+    body.vz[0] -= aContact.normal.z * closing;
   }
+  position = body.position(0);
 }
 
 void Spaceship::updateKeyActions(int aKey, int aAction) {
   // F-Key start and stop animation
   if (GLFW_KEY_F == aKey && GLFW_PRESS == aAction) {
-    animationRunning = !animationRunning;
+    flight.engineOn = !flight.engineOn;
   }
 
   // R-Key spaceship animation reset
@@ -3,62 +3,165 @@
 
 #include <array>
 #include <iostream>
+#include <span>
+#include <vector>
 
+#include "../vmlib/affine34.hpp"
 #include "../vmlib/mat33.hpp"
 #include "../vmlib/mat44.hpp"
+#include "../vmlib/quat.hpp"
+#include "bvh.hpp"
+#include "collision.hpp"
+#include "heightfield.hpp"
+#include "lod.hpp"
 #include "mesh.hpp"
+#include "rigid_body.hpp"
 #include "scene.hpp"
+#include "scene_file.hpp"
+#include "scene_graph.hpp"
 #include "shape.hpp"
 
+// The part of the ship's state needed for rendering
+struct SpaceshipPose {
+  Vec3f position;
+  Quatf orientation;
+  float throttle;  // engine output, 0 to 1
+};
+
+RigidTransform make_model2world(SpaceshipPose const&);
+
+// Capsules around the ship's parts, in world units in the ship's frame
+CollisionShape make_spaceship_collision_shape(SceneFile const&);
+
+// How a ship flies, besides the state of its body
+struct ShipFlight {
+  bool engineOn = false;
+  float time = 0.f;  // into the launch profile
+  Vec3f pad{};       // where the ship starts, standing on its pad
+  // Height of the origin above the lowest point of the collision shape
+  float footClearance = 0.f;
+  Heightfield const* ground = nullptr;  // without it, the pad is everywhere
+};
+
+// One tick for ships [aBegin, aEnd) of aShips, ship i flying aFlights[i].
+// While its engine is on a ship follows the launch profile; otherwise it
+// levels itself and falls. The ground, or its pad, holds a ship up until
+// the thrust beats its weight; standing, it does not slide.
+void fly_ships(RigidBodies& aShips, std::span<ShipFlight> aFlights,
+               float aDt, std::size_t aBegin, std::size_t aEnd);
+
+// The whole ship as one mesh at each level of detail, finest first, in
+// world units
+std::vector<MeshData> make_spaceship_meshes(SceneFile const&);
+
+/* Spaceship
+ *
+ * animate() and the input handlers belong to the simulation thread. The
+ * renderer only uses the pose it was handed (see simulation.hpp) together
+ * with the const drawing helpers.
+ *
+ * The hull and each leg are separate scene graph nodes below one root node
+ * that follows the pose, so parts can be moved without rebuilding meshes.
+ * Parts, legs, lights and the starting position come from the scene file.
+ *
+ * animate() flies the ship as a rigid body with fly_ships() (see also
+ * rigid_body.hpp): once launched, a thrust profile gives the engine thrust
+ * and the tilt an attitude controller steers towards. Launching again cuts
+ * the engine. The ship stands on its pad, or on the ground once
+ * setGround() has been called, until the thrust lifts it.
+ */
 class Spaceship {
  public:
-  Spaceship();
+  Spaceship(SceneGraph& aGraph, SceneFile const& aScene);
+  // Without meshes or nodes, e.g. to simulate without a window; must not
+  // be drawn
+  explicit Spaceship(SceneFile const& aScene);
   void resetState();
-  void updateMatrices();
 
   const Vec3f& getPosition() const { return position; }
+  SpaceshipPose getPose() const {
+    return SpaceshipPose{position, orientation, throttle};
+  }
 
-  void launch() { animationRunning = !animationRunning; }
+  void launch() { flight.engineOn = !flight.engineOn; }
   void animate(float dt);
+  // The terrain to land on; must outlive the ship or be reset
+  void setGround(Heightfield const* aGround) { flight.ground = aGround; }
+
+  // What animate() flies, e.g. to predict where the ship is going
+  RigidBodies const& getBody() const { return body; }
+  ShipFlight const& getFlight() const { return flight; }
   void updateKeyActions(int aKey, int aAction);
 
-  const std::array<Vec3f, 3> getLightPos() const {
+  CollisionShape const& getCollisionShape() const { return collisionShape; }
+  // Pushes the ship out of a contact in which it is the first shape
+  void resolveContact(Contact const& aContact);
+
+  const std::array<Vec3f, 3> getLightPos(const SpaceshipPose& pose) const {
     // Light positions in world space
+    RigidTransform const model2world = make_model2world(pose);
     std::array<Vec3f, 3> array = {};
-    for (int i = 0; i < 3; i++) {
-      Vec4f pos = model2world * Vec4f{lightOffsets[i].x, lightOffsets[i].y,
-                                      lightOffsets[i].z, 1.f};
-      array[i] = Vec3f{pos.x, pos.y, pos.z};
-    }
+    for (int i = 0; i < 3; i++)
+      array[i] = transform_point(model2world, lightOffsets[i]);
     return array;
   }
 
+  // Engine exhaust, offsets in world units
+  std::span<SceneEmitter const> getEmitters() const { return emitters; }
+
   const std::array<Vec3f, 3> getLightAmbient() const { return lightAmbient; }
   const std::array<Vec3f, 3> getLightDiffuse() const { return lightDiffuse; }
 
-  void draw(const Mat44f& cameraProjection) const {
+  NodeId getRootNode() const { return rootNode; }
+  // Moves the ship's nodes to the interpolated pose; call before
+  // SceneGraph::update()
+  void updateNodes(SceneGraph& aGraph, const SpaceshipPose& pose) const {
+    aGraph.setLocal(rootNode, TrsTransform{pose.position, pose.orientation});
+  }
+
+  void draw(const Mat44f& cameraProjection, const LodView& view,
+            const SceneGraph& graph) {
+    Frustum const frustum = make_frustum(cameraProjection);
+    if (!intersects(frustum, graph.subtreeBounds(rootNode))) return;
+
     glUniformMatrix4fv(0, 1, GL_TRUE, cameraProjection.v);
+    drawPart(hullLod, hullLodState, hullNode, frustum, view, graph);
+    for (std::size_t i = 0; i < legNodes.size(); ++i)
+      drawPart(legLod, legLodStates[i], legNodes[i], frustum, view, graph);
+  }
+
+ private:
+  void drawPart(const LodChain& lod, LodState& lodState, NodeId node,
+                const Frustum& frustum, const LodView& view,
+                const SceneGraph& graph) {
+    if (!intersects(frustum, graph.subtreeBounds(node))) return;
+
+    Mat44f const model2world = graph.worldMatrix(node);
     glUniformMatrix4fv(1, 1, GL_TRUE, model2world.v);
-    glUniformMatrix3fv(2, 1, GL_TRUE, normalMatrix.v);
+    glUniformMatrix3fv(2, 1, GL_TRUE, graph.normalMatrix(node).v);
 
-    glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES, 0, numVertices);
+    draw_lod(lod, select_lod(lod, lodState, view, model2world));
   }
 
- private:
-  GLuint vao;
-  GLsizei numVertices;
+  LodChain hullLod;
+  LodChain legLod;
+  LodState hullLodState;
+  std::vector<LodState> legLodStates;
 
-  // Animation
-  float time;
-  Vec3f initialPosition;
-  Vec3f position;
-  float rotationZ;
+  NodeId rootNode = kNoNode;
+  NodeId hullNode = kNoNode;
+  std::vector<NodeId> legNodes;
 
-  Mat44f model2world;
-  Mat33f normalMatrix;
+  // Flight: one rigid body flying the launch thrust profile. position and
+  // orientation are copied from it after every step.
+  RigidBodies body;
+  ShipFlight flight;
+  float throttle;
+  Vec3f position;
+  Quatf orientation;
 
-  bool animationRunning;
+  std::span<SceneEmitter const> emitters;  // in the scene file
+  CollisionShape collisionShape;
 
   // Lights
   std::array<Vec3f, 3> lightOffsets;
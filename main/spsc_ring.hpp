@@ -0,0 +1,62 @@
+#ifndef SPSC_RING_HPP_3A7E0C95_D24B_4F16_8B3E_C5910F6A2D74
+#define SPSC_RING_HPP_3A7E0C95_D24B_4F16_8B3E_C5910F6A2D74
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/* SpscRing: lock-free queue from one producer thread to one consumer thread
+ *
+ * A fixed ring of kCapacity slots (a power of two) with a head the consumer
+ * advances and a tail the producer advances. Neither side ever waits: a
+ * full ring refuses the push, an empty one the pop. Each side keeps a copy
+ * of the other's index and only reloads it when the ring looks full or
+ * empty, so the indices' cache lines rarely move between the threads.
+ */
+template <typename T, std::size_t kCapacity>
+class SpscRing {
+  static_assert(kCapacity > 0 && 0 == (kCapacity & (kCapacity - 1)),
+                "kCapacity must be a power of two");
+
+ public:
+  SpscRing() = default;
+
+  SpscRing(SpscRing const&) = delete;
+  SpscRing& operator=(SpscRing const&) = delete;
+
+  static constexpr std::size_t capacity() { return kCapacity; }
+
+  // Producer side; false if the ring is full
+  bool push(T const& aValue) {
+    std::size_t const t = tail.load(std::memory_order_relaxed);
+    if (t - headCache == kCapacity) {
+      headCache = head.load(std::memory_order_acquire);
+      if (t - headCache == kCapacity) return false;
+    }
+    slots[t & (kCapacity - 1)] = aValue;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side; false if the ring is empty
+  bool pop(T& aOut) {
+    std::size_t const h = head.load(std::memory_order_relaxed);
+    if (h == tailCache) {
+      tailCache = tail.load(std::memory_order_acquire);
+      if (h == tailCache) return false;
+    }
+    aOut = slots[h & (kCapacity - 1)];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  // Indices count up without wrapping; slot i % kCapacity holds item i
+  alignas(64) std::atomic<std::size_t> head{0};  // next to pop
+  std::size_t tailCache = 0;                      // consumer's copy
+  alignas(64) std::atomic<std::size_t> tail{0};  // next to push
+  std::size_t headCache = 0;                      // producer's copy
+  alignas(64) std::array<T, kCapacity> slots{};
+};
+
+#endif  // SPSC_RING_HPP_3A7E0C95_D24B_4F16_8B3E_C5910F6A2D74
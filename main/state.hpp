@@ -6,6 +6,10 @@
 #include "spaceship.hpp"
 
 class Button;
+class Fleet;
+class FleetRenderer;
+class Heightfield;
+class Simulation;
 
 struct State {
   ShaderProgram *prog;
@@ -16,8 +20,24 @@ struct State {
   Camera *leftScreenCamera;
   Camera *rightScreenCamera;
   bool splitScreen;
+  // Whether the first-person camera looks around with the mouse, as last
+  // sent to the simulation
+  bool mouseLook;
 
+  // Owned by the simulation thread; changed only through its input events
   Spaceship *spaceship;
+  Fleet *fleet;
+  Simulation *simulation;
+
+  // Render thread only
+  FleetRenderer *fleetRenderer;
+  // The camera poses the screens showed last frame. Picking uses these, as
+  // the simulation thread moves the Cameras themselves.
+  CameraPose leftCameraPose;
+  CameraPose rightCameraPose;
+
+  // Immutable; any thread
+  Heightfield const *ground;
 
   // UI
   std::vector<Button *> buttons;
@@ -0,0 +1,622 @@
+#include "terrain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "../support/error.hpp"
+#include "bvh.hpp"
+#include "camera.hpp"
+
+namespace {
+constexpr char kTerrainMagic[4] = {'T', 'R', 'N', 'T'};
+constexpr std::uint32_t kTerrainVersion = 1;
+
+// Tiles are loaded within the far plane of the cameras and kept until a
+// little beyond it
+constexpr float kTerrainLoadDistance = kFarPlane;
+constexpr float kTerrainUnloadDistance = 1.25f * kFarPlane;
+constexpr std::size_t kMaxTileLoadsInFlight = 8;
+// Hard limit on the tiles in memory, whatever the load distance
+constexpr std::size_t kMaxResidentTiles = 256;
+
+// Uniform locations in terrain.vert (after the lighting uniforms, 3 - 15)
+constexpr GLint kTileOriginLocation = 16;
+constexpr GLint kTileHeightLocation = 17;
+constexpr GLint kSpacingLocation = 18;
+constexpr GLint kTexULocation = 19;
+constexpr GLint kTexVLocation = 20;
+// The surface texture is on unit 0
+constexpr GLuint kHeightsTextureUnit = 1;
+
+constexpr std::uint32_t kQuads = kTerrainTileQuads;
+
+struct FileCloser {
+  void operator()(std::FILE* aFile) const { std::fclose(aFile); }
+};
+using FilePtr = std::unique_ptr<std::FILE, FileCloser>;
+
+// Heights on the whole bake grid, row by row
+struct HeightGrid {
+  std::uint32_t width = 0, depth = 0;
+  std::vector<float> heights;
+
+  // Clamped to the edge of the grid
+  float at(std::int64_t aX, std::int64_t aZ) const {
+    aX = std::clamp<std::int64_t>(aX, 0, std::int64_t(width) - 1);
+    aZ = std::clamp<std::int64_t>(aZ, 0, std::int64_t(depth) - 1);
+    return heights[std::size_t(aZ) * width + std::size_t(aX)];
+  }
+};
+
+// Twice the signed area of (a, b, c) in the XZ plane
+float edge_(float aAx, float aAz, float aBx, float aBz, float aCx,
+            float aCz) {
+  return (aBx - aAx) * (aCz - aAz) - (aBz - aAz) * (aCx - aAx);
+}
+
+// Looks at the mesh from above and keeps the highest surface at each sample.
+// Samples no triangle covers get aFill.
+HeightGrid rasterize_heights_(MeshData const& aMesh, float aOriginX,
+                              float aOriginZ, float aSpacing,
+                              std::uint32_t aWidth, std::uint32_t aDepth,
+                              float aFill) {
+  HeightGrid grid{aWidth, aDepth,
+                  std::vector<float>(std::size_t(aWidth) * aDepth,
+                                     -std::numeric_limits<float>::infinity())};
+  constexpr float kEdgeEpsilon = -1e-5f;
+  float const invSpacing = 1.f / aSpacing;
+
+  for (std::size_t t = 0; t + 2 < aMesh.positions.size(); t += 3) {
+    Vec3f const a = aMesh.positions[t];
+    Vec3f const b = aMesh.positions[t + 1];
+    Vec3f const c = aMesh.positions[t + 2];
+    // In grid units
+    float const ax = (a.x - aOriginX) * invSpacing;
+    float const az = (a.z - aOriginZ) * invSpacing;
+    float const bx = (b.x - aOriginX) * invSpacing;
+    float const bz = (b.z - aOriginZ) * invSpacing;
+    float const cx = (c.x - aOriginX) * invSpacing;
+    float const cz = (c.z - aOriginZ) * invSpacing;
+
+    float const area = edge_(ax, az, bx, bz, cx, cz);
+    if (std::abs(area) < 1e-12f) continue;  // vertical
+    float const invArea = 1.f / area;
+
+    auto const i0 = std::max(std::ceil(std::min({ax, bx, cx})), 0.f);
+    auto const i1 = std::min(std::floor(std::max({ax, bx, cx})),
+                             float(aWidth - 1));
+    auto const j0 = std::max(std::ceil(std::min({az, bz, cz})), 0.f);
+    auto const j1 = std::min(std::floor(std::max({az, bz, cz})),
+                             float(aDepth - 1));
+    for (float j = j0; j <= j1; ++j) {
+      for (float i = i0; i <= i1; ++i) {
+        float const wa = edge_(bx, bz, cx, cz, i, j) * invArea;
+        float const wb = edge_(cx, cz, ax, az, i, j) * invArea;
+        float const wc = 1.f - wa - wb;
+        if (wa < kEdgeEpsilon || wb < kEdgeEpsilon || wc < kEdgeEpsilon)
+          continue;
+        float& h = grid.heights[std::size_t(j) * aWidth + std::size_t(i)];
+        h = std::max(h, wa * a.y + wb * b.y + wc * c.y);
+      }
+    }
+  }
+
+  for (float& h : grid.heights) {
+    if (h == -std::numeric_limits<float>::infinity()) h = aFill;
+  }
+  return grid;
+}
+
+// Least-squares fit of texcoord[aComponent] = f0 (x - aX0) + f1 (z - aZ0) + f2
+// over the mesh vertices, returned in world coordinates
+std::array<float, 3> fit_texcoord_(MeshData const& aMesh,
+                                   std::size_t aComponent, float aX0,
+                                   float aZ0) {
+  // Normal equations, solved by Cramer's rule
+  double m[3][3] = {}, rhs[3] = {};
+  for (std::size_t i = 0; i < aMesh.positions.size(); ++i) {
+    double const p[3] = {double(aMesh.positions[i].x - aX0),
+                         double(aMesh.positions[i].z - aZ0), 1.0};
+    Vec2f const uv = aMesh.texcoords[i];
+    double const value = double(0 == aComponent ? uv.x : uv.y);
+    for (std::size_t r = 0; r < 3; ++r) {
+      for (std::size_t c = 0; c < 3; ++c) m[r][c] += p[r] * p[c];
+      rhs[r] += p[r] * value;
+    }
+  }
+  auto det3 = [](double const (&aM)[3][3]) {
+    return aM[0][0] * (aM[1][1] * aM[2][2] - aM[1][2] * aM[2][1]) -
+           aM[0][1] * (aM[1][0] * aM[2][2] - aM[1][2] * aM[2][0]) +
+           aM[0][2] * (aM[1][0] * aM[2][1] - aM[1][1] * aM[2][0]);
+  };
+  double const det = det3(m);
+  if (std::abs(det) < 1e-12) return {0.f, 0.f, 0.f};
+
+  double f[3];
+  for (std::size_t k = 0; k < 3; ++k) {
+    double mk[3][3];
+    std::memcpy(mk, m, sizeof(m));
+    for (std::size_t r = 0; r < 3; ++r) mk[r][k] = rhs[r];
+    f[k] = det3(mk) / det;
+  }
+  return {float(f[0]), float(f[1]), float(f[2] - f[0] * aX0 - f[1] * aZ0)};
+}
+
+// Largest vertical distance between each level and full detail, for the
+// tile whose first sample is (aX0, aZ0). Level l is triangulated like
+// level_indices_(l).
+std::array<float, kTerrainLevels> level_errors_(HeightGrid const& aGrid,
+                                                std::int64_t aX0,
+                                                std::int64_t aZ0) {
+  std::array<float, kTerrainLevels> errors{};
+  for (std::size_t level = 1; level < kTerrainLevels; ++level) {
+    std::int64_t const step = std::int64_t(1) << level;
+    float error = 0.f;
+    for (std::int64_t j = 0; j <= kQuads; ++j) {
+      for (std::int64_t i = 0; i <= kQuads; ++i) {
+        std::int64_t const ci = std::min(i / step * step, kQuads - step);
+        std::int64_t const cj = std::min(j / step * step, kQuads - step);
+        float const fx = float(i - ci) / float(step);
+        float const fz = float(j - cj) / float(step);
+        float const h00 = aGrid.at(aX0 + ci, aZ0 + cj);
+        float const h10 = aGrid.at(aX0 + ci + step, aZ0 + cj);
+        float const h01 = aGrid.at(aX0 + ci, aZ0 + cj + step);
+        float const h11 = aGrid.at(aX0 + ci + step, aZ0 + cj + step);
+        float const surface =
+            fx + fz <= 1.f
+                ? h00 + fx * (h10 - h00) + fz * (h01 - h00)
+                : h11 + (1.f - fx) * (h01 - h11) + (1.f - fz) * (h10 - h11);
+        error = std::max(
+            error, std::abs(aGrid.at(aX0 + i, aZ0 + j) - surface));
+      }
+    }
+    errors[level] = std::max(error, errors[level - 1]);
+  }
+  return errors;
+}
+
+// Vertices of the shared tile grid: (kQuads + 1)^2 grid vertices, row by
+// row, then kQuads + 1 skirt vertices along each of the edges z = 0, z = N,
+// x = 0 and x = N
+std::uint32_t grid_vertex_(std::uint32_t aI, std::uint32_t aJ) {
+  return aJ * (kQuads + 1) + aI;
+}
+std::uint32_t skirt_vertex_(std::uint32_t aEdge, std::uint32_t aK) {
+  return (kQuads + 1) * (kQuads + 1) + aEdge * (kQuads + 1) + aK;
+}
+
+std::vector<Vec3f> grid_vertices_() {
+  // (column, row, 1 on skirts); terrain.vert looks up the height
+  std::vector<Vec3f> vertices;
+  for (std::uint32_t j = 0; j <= kQuads; ++j) {
+    for (std::uint32_t i = 0; i <= kQuads; ++i)
+      vertices.push_back({float(i), float(j), 0.f});
+  }
+  float const n = float(kQuads);
+  for (std::uint32_t k = 0; k <= kQuads; ++k)
+    vertices.push_back({float(k), 0.f, 1.f});
+  for (std::uint32_t k = 0; k <= kQuads; ++k)
+    vertices.push_back({float(k), n, 1.f});
+  for (std::uint32_t k = 0; k <= kQuads; ++k)
+    vertices.push_back({0.f, float(k), 1.f});
+  for (std::uint32_t k = 0; k <= kQuads; ++k)
+    vertices.push_back({n, float(k), 1.f});
+  return vertices;
+}
+
+std::vector<std::uint32_t> level_indices_(std::size_t aLevel) {
+  std::uint32_t const step = 1u << aLevel;
+  std::vector<std::uint32_t> indices;
+
+  // Counter-clockwise seen from above (+y)
+  for (std::uint32_t j = 0; j < kQuads; j += step) {
+    for (std::uint32_t i = 0; i < kQuads; i += step) {
+      std::uint32_t const v00 = grid_vertex_(i, j);
+      std::uint32_t const v10 = grid_vertex_(i + step, j);
+      std::uint32_t const v01 = grid_vertex_(i, j + step);
+      std::uint32_t const v11 = grid_vertex_(i + step, j + step);
+      indices.insert(indices.end(), {v00, v01, v10, v10, v01, v11});
+    }
+  }
+
+  // Skirts hang from each edge, facing out of the tile. Each edge is walked
+  // so that (a, b, below a) is counter-clockwise from outside.
+  auto skirt = [&](std::uint32_t aEdge, std::uint32_t aKa, std::uint32_t aKb,
+                   std::uint32_t aA, std::uint32_t aB) {
+    std::uint32_t const a2 = skirt_vertex_(aEdge, aKa);
+    std::uint32_t const b2 = skirt_vertex_(aEdge, aKb);
+    indices.insert(indices.end(), {aA, aB, a2, aB, b2, a2});
+  };
+  std::uint32_t const n = kQuads;
+  for (std::uint32_t k = 0; k < n; k += step) {
+    std::uint32_t const r = n - k;  // walking backwards
+    skirt(0, k, k + step, grid_vertex_(k, 0), grid_vertex_(k + step, 0));
+    skirt(1, r, r - step, grid_vertex_(r, n), grid_vertex_(r - step, n));
+    skirt(2, r, r - step, grid_vertex_(0, r), grid_vertex_(0, r - step));
+    skirt(3, k, k + step, grid_vertex_(n, k), grid_vertex_(n, k + step));
+  }
+  return indices;
+}
+
+// Deep enough to cover the cracks next to a neighbour at any level
+float skirt_depth_(TerrainTileInfo const& aTile, float aSpacing) {
+  return aTile.error.back() + 0.1f * aSpacing;
+}
+}  // namespace
+
+void bake_terrain(MeshData const& aMesh, char const* aPath,
+                  std::uint32_t aSamples) {
+  if (aMesh.positions.size() < 3 ||
+      aMesh.texcoords.size() != aMesh.positions.size()) {
+    throw Error("Unable to bake terrain '%s': mesh has no textured triangles",
+                aPath);
+  }
+
+  Aabb const bounds = compute_bounds(aMesh.positions);
+  float const extentX = bounds.max.x - bounds.min.x;
+  float const extentZ = bounds.max.z - bounds.min.z;
+  std::uint32_t const longTiles =
+      std::max(1u, (aSamples + kQuads - 1) / kQuads);
+  float const spacing =
+      std::max(std::max(extentX, extentZ), 1e-6f) / float(longTiles * kQuads);
+  float const tileSize = spacing * float(kQuads);
+  auto const tilesX =
+      std::max(1u, std::uint32_t(std::ceil(extentX / tileSize)));
+  auto const tilesZ =
+      std::max(1u, std::uint32_t(std::ceil(extentZ / tileSize)));
+
+  HeightGrid const grid = rasterize_heights_(
+      aMesh, bounds.min.x, bounds.min.z, spacing, tilesX * kQuads + 1,
+      tilesZ * kQuads + 1, bounds.min.y);
+
+  TerrainFileHeader header{};
+  std::memcpy(header.magic, kTerrainMagic, sizeof(header.magic));
+  header.version = kTerrainVersion;
+  header.tileQuads = kQuads;
+  header.tilesX = tilesX;
+  header.tilesZ = tilesZ;
+  header.originX = bounds.min.x;
+  header.originZ = bounds.min.z;
+  header.spacing = spacing;
+  auto const texU = fit_texcoord_(aMesh, 0, bounds.min.x, bounds.min.z);
+  auto const texV = fit_texcoord_(aMesh, 1, bounds.min.x, bounds.min.z);
+  std::copy(texU.begin(), texU.end(), header.texU);
+  std::copy(texV.begin(), texV.end(), header.texV);
+
+  std::size_t const tileCount = std::size_t(tilesX) * tilesZ;
+  std::vector<TerrainTileInfo> infos(tileCount);
+  std::vector<std::uint16_t> samples(tileCount * kTerrainTileSamples);
+  std::uint64_t const dataOffset =
+      sizeof(TerrainFileHeader) + tileCount * sizeof(TerrainTileInfo);
+
+  for (std::size_t t = 0; t < tileCount; ++t) {
+    // First sample of the apron
+    std::int64_t const x0 = std::int64_t(t % tilesX) * kQuads - 1;
+    std::int64_t const z0 = std::int64_t(t / tilesX) * kQuads - 1;
+
+    TerrainTileInfo& info = infos[t];
+    info.offset = dataOffset + t * kTerrainTileSamples * sizeof(std::uint16_t);
+    info.minHeight = std::numeric_limits<float>::max();
+    info.maxHeight = std::numeric_limits<float>::lowest();
+    for (std::int64_t j = 0; j < kTerrainTileSide; ++j) {
+      for (std::int64_t i = 0; i < kTerrainTileSide; ++i) {
+        float const h = grid.at(x0 + i, z0 + j);
+        info.minHeight = std::min(info.minHeight, h);
+        info.maxHeight = std::max(info.maxHeight, h);
+      }
+    }
+    info.error = level_errors_(grid, x0 + 1, z0 + 1);
+
+    float const range = info.maxHeight - info.minHeight;
+    float const scale = range > 0.f ? 65535.f / range : 0.f;
+    std::uint16_t* out = samples.data() + t * kTerrainTileSamples;
+    for (std::int64_t j = 0; j < kTerrainTileSide; ++j) {
+      for (std::int64_t i = 0; i < kTerrainTileSide; ++i) {
+        float const h = grid.at(x0 + i, z0 + j);
+        *out++ = std::uint16_t(std::lround((h - info.minHeight) * scale));
+      }
+    }
+  }
+
+  FilePtr file(std::fopen(aPath, "wb"));
+  bool ok = file && 1 == std::fwrite(&header, sizeof(header), 1, file.get());
+  ok = ok && tileCount == std::fwrite(infos.data(), sizeof(TerrainTileInfo),
+                                      tileCount, file.get());
+  ok = ok && samples.size() == std::fwrite(samples.data(),
+                                           sizeof(std::uint16_t),
+                                           samples.size(), file.get());
+  ok = ok && 0 == std::fclose(file.release());
+  if (!ok) throw Error("Unable to write terrain file '%s'", aPath);
+}
+
+TerrainFile::TerrainFile(char const* aPath) : path(aPath), fileHeader{} {
+  FilePtr file(std::fopen(aPath, "rb"));
+  if (!file) throw Error("Unable to open terrain file '%s'", aPath);
+
+  if (1 != std::fread(&fileHeader, sizeof(fileHeader), 1, file.get()))
+    throw Error("Unable to read terrain file '%s'", aPath);
+  if (0 != std::memcmp(fileHeader.magic, kTerrainMagic,
+                       sizeof(kTerrainMagic)) ||
+      kTerrainVersion != fileHeader.version ||
+      kTerrainTileQuads != fileHeader.tileQuads) {
+    throw Error("'%s' is not a version %u terrain file with %u-quad tiles",
+                aPath, kTerrainVersion, kTerrainTileQuads);
+  }
+
+  tiles.resize(std::size_t(fileHeader.tilesX) * fileHeader.tilesZ);
+  if (tiles.size() != std::fread(tiles.data(), sizeof(TerrainTileInfo),
+                                 tiles.size(), file.get())) {
+    throw Error("Unable to read the tile table of terrain file '%s'", aPath);
+  }
+}
+
+Aabb TerrainFile::tileBounds(std::size_t aTile) const {
+  float const size = fileHeader.spacing * float(fileHeader.tileQuads);
+  float const x0 = fileHeader.originX + size * float(aTile % fileHeader.tilesX);
+  float const z0 = fileHeader.originZ + size * float(aTile / fileHeader.tilesX);
+  TerrainTileInfo const& info = tiles[aTile];
+  return Aabb{{x0, info.minHeight, z0}, {x0 + size, info.maxHeight, z0 + size}};
+}
+
+void TerrainFile::readTile(std::size_t aTile, std::uint16_t* aSamples) const {
+  FilePtr file(std::fopen(path.c_str(), "rb"));
+  if (!file ||
+      0 != std::fseek(file.get(), long(tiles[aTile].offset), SEEK_SET) ||
+      kTerrainTileSamples != std::fread(aSamples, sizeof(std::uint16_t),
+                                        kTerrainTileSamples, file.get())) {
+    throw Error("Unable to read tile %zu of terrain file '%s'", aTile,
+                path.c_str());
+  }
+}
+
+std::size_t select_terrain_level(TerrainTileInfo const& aTile, float aDistance,
+                                 float aPixelScale) {
+  float const pixelsPerUnit = aPixelScale / std::max(aDistance, 1e-3f);
+  std::size_t level = 0;
+  while (level + 1 < kTerrainLevels &&
+         aTile.error[level + 1] * pixelsPerUnit <= kTerrainPixelError) {
+    ++level;
+  }
+  return level;
+}
+
+Terrain::Terrain(JobSystem& aJobs, char const* aPath)
+    : jobs(aJobs),
+      file(aPath),
+      tiles(file.tileCount()),
+      loadsInFlight(0),
+      vao(0),
+      vbo(0),
+      ebo(0) {
+  std::vector<Vec3f> const vertices = grid_vertices_();
+  std::vector<std::uint32_t> indices;
+  for (std::size_t level = 0; level < kTerrainLevels; ++level) {
+    std::vector<std::uint32_t> const levelIndices = level_indices_(level);
+    indexOffset[level] = indices.size();
+    indexCount[level] = GLsizei(levelIndices.size());
+    indices.insert(indices.end(), levelIndices.begin(), levelIndices.end());
+  }
+
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
+  glGenBuffers(1, &vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vec3f),
+               vertices.data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glEnableVertexAttribArray(0);
+
+  glGenBuffers(1, &ebo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(std::uint32_t),
+               indices.data(), GL_STATIC_DRAW);
+
+  // Reset State
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+Terrain::~Terrain() {
+  // Loads in flight refer to this
+  finishLoads();
+
+  for (Tile& tile : tiles) {
+    if (tile.heights) glDeleteTextures(1, &tile.heights);
+  }
+  glDeleteBuffers(1, &ebo);
+  glDeleteBuffers(1, &vbo);
+  glDeleteVertexArrays(1, &vao);
+}
+
+float Terrain::distanceXZ(std::size_t aTile,
+                          std::span<Vec3f const> aCameras) const {
+  Aabb const box = file.tileBounds(aTile);
+  float best = std::numeric_limits<float>::infinity();
+  for (Vec3f const& c : aCameras) {
+    float const dx = std::max({box.min.x - c.x, 0.f, c.x - box.max.x});
+    float const dz = std::max({box.min.z - c.z, 0.f, c.z - box.max.z});
+    best = std::min(best, std::sqrt(dx * dx + dz * dz));
+  }
+  return best;
+}
+
+std::size_t Terrain::update(std::span<Vec3f const> aCameras) {
+  // Unload the tiles every camera has left behind
+  for (std::size_t k = 0; k < resident.size();) {
+    std::uint32_t const t = resident[k];
+    if (TileState::resident == tiles[t].state &&
+        distanceXZ(t, aCameras) > kTerrainUnloadDistance) {
+      glDeleteTextures(1, &tiles[t].heights);
+      tiles[t] = Tile{};
+      resident[k] = resident.back();
+      resident.pop_back();
+    } else {
+      ++k;
+    }
+  }
+
+  // Tiles to load, nearest first. Only the tiles around each camera are
+  // looked at, so the cost does not grow with the size of the terrain.
+  TerrainFileHeader const& header = file.header();
+  float const tileSize = header.spacing * float(header.tileQuads);
+  auto tileRange = [&](float aCoord, float aOrigin, std::uint32_t aCount) {
+    auto clampTile = [&](float aX) {
+      return std::int64_t(std::clamp(std::floor((aX - aOrigin) / tileSize),
+                                     0.f, float(aCount - 1)));
+    };
+    return std::pair{clampTile(aCoord - kTerrainLoadDistance),
+                     clampTile(aCoord + kTerrainLoadDistance)};
+  };
+
+  std::vector<std::pair<float, std::uint32_t>> wanted;
+  for (Vec3f const& c : aCameras) {
+    auto const [x0, x1] = tileRange(c.x, header.originX, header.tilesX);
+    auto const [z0, z1] = tileRange(c.z, header.originZ, header.tilesZ);
+    for (std::int64_t z = z0; z <= z1; ++z) {
+      for (std::int64_t x = x0; x <= x1; ++x) {
+        auto const t = std::uint32_t(z * header.tilesX + x);
+        if (TileState::unloaded != tiles[t].state) continue;
+        float const distance = distanceXZ(t, aCameras);
+        if (distance <= kTerrainLoadDistance) wanted.emplace_back(distance, t);
+      }
+    }
+  }
+  std::sort(wanted.begin(), wanted.end());
+
+  Job* batch = nullptr;
+  std::size_t started = 0;
+  for (auto const& [distance, t] : wanted) {
+    if (loadsInFlight >= kMaxTileLoadsInFlight ||
+        resident.size() >= kMaxResidentTiles) {
+      break;
+    }
+    if (TileState::unloaded != tiles[t].state) continue;  // seen twice
+
+    tiles[t].state = TileState::loading;
+    resident.push_back(t);
+    ++loadsInFlight;
+    ++started;
+
+    // Jobs must not throw; a failed read is passed to the main thread, which
+    // may be running the completion from ~Terrain(), so it is not rethrown
+    if (!batch) batch = jobs.create([] {});
+    jobs.run(jobs.createChild(batch, [this, t] {
+      std::shared_ptr<std::vector<std::uint16_t>> samples;
+      std::string error;
+      try {
+        samples = std::make_shared<std::vector<std::uint16_t>>(
+            kTerrainTileSamples);
+        file.readTile(t, samples->data());
+      } catch (std::exception const& eErr) {
+        error = eErr.what();
+      }
+      jobs.runOnMainThread([this, t, samples, error = std::move(error)] {
+        --loadsInFlight;
+        if (!error.empty())
+          failLoad(t, error.c_str());
+        else
+          finishLoad(t, samples->data());
+      });
+    }));
+  }
+
+  if (batch) {
+    jobs.run(batch);
+    // Without other workers nothing would run the loads
+    if (1 == jobs.workerCount()) jobs.wait(batch);
+  }
+  return started;
+}
+
+void Terrain::finishLoads() {
+  while (loadsInFlight > 0) {
+    if (0 == jobs.runMainThreadJobs()) std::this_thread::yield();
+  }
+}
+
+void Terrain::finishLoad(std::size_t aTile, std::uint16_t const* aSamples) {
+  Tile& tile = tiles[aTile];
+  glGenTextures(1, &tile.heights);
+  glBindTexture(GL_TEXTURE_2D, tile.heights);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16, kTerrainTileSide, kTerrainTileSide);
+  // Rows of 16-bit samples are not 4-byte aligned
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, kTerrainTileSide, kTerrainTileSide,
+                  GL_RED, GL_UNSIGNED_SHORT, aSamples);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  tile.state = TileState::resident;
+}
+
+void Terrain::failLoad(std::size_t aTile, char const* aMessage) {
+  std::fprintf(stderr, "Unable to load terrain tile %zu: %s\n", aTile,
+               aMessage);
+
+  // Unloaded again, so a later update() retries it
+  tiles[aTile] = Tile{};
+  auto const it = std::find(resident.begin(), resident.end(),
+                            std::uint32_t(aTile));
+  if (it != resident.end()) {
+    *it = resident.back();
+    resident.pop_back();
+  }
+}
+
+void Terrain::draw(const Mat44f& cameraProjection, const LodView& view) {
+  if (resident.empty()) return;
+
+  TerrainFileHeader const& header = file.header();
+  float const tileSize = header.spacing * float(header.tileQuads);
+  Frustum const frustum = make_frustum(cameraProjection);
+
+  glUniformMatrix4fv(0, 1, GL_TRUE, cameraProjection.v);
+  glUniform1f(kSpacingLocation, header.spacing);
+  glUniform3fv(kTexULocation, 1, header.texU);
+  glUniform3fv(kTexVLocation, 1, header.texV);
+  glBindVertexArray(vao);
+  glActiveTexture(GL_TEXTURE0 + kHeightsTextureUnit);
+
+  for (std::uint32_t t : resident) {
+    if (TileState::resident != tiles[t].state) continue;
+
+    TerrainTileInfo const& info = file.tile(t);
+    float const skirt = skirt_depth_(info, header.spacing);
+    Aabb box = file.tileBounds(t);
+    box.min.y -= skirt;
+    if (!intersects(frustum, box)) continue;
+
+    Vec3f const closest =
+        component_min(component_max(view.cameraPosition, box.min), box.max);
+    std::size_t const level = select_terrain_level(
+        info, length(closest - view.cameraPosition), view.pixelScale);
+
+    lod_stats().trianglesDrawn += std::uint64_t(indexCount[level] / 3);
+    lod_stats().trianglesFull += std::uint64_t(indexCount[0] / 3);
+
+    glUniform2f(kTileOriginLocation,
+                header.originX + tileSize * float(t % header.tilesX),
+                header.originZ + tileSize * float(t / header.tilesX));
+    glUniform3f(kTileHeightLocation, info.minHeight,
+                info.maxHeight - info.minHeight, skirt);
+    glBindTexture(GL_TEXTURE_2D, tiles[t].heights);
+    glDrawElements(GL_TRIANGLES, indexCount[level], GL_UNSIGNED_INT,
+                   reinterpret_cast<void const*>(indexOffset[level] *
+                                                 sizeof(std::uint32_t)));
+  }
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindVertexArray(0);
+}
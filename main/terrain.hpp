@@ -0,0 +1,161 @@
+#ifndef TERRAIN_HPP_5D2A8E61_9C4F_4B37_A0E5_7F13B6C92D48
+#define TERRAIN_HPP_5D2A8E61_9C4F_4B37_A0E5_7F13B6C92D48
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "../vmlib/aabb.hpp"
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/vec3.hpp"
+#include "job_system.hpp"
+#include "lod.hpp"
+#include "mesh.hpp"
+
+// Quads along the edge of a terrain tile at full detail
+constexpr std::uint32_t kTerrainTileQuads = 64;
+// Geomipmap levels; level l uses every 2^l-th sample
+constexpr std::size_t kTerrainLevels = 5;
+static_assert((kTerrainTileQuads >> (kTerrainLevels - 1)) >= 1);
+// Samples stored per tile: the tile's own plus a one-sample apron
+constexpr std::uint32_t kTerrainTileSide = kTerrainTileQuads + 3;
+constexpr std::size_t kTerrainTileSamples =
+    std::size_t(kTerrainTileSide) * kTerrainTileSide;
+
+// Samples along the longer side of a baked terrain
+constexpr std::uint32_t kTerrainBakeSamples = 1024;
+// Largest screen-space error of a geomipmap level, in pixels
+constexpr float kTerrainPixelError = 2.f;
+
+/* Tiled terrain file (*.terrain)
+ *
+ *   TerrainFileHeader
+ *   TerrainTileInfo[tilesX * tilesZ]   row by row, x fastest
+ *   tile samples                       at TerrainTileInfo::offset
+ *
+ * The terrain is a heightfield on a regular XZ grid, cut into tiles of
+ * kTerrainTileQuads^2 quads. Each tile stores kTerrainTileSide^2 samples,
+ * row by row: its own plus a one-sample apron that overlaps its neighbours
+ * so that normals match across tile edges. Samples are UNORM16 between the
+ * tile's minHeight and maxHeight. Written in the host's byte order.
+ */
+struct TerrainFileHeader {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t tileQuads;
+  std::uint32_t tilesX, tilesZ;
+  float originX, originZ;  // world XZ of the first sample of tile 0
+  float spacing;           // between samples
+  // Texture coordinates: u = texU[0] x + texU[1] z + texU[2], likewise v
+  float texU[3];
+  float texV[3];
+};
+
+struct TerrainTileInfo {
+  std::uint64_t offset;
+  float minHeight, maxHeight;
+  // Largest vertical distance between each level and full detail
+  std::array<float, kTerrainLevels> error;
+  std::uint32_t reserved;
+};
+
+static_assert(sizeof(TerrainFileHeader) == 56);
+static_assert(sizeof(TerrainTileInfo) == 40);
+
+// Resamples the top surface of a textured mesh onto a grid of about
+// aSamples along its longer side and writes it as a terrain file. Texture
+// coordinates are fitted as an affine function of XZ. Throws Error.
+void bake_terrain(MeshData const& aMesh, char const* aPath,
+                  std::uint32_t aSamples = kTerrainBakeSamples);
+
+/* TerrainFile: the header and tile table of a terrain file
+ *
+ * Tiles are only read by readTile(), which opens the file itself and so may
+ * be called from any thread.
+ */
+class TerrainFile {
+ public:
+  explicit TerrainFile(char const* aPath);  // throws Error
+
+  TerrainFileHeader const& header() const { return fileHeader; }
+  std::size_t tileCount() const { return tiles.size(); }
+  TerrainTileInfo const& tile(std::size_t aTile) const { return tiles[aTile]; }
+
+  // World-space extent of a tile, without skirts
+  Aabb tileBounds(std::size_t aTile) const;
+  // Fills aSamples[kTerrainTileSamples]; throws Error
+  void readTile(std::size_t aTile, std::uint16_t* aSamples) const;
+
+ private:
+  std::string path;
+  TerrainFileHeader fileHeader;
+  std::vector<TerrainTileInfo> tiles;
+};
+
+// Coarsest level whose error, seen from aDistance, stays below
+// kTerrainPixelError
+std::size_t select_terrain_level(TerrainTileInfo const&, float aDistance,
+                                 float aPixelScale);
+
+/* Terrain: streams the tiles of a terrain file and draws them
+ *
+ * update() keeps the tiles within kTerrainLoadDistance of any camera loaded,
+ * nearest first, and unloads those beyond kTerrainUnloadDistance. Tiles are
+ * read by jobs; the height texture is created when the main thread runs
+ * JobSystem::runMainThreadJobs().
+ *
+ * Every tile is drawn with one shared grid (geomipmapping): each level is
+ * a range of one index buffer, and terrain.vert reads the heights from the
+ * tile's R16 texture. Skirts hide the cracks between tiles of different
+ * levels.
+ */
+class Terrain {
+ public:
+  Terrain(JobSystem& aJobs, char const* aPath);
+  ~Terrain();
+
+  Terrain(Terrain const&) = delete;
+  Terrain& operator=(Terrain const&) = delete;
+
+  TerrainFile const& getFile() const { return file; }
+  std::size_t residentTileCount() const { return resident.size(); }
+
+  // Once per frame. Returns the number of tile loads started.
+  std::size_t update(std::span<Vec3f const> aCameras);
+  // Waits for the loads in flight and uploads them
+  void finishLoads();
+
+  // Draw with terrain.vert after setting the lighting and binding the
+  // surface texture to unit 0
+  void draw(const Mat44f& cameraProjection, const LodView& view);
+
+ private:
+  enum class TileState : std::uint8_t { unloaded, loading, resident };
+  struct Tile {
+    TileState state = TileState::unloaded;
+    GLuint heights = 0;
+  };
+
+  float distanceXZ(std::size_t aTile, std::span<Vec3f const> aCameras) const;
+  void finishLoad(std::size_t aTile, std::uint16_t const* aSamples);
+  void failLoad(std::size_t aTile, char const* aMessage);
+
+  JobSystem& jobs;
+  TerrainFile file;
+  std::vector<Tile> tiles;
+  std::vector<std::uint32_t> resident;  // tiles not unloaded
+  std::size_t loadsInFlight;
+
+  GLuint vao;
+  GLuint vbo;
+  GLuint ebo;
+  std::array<GLsizei, kTerrainLevels> indexCount{};
+  std::array<std::size_t, kTerrainLevels> indexOffset{};
+};
+
+#endif  // TERRAIN_HPP_5D2A8E61_9C4F_4B37_A0E5_7F13B6C92D48
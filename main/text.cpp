@@ -0,0 +1,245 @@
+#include "text.hpp"
+
+#include <fontstash.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "../support/error.hpp"
+
+namespace {
+// Uniform location in text.vert; the atlas is on unit 0
+constexpr GLint kViewportLocation = 0;
+
+constexpr int kInitialAtlasSize = 512;
+constexpr int kMaxAtlasSize = 2048;
+// Initial vertex buffer size, in glyphs
+constexpr std::size_t kInitialGlyphs = 256;
+
+char const* font_error_name_(int aError) {
+  switch (aError) {
+    case FONS_SCRATCH_FULL:
+      return "scratch memory full";
+    case FONS_STATES_OVERFLOW:
+      return "state stack overflow";
+    case FONS_STATES_UNDERFLOW:
+      return "state stack underflow";
+  }
+  return "unknown";
+}
+}  // namespace
+
+TextRenderer::TextRenderer(char const* aFontPath)
+    : context(nullptr),
+      font(FONS_INVALID),
+      fontError(0),
+      atlas(0),
+      atlasWidth(0),
+      atlasHeight(0),
+      generation(0),
+      frameGeneration(0),
+      viewport{1.f, 1.f},
+      vao(0),
+      vbo(0),
+      capacity(6 * kInitialGlyphs) {
+  FONSparams params{};
+  params.width = kInitialAtlasSize;
+  params.height = kInitialAtlasSize;
+  params.flags = FONS_ZERO_BOTTOMLEFT;
+  params.userPtr = this;
+  params.renderCreate = &TextRenderer::createAtlas;
+  params.renderResize = &TextRenderer::resizeAtlas;
+  params.renderDelete = &TextRenderer::deleteAtlas;
+  // Texture updates and drawing are done by draw(), not by fontstash
+
+  context = fonsCreateInternal(&params);
+  if (!context) throw Error("Unable to create the font atlas");
+  fonsSetErrorCallback(context, &TextRenderer::handleError, this);
+
+  font = fonsAddFont(context, "hud", aFontPath);
+  if (FONS_INVALID == font) {
+    fonsDeleteInternal(context);
+    throw Error("Unable to load font '%s'", aFontPath);
+  }
+
+  vertices.reserve(capacity);
+
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
+  glGenBuffers(1, &vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(TextVertex), nullptr,
+               GL_STREAM_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex),
+                        reinterpret_cast<void const*>(
+                            offsetof(TextVertex, position)));
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(TextVertex),
+                        reinterpret_cast<void const*>(
+                            offsetof(TextVertex, color)));
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex),
+                        reinterpret_cast<void const*>(
+                            offsetof(TextVertex, texel)));
+  glEnableVertexAttribArray(2);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+TextRenderer::~TextRenderer() {
+  fonsDeleteInternal(context);  // deletes the atlas texture
+  glDeleteBuffers(1, &vbo);
+  glDeleteVertexArrays(1, &vao);
+}
+
+int TextRenderer::createAtlas(void* aUser, int aWidth, int aHeight) {
+  auto* self = static_cast<TextRenderer*>(aUser);
+  glGenTextures(1, &self->atlas);
+  glBindTexture(GL_TEXTURE_2D, self->atlas);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return resizeAtlas(aUser, aWidth, aHeight);
+}
+
+int TextRenderer::resizeAtlas(void* aUser, int aWidth, int aHeight) {
+  // fontstash marks everything it keeps as dirty, so uploadAtlas() refills
+  // the new storage
+  auto* self = static_cast<TextRenderer*>(aUser);
+  self->atlasWidth = aWidth;
+  self->atlasHeight = aHeight;
+  glBindTexture(GL_TEXTURE_2D, self->atlas);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, aWidth, aHeight, 0, GL_RED,
+               GL_UNSIGNED_BYTE, nullptr);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return 1;
+}
+
+void TextRenderer::deleteAtlas(void* aUser) {
+  auto* self = static_cast<TextRenderer*>(aUser);
+  glDeleteTextures(1, &self->atlas);
+  self->atlas = 0;
+}
+
+void TextRenderer::handleError(void* aUser, int aError, int) {
+  // Exceptions must not cross fontstash; layout() throws once it returns
+  auto* self = static_cast<TextRenderer*>(aUser);
+  if (FONS_ATLAS_FULL != aError) {
+    self->fontError = aError;
+    return;
+  }
+
+  // fontstash retries the glyph after this returns
+  if (self->atlasWidth < kMaxAtlasSize) {
+    fonsExpandAtlas(self->context, 2 * self->atlasWidth,
+                    2 * self->atlasHeight);
+  } else {
+    fonsResetAtlas(self->context, self->atlasWidth, self->atlasHeight);
+    ++self->generation;
+  }
+}
+
+void TextRenderer::layout(std::string_view aText, Vec2f aCentre, float aSize,
+                          Vec4f const& aColor, std::vector<TextVertex>& aOut) {
+  fonsSetFont(context, font);
+  fonsSetSize(context, aSize);
+  fonsSetAlign(context, FONS_ALIGN_CENTER | FONS_ALIGN_MIDDLE);
+
+  FONStextIter iter;
+  FONSquad q;
+  fonsTextIterInit(context, &iter, aCentre.x, aCentre.y, aText.data(),
+                   aText.data() + aText.size());
+  while (fonsTextIterNext(context, &iter, &q)) {
+    // Read the size after the glyph was added, which may have grown it
+    auto const w = float(atlasWidth);
+    auto const h = float(atlasHeight);
+    TextVertex const a{{q.x0, q.y0}, {q.s0 * w, q.t0 * h}, aColor};
+    TextVertex const b{{q.x1, q.y0}, {q.s1 * w, q.t0 * h}, aColor};
+    TextVertex const c{{q.x1, q.y1}, {q.s1 * w, q.t1 * h}, aColor};
+    TextVertex const d{{q.x0, q.y1}, {q.s0 * w, q.t1 * h}, aColor};
+    aOut.insert(aOut.end(), {a, b, c, a, c, d});
+  }
+
+  if (0 != fontError) {
+    int const error = std::exchange(fontError, 0);
+    throw Error("fontstash error %d (%s) laying out '%.*s'", error,
+                font_error_name_(error), int(aText.size()), aText.data());
+  }
+}
+
+void TextRenderer::begin(float aFbWidth, float aFbHeight) {
+  vertices.clear();
+  viewport = {aFbWidth, aFbHeight};
+  frameGeneration = generation;
+}
+
+void TextRenderer::add(std::span<TextVertex const> aVertices) {
+  vertices.insert(vertices.end(), aVertices.begin(), aVertices.end());
+}
+
+void TextRenderer::uploadAtlas() {
+  int dirty[4];
+  if (!fonsValidateTexture(context, dirty)) return;
+
+  int width, height;
+  unsigned char const* data = fonsGetTextureData(context, &width, &height);
+  glBindTexture(GL_TEXTURE_2D, atlas);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+  glPixelStorei(GL_UNPACK_SKIP_PIXELS, dirty[0]);
+  glPixelStorei(GL_UNPACK_SKIP_ROWS, dirty[1]);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, dirty[0], dirty[1], dirty[2] - dirty[0],
+                  dirty[3] - dirty[1], GL_RED, GL_UNSIGNED_BYTE, data);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+  glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+}
+
+void TextRenderer::draw() {
+  // Text laid out before the atlas was cleared this frame points at the
+  // wrong glyphs; skip it, the labels lay themselves out again next frame
+  if (frameGeneration != generation) vertices.clear();
+
+  uploadAtlas();
+  if (vertices.empty()) return;
+
+  // Orphan the previous contents rather than waiting for the GPU to finish
+  // with them; the storage only grows
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  capacity = std::max(capacity, vertices.capacity());
+  glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(TextVertex), nullptr,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(TextVertex),
+                  vertices.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glUniform2f(kViewportLocation, viewport.x, viewport.y);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, atlas);
+  glBindVertexArray(vao);
+  glDrawArrays(GL_TRIANGLES, 0, GLsizei(vertices.size()));
+  glBindVertexArray(0);
+}
+
+void TextLabel::set(TextRenderer& aRenderer, std::string_view aText,
+                    Vec2f aCentre, float aSize, Vec4f const& aColor) {
+  if (generation == aRenderer.atlasGeneration() && text == aText &&
+      centre.x == aCentre.x && centre.y == aCentre.y && size == aSize &&
+      color.x == aColor.x && color.y == aColor.y && color.z == aColor.z &&
+      color.w == aColor.w) {
+    return;
+  }
+
+  text.assign(aText);
+  centre = aCentre;
+  size = aSize;
+  color = aColor;
+  generation = aRenderer.atlasGeneration();
+  quads.clear();
+  aRenderer.layout(text, centre, size, color, quads);
+}
@@ -0,0 +1,106 @@
+#ifndef TEXT_HPP_5F0C2B87_A41D_4E63_8B9A_D7E3162C04F5
+#define TEXT_HPP_5F0C2B87_A41D_4E63_8B9A_D7E3162C04F5
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../vmlib/vec2.hpp"
+#include "../vmlib/vec4.hpp"
+
+struct FONScontext;
+
+constexpr char const* kFontPath = "assets/cw2/DroidSansMonoDotted.ttf";
+
+// One corner of a glyph quad. The position is in framebuffer pixels from the
+// bottom left; the texture coordinate is in atlas texels, so quads stay
+// valid when the atlas grows.
+struct TextVertex {
+  Vec2f position;
+  Vec2f texel;
+  Vec4f color;
+};
+
+/* TextRenderer: HUD text from a glyph atlas, drawn in one call
+ *
+ * Glyphs are rasterised by fontstash the first time they are laid out and
+ * cached in an R8 atlas texture; draw() uploads only the part of the atlas
+ * that changed. When the atlas is full it is doubled in size, keeping the
+ * glyphs where they are, and only cleared once it reaches its largest size.
+ * Clearing bumps atlasGeneration(), after which laid out text must be laid
+ * out again (see TextLabel).
+ *
+ * Like UiBatch, text is appended between begin() and draw() and streamed
+ * into one vertex buffer. Draw with text.vert and text.frag, blending
+ * enabled.
+ */
+class TextRenderer {
+ public:
+  explicit TextRenderer(char const* aFontPath);  // throws Error
+  ~TextRenderer();
+
+  TextRenderer(TextRenderer const&) = delete;
+  TextRenderer& operator=(TextRenderer const&) = delete;
+
+  std::uint32_t atlasGeneration() const { return generation; }
+
+  // Appends the quads of aText, centred on aCentre, to aOut; throws Error
+  void layout(std::string_view aText, Vec2f aCentre, float aSize,
+              Vec4f const& aColor, std::vector<TextVertex>& aOut);
+
+  void begin(float aFbWidth, float aFbHeight);
+  void add(std::span<TextVertex const> aVertices);
+  void draw();
+
+ private:
+  // fontstash callbacks
+  static int createAtlas(void* aUser, int aWidth, int aHeight);
+  static int resizeAtlas(void* aUser, int aWidth, int aHeight);
+  static void deleteAtlas(void* aUser);
+  static void handleError(void* aUser, int aError, int aValue);
+
+  void uploadAtlas();
+
+  FONScontext* context;
+  int font;
+  int fontError;  // reported by fontstash, thrown by layout()
+  GLuint atlas;
+  int atlasWidth, atlasHeight;
+  std::uint32_t generation;
+  std::uint32_t frameGeneration;
+
+  std::vector<TextVertex> vertices;
+  Vec2f viewport;
+
+  GLuint vao;
+  GLuint vbo;
+  std::size_t capacity;  // vertices the buffer can hold
+};
+
+/* TextLabel: a string laid out once and drawn every frame
+ *
+ * set() only lays the text out again when it, its placement or the atlas
+ * changed, and reuses its storage, so an unchanged or same-length label
+ * costs no allocation.
+ */
+class TextLabel {
+ public:
+  void set(TextRenderer& aRenderer, std::string_view aText, Vec2f aCentre,
+           float aSize, Vec4f const& aColor);
+
+  std::span<TextVertex const> vertices() const { return quads; }
+
+ private:
+  std::string text;
+  Vec2f centre{0.f, 0.f};
+  float size = 0.f;
+  Vec4f color{0.f, 0.f, 0.f, 0.f};
+  std::uint32_t generation = ~std::uint32_t(0);
+  std::vector<TextVertex> quads;
+};
+
+#endif  // TEXT_HPP_5F0C2B87_A41D_4E63_8B9A_D7E3162C04F5
@@ -0,0 +1,171 @@
+#include "trajectory.hpp"
+
+#include <algorithm>
+
+#include "simulation.hpp"
+
+namespace {
+// A ship further than this from where its path put it is flown again
+constexpr float kPathTolerance = 1e-4f;
+
+// Ships per job: a tick each when extending, every tick when forking
+constexpr std::size_t kExtendGrain = 2048;
+constexpr std::size_t kForkGrain = 256;
+}  // namespace
+
+TrajectoryPredictor::TrajectoryPredictor(std::size_t aSteps)
+    : stepCount(aSteps) {}
+
+void TrajectoryPredictor::update(RigidBodies const& aShips,
+                                 std::span<ShipFlight const> aFlights) {
+  prepare(aShips, aFlights);
+  if (forked.size() < size()) extend(0, size());
+  if (!forked.empty()) flyForks(0, forked.size());
+  finish();
+}
+
+void TrajectoryPredictor::update(JobSystem& aJobs, RigidBodies const& aShips,
+                                 std::span<ShipFlight const> aFlights) {
+  prepare(aShips, aFlights);
+  // In two passes: the ends of forked ships are extended too, and their
+  // new last points then overwritten
+  if (forked.size() < size()) {
+    aJobs.parallel_for(0, size(), kExtendGrain,
+                       [this](std::size_t aBegin, std::size_t aEnd) {
+                         extend(aBegin, aEnd);
+                       });
+  }
+  aJobs.parallel_for(0, forked.size(), kForkGrain,
+                     [this](std::size_t aBegin, std::size_t aEnd) {
+                       flyForks(aBegin, aEnd);
+                     });
+  finish();
+}
+
+void TrajectoryPredictor::copyPaths(std::vector<Vec3f>& aOut) const {
+  std::size_t const length = stepCount + 1;
+  aOut.resize(size() * length);
+  for (std::size_t k = 0; k < length; ++k) {
+    std::size_t const s = slot(k) * size();
+    for (std::size_t i = 0; i < size(); ++i)
+      aOut[i * length + k] = Vec3f{pathX[s + i], pathY[s + i], pathZ[s + i]};
+  }
+}
+
+void TrajectoryPredictor::setPoint(std::size_t aShip, std::size_t aStep,
+                                   RigidBodies const& aBodies,
+                                   std::size_t aBody) {
+  std::size_t const i = slot(aStep) * size() + aShip;
+  pathX[i] = aBodies.x[aBody];
+  pathY[i] = aBodies.y[aBody];
+  pathZ[i] = aBodies.z[aBody];
+}
+
+void TrajectoryPredictor::prepare(RigidBodies const& aShips,
+                                  std::span<ShipFlight const> aFlights) {
+  std::size_t const count = aShips.size();
+  bool const fresh = count != size();
+  if (fresh) {
+    head = 0;
+    for (auto* path : {&pathX, &pathY, &pathZ})
+      path->assign((stepCount + 1) * count, 0.f);
+    ends.resize(count);
+    endFlights.resize(count);
+    engines.assign(count, 0);
+  } else {
+    // Point 1 becomes point 0, and the old point 0 the last
+    head = slot(1);
+  }
+
+  forked.clear();
+  for (std::size_t i = 0; i < count; ++i) {
+    Vec3f const offset = aShips.position(i) - point(i, 0);
+    bool const engine = aFlights[i].engineOn;
+    if (fresh || engine != bool(engines[i]) ||
+        dot(offset, offset) > kPathTolerance * kPathTolerance)
+      forked.push_back(std::uint32_t(i));
+    engines[i] = engine;
+  }
+
+  forks.resize(forked.size());
+  forkFlights.resize(forked.size());
+  for (std::size_t f = 0; f < forked.size(); ++f) {
+    forks.copy(f, aShips, forked[f]);
+    forkFlights[f] = aFlights[forked[f]];
+    setPoint(forked[f], 0, aShips, forked[f]);
+  }
+}
+
+void TrajectoryPredictor::extend(std::size_t aBegin, std::size_t aEnd) {
+  fly_ships(ends, endFlights, kSimulationStep, aBegin, aEnd);
+  for (std::size_t i = aBegin; i < aEnd; ++i) setPoint(i, stepCount, ends, i);
+}
+
+void TrajectoryPredictor::flyForks(std::size_t aBegin, std::size_t aEnd) {
+  for (std::size_t k = 1; k <= stepCount; ++k) {
+    fly_ships(forks, forkFlights, kSimulationStep, aBegin, aEnd);
+    for (std::size_t f = aBegin; f < aEnd; ++f)
+      setPoint(forked[f], k, forks, f);
+  }
+}
+
+void TrajectoryPredictor::finish() {
+  for (std::size_t f = 0; f < forked.size(); ++f) {
+    ends.copy(forked[f], forks, f);
+    endFlights[forked[f]] = forkFlights[f];
+  }
+}
+
+TrajectoryRenderer::TrajectoryRenderer()
+    : vao(0), vbo(0), capacity(0), pathLength(0) {
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
+  glGenBuffers(1, &vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3f), nullptr);
+  glEnableVertexAttribArray(0);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+TrajectoryRenderer::~TrajectoryRenderer() {
+  glDeleteBuffers(1, &vbo);
+  glDeleteVertexArrays(1, &vao);
+}
+
+void TrajectoryRenderer::update(std::span<Vec3f const> aPaths,
+                                std::size_t aPathLength) {
+  std::size_t const paths = aPathLength > 1 ? aPaths.size() / aPathLength : 0;
+  pathLength = GLint(aPathLength);
+  firsts.resize(paths);
+  counts.resize(paths);
+  for (std::size_t i = 0; i < paths; ++i) {
+    firsts[i] = GLint(i * aPathLength);
+    counts[i] = GLsizei(aPathLength);
+  }
+  if (0 == paths) return;
+
+  // Orphan the previous contents rather than waiting for the GPU to finish
+  // with them
+  capacity = std::max(capacity, aPaths.size());
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(capacity * sizeof(Vec3f)),
+               nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0,
+                  GLsizeiptr(paths * aPathLength * sizeof(Vec3f)),
+                  aPaths.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TrajectoryRenderer::draw(Mat44f const& aCameraProjection) const {
+  if (firsts.empty()) return;
+
+  glUniformMatrix4fv(0, 1, GL_TRUE, aCameraProjection.v);
+  glUniform1i(1, pathLength);
+  glBindVertexArray(vao);
+  glMultiDrawArrays(GL_LINE_STRIP, firsts.data(), counts.data(),
+                    GLsizei(firsts.size()));
+  glBindVertexArray(0);
+}
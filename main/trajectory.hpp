@@ -0,0 +1,121 @@
+#ifndef TRAJECTORY_HPP_2C7D95E1_46AF_4B08_9E3A_D18F60B2C574
+#define TRAJECTORY_HPP_2C7D95E1_46AF_4B08_9E3A_D18F60B2C574
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/vec3.hpp"
+#include "job_system.hpp"
+#include "rigid_body.hpp"
+#include "spaceship.hpp"
+
+// Ticks ahead that paths are predicted
+constexpr std::size_t kPredictionSteps = 480;
+
+/* TrajectoryPredictor: where ships are going if nothing changes
+ *
+ * update() forks the ships' state after a tick and flies the copies ahead
+ * with fly_ships(), the flight model the simulation itself uses. All
+ * copies take each tick together, so every tick is one SIMD pass across
+ * the ships. Point k of a ship's path is where it will be k ticks from
+ * now, for k = 0 .. steps().
+ *
+ * Paths are kept as a ring of ticks, each holding that point of every ship,
+ * together with the copies' state at the end of the paths. Usually a ship
+ * is where its path said it would be and its engine is as it was; then the
+ * path is reused: the ring turns by one tick and the end state flies one
+ * tick on for the new last point. Only ships that have left their paths,
+ * e.g. after a collision or a reset, or whose engine was switched, are
+ * flown again from the start.
+ */
+class TrajectoryPredictor {
+ public:
+  explicit TrajectoryPredictor(std::size_t aSteps = kPredictionSteps);
+
+  std::size_t size() const { return engines.size(); }
+  std::size_t steps() const { return stepCount; }
+  // Ships flown from the start by the last update()
+  std::size_t repredicted() const { return forked.size(); }
+
+  // aShips as after the latest tick, flying aFlights. A different number
+  // of ships than last time are all predicted from the start.
+  void update(RigidBodies const& aShips, std::span<ShipFlight const> aFlights);
+  void update(JobSystem& aJobs, RigidBodies const& aShips,
+              std::span<ShipFlight const> aFlights);
+
+  Vec3f point(std::size_t aShip, std::size_t aStep) const {
+    std::size_t const i = slot(aStep) * size() + aShip;
+    return Vec3f{pathX[i], pathY[i], pathZ[i]};
+  }
+  // All paths one after the other, steps() + 1 points each
+  void copyPaths(std::vector<Vec3f>& aOut) const;
+
+ private:
+  std::size_t slot(std::size_t aStep) const {
+    return (head + aStep) % (stepCount + 1);
+  }
+  void setPoint(std::size_t aShip, std::size_t aStep, RigidBodies const&,
+                std::size_t aBody);
+
+  // Turns the ring and forks the ships whose paths cannot be reused
+  void prepare(RigidBodies const& aShips,
+               std::span<ShipFlight const> aFlights);
+  // Flies ends [aBegin, aEnd) one tick on
+  void extend(std::size_t aBegin, std::size_t aEnd);
+  // Flies forks [aBegin, aEnd) every step from the start
+  void flyForks(std::size_t aBegin, std::size_t aEnd);
+  // Makes the forks' final states the ends of their ships' paths
+  void finish();
+
+  std::size_t stepCount;
+  // Slot s of the ring holds point (s - head) mod (stepCount + 1) of every
+  // ship, at [s * size(), (s + 1) * size())
+  std::size_t head = 0;
+  std::vector<float> pathX, pathY, pathZ;
+  // State at the last point of every path, and the engines as of the last
+  // update()
+  RigidBodies ends;
+  std::vector<ShipFlight> endFlights;
+  std::vector<std::uint8_t> engines;
+
+  // Ships being flown from the start; fork i is ship forked[i]
+  RigidBodies forks;
+  std::vector<ShipFlight> forkFlights;
+  std::vector<std::uint32_t> forked;
+};
+
+/* TrajectoryRenderer: draws predicted paths as line strips
+ *
+ * update() streams the paths into a vertex buffer, orphaning the previous
+ * contents, and draw() draws a strip per path with one glMultiDrawArrays()
+ * call. Draw with trajectory.vert; paths fade out towards their ends.
+ */
+class TrajectoryRenderer {
+ public:
+  TrajectoryRenderer();
+  ~TrajectoryRenderer();
+
+  TrajectoryRenderer(TrajectoryRenderer const&) = delete;
+  TrajectoryRenderer& operator=(TrajectoryRenderer const&) = delete;
+
+  // aPaths holds paths of aPathLength points, one after the other
+  void update(std::span<Vec3f const> aPaths, std::size_t aPathLength);
+  // The program must be in use
+  void draw(Mat44f const& aCameraProjection) const;
+
+ private:
+  GLuint vao;
+  GLuint vbo;
+  std::size_t capacity;  // points
+  GLint pathLength;
+
+  std::vector<GLint> firsts;
+  std::vector<GLsizei> counts;
+};
+
+#endif  // TRAJECTORY_HPP_2C7D95E1_46AF_4B08_9E3A_D18F60B2C574
@@ -0,0 +1,54 @@
+#ifndef TRIPLE_BUFFER_HPP_5E2B8C41_93D7_4F0A_A6C2_1B7D0E94F3A8
+#define TRIPLE_BUFFER_HPP_5E2B8C41_93D7_4F0A_A6C2_1B7D0E94F3A8
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/* TripleBuffer: lock-free hand-over of the latest value from one writer
+ * thread to one reader thread
+ *
+ * The writer fills writeBuffer() and publish()es it; the reader calls read()
+ * to get the most recently published value. Neither side ever waits for the
+ * other: the third slot sits between them and is swapped in with a single
+ * atomic exchange. Values published while the reader is busy are dropped in
+ * favour of newer ones.
+ */
+template <typename T>
+class TripleBuffer {
+ public:
+  explicit TripleBuffer(T const& aInitial = T{})
+      : slots{Slot{aInitial}, Slot{aInitial}, Slot{aInitial}} {}
+
+  TripleBuffer(TripleBuffer const&) = delete;
+  TripleBuffer& operator=(TripleBuffer const&) = delete;
+
+  // Writer side
+  T& writeBuffer() { return slots[back].value; }
+  void publish() {
+    back = middle.exchange(back | kFresh, std::memory_order_acq_rel) & kIndex;
+  }
+
+  // Reader side. The reference stays valid until the next call.
+  T const& read() {
+    if (middle.load(std::memory_order_relaxed) & kFresh)
+      front = middle.exchange(front, std::memory_order_acq_rel) & kIndex;
+    return slots[front].value;
+  }
+
+ private:
+  static constexpr std::uint8_t kIndex = 0x3;
+  static constexpr std::uint8_t kFresh = 0x4;  // middle holds unread data
+
+  // Keep the slots on separate cache lines
+  struct alignas(64) Slot {
+    T value;
+  };
+  std::array<Slot, 3> slots;
+
+  alignas(64) std::uint8_t back = 0;   // owned by the writer
+  alignas(64) std::uint8_t front = 1;  // owned by the reader
+  alignas(64) std::atomic<std::uint8_t> middle{2};
+};
+
+#endif  // TRIPLE_BUFFER_HPP_5E2B8C41_93D7_4F0A_A6C2_1B7D0E94F3A8
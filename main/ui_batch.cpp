@@ -0,0 +1,81 @@
+#include "ui_batch.hpp"
+
+#include <algorithm>
+
+namespace {
+// Uniform location in ui.vert
+constexpr GLint kViewportLocation = 0;
+// Initial buffer size, in quads; enough for the usual HUD
+constexpr std::size_t kInitialQuads = 64;
+}  // namespace
+
+UiBatch::UiBatch()
+    : viewport{1.f, 1.f}, vao(0), vbo(0), capacity(6 * kInitialQuads) {
+  vertices.reserve(capacity);
+
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
+  glGenBuffers(1, &vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(UiVertex), nullptr,
+               GL_STREAM_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(UiVertex),
+                        reinterpret_cast<void const*>(
+                            offsetof(UiVertex, position)));
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(UiVertex),
+                        reinterpret_cast<void const*>(
+                            offsetof(UiVertex, color)));
+  glEnableVertexAttribArray(1);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+UiBatch::~UiBatch() {
+  glDeleteBuffers(1, &vbo);
+  glDeleteVertexArrays(1, &vao);
+}
+
+void UiBatch::begin(float aFbWidth, float aFbHeight) {
+  vertices.clear();
+  viewport = {aFbWidth, aFbHeight};
+}
+
+void UiBatch::addRect(Vec4f const& aRect, Vec4f const& aColor) {
+  UiVertex const bl{{aRect.x, aRect.y}, aColor};
+  UiVertex const br{{aRect.z, aRect.y}, aColor};
+  UiVertex const tr{{aRect.z, aRect.w}, aColor};
+  UiVertex const tl{{aRect.x, aRect.w}, aColor};
+  vertices.insert(vertices.end(), {bl, br, tr, bl, tr, tl});
+}
+
+void UiBatch::addFrame(Vec4f const& aRect, float aWidth,
+                       Vec4f const& aColor) {
+  float const w = aWidth;
+  // Bottom and top span the corners; left and right fit between them
+  addRect({aRect.x - w, aRect.y - w, aRect.z + w, aRect.y}, aColor);
+  addRect({aRect.x - w, aRect.w, aRect.z + w, aRect.w + w}, aColor);
+  addRect({aRect.x - w, aRect.y, aRect.x, aRect.w}, aColor);
+  addRect({aRect.z, aRect.y, aRect.z + w, aRect.w}, aColor);
+}
+
+void UiBatch::draw() {
+  if (vertices.empty()) return;
+
+  // Orphan the previous contents rather than waiting for the GPU to finish
+  // with them; the storage only grows
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  capacity = std::max(capacity, vertices.capacity());
+  glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(UiVertex), nullptr,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(UiVertex),
+                  vertices.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glUniform2f(kViewportLocation, viewport.x, viewport.y);
+  glBindVertexArray(vao);
+  glDrawArrays(GL_TRIANGLES, 0, GLsizei(vertices.size()));
+  glBindVertexArray(0);
+}
@@ -0,0 +1,55 @@
+#ifndef UI_BATCH_HPP_A83F5C12_6D4E_4B97_B1C0_2E9D7F64A581
+#define UI_BATCH_HPP_A83F5C12_6D4E_4B97_B1C0_2E9D7F64A581
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "../vmlib/vec2.hpp"
+#include "../vmlib/vec4.hpp"
+
+// One corner of a UI quad; the position is in framebuffer pixels from the
+// bottom left
+struct UiVertex {
+  Vec2f position;
+  Vec4f color;
+};
+
+/* UiBatch: collects the HUD's coloured quads and draws them in one call
+ *
+ * Widgets append quads between begin() and draw(), in back-to-front order.
+ * draw() streams them into one vertex buffer that only grows, so neither
+ * new frames nor framebuffer resizes create GL objects. Draw with ui.vert
+ * and ui.frag, blending enabled.
+ */
+class UiBatch {
+ public:
+  UiBatch();
+  ~UiBatch();
+
+  UiBatch(UiBatch const&) = delete;
+  UiBatch& operator=(UiBatch const&) = delete;
+
+  // Starts a frame for a framebuffer of the given size
+  void begin(float aFbWidth, float aFbHeight);
+
+  // aRect is (left, bottom, right, top)
+  void addRect(Vec4f const& aRect, Vec4f const& aColor);
+  // A border of aWidth pixels around the outside of aRect
+  void addFrame(Vec4f const& aRect, float aWidth, Vec4f const& aColor);
+
+  void draw();
+
+  std::size_t quadCount() const { return vertices.size() / 6; }
+
+ private:
+  std::vector<UiVertex> vertices;
+  Vec2f viewport;
+
+  GLuint vao;
+  GLuint vbo;
+  std::size_t capacity;  // vertices the buffer can hold
+};
+
+#endif  // UI_BATCH_HPP_A83F5C12_6D4E_4B97_B1C0_2E9D7F64A581
@@ -0,0 +1,246 @@
+#ifndef UNIT_SHAPES_HPP_216328F6_F204_4A63_89C1_E002D32A3369
+#define UNIT_SHAPES_HPP_216328F6_F204_4A63_89C1_E002D32A3369
+
+#include <array>
+#include <cstdlib>
+#include <numbers>
+
+#include "../vmlib/vec3.hpp"
+
+/* Canonical (untransformed) primitive tables
+ *
+ * The unit cylinder, cone and sphere only depend on their template
+ * parameters, so their vertex and normal tables are evaluated once by the
+ * compiler and stored as constant data. make_cylinder() and friends (see
+ * shape.hpp) then only have to apply the pre-transform to these tables.
+ *
+ * std::sin(), std::cos() and std::sqrt() are not constexpr, hence the small
+ * replacements in detail. They evaluate in double precision, which is plenty
+ * for values that end up as floats.
+ */
+namespace detail {
+constexpr double ct_sin(double aX) noexcept {
+  // Reduce to [-pi, pi]; the series below converges well in that range.
+  constexpr double kTwoPi = 2.0 * std::numbers::pi;
+  while (aX > std::numbers::pi) aX -= kTwoPi;
+  while (aX < -std::numbers::pi) aX += kTwoPi;
+
+  double term = aX;
+  double sum = aX;
+  for (int i = 1; i < 12; ++i) {
+    term *= -aX * aX / double((2 * i) * (2 * i + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double ct_cos(double aX) noexcept {
+  return ct_sin(aX + 0.5 * std::numbers::pi);
+}
+
+constexpr double ct_sqrt(double aX) noexcept {
+  if (aX <= 0.0) return 0.0;
+
+  // Newton iterations starting above the root converge monotonically.
+  double r = aX > 1.0 ? aX : 1.0;
+  for (int i = 0; i < 128; ++i) {
+    double const next = 0.5 * (r + aX / r);
+    if (next >= r) break;
+    r = next;
+  }
+  return r;
+}
+
+constexpr Vec3f ct_normalize(Vec3f aVec) noexcept {
+  return aVec / float(ct_sqrt(double(dot(aVec, aVec))));
+}
+
+// Point on the unit circle in the YZ plane (matches the original generators)
+constexpr Vec3f circle_point(std::size_t aIndex, std::size_t aSubdivs) noexcept {
+  double const angle =
+      double(aIndex) / double(aSubdivs) * 2.0 * std::numbers::pi;
+  return Vec3f{0.f, float(ct_sin(angle)), float(ct_cos(angle))};
+}
+}  // namespace detail
+
+template <std::size_t tVertexCount>
+struct UnitShape {
+  static constexpr std::size_t kVertexCount = tVertexCount;
+
+  std::array<Vec3f, tVertexCount> positions{};
+  std::array<Vec3f, tVertexCount> normals{};
+};
+
+// Cylinder along the X axis from x=0 to x=1 with radius 1
+template <std::size_t tSubdivs, bool tCapped>
+constexpr auto make_unit_cylinder() noexcept {
+  static_assert(tSubdivs >= 3, "Cylinder needs at least three subdivisions");
+
+  UnitShape<3 * (2 + (tCapped ? 2 : 0)) * tSubdivs> ret;
+  auto& pos = ret.positions;
+  auto& norm = ret.normals;
+
+  std::size_t index = 0;
+  for (std::size_t i = 0; i < tSubdivs; i++) {
+    Vec3f const prev = detail::circle_point(i, tSubdivs);
+    Vec3f const cur = detail::circle_point(i + 1, tSubdivs);
+
+    // Normals point out from unit circle
+    norm[index] = prev;
+    pos[index++] = prev;
+    norm[index] = prev;
+    pos[index++] = Vec3f{1.f, prev.y, prev.z};
+    norm[index] = cur;
+    pos[index++] = cur;
+
+    norm[index] = cur;
+    pos[index++] = cur;
+    norm[index] = prev;
+    pos[index++] = Vec3f{1.f, prev.y, prev.z};
+    norm[index] = cur;
+    pos[index++] = Vec3f{1.f, cur.y, cur.z};
+
+    if constexpr (tCapped) {
+      norm[index] = Vec3f{-1.f, 0.f, 0.f};
+      pos[index++] = Vec3f{0.f, 0.f, 0.f};
+      norm[index] = Vec3f{-1.f, 0.f, 0.f};
+      pos[index++] = prev;
+      norm[index] = Vec3f{-1.f, 0.f, 0.f};
+      pos[index++] = cur;
+
+      norm[index] = Vec3f{1.f, 0.f, 0.f};
+      pos[index++] = Vec3f{1.f, 0.f, 0.f};
+      norm[index] = Vec3f{1.f, 0.f, 0.f};
+      pos[index++] = Vec3f{1.f, cur.y, cur.z};
+      norm[index] = Vec3f{1.f, 0.f, 0.f};
+      pos[index++] = Vec3f{1.f, prev.y, prev.z};
+    }
+  }
+  return ret;
+}
+
+// Cone along the X axis with its base at x=0 and its tip at x=1
+template <std::size_t tSubdivs, bool tCapped>
+constexpr auto make_unit_cone() noexcept {
+  static_assert(tSubdivs >= 3, "Cone needs at least three subdivisions");
+
+  UnitShape<3 * (1 + (tCapped ? 1 : 0)) * tSubdivs> ret;
+  auto& pos = ret.positions;
+  auto& norm = ret.normals;
+
+  std::size_t index = 0;
+  for (std::size_t i = 0; i < tSubdivs; i++) {
+    Vec3f const prev = detail::circle_point(i, tSubdivs);
+    Vec3f const cur = detail::circle_point(i + 1, tSubdivs);
+
+    // Normals are slanted upwards towards X axis by 45 degrees. Normalize
+    // vector sum of (1, 0, 0) and (0, y, z)
+
+    // Cone top chosen to have normal equal to face normal
+    norm[index] = detail::ct_normalize(
+        Vec3f{1.f, 0.f, 0.f} + detail::ct_normalize((prev + cur) / 2.f));
+    pos[index++] = Vec3f{1.f, 0.f, 0.f};
+    norm[index] = detail::ct_normalize(Vec3f{1.f, cur.y, cur.z});
+    pos[index++] = cur;
+    norm[index] = detail::ct_normalize(Vec3f{1.f, prev.y, prev.z});
+    pos[index++] = prev;
+
+    if constexpr (tCapped) {
+      norm[index] = Vec3f{-1.f, 0.f, 0.f};
+      pos[index++] = Vec3f{0.f, 0.f, 0.f};
+      norm[index] = Vec3f{-1.f, 0.f, 0.f};
+      pos[index++] = prev;
+      norm[index] = Vec3f{-1.f, 0.f, 0.f};
+      pos[index++] = cur;
+    }
+  }
+  return ret;
+}
+
+// Unit sphere made by subdividing an icosahedron tSubdivLoops times
+template <std::size_t tSubdivLoops>
+constexpr auto make_unit_sphere() noexcept {
+  constexpr std::size_t kFaceCount = 20 * (std::size_t(1) << (2 * tSubdivLoops));
+  // Each loop adds three (unshared) midpoints per face
+  constexpr std::size_t kPointCount = 12 + (kFaceCount - 20);
+
+  // Start with triangular icosohedron
+  float const phi = float((1.0 + detail::ct_sqrt(5.0)) * 0.5);
+  float const a = float(1.0 / detail::ct_sqrt(1.0 + 1.0 / (phi * phi)));
+  float const b = a / phi;
+
+  std::array<Vec3f, kPointCount> points{};
+  std::array<Vec3f, 12> const base = {{{0, b, -a},
+                                       {b, a, 0},
+                                       {-b, a, 0},
+                                       {0, b, a},
+                                       {0, -b, a},
+                                       {-a, 0, b},
+                                       {0, -b, -a},
+                                       {a, 0, -b},
+                                       {a, 0, b},
+                                       {-a, 0, -b},
+                                       {b, -a, 0},
+                                       {-b, -a, 0}}};
+  for (std::size_t i = 0; i < base.size(); ++i) points[i] = base[i];
+
+  using Face = std::array<std::size_t, 3>;
+  std::array<Face, kFaceCount> faces{};
+  std::array<Face, 20> const baseFaces = {
+      {{2, 1, 0},   {1, 2, 3},   {5, 4, 3},  {4, 8, 3},  {7, 6, 0},
+       {6, 9, 0},   {11, 10, 4}, {10, 11, 6}, {9, 5, 2},  {5, 9, 11},
+       {8, 7, 1},   {7, 8, 10},  {2, 5, 3},   {8, 1, 3},  {9, 2, 0},
+       {1, 7, 0},   {11, 9, 6},  {7, 10, 6},  {5, 11, 4}, {10, 8, 4}}};
+  for (std::size_t i = 0; i < baseFaces.size(); ++i) faces[i] = baseFaces[i];
+
+  // Perform sub division
+  std::size_t pointCount = base.size();
+  std::size_t faceCount = baseFaces.size();
+  for (std::size_t i = 0; i < tSubdivLoops; i++) {
+    std::array<Face, kFaceCount> newFaces{};
+    std::size_t face_i = 0;
+    for (std::size_t f = 0; f < faceCount; ++f) {
+      Vec3f const v0 = points[faces[f][0]];
+      Vec3f const v1 = points[faces[f][1]];
+      Vec3f const v2 = points[faces[f][2]];
+
+      // Add midpoints to points
+      std::size_t const m = pointCount;
+      points[pointCount++] = detail::ct_normalize((v0 + v1) / 2.f);
+      points[pointCount++] = detail::ct_normalize((v1 + v2) / 2.f);
+      points[pointCount++] = detail::ct_normalize((v2 + v0) / 2.f);
+
+      // Create new faces (ensuring forward facing)
+      newFaces[face_i++] = {faces[f][0], m, m + 2};
+      newFaces[face_i++] = {faces[f][1], m + 1, m};
+      newFaces[face_i++] = {faces[f][2], m + 2, m + 1};
+      newFaces[face_i++] = {m, m + 1, m + 2};
+    }
+    faces = newFaces;
+    faceCount = face_i;
+  }
+
+  // Convert to triangle soup; normals are equal to positions
+  UnitShape<3 * kFaceCount> ret;
+  std::size_t index = 0;
+  for (auto const& f : faces) {
+    for (std::size_t k = 0; k < 3; ++k) {
+      ret.positions[index] = points[f[k]];
+      ret.normals[index] = points[f[k]];
+      ++index;
+    }
+  }
+  return ret;
+}
+
+// Tables, evaluated at compile time on first use of each parameter set
+template <std::size_t tSubdivs, bool tCapped>
+inline constexpr auto kUnitCylinder = make_unit_cylinder<tSubdivs, tCapped>();
+
+template <std::size_t tSubdivs, bool tCapped>
+inline constexpr auto kUnitCone = make_unit_cone<tSubdivs, tCapped>();
+
+template <std::size_t tSubdivLoops>
+inline constexpr auto kUnitSphere = make_unit_sphere<tSubdivLoops>();
+
+#endif  // UNIT_SHAPES_HPP_216328F6_F204_4A63_89C1_E002D32A3369
@@ -0,0 +1,62 @@
+#include <catch2/catch_amalgamated.hpp>
+#include <random>
+
+#include "../vmlib/aabb.hpp"
+
+TEST_CASE("Axis-aligned bounding boxes", "[aabb]") {
+  static constexpr float kEps_ = 1e-4f;
+
+  using namespace Catch::Matchers;
+
+  SECTION("Empty box") {
+    Aabb const empty;
+    REQUIRE(is_empty(empty));
+
+    Aabb const box{{-1.f, -2.f, -3.f}, {1.f, 2.f, 3.f}};
+    Aabb const merged = merge(empty, box);
+    REQUIRE(!is_empty(merged));
+    for (std::size_t i = 0; i < 3; ++i) {
+      REQUIRE(merged.min[i] == box.min[i]);
+      REQUIRE(merged.max[i] == box.max[i]);
+    }
+    REQUIRE(is_empty(transform(kIdentity34f, empty)));
+  }
+
+  SECTION("Transformed box contains the transformed corners") {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+    std::uniform_real_distribution<float> offset(-10.f, 10.f);
+
+    for (int n = 0; n < 100; ++n) {
+      Affine34f const m = to_affine34(
+          make_translation({offset(rng), offset(rng), offset(rng)}) *
+          make_rotation_x(angle(rng)) * make_rotation_y(angle(rng)) *
+          make_scaling(2.f, 0.5f, 3.f));
+      Aabb const box{{-1.f, 0.f, -2.f}, {1.f, 4.f, 0.5f}};
+
+      Aabb corners;
+      for (int c = 0; c < 8; ++c) {
+        Vec3f const p{(c & 1) ? box.max.x : box.min.x,
+                      (c & 2) ? box.max.y : box.min.y,
+                      (c & 4) ? box.max.z : box.min.z};
+        corners = merge(corners, transform_point(m, p));
+      }
+
+      // Arvo's box is the tight box around the transformed corners
+      Aabb const transformed = transform(m, box);
+      for (std::size_t i = 0; i < 3; ++i) {
+        REQUIRE_THAT(transformed.min[i], WithinAbs(corners.min[i], kEps_));
+        REQUIRE_THAT(transformed.max[i], WithinAbs(corners.max[i], kEps_));
+      }
+    }
+  }
+
+  SECTION("Overlap and area") {
+    Aabb const a{{0.f, 0.f, 0.f}, {1.f, 2.f, 3.f}};
+    Aabb const b{{1.f, 1.f, 1.f}, {2.f, 2.f, 2.f}};
+    Aabb const c{{1.5f, 0.f, 0.f}, {2.f, 1.f, 1.f}};
+    REQUIRE(overlaps(a, b));
+    REQUIRE(!overlaps(a, c));
+    REQUIRE_THAT(half_area(a), WithinAbs(2.f + 6.f + 3.f, kEps_));
+  }
+}
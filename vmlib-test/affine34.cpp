@@ -0,0 +1,99 @@
+#include <catch2/catch_amalgamated.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "../vmlib/affine34.hpp"
+
+namespace {
+// Random rotation, non-uniform scale and translation
+Mat44f random_affine_(std::mt19937& aRng) {
+  std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+  std::uniform_real_distribution<float> scale(0.1f, 10.f);
+  std::uniform_real_distribution<float> offset(-100.f, 100.f);
+
+  return make_translation({offset(aRng), offset(aRng), offset(aRng)}) *
+         make_rotation_x(angle(aRng)) * make_rotation_y(angle(aRng)) *
+         make_rotation_z(angle(aRng)) *
+         make_scaling(scale(aRng), scale(aRng), scale(aRng));
+}
+
+RigidTransform random_rigid_(std::mt19937& aRng) {
+  std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+  std::uniform_real_distribution<float> offset(-100.f, 100.f);
+
+  Mat44f const r = make_rotation_x(angle(aRng)) * make_rotation_y(angle(aRng)) *
+                   make_rotation_z(angle(aRng));
+  return {mat44_to_mat33(r), {offset(aRng), offset(aRng), offset(aRng)}};
+}
+
+// Relative to the largest element of aExpected
+void require_close_(Mat44f const& aActual, Mat44f const& aExpected,
+                    float aRelEps) {
+  float scale = 1.f;
+  for (float x : aExpected.v) scale = std::max(scale, std::abs(x));
+  for (std::size_t i = 0; i < 16; ++i)
+    REQUIRE_THAT(aActual.v[i],
+                 Catch::Matchers::WithinAbs(aExpected.v[i], aRelEps * scale));
+}
+
+void require_close_(Mat33f const& aActual, Mat33f const& aExpected,
+                    float aRelEps) {
+  float scale = 1.f;
+  for (float x : aExpected.v) scale = std::max(scale, std::abs(x));
+  for (std::size_t i = 0; i < 9; ++i)
+    REQUIRE_THAT(aActual.v[i],
+                 Catch::Matchers::WithinAbs(aExpected.v[i], aRelEps * scale));
+}
+}  // namespace
+
+TEST_CASE("Affine and rigid transforms", "[affine34][mat44]") {
+  static constexpr float kEps_ = 1e-4f;
+  std::mt19937 rng(42);
+
+  SECTION("Affine inverse matches invert()") {
+    for (int n = 0; n < 1000; ++n) {
+      Mat44f const m = random_affine_(rng);
+      require_close_(to_mat44(invert(to_affine34(m))), invert(m), kEps_);
+    }
+  }
+
+  SECTION("Affine normal matrix matches transpose(invert())") {
+    for (int n = 0; n < 1000; ++n) {
+      Mat44f const m = random_affine_(rng);
+      require_close_(normal_matrix(to_affine34(m)),
+                     mat44_to_mat33(transpose(invert(m))), kEps_);
+    }
+  }
+
+  SECTION("Affine product matches Mat44f product") {
+    for (int n = 0; n < 1000; ++n) {
+      Mat44f const a = random_affine_(rng);
+      Mat44f const b = random_affine_(rng);
+      require_close_(to_mat44(to_affine34(a) * to_affine34(b)), a * b, kEps_);
+    }
+  }
+
+  SECTION("Rigid inverse matches invert()") {
+    for (int n = 0; n < 1000; ++n) {
+      RigidTransform const t = random_rigid_(rng);
+      require_close_(to_mat44(invert(t)), invert(to_mat44(t)), kEps_);
+      require_close_(normal_matrix(t),
+                     mat44_to_mat33(transpose(invert(to_mat44(t)))), kEps_);
+    }
+  }
+
+  SECTION("Rigid product and points") {
+    for (int n = 0; n < 1000; ++n) {
+      RigidTransform const a = random_rigid_(rng);
+      RigidTransform const b = random_rigid_(rng);
+      require_close_(to_mat44(a * b), to_mat44(a) * to_mat44(b), kEps_);
+
+      Vec3f const p{1.f, -2.f, 3.f};
+      Vec3f const q = transform_point(invert(a), transform_point(a, p));
+      REQUIRE_THAT(q.x, Catch::Matchers::WithinAbs(p.x, 1e-3f));
+      REQUIRE_THAT(q.y, Catch::Matchers::WithinAbs(p.y, 1e-3f));
+      REQUIRE_THAT(q.z, Catch::Matchers::WithinAbs(p.z, 1e-3f));
+    }
+  }
+}
@@ -0,0 +1,102 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+#include "../vmlib/quantize.hpp"
+
+TEST_CASE("Vertex attribute quantisation", "[quantize]") {
+  using namespace Catch::Matchers;
+
+  // Positions are stored as UNORM16 relative to the mesh AABB; the error on
+  // each axis must not exceed half a grid step.
+  SECTION("UNORM16 positions") {
+    Vec3f const lo{-3.5f, 0.f, 12.f};
+    Vec3f const extent{7.f, 0.25f, 40.f};
+    for (int i = 0; i <= 1000; ++i) {
+      float const t = float(i) / 1000.f;
+      Vec3f const p{lo.x + extent.x * t, lo.y + extent.y * t * t,
+                    lo.z + extent.z * std::sqrt(t)};
+      Vec3f const q{
+          lo.x + extent.x * dequantize_unorm16(
+                                quantize_unorm16((p.x - lo.x) / extent.x)),
+          lo.y + extent.y * dequantize_unorm16(
+                                quantize_unorm16((p.y - lo.y) / extent.y)),
+          lo.z + extent.z * dequantize_unorm16(
+                                quantize_unorm16((p.z - lo.z) / extent.z))};
+
+      // 1.01: slack for float rounding in the reconstruction itself
+      REQUIRE_THAT(q.x, WithinAbs(p.x, 1.01f * extent.x / 65535.f / 2.f));
+      REQUIRE_THAT(q.y, WithinAbs(p.y, 1.01f * extent.y / 65535.f / 2.f));
+      REQUIRE_THAT(q.z, WithinAbs(p.z, 1.01f * extent.z / 65535.f / 2.f));
+    }
+
+    REQUIRE(quantize_unorm16(0.f) == 0);
+    REQUIRE(quantize_unorm16(1.f) == 65535);
+    REQUIRE(quantize_unorm16(-0.5f) == 0);
+    REQUIRE(quantize_unorm16(1.5f) == 65535);
+  }
+
+  // Half floats have an 11 bit significand: relative error <= 2^-11
+  SECTION("Half floats") {
+    for (float v = 1e-4f; v < 60000.f; v *= 1.0137f) {
+      REQUIRE_THAT(half_to_float(float_to_half(v)),
+                   WithinRel(v, std::ldexp(1.f, -11)));
+      REQUIRE_THAT(half_to_float(float_to_half(-v)),
+                   WithinRel(-v, std::ldexp(1.f, -11)));
+    }
+
+    // Exactly representable values round trip
+    REQUIRE(half_to_float(float_to_half(0.f)) == 0.f);
+    REQUIRE(half_to_float(float_to_half(1.f)) == 1.f);
+    REQUIRE(half_to_float(float_to_half(-2.5f)) == -2.5f);
+    REQUIRE(half_to_float(float_to_half(65504.f)) == 65504.f);
+    REQUIRE(half_to_float(float_to_half(std::ldexp(1.f, -24))) ==
+            std::ldexp(1.f, -24));
+
+    // Ties round to even
+    REQUIRE(float_to_half(1.f + std::ldexp(1.f, -11)) == 0x3c00);
+    REQUIRE(float_to_half(1.f + 3.f * std::ldexp(1.f, -11)) == 0x3c02);
+
+    REQUIRE(std::isinf(half_to_float(float_to_half(1e6f))));
+  }
+
+  // Octahedral normals in 2 x SNORM16
+  SECTION("Octahedral normals") {
+    float maxAngle = 0.f;
+    for (int i = 0; i <= 64; ++i) {
+      float const theta = std::numbers::pi_v<float> * float(i) / 64.f;
+      for (int j = 0; j < 128; ++j) {
+        float const phi = 2.f * std::numbers::pi_v<float> * float(j) / 128.f;
+        Vec3f const n{std::sin(theta) * std::cos(phi),
+                      std::sin(theta) * std::sin(phi), std::cos(theta)};
+
+        Vec3f const d = oct_decode_snorm16(oct_encode_snorm16(n));
+        REQUIRE_THAT(length(d), WithinAbs(1.f, 1e-5f));
+
+        // Chord length ~ angle; acos() is too coarse in float near 1
+        maxAngle = std::max(maxAngle, length(n - d));
+      }
+    }
+
+    // The grid spacing is 2/32767 on the octahedron, which the projection
+    // stretches by up to about 2x on the sphere: ~0.01 degrees.
+    REQUIRE(maxAngle < 2e-4f);
+  }
+
+  // Colours in UNORM 2_10_10_10
+  SECTION("Packed colours") {
+    for (int i = 0; i <= 100; ++i) {
+      float const t = float(i) / 100.f;
+      Vec3f const c{t, 1.f - t, t * t};
+      Vec3f const d = unpack_unorm_1010102(pack_unorm_1010102(c));
+      REQUIRE_THAT(d.x, WithinAbs(c.x, 0.5f / 1023.f + 1e-7f));
+      REQUIRE_THAT(d.y, WithinAbs(c.y, 0.5f / 1023.f + 1e-7f));
+      REQUIRE_THAT(d.z, WithinAbs(c.z, 0.5f / 1023.f + 1e-7f));
+    }
+
+    // Alpha is always one
+    REQUIRE((pack_unorm_1010102(Vec3f{0.f, 0.f, 0.f}) >> 30) == 3u);
+  }
+}
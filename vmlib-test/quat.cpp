@@ -0,0 +1,120 @@
+#include <catch2/catch_amalgamated.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "../vmlib/quat.hpp"
+
+namespace {
+void require_close_(Mat44f const& aActual, Mat44f const& aExpected,
+                    float aEps) {
+  for (std::size_t i = 0; i < 16; ++i)
+    REQUIRE_THAT(aActual.v[i],
+                 Catch::Matchers::WithinAbs(aExpected.v[i], aEps));
+}
+
+void require_close_(Vec3f aActual, Vec3f aExpected, float aEps) {
+  for (std::size_t i = 0; i < 3; ++i)
+    REQUIRE_THAT(aActual[i], Catch::Matchers::WithinAbs(aExpected[i], aEps));
+}
+
+// Angle between two rotations
+float angle_between_(Quatf const& aA, Quatf const& aB) {
+  float const d = std::min(std::abs(dot(aA, aB)), 1.f);
+  return 2.f * std::acos(d);
+}
+}  // namespace
+
+TEST_CASE("Quaternions and TRS transforms", "[quat][mat44]") {
+  static constexpr float kEps_ = 1e-5f;
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+  std::uniform_real_distribution<float> offset(-10.f, 10.f);
+
+  SECTION("Axis rotations match make_rotation_*") {
+    for (int n = 0; n < 100; ++n) {
+      float const a = angle(rng);
+      require_close_(to_mat44(make_quat_rotation_x(a)), make_rotation_x(a),
+                     kEps_);
+      require_close_(to_mat44(make_quat_rotation_y(a)), make_rotation_y(a),
+                     kEps_);
+      require_close_(to_mat44(make_quat_rotation_z(a)), make_rotation_z(a),
+                     kEps_);
+    }
+  }
+
+  SECTION("Product matches the matrix product") {
+    for (int n = 0; n < 100; ++n) {
+      float const a = angle(rng), b = angle(rng), c = angle(rng);
+      Quatf const q = make_quat_rotation_x(a) * make_quat_rotation_y(b) *
+                      make_quat_rotation_z(c);
+      require_close_(to_mat44(q),
+                     make_rotation_x(a) * make_rotation_y(b) *
+                         make_rotation_z(c),
+                     kEps_);
+
+      Vec3f const v{offset(rng), offset(rng), offset(rng)};
+      require_close_(rotate(q, v), to_mat33(q) * v, 1e-4f);
+      require_close_(rotate(conjugate(q), rotate(q, v)), v, 1e-4f);
+    }
+  }
+
+  SECTION("slerp and nlerp") {
+    Quatf const from = make_quat_rotation_y(0.2f);
+    Quatf const to = make_quat_rotation_y(1.8f);
+
+    // Constant angular velocity
+    for (float t : {0.f, 0.25f, 0.5f, 0.75f, 1.f}) {
+      Quatf const q = slerp(from, to, t);
+      REQUIRE_THAT(angle_between_(q, make_quat_rotation_y(0.2f + 1.6f * t)),
+                   Catch::Matchers::WithinAbs(0.f, 1e-3f));
+    }
+
+    // The shorter arc, whichever sign the inputs have
+    Quatf const negTo{-to.x, -to.y, -to.z, -to.w};
+    REQUIRE_THAT(angle_between_(slerp(from, negTo, 0.5f),
+                                make_quat_rotation_y(1.f)),
+                 Catch::Matchers::WithinAbs(0.f, 1e-3f));
+    REQUIRE_THAT(angle_between_(nlerp(from, negTo, 0.5f),
+                                make_quat_rotation_y(1.f)),
+                 Catch::Matchers::WithinAbs(0.f, 1e-3f));
+
+    // nlerp is close to slerp over one simulation tick's worth of rotation
+    Quatf const a = make_quat_rotation_z(0.3f) * make_quat_rotation_x(0.1f);
+    Quatf const b = make_quat_rotation_z(0.35f) * make_quat_rotation_x(0.12f);
+    for (float t : {0.1f, 0.3f, 0.5f, 0.7f, 0.9f}) {
+      REQUIRE(angle_between_(nlerp(a, b, t), slerp(a, b, t)) < 1e-3f);
+    }
+  }
+
+  SECTION("TRS matches T * R * S") {
+    for (int n = 0; n < 100; ++n) {
+      float const a = angle(rng);
+      Vec3f const t{offset(rng), offset(rng), offset(rng)};
+      TrsTransform const trs{t, make_quat_rotation_x(a), {2.f, 3.f, 0.5f}};
+      require_close_(to_mat44(trs),
+                     make_translation(t) * make_rotation_x(a) *
+                         make_scaling(2.f, 3.f, 0.5f),
+                     1e-4f);
+    }
+  }
+
+  SECTION("TRS product with uniform scale") {
+    for (int n = 0; n < 100; ++n) {
+      TrsTransform const a{{offset(rng), offset(rng), offset(rng)},
+                           make_quat_rotation_y(angle(rng)),
+                           {2.f, 2.f, 2.f}};
+      TrsTransform const b{{offset(rng), offset(rng), offset(rng)},
+                           make_quat_rotation_z(angle(rng)),
+                           {0.5f, 0.5f, 0.5f}};
+      require_close_(to_mat44(a * b), to_mat44(a) * to_mat44(b), 1e-3f);
+    }
+  }
+
+  SECTION("TRS interpolation endpoints") {
+    TrsTransform const a{{1.f, 2.f, 3.f}, make_quat_rotation_x(0.5f)};
+    TrsTransform const b{{-1.f, 0.f, 5.f}, make_quat_rotation_y(-0.5f)};
+    require_close_(to_mat44(interpolate(a, b, 0.f)), to_mat44(a), kEps_);
+    require_close_(to_mat44(interpolate(a, b, 1.f)), to_mat44(b), kEps_);
+  }
+}
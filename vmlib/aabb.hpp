@@ -0,0 +1,88 @@
+#ifndef AABB_HPP_9E3B1F60_5C27_4D84_B0A9_7F14E6C2D358
+#define AABB_HPP_9E3B1F60_5C27_4D84_B0A9_7F14E6C2D358
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <span>
+
+#include "affine34.hpp"
+#include "vec3.hpp"
+
+/** Aabb: axis-aligned bounding box
+ *
+ * The default box is empty (min > max), so merging into it gives the other
+ * box unchanged.
+ */
+struct Aabb {
+  Vec3f min{std::numeric_limits<float>::max(),
+            std::numeric_limits<float>::max(),
+            std::numeric_limits<float>::max()};
+  Vec3f max{std::numeric_limits<float>::lowest(),
+            std::numeric_limits<float>::lowest(),
+            std::numeric_limits<float>::lowest()};
+};
+
+constexpr bool is_empty(Aabb const& aBox) noexcept {
+  return aBox.min.x > aBox.max.x || aBox.min.y > aBox.max.y ||
+         aBox.min.z > aBox.max.z;
+}
+
+constexpr Vec3f component_min(Vec3f aLeft, Vec3f aRight) noexcept {
+  return Vec3f{std::min(aLeft.x, aRight.x), std::min(aLeft.y, aRight.y),
+               std::min(aLeft.z, aRight.z)};
+}
+constexpr Vec3f component_max(Vec3f aLeft, Vec3f aRight) noexcept {
+  return Vec3f{std::max(aLeft.x, aRight.x), std::max(aLeft.y, aRight.y),
+               std::max(aLeft.z, aRight.z)};
+}
+
+constexpr Aabb merge(Aabb const& aLeft, Aabb const& aRight) noexcept {
+  return Aabb{component_min(aLeft.min, aRight.min),
+              component_max(aLeft.max, aRight.max)};
+}
+constexpr Aabb merge(Aabb const& aBox, Vec3f aPoint) noexcept {
+  return Aabb{component_min(aBox.min, aPoint), component_max(aBox.max, aPoint)};
+}
+
+constexpr Vec3f center(Aabb const& aBox) noexcept {
+  return (aBox.min + aBox.max) / 2.f;
+}
+constexpr Vec3f extent(Aabb const& aBox) noexcept {
+  return aBox.max - aBox.min;
+}
+
+// Half the surface area, the quantity compared by SAH builders
+constexpr float half_area(Aabb const& aBox) noexcept {
+  Vec3f const e = extent(aBox);
+  return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+constexpr bool overlaps(Aabb const& aLeft, Aabb const& aRight) noexcept {
+  return aLeft.min.x <= aRight.max.x && aRight.min.x <= aLeft.max.x &&
+         aLeft.min.y <= aRight.max.y && aRight.min.y <= aLeft.max.y &&
+         aLeft.min.z <= aRight.max.z && aRight.min.z <= aLeft.max.z;
+}
+
+inline Aabb compute_bounds(std::span<Vec3f const> aPoints) noexcept {
+  Aabb ret;
+  for (Vec3f const& p : aPoints) ret = merge(ret, p);
+  return ret;
+}
+
+// Bounds of the transformed box (Arvo's method: transform the centre, and
+// the half extent by the absolute values of the linear part)
+inline Aabb transform(Affine34f const& aA, Aabb const& aBox) noexcept {
+  if (is_empty(aBox)) return aBox;
+
+  Vec3f const c = transform_point(aA, center(aBox));
+  Vec3f const h = extent(aBox) / 2.f;
+  Vec3f r{};
+  for (std::size_t i = 0; i < 3; ++i) {
+    r[i] = std::abs(aA(i, 0)) * h.x + std::abs(aA(i, 1)) * h.y +
+           std::abs(aA(i, 2)) * h.z;
+  }
+  return Aabb{c - r, c + r};
+}
+
+#endif  // AABB_HPP_9E3B1F60_5C27_4D84_B0A9_7F14E6C2D358
@@ -0,0 +1,186 @@
+#ifndef AFFINE34_HPP_2C6E0F93_7B41_4D8A_A5F2_19E3C84B6D07
+#define AFFINE34_HPP_2C6E0F93_7B41_4D8A_A5F2_19E3C84B6D07
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+
+#include "mat33.hpp"
+#include "mat44.hpp"
+#include "vec3.hpp"
+
+/** Affine34f: affine transform stored as the upper 3x4 block of a Mat44f
+ *
+ * The bottom row is implicitly (0, 0, 0, 1). Row-major, like Mat44f:
+ *
+ *   ⎛ 0,0  0,1  0,2  0,3 ⎞
+ *   ⎜ 1,0  1,1  1,2  1,3 ⎟
+ *   ⎝ 2,0  2,1  2,2  2,3 ⎠
+ *
+ * Composing, inverting and deriving the normal matrix only need the 3x3 block
+ * and the translation, which makes them several times cheaper than the
+ * general 4x4 invert().
+ */
+struct Affine34f {
+  float v[12];
+
+  constexpr float& operator()(std::size_t aI, std::size_t aJ) noexcept {
+    assert(aI < 3 && aJ < 4);
+    return v[aI * 4 + aJ];
+  }
+  constexpr float const& operator()(std::size_t aI,
+                                    std::size_t aJ) const noexcept {
+    assert(aI < 3 && aJ < 4);
+    return v[aI * 4 + aJ];
+  }
+};
+
+constexpr Affine34f kIdentity34f = {
+    {1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f}};
+
+/** RigidTransform: rotation followed by translation
+ *
+ * `rotation` must be orthonormal. The inverse is then the transposed rotation
+ * and the normal matrix is the rotation itself.
+ */
+struct RigidTransform {
+  Mat33f rotation;
+  Vec3f translation;
+};
+
+constexpr RigidTransform kIdentityRigid = {kIdentity33f, {0.f, 0.f, 0.f}};
+
+// Conversions. aM must be affine (bottom row 0, 0, 0, 1).
+
+constexpr Affine34f to_affine34(Mat44f const& aM) noexcept {
+  Affine34f ret{};
+  for (std::size_t i = 0; i < 12; ++i) ret.v[i] = aM.v[i];
+  return ret;
+}
+
+constexpr Affine34f to_affine34(RigidTransform const& aT) noexcept {
+  Affine34f ret{};
+  for (std::size_t i = 0; i < 3; ++i) {
+    for (std::size_t j = 0; j < 3; ++j) ret(i, j) = aT.rotation(i, j);
+    ret(i, 3) = aT.translation[i];
+  }
+  return ret;
+}
+
+constexpr Mat44f to_mat44(Affine34f const& aA) noexcept {
+  Mat44f ret{};
+  for (std::size_t i = 0; i < 12; ++i) ret.v[i] = aA.v[i];
+  ret(3, 3) = 1.f;
+  return ret;
+}
+
+constexpr Mat44f to_mat44(RigidTransform const& aT) noexcept {
+  return to_mat44(to_affine34(aT));
+}
+
+constexpr Mat33f linear_part(Affine34f const& aA) noexcept {
+  Mat33f ret{};
+  for (std::size_t i = 0; i < 3; ++i) {
+    for (std::size_t j = 0; j < 3; ++j) ret(i, j) = aA(i, j);
+  }
+  return ret;
+}
+
+// Operators
+
+constexpr Affine34f operator*(Affine34f const& aLeft,
+                              Affine34f const& aRight) noexcept {
+  // Written out row by row; the generic triple loop does not vectorise
+  Affine34f ret{};
+  for (std::size_t i = 0; i < 3; ++i) {
+    float const a0 = aLeft.v[i * 4 + 0];
+    float const a1 = aLeft.v[i * 4 + 1];
+    float const a2 = aLeft.v[i * 4 + 2];
+    for (std::size_t j = 0; j < 4; ++j) {
+      ret.v[i * 4 + j] = a0 * aRight.v[j] + a1 * aRight.v[4 + j] +
+                         a2 * aRight.v[8 + j];
+    }
+    ret.v[i * 4 + 3] += aLeft.v[i * 4 + 3];
+  }
+  return ret;
+}
+
+constexpr RigidTransform operator*(RigidTransform const& aLeft,
+                                   RigidTransform const& aRight) noexcept {
+  return {aLeft.rotation * aRight.rotation,
+          aLeft.rotation * aRight.translation + aLeft.translation};
+}
+
+// Functions:
+
+constexpr Vec3f transform_point(Affine34f const& aA, Vec3f aP) noexcept {
+  return Vec3f{aA(0, 0) * aP.x + aA(0, 1) * aP.y + aA(0, 2) * aP.z + aA(0, 3),
+               aA(1, 0) * aP.x + aA(1, 1) * aP.y + aA(1, 2) * aP.z + aA(1, 3),
+               aA(2, 0) * aP.x + aA(2, 1) * aP.y + aA(2, 2) * aP.z + aA(2, 3)};
+}
+constexpr Vec3f transform_vector(Affine34f const& aA, Vec3f aV) noexcept {
+  return Vec3f{aA(0, 0) * aV.x + aA(0, 1) * aV.y + aA(0, 2) * aV.z,
+               aA(1, 0) * aV.x + aA(1, 1) * aV.y + aA(1, 2) * aV.z,
+               aA(2, 0) * aV.x + aA(2, 1) * aV.y + aA(2, 2) * aV.z};
+}
+
+constexpr Vec3f transform_point(RigidTransform const& aT, Vec3f aP) noexcept {
+  return aT.rotation * aP + aT.translation;
+}
+constexpr Vec3f transform_vector(RigidTransform const& aT, Vec3f aV) noexcept {
+  return aT.rotation * aV;
+}
+
+// Cofactor matrix of the 3x3 block, i.e. det * inverse-transpose
+constexpr Mat33f cofactors(Affine34f const& aA) noexcept {
+  return Mat33f{{aA(1, 1) * aA(2, 2) - aA(1, 2) * aA(2, 1),
+                 aA(1, 2) * aA(2, 0) - aA(1, 0) * aA(2, 2),
+                 aA(1, 0) * aA(2, 1) - aA(1, 1) * aA(2, 0),
+                 aA(0, 2) * aA(2, 1) - aA(0, 1) * aA(2, 2),
+                 aA(0, 0) * aA(2, 2) - aA(0, 2) * aA(2, 0),
+                 aA(0, 1) * aA(2, 0) - aA(0, 0) * aA(2, 1),
+                 aA(0, 1) * aA(1, 2) - aA(0, 2) * aA(1, 1),
+                 aA(0, 2) * aA(1, 0) - aA(0, 0) * aA(1, 2),
+                 aA(0, 0) * aA(1, 1) - aA(0, 1) * aA(1, 0)}};
+}
+
+// aA must be invertible
+inline Affine34f invert(Affine34f const& aA) noexcept {
+  Mat33f const c = cofactors(aA);
+  float const det = aA(0, 0) * c(0, 0) + aA(0, 1) * c(0, 1) +
+                    aA(0, 2) * c(0, 2);
+  assert(det != 0.f);
+  float const invDet = 1.f / det;
+
+  Affine34f ret{};
+  for (std::size_t i = 0; i < 3; ++i) {
+    for (std::size_t j = 0; j < 3; ++j) ret(i, j) = c(j, i) * invDet;
+  }
+  for (std::size_t i = 0; i < 3; ++i) {
+    ret(i, 3) = -(ret(i, 0) * aA(0, 3) + ret(i, 1) * aA(1, 3) +
+                  ret(i, 2) * aA(2, 3));
+  }
+  return ret;
+}
+
+constexpr RigidTransform invert(RigidTransform const& aT) noexcept {
+  Mat33f const rt = transpose(aT.rotation);
+  return {rt, -(rt * aT.translation)};
+}
+
+// Inverse-transpose of the 3x3 block, for transforming normals
+inline Mat33f normal_matrix(Affine34f const& aA) noexcept {
+  Mat33f ret = cofactors(aA);
+  float const det = aA(0, 0) * ret(0, 0) + aA(0, 1) * ret(0, 1) +
+                    aA(0, 2) * ret(0, 2);
+  assert(det != 0.f);
+  float const invDet = 1.f / det;
+  for (float& x : ret.v) x *= invDet;
+  return ret;
+}
+
+constexpr Mat33f normal_matrix(RigidTransform const& aT) noexcept {
+  return aT.rotation;
+}
+
+#endif  // AFFINE34_HPP_2C6E0F93_7B41_4D8A_A5F2_19E3C84B6D07
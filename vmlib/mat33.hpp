@@ -68,8 +68,35 @@ Vec3f operator*( Mat33f const& aLeft, Vec3f const& aRight ) noexcept
 	return ret;
 }
 
+constexpr
+Mat33f operator*( Mat33f const& aLeft, Mat33f const& aRight ) noexcept
+{
+	Mat33f ret{};
+	for( std::size_t i = 0; i < 3; ++i )
+	{
+		for( std::size_t j = 0; j < 3; ++j )
+		{
+			for( std::size_t k = 0; k < 3; ++k )
+				ret(i,j) += aLeft(i,k) * aRight(k,j);
+		}
+	}
+	return ret;
+}
+
 // Functions:
 
+constexpr
+Mat33f transpose( Mat33f const& aM ) noexcept
+{
+	Mat33f ret{};
+	for( std::size_t i = 0; i < 3; ++i )
+	{
+		for( std::size_t j = 0; j < 3; ++j )
+			ret(j,i) = aM(i,j);
+	}
+	return ret;
+}
+
 inline
 Mat33f mat44_to_mat33( Mat44f const& aM )
 {
@@ -0,0 +1,165 @@
+#ifndef QUANTIZE_HPP_7A45BC20_0AF7_42F4_BEB7_F2EBD44D2B61
+#define QUANTIZE_HPP_7A45BC20_0AF7_42F4_BEB7_F2EBD44D2B61
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "vec2.hpp"
+#include "vec3.hpp"
+
+/* Conversions between floats and the compact formats used for vertex data
+ *
+ * The decoders mirror what OpenGL does when fetching normalized integer and
+ * half float attributes, so that CPU-side round trips give the exact values
+ * the vertex shader will see:
+ *   UNORM16            c / 65535
+ *   SNORM16            max(c / 32767, -1)
+ *   UNORM 2_10_10_10   x / 1023 (RGB), w / 3 (A)
+ */
+
+// IEEE 754 binary16, round to nearest even
+inline std::uint16_t float_to_half(float aValue) noexcept {
+  std::uint32_t bits;
+  std::memcpy(&bits, &aValue, sizeof(bits));
+
+  auto const sign = std::uint16_t((bits >> 16) & 0x8000u);
+  std::uint32_t const absBits = bits & 0x7fffffffu;
+
+  if (absBits >= 0x7f800000u)  // Inf or NaN (keep NaNs quiet)
+    return sign | std::uint16_t(absBits > 0x7f800000u ? 0x7e00u : 0x7c00u);
+  if (absBits >= 0x477ff000u)  // rounds to a value above 65504
+    return sign | std::uint16_t(0x7c00u);
+
+  if (absBits < 0x38800000u) {  // below 2^-14: subnormal half (or zero)
+    if (absBits < 0x33000000u) return sign;
+
+    std::uint32_t const exp = absBits >> 23;
+    std::uint32_t const mant = (absBits & 0x7fffffu) | 0x800000u;
+    std::uint32_t const shift = 126 - exp;
+    std::uint32_t m = mant >> shift;
+    std::uint32_t const rem = mant & ((1u << shift) - 1u);
+    std::uint32_t const halfway = 1u << (shift - 1);
+    if (rem > halfway || (rem == halfway && (m & 1u))) ++m;
+    return sign | std::uint16_t(m);
+  }
+
+  // Rebias the exponent from 127 to 15 and drop 13 mantissa bits. A carry
+  // out of the mantissa correctly bumps the exponent.
+  std::uint32_t h = (absBits - 0x38000000u) >> 13;
+  std::uint32_t const rem = absBits & 0x1fffu;
+  if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) ++h;
+  return sign | std::uint16_t(h);
+}
+
+inline float half_to_float(std::uint16_t aValue) noexcept {
+  std::uint32_t const sign = std::uint32_t(aValue & 0x8000u) << 16;
+  std::uint32_t const exp = (aValue >> 10) & 0x1fu;
+  std::uint32_t const mant = aValue & 0x3ffu;
+
+  if (0 == exp) {
+    float const v = std::ldexp(float(mant), -24);
+    return sign ? -v : v;
+  }
+
+  std::uint32_t const bits =
+      31 == exp ? (sign | 0x7f800000u | (mant << 13))
+                : (sign | ((exp + 112) << 23) | (mant << 13));
+  float ret;
+  std::memcpy(&ret, &bits, sizeof(ret));
+  return ret;
+}
+
+inline std::uint16_t quantize_unorm16(float aValue) noexcept {
+  return std::uint16_t(std::lround(std::clamp(aValue, 0.f, 1.f) * 65535.f));
+}
+constexpr float dequantize_unorm16(std::uint16_t aValue) noexcept {
+  return float(aValue) / 65535.f;
+}
+
+inline std::int16_t quantize_snorm16(float aValue) noexcept {
+  return std::int16_t(std::lround(std::clamp(aValue, -1.f, 1.f) * 32767.f));
+}
+constexpr float dequantize_snorm16(std::int16_t aValue) noexcept {
+  return std::max(float(aValue) / 32767.f, -1.f);
+}
+
+// RGB in the 10-bit fields of GL_UNSIGNED_INT_2_10_10_10_REV, alpha = 1.
+// Components are clamped to [0, 1].
+inline std::uint32_t pack_unorm_1010102(Vec3f aValue) noexcept {
+  auto q = [](float aX) {
+    return std::uint32_t(std::lround(std::clamp(aX, 0.f, 1.f) * 1023.f));
+  };
+  return q(aValue.x) | q(aValue.y) << 10 | q(aValue.z) << 20 | 3u << 30;
+}
+constexpr Vec3f unpack_unorm_1010102(std::uint32_t aValue) noexcept {
+  return Vec3f{float(aValue & 0x3ffu) / 1023.f,
+               float((aValue >> 10) & 0x3ffu) / 1023.f,
+               float((aValue >> 20) & 0x3ffu) / 1023.f};
+}
+
+/* Octahedral unit vector encoding
+ *
+ * Projects the unit sphere onto the octahedron |x|+|y|+|z| = 1 and unfolds
+ * the lower half into the corners of the [-1,1]^2 square (Cigolle et al.,
+ * "A Survey of Efficient Representations for Independent Unit Vectors").
+ */
+inline Vec2f oct_encode(Vec3f aNormal) noexcept {
+  auto signNotZero = [](float aX) { return aX >= 0.f ? 1.f : -1.f; };
+
+  float const l1 =
+      std::abs(aNormal.x) + std::abs(aNormal.y) + std::abs(aNormal.z);
+  Vec2f p{aNormal.x / l1, aNormal.y / l1};
+  if (aNormal.z < 0.f) {
+    p = Vec2f{(1.f - std::abs(p.y)) * signNotZero(p.x),
+              (1.f - std::abs(p.x)) * signNotZero(p.y)};
+  }
+  return p;
+}
+
+inline Vec3f oct_decode(Vec2f aEncoded) noexcept {
+  Vec3f n{aEncoded.x, aEncoded.y,
+          1.f - std::abs(aEncoded.x) - std::abs(aEncoded.y)};
+  float const t = std::max(-n.z, 0.f);
+  n.x += n.x >= 0.f ? -t : t;
+  n.y += n.y >= 0.f ? -t : t;
+  return normalize(n);
+}
+
+// Octahedral encoding in two SNORM16 values. Tries the four neighbouring
+// grid points and keeps the one that decodes closest to aNormal.
+inline std::array<std::int16_t, 2> oct_encode_snorm16(
+    Vec3f aNormal) noexcept {
+  Vec2f const p = oct_encode(aNormal);
+
+  std::array<std::int16_t, 2> best{quantize_snorm16(p.x),
+                                   quantize_snorm16(p.y)};
+  float bestDot = -2.f;
+  for (int i = 0; i < 4; ++i) {
+    float const fx = (i & 1) ? std::ceil(p.x * 32767.f)
+                             : std::floor(p.x * 32767.f);
+    float const fy = (i & 2) ? std::ceil(p.y * 32767.f)
+                             : std::floor(p.y * 32767.f);
+    std::array<std::int16_t, 2> const c{
+        std::int16_t(std::clamp(fx, -32767.f, 32767.f)),
+        std::int16_t(std::clamp(fy, -32767.f, 32767.f))};
+
+    float const d = dot(aNormal, oct_decode(Vec2f{dequantize_snorm16(c[0]),
+                                                  dequantize_snorm16(c[1])}));
+    if (d > bestDot) {
+      bestDot = d;
+      best = c;
+    }
+  }
+  return best;
+}
+
+inline Vec3f oct_decode_snorm16(
+    std::array<std::int16_t, 2> aEncoded) noexcept {
+  return oct_decode(
+      Vec2f{dequantize_snorm16(aEncoded[0]), dequantize_snorm16(aEncoded[1])});
+}
+
+#endif  // QUANTIZE_HPP_7A45BC20_0AF7_42F4_BEB7_F2EBD44D2B61
@@ -0,0 +1,169 @@
+#ifndef QUAT_HPP_4B0D7E25_91C8_4A36_8F1E_D62A5C093B7F
+#define QUAT_HPP_4B0D7E25_91C8_4A36_8F1E_D62A5C093B7F
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+
+#include "affine34.hpp"
+#include "mat33.hpp"
+#include "mat44.hpp"
+#include "vec3.hpp"
+
+/** Quatf: rotation quaternion, w + xi + yj + zk
+ *
+ * Rotation quaternions have unit length; q and -q are the same rotation.
+ * The product a * b applies b first, like the matrix product. The
+ * make_quat_rotation_* functions match make_rotation_x/y/z in mat44.hpp.
+ */
+struct Quatf {
+  float x, y, z, w;
+};
+
+constexpr Quatf kIdentityQuatf = {0.f, 0.f, 0.f, 1.f};
+
+// Operators
+
+constexpr Quatf operator*(Quatf const& aLeft, Quatf const& aRight) noexcept {
+  return Quatf{
+      aLeft.w * aRight.x + aLeft.x * aRight.w + aLeft.y * aRight.z -
+          aLeft.z * aRight.y,
+      aLeft.w * aRight.y - aLeft.x * aRight.z + aLeft.y * aRight.w +
+          aLeft.z * aRight.x,
+      aLeft.w * aRight.z + aLeft.x * aRight.y - aLeft.y * aRight.x +
+          aLeft.z * aRight.w,
+      aLeft.w * aRight.w - aLeft.x * aRight.x - aLeft.y * aRight.y -
+          aLeft.z * aRight.z};
+}
+
+// Functions:
+
+constexpr float dot(Quatf const& aLeft, Quatf const& aRight) noexcept {
+  return aLeft.x * aRight.x + aLeft.y * aRight.y + aLeft.z * aRight.z +
+         aLeft.w * aRight.w;
+}
+
+// Inverse of a unit quaternion
+constexpr Quatf conjugate(Quatf const& aQ) noexcept {
+  return Quatf{-aQ.x, -aQ.y, -aQ.z, aQ.w};
+}
+
+inline Quatf normalize(Quatf const& aQ) noexcept {
+  float const len = std::sqrt(dot(aQ, aQ));
+  assert(len > 0.f);
+  float const inv = 1.f / len;
+  return Quatf{aQ.x * inv, aQ.y * inv, aQ.z * inv, aQ.w * inv};
+}
+
+// aAxis must be normalized
+inline Quatf make_quat_axis_angle(Vec3f aAxis, float aAngle) noexcept {
+  float const s = std::sin(0.5f * aAngle);
+  float const c = std::cos(0.5f * aAngle);
+  return Quatf{aAxis.x * s, aAxis.y * s, aAxis.z * s, c};
+}
+
+inline Quatf make_quat_rotation_x(float aAngle) noexcept {
+  return Quatf{std::sin(0.5f * aAngle), 0.f, 0.f, std::cos(0.5f * aAngle)};
+}
+inline Quatf make_quat_rotation_y(float aAngle) noexcept {
+  return Quatf{0.f, std::sin(0.5f * aAngle), 0.f, std::cos(0.5f * aAngle)};
+}
+inline Quatf make_quat_rotation_z(float aAngle) noexcept {
+  return Quatf{0.f, 0.f, std::sin(0.5f * aAngle), std::cos(0.5f * aAngle)};
+}
+
+// q v q*, without building the matrix
+inline Vec3f rotate(Quatf const& aQ, Vec3f aV) noexcept {
+  Vec3f const u{aQ.x, aQ.y, aQ.z};
+  Vec3f const t = 2.f * cross(u, aV);
+  return aV + aQ.w * t + cross(u, t);
+}
+
+constexpr Mat33f to_mat33(Quatf const& aQ) noexcept {
+  float const xx = aQ.x * aQ.x, yy = aQ.y * aQ.y, zz = aQ.z * aQ.z;
+  float const xy = aQ.x * aQ.y, xz = aQ.x * aQ.z, yz = aQ.y * aQ.z;
+  float const wx = aQ.w * aQ.x, wy = aQ.w * aQ.y, wz = aQ.w * aQ.z;
+  return Mat33f{{1.f - 2.f * (yy + zz), 2.f * (xy - wz), 2.f * (xz + wy),
+                 2.f * (xy + wz), 1.f - 2.f * (xx + zz), 2.f * (yz - wx),
+                 2.f * (xz - wy), 2.f * (yz + wx), 1.f - 2.f * (xx + yy)}};
+}
+
+constexpr Mat44f to_mat44(Quatf const& aQ) noexcept {
+  return to_mat44(RigidTransform{to_mat33(aQ), {0.f, 0.f, 0.f}});
+}
+
+// Normalized linear interpolation along the shorter arc. Cheap, and close to
+// slerp() for the small steps between simulation ticks.
+inline Quatf nlerp(Quatf const& aFrom, Quatf const& aTo, float aT) noexcept {
+  float const sign = dot(aFrom, aTo) < 0.f ? -1.f : 1.f;
+  return normalize(Quatf{aFrom.x + aT * (sign * aTo.x - aFrom.x),
+                         aFrom.y + aT * (sign * aTo.y - aFrom.y),
+                         aFrom.z + aT * (sign * aTo.z - aFrom.z),
+                         aFrom.w + aT * (sign * aTo.w - aFrom.w)});
+}
+
+// Constant angular velocity interpolation along the shorter arc
+inline Quatf slerp(Quatf const& aFrom, Quatf const& aTo, float aT) noexcept {
+  float cosTheta = dot(aFrom, aTo);
+  float sign = 1.f;
+  if (cosTheta < 0.f) {
+    cosTheta = -cosTheta;
+    sign = -1.f;
+  }
+  // Nearly parallel: sin(theta) is too small to divide by
+  if (cosTheta > 0.9995f) return nlerp(aFrom, aTo, aT);
+
+  float const theta = std::acos(std::min(cosTheta, 1.f));
+  float const invSin = 1.f / std::sin(theta);
+  float const a = std::sin((1.f - aT) * theta) * invSin;
+  float const b = sign * std::sin(aT * theta) * invSin;
+  return Quatf{a * aFrom.x + b * aTo.x, a * aFrom.y + b * aTo.y,
+               a * aFrom.z + b * aTo.z, a * aFrom.w + b * aTo.w};
+}
+
+/** TrsTransform: scale, then rotate, then translate
+ *
+ * Ten floats instead of sixteen, and cheap to interpolate. Products of
+ * transforms with non-uniform scale are only exact when the scale axes line
+ * up with the rotation; the ship and camera use unit scale.
+ */
+struct TrsTransform {
+  Vec3f translation{0.f, 0.f, 0.f};
+  Quatf rotation = kIdentityQuatf;
+  Vec3f scale{1.f, 1.f, 1.f};
+};
+
+inline TrsTransform operator*(TrsTransform const& aLeft,
+                              TrsTransform const& aRight) noexcept {
+  Vec3f const scaled{aLeft.scale.x * aRight.translation.x,
+                     aLeft.scale.y * aRight.translation.y,
+                     aLeft.scale.z * aRight.translation.z};
+  return TrsTransform{
+      aLeft.translation + rotate(aLeft.rotation, scaled),
+      aLeft.rotation * aRight.rotation,
+      Vec3f{aLeft.scale.x * aRight.scale.x, aLeft.scale.y * aRight.scale.y,
+            aLeft.scale.z * aRight.scale.z}};
+}
+
+constexpr Affine34f to_affine34(TrsTransform const& aT) noexcept {
+  Mat33f const r = to_mat33(aT.rotation);
+  float const sx = aT.scale.x, sy = aT.scale.y, sz = aT.scale.z;
+  return Affine34f{{r.v[0] * sx, r.v[1] * sy, r.v[2] * sz, aT.translation.x,
+                    r.v[3] * sx, r.v[4] * sy, r.v[5] * sz, aT.translation.y,
+                    r.v[6] * sx, r.v[7] * sy, r.v[8] * sz, aT.translation.z}};
+}
+
+constexpr Mat44f to_mat44(TrsTransform const& aT) noexcept {
+  return to_mat44(to_affine34(aT));
+}
+
+inline TrsTransform interpolate(TrsTransform const& aFrom,
+                                TrsTransform const& aTo, float aT) noexcept {
+  return TrsTransform{
+      aFrom.translation + aT * (aTo.translation - aFrom.translation),
+      nlerp(aFrom.rotation, aTo.rotation, aT),
+      aFrom.scale + aT * (aTo.scale - aFrom.scale)};
+}
+
+#endif  // QUAT_HPP_4B0D7E25_91C8_4A36_8F1E_D62A5C093B7F